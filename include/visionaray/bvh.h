@@ -25,6 +25,9 @@
 
 namespace visionaray
 {
+
+class thread_pool;
+
 namespace detail
 {
 
@@ -42,15 +45,45 @@ inline T const* get_pointer(thrust::device_vector<T> const& vec)
     return thrust::raw_pointer_cast(vec.data());
 }
 #endif
+
+// Inverse of the linear interpolation between two transforms at TIME (clamped to [0..1])
+template <typename T>
+VSNRAY_FUNC
+inline matrix<4, 4, T> interpolate_transform_inv(mat4 const& transform0, mat4 const& transform1, T const& time)
+{
+    T x = saturate(time);
+
+    matrix<4, 4, T> m0(transform0);
+    matrix<4, 4, T> m1(transform1);
+
+    return inverse(matrix<4, 4, T>(
+            lerp(m0.col0, m1.col0, x),
+            lerp(m0.col1, m1.col1, x),
+            lerp(m0.col2, m1.col2, x),
+            lerp(m0.col3, m1.col3, x)
+            ));
+}
+
 } // detail
 
 
 //--------------------------------------------------------------------------------------------------
 // bvh_node
 //
+// Leaves store the number of primitives in num_prims. Inner nodes set InnerBit
+// and store the axis along which the two children are separated the most, and
+// which of the children lies on the low side of that axis (LowChildBit).
+//
 
 struct VSNRAY_ALIGN(32) bvh_node
 {
+    enum : unsigned
+    {
+        InnerBit    = 0x80000000,
+        LowChildBit = 0x4,
+        AxisMask    = 0x3
+    };
+
     float bbox_min[3];
     union
     {
@@ -60,8 +93,8 @@ struct VSNRAY_ALIGN(32) bvh_node
     float bbox_max[3];
     unsigned num_prims;
 
-    VSNRAY_FUNC bool is_inner() const { return num_prims == 0; }
-    VSNRAY_FUNC bool is_leaf() const { return num_prims != 0; }
+    VSNRAY_FUNC bool is_inner() const { return (num_prims & InnerBit) != 0; }
+    VSNRAY_FUNC bool is_leaf() const { return !is_inner(); }
 
     VSNRAY_FUNC aabb const& get_bounds() const
     {
@@ -87,6 +120,19 @@ struct VSNRAY_ALIGN(32) bvh_node
         return { first_prim, first_prim + num_prims };
     }
 
+    VSNRAY_FUNC unsigned get_split_axis() const
+    {
+        assert(is_inner());
+        return num_prims & AxisMask;
+    }
+
+    // Index (0 or 1) of the child on the low side of the split axis
+    VSNRAY_FUNC unsigned get_low_child() const
+    {
+        assert(is_inner());
+        return (num_prims & LowChildBit) != 0 ? 1 : 0;
+    }
+
     VSNRAY_FUNC unsigned get_first_primitive() const
     {
         assert(is_leaf());
@@ -104,7 +150,30 @@ struct VSNRAY_ALIGN(32) bvh_node
         memcpy(bbox_min, &bounds.min, sizeof(bbox_min));
         memcpy(bbox_max, &bounds.max, sizeof(bbox_max));
         first_child = first_child_index;
-        num_prims = 0;
+        num_prims = InnerBit;
+    }
+
+    // Also store the split axis, derived from the bounds of the two children
+    VSNRAY_FUNC void set_inner(
+            aabb const& bounds,
+            unsigned    first_child_index,
+            aabb const& left,
+            aabb const& right
+            )
+    {
+        set_inner(bounds, first_child_index);
+
+        vec3 d = (right.min + right.max) - (left.min + left.max);
+        vec3 ad(d.x < 0.0f ? -d.x : d.x, d.y < 0.0f ? -d.y : d.y, d.z < 0.0f ? -d.z : d.z);
+
+        unsigned axis = ad.x >= ad.y && ad.x >= ad.z ? 0 : ad.y >= ad.z ? 1 : 2;
+
+        num_prims |= axis;
+
+        if (d[axis] < 0.0f)
+        {
+            num_prims |= LowChildBit;
+        }
     }
 
     VSNRAY_FUNC void set_leaf(aabb const& bounds, unsigned first_primitive_index, unsigned count)
@@ -116,6 +185,12 @@ struct VSNRAY_ALIGN(32) bvh_node
         first_prim = first_primitive_index;
         num_prims = count;
     }
+
+    VSNRAY_FUNC void set_bounds(aabb const& bounds)
+    {
+        memcpy(bbox_min, &bounds.min, sizeof(bbox_min));
+        memcpy(bbox_max, &bounds.max, sizeof(bbox_max));
+    }
 };
 
 static_assert( sizeof(bvh_node) == 32, "Size mismatch" );
@@ -140,21 +215,70 @@ inline bool operator==(bvh_node const& a, bvh_node const& b)
 }
 
 
+//--------------------------------------------------------------------------------------------------
+// motion_bvh_node
+//
+// Node of a motion BVH. The bvh_node bounds enclose the subtree over the whole
+// motion interval, so that algorithms that are unaware of motion stay correct.
+// In addition, the node stores the bounds at the motion keys (time 0 and 1).
+// Primitives move linearly between the keys, so at time t the subtree lies
+// within the linear interpolation of the key bounds. Key bounds enclose whole
+// primitives, they are not clipped by spatial splits.
+//
+
+struct VSNRAY_ALIGN(32) motion_bvh_node : bvh_node
+{
+    float key_min[2][3];
+    float key_max[2][3];
+
+    VSNRAY_FUNC aabb get_key_bounds(int key) const
+    {
+        return aabb(
+                vec3(key_min[key][0], key_min[key][1], key_min[key][2]),
+                vec3(key_max[key][0], key_max[key][1], key_max[key][2])
+                );
+    }
+
+    VSNRAY_FUNC void set_key_bounds(int key, aabb const& bounds)
+    {
+        memcpy(key_min[key], &bounds.min, sizeof(key_min[key]));
+        memcpy(key_max[key], &bounds.max, sizeof(key_max[key]));
+    }
+
+    // Bounds at TIME (clamped to [0..1]), T may be a SIMD type
+    template <typename T>
+    VSNRAY_FUNC basic_aabb<T> get_bounds_at(T const& time) const
+    {
+        T x = saturate(time);
+
+        vector<3, T> min0(key_min[0][0], key_min[0][1], key_min[0][2]);
+        vector<3, T> max0(key_max[0][0], key_max[0][1], key_max[0][2]);
+        vector<3, T> min1(key_min[1][0], key_min[1][1], key_min[1][2]);
+        vector<3, T> max1(key_max[1][0], key_max[1][1], key_max[1][2]);
+
+        return basic_aabb<T>(lerp(min0, min1, x), lerp(max0, max1, x));
+    }
+};
+
+static_assert( sizeof(motion_bvh_node) == 96, "Size mismatch" );
+
+
 //--------------------------------------------------------------------------------------------------
 // [index_]bvh_ref_t
 //
 
-template <typename PrimitiveType>
+template <typename PrimitiveType, typename Node = bvh_node>
 class bvh_ref_t
 {
 public:
 
     using primitive_type = PrimitiveType;
+    using node_type      = Node;
 
 private:
 
     using P = const PrimitiveType;
-    using N = const bvh_node;
+    using N = const Node;
 
     P* primitives_first;
     P* primitives_last;
@@ -195,17 +319,18 @@ public:
     }
 };
 
-template <typename PrimitiveType>
+template <typename PrimitiveType, typename Node = bvh_node>
 class index_bvh_ref_t
 {
 public:
 
     using primitive_type = PrimitiveType;
+    using node_type      = Node;
 
 private:
 
     using P = const PrimitiveType;
-    using N = const bvh_node;
+    using N = const Node;
     using I = const unsigned;
 
     P* primitives_first;
@@ -258,6 +383,12 @@ public:
 //--------------------------------------------------------------------------------------------------
 // [index_]bvh_inst_t
 //
+// Transformed instance of a BVH. Instances can be nested: a BVH over instances
+// can itself be instanced. Each level transforms the ray into its own object
+// space, the nesting depth is fixed by the type, so the transformations of a
+// traversal are bounded by it. Hit records store one hit_record_bvh_inst per
+// level, cf. get_inst_path().
+//
 
 template <typename PrimitiveType>
 class bvh_inst_t
@@ -311,9 +442,54 @@ public:
         return transform_inv_;
     }
 
+    // Same interface as [index_]bvh_motion_inst_t, static instances ignore TIME
+    template <typename T>
+    VSNRAY_FUNC matrix<4, 4, T> transform_inv(T const& /* time */) const
+    {
+        return matrix<4, 4, T>(transform_inv_);
+    }
+
+    VSNRAY_FUNC bool has_motion() const
+    {
+        return false;
+    }
+
+    // Update the transformation, the referenced BVH is not modified
+    VSNRAY_FUNC void set_transform(mat4 const& transform)
+    {
+        transform_inv_ = inverse(transform);
+    }
+
+    // User-defined id, reported by hit records (cf. get_inst_path())
+    VSNRAY_FUNC unsigned inst_id() const
+    {
+        return inst_id_;
+    }
+
+    VSNRAY_FUNC void set_inst_id(unsigned id)
+    {
+        inst_id_ = id;
+    }
+
+    // Hits in the instance report this geom_id instead of the one of the
+    // primitive, so that instances of a BVH can have their own materials.
+    // ~0U (the default) keeps the geom_id of the primitive
+    VSNRAY_FUNC unsigned geom_id() const
+    {
+        return geom_id_;
+    }
+
+    VSNRAY_FUNC void set_geom_id(unsigned id)
+    {
+        geom_id_ = id;
+    }
+
     VSNRAY_FUNC bool operator==(bvh_inst_t const& rhs) const
     {
-        return ref_ == rhs.ref_ && transform_inv_ == rhs.transform_inv_;
+        return ref_ == rhs.ref_
+            && transform_inv_ == rhs.transform_inv_
+            && inst_id_ == rhs.inst_id_
+            && geom_id_ == rhs.geom_id_;
     }
 
 private:
@@ -324,6 +500,10 @@ private:
     // Inverse transformation matrix
     mat4 transform_inv_;
 
+    // Per-instance shading data
+    unsigned inst_id_ = 0;
+    unsigned geom_id_ = ~0U;
+
 };
 
 template <typename PrimitiveType>
@@ -383,9 +563,54 @@ public:
         return transform_inv_;
     }
 
+    // Same interface as [index_]bvh_motion_inst_t, static instances ignore TIME
+    template <typename T>
+    VSNRAY_FUNC matrix<4, 4, T> transform_inv(T const& /* time */) const
+    {
+        return matrix<4, 4, T>(transform_inv_);
+    }
+
+    VSNRAY_FUNC bool has_motion() const
+    {
+        return false;
+    }
+
+    // Update the transformation, the referenced BVH is not modified
+    VSNRAY_FUNC void set_transform(mat4 const& transform)
+    {
+        transform_inv_ = inverse(transform);
+    }
+
+    // User-defined id, reported by hit records (cf. get_inst_path())
+    VSNRAY_FUNC unsigned inst_id() const
+    {
+        return inst_id_;
+    }
+
+    VSNRAY_FUNC void set_inst_id(unsigned id)
+    {
+        inst_id_ = id;
+    }
+
+    // Hits in the instance report this geom_id instead of the one of the
+    // primitive, so that instances of a BVH can have their own materials.
+    // ~0U (the default) keeps the geom_id of the primitive
+    VSNRAY_FUNC unsigned geom_id() const
+    {
+        return geom_id_;
+    }
+
+    VSNRAY_FUNC void set_geom_id(unsigned id)
+    {
+        geom_id_ = id;
+    }
+
     VSNRAY_FUNC bool operator==(index_bvh_inst_t const& rhs) const
     {
-        return ref_ == rhs.ref_ && transform_inv_ == rhs.transform_inv_;
+        return ref_ == rhs.ref_
+            && transform_inv_ == rhs.transform_inv_
+            && inst_id_ == rhs.inst_id_
+            && geom_id_ == rhs.geom_id_;
     }
 
 private:
@@ -396,6 +621,204 @@ private:
     // Inverse transformation matrix
     mat4 transform_inv_;
 
+    // Per-instance shading data
+    unsigned inst_id_ = 0;
+    unsigned geom_id_ = ~0U;
+
+};
+
+
+//--------------------------------------------------------------------------------------------------
+// [index_]bvh_motion_inst_t
+//
+// BVH instance with transform motion. The transformations at the two motion
+// keys are stored in addition to the static instance data, so that static
+// instances do not pay for them. Use as the primitive type of a top-level BVH
+// when some of its instances move, static instances then have equal keys.
+//
+
+template <typename PrimitiveType>
+class bvh_motion_inst_t : public bvh_inst_t<PrimitiveType>
+{
+public:
+
+    using base_type = bvh_inst_t<PrimitiveType>;
+
+public:
+
+    bvh_motion_inst_t() = default;
+
+    // Static instance, has_motion() returns false
+    bvh_motion_inst_t(bvh_ref_t<PrimitiveType> const& ref, mat4 const& transform)
+        : base_type(ref, transform)
+        , transform_{ transform, transform }
+        , motion_(false)
+    {
+    }
+
+    // Transform motion, linear interpolation from TRANSFORM0 at time 0 to
+    // TRANSFORM1 at time 1
+    bvh_motion_inst_t(bvh_ref_t<PrimitiveType> const& ref, mat4 const& transform0, mat4 const& transform1)
+        : base_type(ref, transform0)
+        , transform_{ transform0, transform1 }
+        , motion_(true)
+    {
+    }
+
+    // Inverse transformation at time 0
+    VSNRAY_FUNC mat4 const& transform_inv() const
+    {
+        return base_type::transform_inv();
+    }
+
+    // Inverse transformation at TIME (clamped to [0..1]), T may be a SIMD type
+    template <typename T>
+    VSNRAY_FUNC matrix<4, 4, T> transform_inv(T const& time) const
+    {
+        if (!motion_)
+        {
+            return matrix<4, 4, T>(base_type::transform_inv());
+        }
+
+        return detail::interpolate_transform_inv(transform_[0], transform_[1], time);
+    }
+
+    // Transformation at motion key KEY (0 or 1)
+    VSNRAY_FUNC mat4 const& transform(int key) const
+    {
+        return transform_[key];
+    }
+
+    VSNRAY_FUNC bool has_motion() const
+    {
+        return motion_;
+    }
+
+    // Update the transformation, the referenced BVH is not modified
+    VSNRAY_FUNC void set_transform(mat4 const& transform)
+    {
+        base_type::set_transform(transform);
+        transform_[0] = transform;
+        transform_[1] = transform;
+        motion_ = false;
+    }
+
+    VSNRAY_FUNC void set_transform(mat4 const& transform0, mat4 const& transform1)
+    {
+        base_type::set_transform(transform0);
+        transform_[0] = transform0;
+        transform_[1] = transform1;
+        motion_ = true;
+    }
+
+    VSNRAY_FUNC bool operator==(bvh_motion_inst_t const& rhs) const
+    {
+        return base_type::operator==(rhs)
+            && transform_[0] == rhs.transform_[0]
+            && transform_[1] == rhs.transform_[1]
+            && motion_ == rhs.motion_;
+    }
+
+private:
+
+    // Transformations at the motion keys
+    mat4 transform_[2];
+
+    // Interpolate the transformation with the ray time
+    bool motion_ = false;
+
+};
+
+template <typename PrimitiveType>
+class index_bvh_motion_inst_t : public index_bvh_inst_t<PrimitiveType>
+{
+public:
+
+    using base_type = index_bvh_inst_t<PrimitiveType>;
+
+public:
+
+    index_bvh_motion_inst_t() = default;
+
+    // Static instance, has_motion() returns false
+    index_bvh_motion_inst_t(index_bvh_ref_t<PrimitiveType> const& ref, mat4 const& transform)
+        : base_type(ref, transform)
+        , transform_{ transform, transform }
+        , motion_(false)
+    {
+    }
+
+    // Transform motion, linear interpolation from TRANSFORM0 at time 0 to
+    // TRANSFORM1 at time 1
+    index_bvh_motion_inst_t(index_bvh_ref_t<PrimitiveType> const& ref, mat4 const& transform0, mat4 const& transform1)
+        : base_type(ref, transform0)
+        , transform_{ transform0, transform1 }
+        , motion_(true)
+    {
+    }
+
+    // Inverse transformation at time 0
+    VSNRAY_FUNC mat4 const& transform_inv() const
+    {
+        return base_type::transform_inv();
+    }
+
+    // Inverse transformation at TIME (clamped to [0..1]), T may be a SIMD type
+    template <typename T>
+    VSNRAY_FUNC matrix<4, 4, T> transform_inv(T const& time) const
+    {
+        if (!motion_)
+        {
+            return matrix<4, 4, T>(base_type::transform_inv());
+        }
+
+        return detail::interpolate_transform_inv(transform_[0], transform_[1], time);
+    }
+
+    // Transformation at motion key KEY (0 or 1)
+    VSNRAY_FUNC mat4 const& transform(int key) const
+    {
+        return transform_[key];
+    }
+
+    VSNRAY_FUNC bool has_motion() const
+    {
+        return motion_;
+    }
+
+    // Update the transformation, the referenced BVH is not modified
+    VSNRAY_FUNC void set_transform(mat4 const& transform)
+    {
+        base_type::set_transform(transform);
+        transform_[0] = transform;
+        transform_[1] = transform;
+        motion_ = false;
+    }
+
+    VSNRAY_FUNC void set_transform(mat4 const& transform0, mat4 const& transform1)
+    {
+        base_type::set_transform(transform0);
+        transform_[0] = transform0;
+        transform_[1] = transform1;
+        motion_ = true;
+    }
+
+    VSNRAY_FUNC bool operator==(index_bvh_motion_inst_t const& rhs) const
+    {
+        return base_type::operator==(rhs)
+            && transform_[0] == rhs.transform_[0]
+            && transform_[1] == rhs.transform_[1]
+            && motion_ == rhs.motion_;
+    }
+
+private:
+
+    // Transformations at the motion keys
+    mat4 transform_[2];
+
+    // Interpolate the transformation with the ray time
+    bool motion_ = false;
+
 };
 
 
@@ -413,8 +836,9 @@ public:
     using node_type         = typename NodeVector::value_type;
     using node_vector       = NodeVector;
 
-    using bvh_ref  = bvh_ref_t<primitive_type>;
+    using bvh_ref  = bvh_ref_t<primitive_type, node_type>;
     using bvh_inst = bvh_inst_t<primitive_type>;
+    using bvh_motion_inst = bvh_motion_inst_t<primitive_type>;
 
 public:
 
@@ -456,9 +880,25 @@ public:
 
     bvh_inst inst(mat4 const& transform)
     {
+        static_assert(
+                std::is_same<node_type, bvh_node>::value,
+                "Instances of motion BVHs are not supported, instance refs use static nodes"
+                );
+
         return bvh_inst(ref(), transform);
     }
 
+    // Instance with transform motion from TRANSFORM0 at time 0 to TRANSFORM1 at time 1
+    bvh_motion_inst motion_inst(mat4 const& transform0, mat4 const& transform1)
+    {
+        static_assert(
+                std::is_same<node_type, bvh_node>::value,
+                "Instances of motion BVHs are not supported, instance refs use static nodes"
+                );
+
+        return bvh_motion_inst(ref(), transform0, transform1);
+    }
+
     primitive_type const& primitive(size_t index) const
     {
         return primitives_[index];
@@ -493,8 +933,9 @@ public:
     using node_vector       = NodeVector;
     using index_vector      = IndexVector;
 
-    using bvh_ref  = index_bvh_ref_t<primitive_type>;
+    using bvh_ref  = index_bvh_ref_t<primitive_type, node_type>;
     using bvh_inst = index_bvh_inst_t<primitive_type>;
+    using bvh_motion_inst = index_bvh_motion_inst_t<primitive_type>;
 
 public:
 
@@ -545,9 +986,25 @@ public:
 
     bvh_inst inst(mat4 const& transform)
     {
+        static_assert(
+                std::is_same<node_type, bvh_node>::value,
+                "Instances of motion BVHs are not supported, instance refs use static nodes"
+                );
+
         return bvh_inst(ref(), transform);
     }
 
+    // Instance with transform motion from TRANSFORM0 at time 0 to TRANSFORM1 at time 1
+    bvh_motion_inst motion_inst(mat4 const& transform0, mat4 const& transform1)
+    {
+        static_assert(
+                std::is_same<node_type, bvh_node>::value,
+                "Instances of motion BVHs are not supported, instance refs use static nodes"
+                );
+
+        return bvh_motion_inst(ref(), transform0, transform1);
+    }
+
     primitive_type const& primitive(size_t indirect_index) const
     {
         return primitives_[indices_[indirect_index]];
@@ -610,26 +1067,36 @@ struct is_bvh : std::false_type {};
 template <typename T1, typename T2>
 struct is_bvh<bvh_t<T1, T2>> : std::true_type {};
 
-template <typename T>
-struct is_bvh<bvh_ref_t<T>> : std::true_type {};
+template <typename T1, typename T2>
+struct is_bvh<bvh_ref_t<T1, T2>> : std::true_type {};
 
 template <typename T>
 struct is_bvh<bvh_inst_t<T>> : std::true_type {};
 
+template <typename T>
+struct is_bvh<bvh_motion_inst_t<T>> : std::true_type {};
+
 template <typename T>
 struct is_index_bvh : std::false_type {};
 
 template <typename T1, typename T2, typename T3>
 struct is_index_bvh<index_bvh_t<T1, T2, T3>> : std::true_type {};
 
-template <typename T>
-struct is_index_bvh<index_bvh_ref_t<T>> : std::true_type {};
+template <typename T1, typename T2>
+struct is_index_bvh<index_bvh_ref_t<T1, T2>> : std::true_type {};
 
 template <typename T>
 struct is_index_bvh<index_bvh_inst_t<T>> : std::true_type {};
 
 template <typename T>
-struct is_any_bvh : std::integral_constant<bool, is_bvh<T>::value || is_index_bvh<T>::value>
+struct is_index_bvh<index_bvh_motion_inst_t<T>> : std::true_type {};
+
+// Specialized in wide_bvh.h
+template <typename T>
+struct is_wide_bvh : std::false_type {};
+
+template <typename T>
+struct is_any_bvh : std::integral_constant<bool, is_bvh<T>::value || is_index_bvh<T>::value || is_wide_bvh<T>::value>
 {
 };
 
@@ -640,17 +1107,33 @@ struct is_bvh_inst : std::false_type {};
 template <typename T>
 struct is_bvh_inst<bvh_inst_t<T>> : std::true_type {};
 
+template <typename T>
+struct is_bvh_inst<bvh_motion_inst_t<T>> : std::true_type {};
+
 template <typename T>
 struct is_index_bvh_inst : std::false_type {};
 
 template <typename T>
 struct is_index_bvh_inst<index_bvh_inst_t<T>> : std::true_type {};
 
+template <typename T>
+struct is_index_bvh_inst<index_bvh_motion_inst_t<T>> : std::true_type {};
+
 template <typename T>
 struct is_any_bvh_inst : std::integral_constant<bool, is_bvh_inst<T>::value || is_index_bvh_inst<T>::value>
 {
 };
 
+// Instances with transform motion
+template <typename T>
+struct is_bvh_motion_inst : std::false_type {};
+
+template <typename T>
+struct is_bvh_motion_inst<bvh_motion_inst_t<T>> : std::true_type {};
+
+template <typename T>
+struct is_bvh_motion_inst<index_bvh_motion_inst_t<T>> : std::true_type {};
+
 
 //-------------------------------------------------------------------------------------------------
 // Typedefs
@@ -661,6 +1144,12 @@ using bvh               = bvh_t<aligned_vector<P>, aligned_vector<bvh_node, 32>>
 template <typename P>
 using index_bvh         = index_bvh_t<aligned_vector<P>, aligned_vector<bvh_node, 32>, aligned_vector<unsigned>>;
 
+// Motion blur, cf. motion_bvh_node
+template <typename P>
+using motion_bvh        = bvh_t<aligned_vector<P>, aligned_vector<motion_bvh_node, 32>>;
+template <typename P>
+using index_motion_bvh  = index_bvh_t<aligned_vector<P>, aligned_vector<motion_bvh_node, 32>, aligned_vector<unsigned>>;
+
 #ifdef __CUDACC__
 template <typename P>
 using cuda_bvh          = bvh_t<thrust::device_vector<P>, thrust::device_vector<bvh_node>>;
@@ -677,6 +1166,88 @@ template <typename Tree, typename P>
 Tree build(P* primitives, size_t num_prims, bool use_spatial_splits = false);
 
 
+//-------------------------------------------------------------------------------------------------
+// build_top_level() interface
+//
+// Rebuild an index_bvh_t over BVH instances (the top level of a two-level BVH)
+// in place with BUILDER (lbvh_builder or binned_sah_builder). The world space
+// bounds of the instances are computed in parallel from the root bounds of the
+// referenced BVHs, the referenced BVHs themselves are not touched.
+//
+// To animate instances, update their transforms with set_transform() and
+// either rebuild, or refit() the top level BVH if the instances moved little.
+//
+
+template <typename Tree, typename Builder>
+void build_top_level(
+        Tree&                                   tree,
+        Builder&                                builder,
+        typename Tree::primitive_type const*    instances,
+        size_t                                  num_instances,
+        thread_pool&                            pool,
+        int                                     max_leaf_size = -1
+        );
+
+
+//-------------------------------------------------------------------------------------------------
+// build_indexed_triangles() interface
+//
+// Build an index_bvh_t over basic_indexed_triangle primitives with BUILDER
+// (lbvh_builder or binned_sah_builder). The triangles don't store their
+// vertices, so the builder works on temporary basic_triangle copies fetched
+// from VERTICES (spatial splits clip the actual triangles). The tree stores
+// the indexed triangles in the input order.
+//
+// refit() is not supported for BVHs over indexed triangles, rebuild instead.
+//
+
+template <typename Tree, typename Builder>
+void build_indexed_triangles(
+        Tree&                                   tree,
+        Builder&                                builder,
+        typename Tree::primitive_type const*    triangles,
+        size_t                                  num_triangles,
+        vec3 const*                             vertices,
+        thread_pool&                            pool,
+        int                                     max_leaf_size = -1
+        );
+
+
+//-------------------------------------------------------------------------------------------------
+// refit() interface
+//
+// Update the node bounds of a bvh_t or index_bvh_t in place after the primitives
+// were modified (the tree topology is kept). Runs bottom-up on the thread pool.
+//
+// Returns the SAH cost of the refitted tree (cf. sah_cost()) relative to
+// REFERENCE_COST, typically sah_cost(tree) right after the tree was built.
+// The value grows as the tree quality degrades, rebuild when it gets too large.
+// If REFERENCE_COST is 0, the absolute SAH cost is returned.
+//
+
+template <typename Tree>
+float refit(Tree& tree, thread_pool& pool, float reference_cost = 0.0f);
+
+
+//-------------------------------------------------------------------------------------------------
+// optimize() interface
+//
+// Lower the SAH cost of a built bvh_t or index_bvh_t in place by treelet
+// restructuring (cf. Karras, Aila 2013), e.g. to bring a tree built with
+// lbvh_builder closer to binned_sah_builder quality. Runs bottom-up on the
+// thread pool, the result does not depend on the number of threads.
+//
+// ITERATIONS and TREELET_SIZE (3..8) trade quality for time: each iteration is
+// a pass over the tree, the work per treelet grows exponentially with its size.
+// Leaves and the primitive order are not changed.
+//
+// Returns the SAH cost of the optimized tree (cf. sah_cost()).
+//
+
+template <typename Tree>
+float optimize(Tree& tree, thread_pool& pool, int iterations = 3, int treelet_size = 7);
+
+
 //-------------------------------------------------------------------------------------------------
 // Traversal algorithms
 //
@@ -692,16 +1263,83 @@ void traverse_leaves(B const& b, F func);
 template <typename B, typename N, typename F>
 void traverse_parents(B const& b, N const& n, F func);
 
+
+//-------------------------------------------------------------------------------------------------
+// Ray / BVH traversal strategies
+//
+// Passed as a template parameter to intersect(), usually through a custom
+// intersector, e.g.:
+//
+//   struct my_intersector : basic_intersector<
+//           my_intersector,
+//           bvh_traversal<bvh_child_order::split_axis, bvh_stack_mode::restart>
+//           >
+//   {
+//   };
+//
+// All strategies report the same hits.
+//
+
+enum class bvh_child_order
+{
+    distance,       // Visit the child with the smaller entry distance first
+    split_axis      // Order by the sign of the ray direction along the split axis
+                    // stored in the node, coherent for SIMD ray packets
+};
+
+enum class bvh_stack_mode
+{
+    full,           // Full traversal stack
+    restart         // Short stack with ShortStackSize entries. When an entry is
+                    // missing, traversal restarts from the root and uses a restart
+                    // trail to skip finished subtrees. Supports trees of depth <= 64,
+                    // ShortStackSize = 0 is stackless
+};
+
+template <
+    bvh_child_order Order = bvh_child_order::distance,
+    bvh_stack_mode Mode = bvh_stack_mode::full,
+    unsigned ShortStackSize = 4
+    >
+struct bvh_traversal
+{
+    static constexpr bvh_child_order order = Order;
+    static constexpr bvh_stack_mode mode = Mode;
+    static constexpr unsigned short_stack_size = ShortStackSize;
+};
+
+using default_bvh_traversal = bvh_traversal<>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Child order for occlusion queries, cf. occluded()
+//
+// Occlusion queries stop at the first hit, so visiting the near child first
+// does not pay off.
+//
+
+enum class bvh_occlusion_order
+{
+    none,           // Visit the children in memory order, no ordering overhead
+    surface_area    // Visit the child with the larger surface area first, it is more
+                    // likely to contain an occluder
+};
+
 } // visionaray
 
 #include "detail/bvh/build.inl"
+#include "detail/bvh/build_indexed_triangles.inl"
+#include "detail/bvh/build_top_level.inl"
 #include "detail/bvh/get_bounds.inl"
 #include "detail/bvh/get_color.h"
 #include "detail/bvh/get_normal.h"
 #include "detail/bvh/get_tex_coord.h"
 #include "detail/bvh/hit_record.h"
 #include "detail/bvh/intersect.inl"
+#include "detail/bvh/occluded.inl"
+#include "detail/bvh/optimize.inl"
 #include "detail/bvh/prim_traits.h"
+#include "detail/bvh/refit.inl"
 #include "detail/bvh/statistics.h"
 #include "detail/bvh/traverse.h"
 
@@ -0,0 +1,441 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_BVH_FILE_H
+#define VSNRAY_BVH_FILE_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+#include "detail/mapped_file.h"
+#include "math/forward.h"
+#include "math/matrix.h"
+#include "array_ref.h"
+#include "bvh.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// BVH cache files
+//
+// save_bvh() writes the nodes, indices and primitives of a bvh_t or index_bvh_t
+// to a binary file. mapped_bvh maps such a file into memory and hands out a
+// bvh_ref_t / index_bvh_ref_t that points into the mapping, so loading does
+// not copy anything.
+//
+// Files start with a bvh_file_header, the sections are aligned to 64 bytes.
+// The data is stored as is, so files can only be read back on platforms with
+// the same byte order and type layout. The header also stores a user-defined
+// key, typically bvh_cache_key() of the input primitives and the builder
+// settings. mapped_bvh rejects files with another key, version, BVH type,
+// node type, node size or primitive size. Both bvh_node and motion_bvh_node
+// trees can be stored.
+//
+
+struct bvh_file_header
+{
+    enum : uint32_t
+    {
+        Version     = 2,
+        Alignment   = 64
+    };
+
+    enum : uint32_t
+    {
+        BVH         = 0,
+        IndexBVH    = 1
+    };
+
+    enum : uint32_t
+    {
+        Node        = 0,
+        MotionNode  = 1
+    };
+
+    char     magic[8];          // "VSNRBVH"
+    uint32_t version;           // Version
+    uint32_t type;              // BVH or IndexBVH
+    uint32_t node_type;         // Node or MotionNode
+    uint32_t node_size;         // sizeof(node_type)
+    uint32_t prim_size;         // sizeof(primitive_type)
+    uint32_t reserved;
+    uint64_t key;               // User-defined key
+    uint64_t num_nodes;
+    uint64_t num_indices;       // 0 for BVH
+    uint64_t num_primitives;
+    uint64_t nodes_offset;      // Section offsets in bytes, relative to the file begin
+    uint64_t indices_offset;
+    uint64_t primitives_offset;
+    uint64_t file_size;
+};
+
+namespace detail
+{
+
+static char const bvh_file_magic[8] = "VSNRBVH";
+
+inline uint64_t bvh_file_align(uint64_t offset)
+{
+    return (offset + bvh_file_header::Alignment - 1) / bvh_file_header::Alignment * bvh_file_header::Alignment;
+}
+
+// 64-bit FNV-1a, processes eight bytes at a time
+inline uint64_t hash_bytes(void const* data, size_t size, uint64_t h)
+{
+    static const uint64_t prime = 1099511628211ULL;
+
+    auto bytes = static_cast<unsigned char const*>(data);
+
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+
+        h = (h ^ word) * prime;
+        h ^= h >> 29;
+    }
+
+    for (; i < size; ++i)
+    {
+        h = (h ^ bytes[i]) * prime;
+    }
+
+    return h;
+}
+
+template <typename Node>
+struct bvh_file_node_type;
+
+template <>
+struct bvh_file_node_type<bvh_node>
+    : std::integral_constant<uint32_t, bvh_file_header::Node>
+{
+};
+
+template <>
+struct bvh_file_node_type<motion_bvh_node>
+    : std::integral_constant<uint32_t, bvh_file_header::MotionNode>
+{
+};
+
+template <typename Tree>
+inline array_ref<unsigned const> bvh_file_indices(Tree const& tree, std::true_type /* is_index_bvh */)
+{
+    return { tree.indices().data(), tree.indices().size() };
+}
+
+template <typename Tree>
+inline array_ref<unsigned const> bvh_file_indices(Tree const& /* tree */, std::false_type /* is_index_bvh */)
+{
+    return {};
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// is_serializable_primitive
+//
+// Primitives are stored bytewise, so they must be trivially copyable and must
+// not point to other memory. BVH refs and instances (e.g. the primitives of a
+// top-level BVH) point to the nodes of another BVH and are rejected.
+//
+
+template <typename P>
+struct is_serializable_primitive
+    : std::integral_constant<bool, std::is_trivially_copyable<P>::value && !is_any_bvh<P>::value>
+{
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// bvh_cache_key()
+//
+// Hash of the primitives (bytewise, so padding bytes should be initialized),
+// combined with SEED, e.g. an identifier of the builder and its settings.
+//
+
+template <typename P>
+inline uint64_t bvh_cache_key(P const* primitives, size_t num_prims, uint64_t seed = 0)
+{
+    uint64_t count = num_prims;
+
+    auto h = detail::hash_bytes(&seed, sizeof(seed), 14695981039346656037ULL);
+    h = detail::hash_bytes(&count, sizeof(count), h);
+
+    return detail::hash_bytes(primitives, sizeof(P) * num_prims, h);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// save_bvh()
+//
+// Returns false if the file could not be written. The file is written under
+// a temporary name first and then renamed, so that concurrent readers never
+// see an incomplete file.
+//
+
+template <typename Tree>
+bool save_bvh(std::string const& filename, Tree const& tree, uint64_t key = 0)
+{
+    static_assert(
+            is_bvh<Tree>::value || is_index_bvh<Tree>::value,
+            "save_bvh() requires bvh_t or index_bvh_t"
+            );
+
+    using N = typename Tree::node_type;
+    using P = typename Tree::primitive_type;
+
+    static_assert(
+            is_serializable_primitive<P>::value,
+            "save_bvh() requires trivially copyable primitives that don't point to other memory"
+            );
+
+    auto indices = detail::bvh_file_indices(tree, is_index_bvh<Tree>());
+
+    bvh_file_header header;
+    std::memset(&header, 0, sizeof(header));
+
+    std::memcpy(header.magic, detail::bvh_file_magic, sizeof(header.magic));
+    header.version              = bvh_file_header::Version;
+    header.type                 = is_index_bvh<Tree>::value ? bvh_file_header::IndexBVH : bvh_file_header::BVH;
+    header.node_type            = detail::bvh_file_node_type<N>::value;
+    header.node_size            = sizeof(N);
+    header.prim_size            = sizeof(P);
+    header.key                  = key;
+    header.num_nodes            = tree.num_nodes();
+    header.num_indices          = indices.size();
+    header.num_primitives       = tree.num_primitives();
+    header.nodes_offset         = detail::bvh_file_align(sizeof(header));
+    header.indices_offset       = detail::bvh_file_align(header.nodes_offset + header.num_nodes * sizeof(N));
+    header.primitives_offset    = detail::bvh_file_align(header.indices_offset + header.num_indices * sizeof(unsigned));
+    header.file_size            = header.primitives_offset + header.num_primitives * sizeof(P);
+
+    std::string tmp = filename + ".tmp";
+
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+
+        uint64_t pos = 0;
+
+        auto write = [&](void const* data, uint64_t offset, uint64_t size)
+        {
+            static const char zeros[bvh_file_header::Alignment] = {};
+
+            // Padding
+            file.write(zeros, static_cast<std::streamsize>(offset - pos));
+
+            file.write(static_cast<char const*>(data), static_cast<std::streamsize>(size));
+
+            pos = offset + size;
+        };
+
+        write(&header, 0, sizeof(header));
+        write(tree.nodes().data(), header.nodes_offset, header.num_nodes * sizeof(N));
+        write(indices.data(), header.indices_offset, header.num_indices * sizeof(unsigned));
+        write(tree.primitives().data(), header.primitives_offset, header.num_primitives * sizeof(P));
+
+        file.close();
+
+        if (!file)
+        {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+
+    if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+    {
+        // Some platforms don't replace existing files
+        std::remove(filename.c_str());
+
+        if (std::rename(tmp.c_str(), filename.c_str()) != 0)
+        {
+            std::remove(tmp.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// mapped_bvh
+//
+// Read-only view of a BVH file written by save_bvh(). Tree is the type of the
+// BVH that was saved. The refs and instances stay valid as long as the file is
+// mapped.
+//
+
+template <typename Tree>
+class mapped_bvh
+{
+public:
+
+    static_assert(
+            is_bvh<Tree>::value || is_index_bvh<Tree>::value,
+            "mapped_bvh requires bvh_t or index_bvh_t"
+            );
+
+    static_assert(
+            is_serializable_primitive<typename Tree::primitive_type>::value,
+            "mapped_bvh requires trivially copyable primitives that don't point to other memory"
+            );
+
+    using primitive_type    = typename Tree::primitive_type;
+    using node_type         = typename Tree::node_type;
+    using bvh_ref           = typename Tree::bvh_ref;
+    using bvh_inst          = typename Tree::bvh_inst;
+    using bvh_motion_inst   = typename Tree::bvh_motion_inst;
+
+public:
+
+    mapped_bvh() = default;
+
+    // Returns false if the file does not exist or was not written with KEY for Tree
+    bool open(std::string const& filename, uint64_t key)
+    {
+        if (!file_.open(filename) || !valid(key))
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        file_.close();
+    }
+
+    bool is_open() const
+    {
+        return file_.is_open();
+    }
+
+    size_t num_primitives() const   { return is_open() ? header().num_primitives : 0; }
+    size_t num_nodes() const        { return is_open() ? header().num_nodes : 0; }
+    size_t num_indices() const      { return is_open() ? header().num_indices : 0; }
+
+    array_ref<primitive_type const> primitives() const
+    {
+        return { section<primitive_type>(header().primitives_offset), num_primitives() };
+    }
+
+    array_ref<node_type const> nodes() const
+    {
+        return { section<node_type>(header().nodes_offset), num_nodes() };
+    }
+
+    array_ref<unsigned const> indices() const
+    {
+        return { section<unsigned>(header().indices_offset), num_indices() };
+    }
+
+    bvh_ref ref() const
+    {
+        return make_ref(is_index_bvh<Tree>());
+    }
+
+    bvh_inst inst(mat4 const& transform) const
+    {
+        static_assert(
+                std::is_same<node_type, bvh_node>::value,
+                "Instances of motion BVHs are not supported, instance refs use static nodes"
+                );
+
+        return bvh_inst(ref(), transform);
+    }
+
+    bvh_motion_inst motion_inst(mat4 const& transform0, mat4 const& transform1) const
+    {
+        static_assert(
+                std::is_same<node_type, bvh_node>::value,
+                "Instances of motion BVHs are not supported, instance refs use static nodes"
+                );
+
+        return bvh_motion_inst(ref(), transform0, transform1);
+    }
+
+private:
+
+    detail::mapped_file file_;
+
+    bvh_file_header const& header() const
+    {
+        return *reinterpret_cast<bvh_file_header const*>(file_.data());
+    }
+
+    template <typename T>
+    T const* section(uint64_t offset) const
+    {
+        return is_open() ? reinterpret_cast<T const*>(file_.data() + offset) : nullptr;
+    }
+
+    bool valid(uint64_t key) const
+    {
+        if (file_.size() < sizeof(bvh_file_header))
+        {
+            return false;
+        }
+
+        auto const& h = header();
+
+        uint32_t type = is_index_bvh<Tree>::value ? bvh_file_header::IndexBVH : bvh_file_header::BVH;
+
+        auto aligned = [](uint64_t offset)
+        {
+            return offset % bvh_file_header::Alignment == 0;
+        };
+
+        return std::memcmp(h.magic, detail::bvh_file_magic, sizeof(h.magic)) == 0
+            && h.version == bvh_file_header::Version
+            && h.type == type
+            && h.node_type == detail::bvh_file_node_type<node_type>::value
+            && h.node_size == sizeof(node_type)
+            && h.prim_size == sizeof(primitive_type)
+            && h.key == key
+            && h.file_size == file_.size()
+            && aligned(h.nodes_offset)
+            && aligned(h.indices_offset)
+            && aligned(h.primitives_offset)
+            && h.nodes_offset >= sizeof(bvh_file_header)
+            && h.nodes_offset + h.num_nodes * sizeof(node_type) <= h.indices_offset
+            && h.indices_offset + h.num_indices * sizeof(unsigned) <= h.primitives_offset
+            && h.primitives_offset + h.num_primitives * sizeof(primitive_type) <= h.file_size;
+    }
+
+    bvh_ref make_ref(std::true_type /* is_index_bvh */) const
+    {
+        auto p = primitives();
+        auto n = nodes();
+        auto i = indices();
+
+        return { p.begin(), p.end(), n.begin(), n.end(), i.begin(), i.end() };
+    }
+
+    bvh_ref make_ref(std::false_type /* is_index_bvh */) const
+    {
+        auto p = primitives();
+        auto n = nodes();
+
+        return { p.begin(), p.end(), n.begin(), n.end() };
+    }
+
+};
+
+} // visionaray
+
+#endif // VSNRAY_BVH_FILE_H
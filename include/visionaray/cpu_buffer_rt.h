@@ -14,6 +14,8 @@
 namespace visionaray
 {
 
+class thread_pool;
+
 template <pixel_format ColorFormat, pixel_format DepthFormat>
 class cpu_buffer_rt : public render_target
 {
@@ -44,6 +46,16 @@ public:
     void resize(int w, int h);
     void display_color_buffer() const;
 
+    // With first touch, resize() returns the buffer memory to the OS. The
+    // buffers read as zeros, and each page is placed on the NUMA node of the
+    // thread that writes it first, i.e. the thread that renders that part of
+    // the image, cf. thread_pool. Pass the pool of the scheduler, so that
+    // clear_color_buffer() and clear_depth_buffer() write the same 16x16 tiles
+    // as tiled_sched from the same nodes. W/o a pool, they touch the whole
+    // buffers from the calling thread
+    void set_first_touch(bool enable, thread_pool* pool = nullptr);
+    bool get_first_touch() const;
+
 private:
 
     struct impl;
@@ -0,0 +1,305 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_ADAPTIVE_SCHED_H
+#define VSNRAY_DETAIL_ADAPTIVE_SCHED_H 1
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "../math/detail/math.h"
+#include "basic_sched.h"
+#include "range.h"
+#include "thread_pool.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Distance of (x,y) along the Hilbert curve that fills an NxN grid, N is a power of two
+//
+
+inline unsigned hilbert_index(unsigned n, unsigned x, unsigned y)
+{
+    unsigned d = 0;
+
+    for (unsigned s = n / 2; s > 0; s /= 2)
+    {
+        unsigned rx = (x & s) > 0;
+        unsigned ry = (y & s) > 0;
+
+        d += s * s * ((3 * rx) ^ ry);
+
+        // Rotate the quadrant
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+
+            std::swap(x, y);
+        }
+    }
+
+    return d;
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Adaptive scheduler backend
+//
+// Tiles are visited along a Hilbert curve, so that the ranges a thread takes
+// from the pool cover compact image regions. The render time of each tile is
+// measured, and in the next frame tiles that were expensive (e.g. glass or
+// hair) are split until no work item is expected to take longer than a small
+// fraction of a thread's share of the frame. This avoids idle cores at the
+// end of a frame. Costs are reset whenever the viewport changes.
+//
+
+struct adaptive_sched_backend
+{
+    explicit adaptive_sched_backend(unsigned num_threads)
+        : own_pool_(new thread_pool(num_threads))
+        , pool_(own_pool_.get())
+    {
+    }
+
+    // Share POOL with other users, e.g. BVH builds. The pool must outlive the scheduler
+    explicit adaptive_sched_backend(thread_pool& pool)
+        : pool_(&pool)
+    {
+    }
+
+    // Use a pool of its own with NUM_THREADS threads, also if a pool was shared before
+    void reset(unsigned num_threads)
+    {
+        if (own_pool_ != nullptr)
+        {
+            own_pool_->reset(num_threads);
+        }
+        else
+        {
+            own_pool_.reset(new thread_pool(num_threads));
+            pool_ = own_pool_.get();
+        }
+    }
+
+    template <typename Func>
+    void for_each_packet(
+            tiled_range2d<int> const& tr,
+            int packet_width,
+            int packet_height,
+            Func const& func
+            )
+    {
+        using clock = std::chrono::steady_clock;
+
+        init_tiles(tr);
+        split_tiles(packet_width, packet_height);
+
+        work_item* items = items_.data();
+
+        pool_->run([&](long index)
+            {
+                work_item& item = items[index];
+
+                auto start = clock::now();
+
+                for (int y = item.y0; y < item.y1; y += packet_height)
+                {
+                    for (int x = item.x0; x < item.x1; x += packet_width)
+                    {
+                        func(x, y);
+                    }
+                }
+
+                item.cost = std::chrono::duration<float>(clock::now() - start).count();
+
+            }, static_cast<long>(items_.size()));
+
+        // Costs per tile for the next frame
+        std::fill(costs_.begin(), costs_.end(), 0.0f);
+
+        for (auto const& item : items_)
+        {
+            costs_[item.tile] += item.cost;
+        }
+    }
+
+private:
+
+    // Work items are split until they are expected to take at most
+    // 1/SplitFactor of the time a thread spends on the frame
+    enum { SplitFactor = 32 };
+
+    struct work_item
+    {
+        int x0;
+        int y0;
+        int x1;
+        int y1;
+        unsigned tile;  // Index into tiles_ and costs_
+        float cost;     // Render time in seconds
+    };
+
+    std::unique_ptr<thread_pool> own_pool_;
+    thread_pool* pool_;
+
+    // Tiles in Hilbert order and their render times from the previous frame
+    std::vector<work_item> tiles_;
+    std::vector<float> costs_;
+
+    // Work items of the current frame
+    std::vector<work_item> items_;
+
+    // Viewport and tile size that tiles_ was built for
+    int viewport_[6] = { 0, 0, 0, 0, 0, 0 };
+
+    void init_tiles(tiled_range2d<int> const& tr)
+    {
+        int viewport[6] = {
+                tr.rows().begin(),
+                tr.rows().end(),
+                tr.rows().tile_size(),
+                tr.cols().begin(),
+                tr.cols().end(),
+                tr.cols().tile_size()
+                };
+
+        if (!tiles_.empty() && std::equal(viewport, viewport + 6, viewport_))
+        {
+            return;
+        }
+
+        std::copy(viewport, viewport + 6, viewport_);
+
+        int num_tiles_x = div_up(tr.rows().length(), tr.rows().tile_size());
+        int num_tiles_y = div_up(tr.cols().length(), tr.cols().tile_size());
+
+        unsigned n = 1;
+
+        while (n < static_cast<unsigned>(std::max(num_tiles_x, num_tiles_y)))
+        {
+            n *= 2;
+        }
+
+        std::vector<std::pair<unsigned, work_item>> order;
+        order.reserve(num_tiles_x * num_tiles_y);
+
+        for (int j = 0; j < num_tiles_y; ++j)
+        {
+            for (int i = 0; i < num_tiles_x; ++i)
+            {
+                work_item t;
+                t.x0 = tr.rows().begin() + i * tr.rows().tile_size();
+                t.y0 = tr.cols().begin() + j * tr.cols().tile_size();
+                t.x1 = std::min(t.x0 + tr.rows().tile_size(), tr.rows().end());
+                t.y1 = std::min(t.y0 + tr.cols().tile_size(), tr.cols().end());
+                t.tile = 0;
+                t.cost = 0.0f;
+
+                order.emplace_back(detail::hilbert_index(n, i, j), t);
+            }
+        }
+
+        std::sort(
+                order.begin(),
+                order.end(),
+                [](std::pair<unsigned, work_item> const& a, std::pair<unsigned, work_item> const& b)
+                {
+                    return a.first < b.first;
+                }
+                );
+
+        tiles_.resize(order.size());
+
+        for (size_t i = 0; i < order.size(); ++i)
+        {
+            tiles_[i] = order[i].second;
+            tiles_[i].tile = static_cast<unsigned>(i);
+        }
+
+        // No render times yet
+        costs_.assign(tiles_.size(), 0.0f);
+    }
+
+    void split_tiles(int packet_width, int packet_height)
+    {
+        items_.clear();
+
+        float total = 0.0f;
+
+        for (float c : costs_)
+        {
+            total += c;
+        }
+
+        // Threads in the pool plus the thread that calls run()
+        float target = total / ((pool_->num_threads + 1) * SplitFactor);
+
+        for (auto const& t : tiles_)
+        {
+            split(t, costs_[t.tile], target, packet_width, packet_height);
+        }
+    }
+
+    // Split T in up to four parts until the expected cost is below TARGET,
+    // the cost is assumed to be evenly distributed over the tile
+    void split(work_item const& t, float cost, float target, int packet_width, int packet_height)
+    {
+        int w = t.x1 - t.x0;
+        int h = t.y1 - t.y0;
+
+        bool split_x = w > packet_width;
+        bool split_y = h > packet_height;
+
+        if (cost <= target || (!split_x && !split_y))
+        {
+            items_.push_back(t);
+            return;
+        }
+
+        // Parts start at multiples of the packet size
+        int xs[] = { t.x0, split_x ? t.x0 + round_up(w / 2, packet_width) : t.x1, t.x1 };
+        int ys[] = { t.y0, split_y ? t.y0 + round_up(h / 2, packet_height) : t.y1, t.y1 };
+
+        for (int j = 0; j < 2; ++j)
+        {
+            for (int i = 0; i < 2; ++i)
+            {
+                work_item part = t;
+                part.x0 = xs[i];
+                part.y0 = ys[j];
+                part.x1 = xs[i + 1];
+                part.y1 = ys[j + 1];
+
+                if (part.x0 == part.x1 || part.y0 == part.y1)
+                {
+                    continue;
+                }
+
+                float area = static_cast<float>((part.x1 - part.x0) * (part.y1 - part.y0));
+                split(part, cost * area / (w * h), target, packet_width, packet_height);
+            }
+        }
+    }
+};
+
+template <typename R>
+using adaptive_sched = basic_sched<adaptive_sched_backend, R>;
+
+} // visionaray
+
+#endif // VSNRAY_DETAIL_ADAPTIVE_SCHED_H
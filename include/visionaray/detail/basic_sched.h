@@ -6,6 +6,10 @@
 #ifndef VSNRAY_DETAIL_BASIC_SCHED_H
 #define VSNRAY_DETAIL_BASIC_SCHED_H 1
 
+#include <memory>
+
+#include "frame_handle.h"
+
 namespace visionaray
 {
 
@@ -20,6 +24,20 @@ public:
     template <typename K, typename SP>
     void frame(K kernel, SP sched_params);
 
+    // Render the frame on a separate thread and return immediately. The
+    // render target, camera and intersector referenced by SCHED_PARAMS and
+    // the scheduler itself must stay alive until the frame is ready.
+    // begin_frame() is called on the calling thread, end_frame() by
+    // frame_handle::finish(). One frame per scheduler is in flight, frame()
+    // and frame_async() finish the previous frame first
+    template <typename K, typename SP>
+    frame_handle frame_async(K kernel, SP sched_params);
+
+    // Call ON_TILE(recti const& tile) for each completed tile, from the
+    // thread that rendered the last packet of that tile
+    template <typename K, typename SP, typename TileFunc>
+    frame_handle frame_async(K kernel, SP sched_params, TileFunc on_tile);
+
     template <typename ...Args>
     void reset(Args&&... args);
 
@@ -27,6 +45,15 @@ private:
 
     Backend backend_;
 
+    // Last frame from frame_async()
+    std::weak_ptr<detail::frame_state> last_frame_;
+
+    void finish_last_frame();
+
+    // Render all packets, w/o begin_frame() and end_frame()
+    template <typename K, typename SP, typename Visitor>
+    void frame_impl(K kernel, SP sched_params, Visitor visitor);
+
 };
 
 } // visionaray
@@ -1,10 +1,15 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
 #include <type_traits>
 #include <utility>
 
 #include "../make_generator.h"
+#include "numa.h"
 #include "range.h"
 #include "sched_common.h"
 
@@ -73,6 +78,71 @@ void call_sample_pixel(
             );
 }
 
+
+
+//-------------------------------------------------------------------------------------------------
+// Packet visitors, render the packet at (x,y) by calling sample()
+//
+
+struct sync_visitor
+{
+    template <typename Sample>
+    void operator()(int /* x */, int /* y */, Sample const& sample) const
+    {
+        sample();
+    }
+};
+
+template <typename TileFunc>
+struct async_visitor
+{
+    detail::frame_state* state;
+    TileFunc on_tile;
+
+    recti viewport;
+    int tile_width;
+    int tile_height;
+    int num_tiles_x;
+
+    template <typename Sample>
+    void operator()(int x, int y, Sample const& sample) const
+    {
+        if (state->canceled.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        sample();
+
+        int tile_x = (x - viewport.x) / tile_width;
+        int tile_y = (y - viewport.y) / tile_height;
+
+        // Last packet of the tile
+        if (--state->pending[tile_y * num_tiles_x + tile_x] == 0)
+        {
+            int x0 = viewport.x + tile_x * tile_width;
+            int y0 = viewport.y + tile_y * tile_height;
+
+            recti tile(
+                    x0,
+                    y0,
+                    std::min(tile_width, viewport.x + viewport.w - x0),
+                    std::min(tile_height, viewport.y + viewport.h - y0)
+                    );
+
+            state->complete_tile(tile);
+            on_tile(tile);
+        }
+    }
+};
+
+struct no_tile_func
+{
+    void operator()(recti const& /* tile */) const
+    {
+    }
+};
+
 } // basic_sched_impl
 
 
@@ -91,6 +161,34 @@ template <typename B, typename R>
 template <typename K, typename SP>
 void basic_sched<B, R>::frame(K kernel, SP sched_params)
 {
+    finish_last_frame();
+
+    sched_params.cam.begin_frame();
+
+    sched_params.rt.begin_frame();
+
+    frame_impl(kernel, sched_params, basic_sched_impl::sync_visitor{});
+
+    sched_params.rt.end_frame();
+
+    sched_params.cam.end_frame();
+}
+
+template <typename B, typename R>
+template <typename K, typename SP>
+frame_handle basic_sched<B, R>::frame_async(K kernel, SP sched_params)
+{
+    return frame_async(kernel, sched_params, basic_sched_impl::no_tile_func{});
+}
+
+template <typename B, typename R>
+template <typename K, typename SP, typename TileFunc>
+frame_handle basic_sched<B, R>::frame_async(K kernel, SP sched_params, TileFunc on_tile)
+{
+    // Packets of a canceled frame may still be writing to the render target
+    finish_last_frame();
+
+    // Render targets may map GL or CUDA resources, do that on this thread
     sched_params.cam.begin_frame();
 
     sched_params.rt.begin_frame();
@@ -98,6 +196,70 @@ void basic_sched<B, R>::frame(K kernel, SP sched_params)
     int pw = packet_size<typename R::scalar_type>::w;
     int ph = packet_size<typename R::scalar_type>::h;
 
+    int dx = round_up(16, pw);
+    int dy = round_up(16, ph);
+
+    recti viewport = sched_params.scissor_box;
+
+    int num_tiles_x = div_up(viewport.w, dx);
+    int num_tiles_y = div_up(viewport.h, dy);
+
+    auto state = std::make_shared<detail::frame_state>();
+
+    state->num_tiles = static_cast<size_t>(num_tiles_x * num_tiles_y);
+    state->pending.reset(new std::atomic<int>[state->num_tiles]);
+
+    for (int j = 0; j < num_tiles_y; ++j)
+    {
+        for (int i = 0; i < num_tiles_x; ++i)
+        {
+            int w = std::min(dx, viewport.w - i * dx);
+            int h = std::min(dy, viewport.h - j * dy);
+
+            state->pending[j * num_tiles_x + i] = div_up(w, pw) * div_up(h, ph);
+        }
+    }
+
+    state->end_frame = [sched_params]() mutable
+    {
+        sched_params.rt.end_frame();
+
+        sched_params.cam.end_frame();
+    };
+
+    basic_sched_impl::async_visitor<TileFunc> visitor{ state.get(), on_tile, viewport, dx, dy, num_tiles_x };
+
+    detail::frame_state* s = state.get();
+
+    s->thread = std::thread([=]()
+        {
+            frame_impl(kernel, sched_params, visitor);
+            s->complete_frame();
+        });
+
+    last_frame_ = state;
+
+    return frame_handle(state);
+}
+
+template <typename B, typename R>
+void basic_sched<B, R>::finish_last_frame()
+{
+    if (auto state = last_frame_.lock())
+    {
+        state->finish();
+    }
+
+    last_frame_.reset();
+}
+
+template <typename B, typename R>
+template <typename K, typename SP, typename Visitor>
+void basic_sched<B, R>::frame_impl(K kernel, SP sched_params, Visitor visitor)
+{
+    int pw = packet_size<typename R::scalar_type>::w;
+    int ph = packet_size<typename R::scalar_type>::h;
+
     // Tile size must be be a multiple of packet size.
     int dx = round_up(16, pw);
     int dy = round_up(16, ph);
@@ -112,29 +274,29 @@ void basic_sched<B, R>::frame(K kernel, SP sched_params)
         tiled_range2d<int>(x0, nx, dx, y0, ny, dy), pw, ph,
         [=](int x, int y)
         {
-            auto gen = make_generator(
-                    typename R::scalar_type{},
-                    sched_params.sample_params,
-                    detail::tic(typename R::scalar_type{})
-                    );
+            visitor(x, y, [&]()
+            {
+                auto gen = make_generator(
+                        typename R::scalar_type{},
+                        sched_params.sample_params,
+                        detail::tic(typename R::scalar_type{})
+                        );
 
-            basic_sched_impl::call_sample_pixel(
-                    typename detail::sched_params_has_intersector<SP>::type(),
-                    R{},
-                    kernel,
-                    sched_params,
-                    gen,
-                    x,
-                    y,
-                    sched_params.rt.width(),
-                    sched_params.rt.height(),
-                    sched_params.cam
-                    );
+                // Kernels may be replicated per NUMA node, cf. numa_replicated
+                basic_sched_impl::call_sample_pixel(
+                        typename detail::sched_params_has_intersector<SP>::type(),
+                        R{},
+                        local_replica(kernel),
+                        sched_params,
+                        gen,
+                        x,
+                        y,
+                        sched_params.rt.width(),
+                        sched_params.rt.height(),
+                        sched_params.cam
+                        );
+            });
         });
-
-    sched_params.rt.end_frame();
-
-    sched_params.cam.end_frame();
 }
 
 template <typename B, typename R>
@@ -0,0 +1,74 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <visionaray/math/indexed_triangle.h>
+#include <visionaray/math/triangle.h>
+
+#include "../../aligned_vector.h"
+#include "../../array_ref.h"
+#include "../parallel_for.h"
+#include "../range.h"
+#include "../thread_pool.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// build_indexed_triangles()
+//
+
+template <typename Tree, typename Builder>
+void build_indexed_triangles(
+        Tree&                                   tree,
+        Builder&                                builder,
+        typename Tree::primitive_type const*    triangles,
+        size_t                                  num_triangles,
+        vec3 const*                             vertices,
+        thread_pool&                            pool,
+        int                                     max_leaf_size
+        )
+{
+    using P = typename Tree::primitive_type;
+
+    static_assert(
+            is_index_bvh<Tree>::value && std::is_same<P, basic_indexed_triangle<float>>::value,
+            "build_indexed_triangles() requires an index_bvh_t over basic_indexed_triangle<float>"
+            );
+
+    enum { TileSize = 1024 };
+
+    using proxy_type = basic_triangle<3, float>;
+
+    using proxy_tree = index_bvh_t<
+            array_ref<proxy_type>,
+            typename Tree::node_vector,
+            typename Tree::index_vector
+            >;
+
+    int n = static_cast<int>(num_triangles);
+
+    aligned_vector<proxy_type> proxies(n);
+
+    if (n > 0)
+    {
+        parallel_for(pool, tiled_range1d<int>(0, n, TileSize), [&](range1d<int> const& r)
+            {
+                for (int i = r.begin(); i != r.end(); ++i)
+                {
+                    proxies[i] = make_triangle(triangles[i], vertices);
+                }
+            });
+    }
+
+    auto proxy = builder.build(proxy_tree{}, proxies.data(), proxies.size(), pool, max_leaf_size);
+
+    tree.primitives().assign(triangles, triangles + num_triangles);
+    tree.nodes() = std::move(proxy.nodes());
+    tree.indices() = std::move(proxy.indices());
+}
+
+} // visionaray
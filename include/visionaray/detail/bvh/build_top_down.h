@@ -8,11 +8,15 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstddef>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include <visionaray/aligned_vector.h>
 
 #include "../algorithm.h"
+#include "../thread_pool.h"
 
 namespace visionaray
 {
@@ -42,7 +46,7 @@ inline void build_top_down_impl(
     {
         auto first_child_index = static_cast<int>(nodes.size());
 
-        nodes[index].set_inner(leaf.prim_bounds, first_child_index);
+        nodes[index].set_inner(leaf.prim_bounds, first_child_index, childs[0].prim_bounds, childs[1].prim_bounds);
 
         nodes.emplace_back();
         nodes.emplace_back();
@@ -154,9 +158,17 @@ inline void build_top_down(Tree& tree, Builder& builder, I first, I last, int ma
     }
 
     // Precompute primitive data needed by the builder
+    // Spatial splits are only performed for index BVHs (cf. build_top_down_work()),
+    // don't reserve references for them otherwise
+
+    auto uss = builder.use_spatial_splits;
+
+    builder.use_spatial_splits = uss && is_index_bvh<Tree>::value;
 
     auto root = builder.init(first, last);
 
+    builder.use_spatial_splits = uss;
+
     // Preallocate memory
     // Guess number of nodes...
 
@@ -172,6 +184,331 @@ inline void build_top_down(Tree& tree, Builder& builder, I first, I last, int ma
     build_top_down_work(tree, builder, root, first, last, max_leaf_size, is_index_bvh<Tree>());
 }
 
+//--------------------------------------------------------------------------------------------------
+// build_top_down_parallel
+//
+// The upper levels of the tree are built on the calling thread (the builder may
+// use the thread pool to bin and partition large leaves). Once a leaf contains
+// no more than subtree_size references, it is detached from the builder and its
+// subtree is constructed by a single task on the thread pool. The subtrees are
+// finally stitched into the node and index lists in a fixed order, so that the
+// resulting tree does not depend on the number of threads.
+//
+// Builders must implement the following additional interface:
+//
+//      int leaf_size(leaf_info const& leaf) const;
+//      bool split(leaf_infos& childs, leaf_info const& leaf, Data const& data, int max_leaf_size, thread_pool& pool);
+//      Builder detach(leaf_info const& leaf, leaf_info& subtree_root);
+//
+
+template <typename Builder, typename Nodes>
+struct build_top_down_task
+{
+    using leaf_info = typename Builder::leaf_info;
+
+    // Index of the subtree's root node in the final node list
+    int index;
+    // Builder that exclusively owns the subtree's primitive references
+    Builder builder;
+    // Root of the subtree
+    leaf_info leaf;
+    // Subtree nodes, nodes[0] is the root node
+    Nodes nodes;
+    // Primitive indices of the subtree
+    aligned_vector<unsigned> indices;
+};
+
+template <typename Nodes, typename Indices, typename Builder, typename LeafInfo, typename Data, typename Tasks>
+inline void build_top_down_parallel_impl(
+        int             index,
+        Nodes&          nodes,
+        Indices&        indices,
+        Builder&        builder,
+        LeafInfo const& leaf,
+        Data const&     data,
+        int             max_leaf_size,
+        int             subtree_size,
+        thread_pool&    pool,
+        Tasks&          tasks
+        )
+{
+    if (builder.leaf_size(leaf) <= subtree_size)
+    {
+        typename Tasks::value_type task;
+
+        task.index = index;
+        task.builder = builder.detach(leaf, task.leaf);
+
+        tasks.push_back(std::move(task));
+        return;
+    }
+
+    typename Builder::leaf_infos childs;
+
+    auto split = builder.split(childs, leaf, data, max_leaf_size, pool);
+
+    if (split)
+    {
+        auto first_child_index = static_cast<int>(nodes.size());
+
+        nodes[index].set_inner(leaf.prim_bounds, first_child_index, childs[0].prim_bounds, childs[1].prim_bounds);
+
+        nodes.emplace_back();
+        nodes.emplace_back();
+
+        // Same order as build_top_down_impl: the builder's references behave like a stack
+
+        // Construct right subtree
+        build_top_down_parallel_impl(
+                first_child_index + 1,
+                nodes,
+                indices,
+                builder,
+                childs[1],
+                data,
+                max_leaf_size,
+                subtree_size,
+                pool,
+                tasks
+                );
+
+        // Construct left subtree
+        build_top_down_parallel_impl(
+                first_child_index + 0,
+                nodes,
+                indices,
+                builder,
+                childs[0],
+                data,
+                max_leaf_size,
+                subtree_size,
+                pool,
+                tasks
+                );
+    }
+    else
+    {
+        auto first = static_cast<int>(indices.size());
+        auto count = builder.insert_indices(indices, leaf);
+
+        nodes[index].set_leaf(leaf.prim_bounds, first, count);
+    }
+}
+
+template <typename Nodes, typename Indices, typename Builder, typename Root, typename Data>
+inline void build_top_down_parallel_subtrees(
+        Nodes&          nodes,
+        Indices&        indices,
+        Builder&        builder,
+        Root            root,
+        Data const&     data,
+        int             max_leaf_size,
+        int             subtree_size,
+        thread_pool&    pool
+        )
+{
+    using task_type = build_top_down_task<Builder, Nodes>;
+
+    std::vector<task_type> tasks;
+
+    // Build the upper levels of the tree
+
+    build_top_down_parallel_impl(
+            0, // root node index
+            nodes,
+            indices,
+            builder,
+            root,
+            data,
+            max_leaf_size,
+            subtree_size,
+            pool,
+            tasks
+            );
+
+    if (tasks.empty())
+    {
+        return;
+    }
+
+    // Build the subtrees
+
+    pool.run([&](long i)
+        {
+            auto& t = tasks[i];
+
+            t.nodes.emplace_back();
+
+            build_top_down_impl(0, t.nodes, t.indices, t.builder, t.leaf, data, max_leaf_size);
+
+            // Release the references early
+            t.builder = Builder();
+
+        }, static_cast<long>(tasks.size()));
+
+    // Stitch the subtrees into the node and index lists
+
+    std::vector<size_t> node_offsets(tasks.size());
+    std::vector<size_t> index_offsets(tasks.size());
+
+    size_t num_nodes = nodes.size();
+    size_t num_indices = indices.size();
+
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        // Local node 0 replaces the subtree root, local node j > 0 is stored at offset + j
+        node_offsets[i] = num_nodes - 1;
+        index_offsets[i] = num_indices;
+
+        num_nodes += tasks[i].nodes.size() - 1;
+        num_indices += tasks[i].indices.size();
+    }
+
+    nodes.resize(num_nodes);
+    indices.resize(num_indices);
+
+    pool.run([&](long i)
+        {
+            auto const& t = tasks[i];
+
+            auto node_offset = static_cast<unsigned>(node_offsets[i]);
+            auto index_offset = static_cast<unsigned>(index_offsets[i]);
+
+            for (size_t j = 0; j < t.nodes.size(); ++j)
+            {
+                auto n = t.nodes[j];
+
+                if (n.is_inner())
+                {
+                    n.first_child += node_offset;
+                }
+                else
+                {
+                    n.first_prim += index_offset;
+                }
+
+                auto dst = j == 0 ? static_cast<size_t>(t.index) : node_offset + j;
+
+                nodes[dst] = n;
+            }
+
+            std::copy(t.indices.begin(), t.indices.end(), indices.begin() + index_offset);
+
+        }, static_cast<long>(tasks.size()));
+}
+
+template <typename Tree, typename Builder, typename Root, typename I>
+inline void build_top_down_parallel_work(
+        Tree&          tree,
+        Builder&       builder,
+        Root           root,
+        I              first,
+        I              /*last*/,
+        int            max_leaf_size,
+        int            subtree_size,
+        thread_pool&   pool,
+        std::true_type /*is_index_bvh*/
+        )
+{
+    build_top_down_parallel_subtrees(
+            tree.nodes(),
+            tree.indices(),
+            builder,
+            root,
+            first, // primitive data
+            max_leaf_size,
+            subtree_size,
+            pool
+            );
+}
+
+template <typename Tree, typename Builder, typename Root, typename I>
+inline void build_top_down_parallel_work(
+        Tree&           tree,
+        Builder&        builder,
+        Root            root,
+        I               first,
+        I               /*last*/,
+        int             max_leaf_size,
+        int             subtree_size,
+        thread_pool&    pool,
+        std::false_type /*is_index_bvh*/
+        )
+{
+    aligned_vector<unsigned> indices;
+
+    auto uss = builder.use_spatial_splits;
+
+    builder.use_spatial_splits = false;
+
+    build_top_down_parallel_subtrees(
+            tree.nodes(),
+            indices,
+            builder,
+            root,
+            first, // primitive data
+            max_leaf_size,
+            subtree_size,
+            pool
+            );
+
+    builder.use_spatial_splits = uss;
+
+    assert(indices.size() == tree.primitives().size());
+
+    // Reorder the primitives according to the indices.
+    algo::reorder_n(indices.begin(), tree.primitives().begin(), indices.size());
+}
+
+template <typename Tree, typename Builder, typename I>
+inline void build_top_down_parallel(
+        Tree&           tree,
+        Builder&        builder,
+        I               first,
+        I               last,
+        thread_pool&    pool,
+        int             max_leaf_size = -1
+        )
+{
+    if (max_leaf_size <= 0)
+    {
+        max_leaf_size = 4;
+    }
+
+    // No references reserved for spatial splits if they don't apply (cf. build_top_down())
+
+    auto uss = builder.use_spatial_splits;
+
+    builder.use_spatial_splits = uss && is_index_bvh<Tree>::value;
+
+    auto root = builder.init(first, last);
+
+    builder.use_spatial_splits = uss;
+
+    auto count = std::distance(first, last);
+
+    tree.clear(2 * (count / max_leaf_size));
+
+    // Subtrees no larger than this are built by a single task. Depends only
+    // on the number of primitives, so that the tree is deterministic.
+    auto subtree_size = std::max(4096, static_cast<int>(count / 256));
+
+    // Create root node
+    tree.nodes().emplace_back();
+
+    build_top_down_parallel_work(
+            tree,
+            builder,
+            root,
+            first,
+            last,
+            max_leaf_size,
+            subtree_size,
+            pool,
+            is_index_bvh<Tree>()
+            );
+}
+
 } // detail
 } // visionaray
 
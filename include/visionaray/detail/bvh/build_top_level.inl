@@ -0,0 +1,111 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <visionaray/math/aabb.h>
+
+#include "../../aligned_vector.h"
+#include "../../array_ref.h"
+#include "../parallel_for.h"
+#include "../range.h"
+#include "../thread_pool.h"
+#include "motion_bounds.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Proxy primitive with precomputed (instance) bounds
+//
+
+struct instance_bounds
+{
+    aabb bounds;
+};
+
+inline aabb get_bounds(instance_bounds const& prim)
+{
+    return prim.bounds;
+}
+
+// Instances are only split at their bounding boxes
+inline void split_primitive(aabb& L, aabb& R, float plane, int axis, instance_bounds const& prim)
+{
+    L.invalidate();
+    R.invalidate();
+
+    if (prim.bounds.min[axis] <= plane)
+    {
+        L = prim.bounds;
+        L.max[axis] = min(L.max[axis], plane);
+    }
+
+    if (prim.bounds.max[axis] >= plane)
+    {
+        R = prim.bounds;
+        R.min[axis] = max(R.min[axis], plane);
+    }
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// build_top_level()
+//
+
+template <typename Tree, typename Builder>
+void build_top_level(
+        Tree&                                   tree,
+        Builder&                                builder,
+        typename Tree::primitive_type const*    instances,
+        size_t                                  num_instances,
+        thread_pool&                            pool,
+        int                                     max_leaf_size
+        )
+{
+    static_assert(
+            is_index_bvh<Tree>::value && is_any_bvh_inst<typename Tree::primitive_type>::value,
+            "build_top_level() requires an index_bvh_t over BVH instances"
+            );
+
+    // Instances are cheap to bound, use small tiles
+    enum { TileSize = 64 };
+
+    using proxy_tree = index_bvh_t<
+            array_ref<detail::instance_bounds>,
+            typename Tree::node_vector,
+            typename Tree::index_vector
+            >;
+
+    int n = static_cast<int>(num_instances);
+
+    aligned_vector<detail::instance_bounds> bounds(n);
+
+    if (n > 0)
+    {
+        parallel_for(pool, tiled_range1d<int>(0, n, TileSize), [&](range1d<int> const& r)
+            {
+                for (int i = r.begin(); i != r.end(); ++i)
+                {
+                    bounds[i].bounds = get_bounds(instances[i]);
+                }
+            });
+    }
+
+    auto proxy = builder.build(proxy_tree{}, bounds.data(), bounds.size(), pool, max_leaf_size);
+
+    tree.primitives().assign(instances, instances + num_instances);
+    tree.nodes() = std::move(proxy.nodes());
+    tree.indices() = std::move(proxy.indices());
+
+    // Key bounds of the proxies do not know about transform motion
+    detail::update_motion_bounds(tree);
+}
+
+} // visionaray
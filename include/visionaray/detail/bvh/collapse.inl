@@ -0,0 +1,148 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include <visionaray/math/aabb.h>
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// collapse()
+//
+// Wide nodes are created top-down. Starting with the two children of a binary
+// inner node, the inner child with the largest surface area is repeatedly
+// replaced by its own children until all Width slots are filled or only leaves
+// remain. Primitives are copied in the order the leaves are emitted.
+// Nodes are assembled as wide_bvh_node<Width> and then converted to the node
+// type of WideBVH (e.g. to compress them).
+//
+
+template <typename WideBVH, typename BVH>
+WideBVH collapse(BVH const& b)
+{
+    static_assert(is_any_bvh<BVH>::value && !is_wide_bvh<BVH>::value, "collapse() requires a binary BVH");
+
+    using node_type = typename WideBVH::node_type;
+
+    enum { Width = WideBVH::width };
+
+    WideBVH result;
+
+    auto& nodes = result.nodes();
+    auto& primitives = result.primitives();
+
+    if (b.num_nodes() == 0)
+    {
+        return result;
+    }
+
+    // Append the primitives of binary leaf n, return the index of the first one
+    auto emit_leaf = [&](bvh_node const& n)
+    {
+        unsigned first = static_cast<unsigned>(primitives.size());
+
+        for (auto i = n.get_indices().first; i != n.get_indices().last; ++i)
+        {
+            primitives.push_back(b.primitive(i));
+        }
+
+        return first;
+    };
+
+    nodes.emplace_back();
+
+    if (is_leaf(b.node(0)))
+    {
+        auto const& n = b.node(0);
+
+        wide_bvh_node<Width> wn;
+        wn.set_leaf(0, n.get_bounds(), emit_leaf(n), n.get_num_primitives());
+
+        for (unsigned i = 1; i < Width; ++i)
+        {
+            wn.set_empty(i);
+        }
+
+        nodes[0] = node_type(wn);
+
+        return result;
+    }
+
+    // (binary node, wide node) pairs that still need to be processed
+    std::vector<std::pair<unsigned, unsigned>> work;
+    work.emplace_back(0U, 0U);
+
+    while (!work.empty())
+    {
+        auto item = work.back();
+        work.pop_back();
+
+        auto const& n = b.node(item.first);
+
+        unsigned slots[Width];
+        unsigned num_slots = 2;
+
+        slots[0] = n.get_child(0);
+        slots[1] = n.get_child(1);
+
+        while (num_slots < Width)
+        {
+            int largest = -1;
+            float max_area = -1.0f;
+
+            for (unsigned i = 0; i < num_slots; ++i)
+            {
+                auto const& c = b.node(slots[i]);
+
+                if (!is_leaf(c) && surface_area(c.get_bounds()) > max_area)
+                {
+                    largest = static_cast<int>(i);
+                    max_area = surface_area(c.get_bounds());
+                }
+            }
+
+            if (largest < 0)
+            {
+                break;
+            }
+
+            auto const& c = b.node(slots[largest]);
+            slots[largest] = c.get_child(0);
+            slots[num_slots++] = c.get_child(1);
+        }
+
+        wide_bvh_node<Width> wn;
+
+        for (unsigned i = 0; i < num_slots; ++i)
+        {
+            auto const& c = b.node(slots[i]);
+
+            if (is_leaf(c))
+            {
+                wn.set_leaf(i, c.get_bounds(), emit_leaf(c), c.get_num_primitives());
+            }
+            else
+            {
+                unsigned child_index = static_cast<unsigned>(nodes.size());
+                nodes.emplace_back();
+                wn.set_inner(i, c.get_bounds(), child_index);
+                work.emplace_back(slots[i], child_index);
+            }
+        }
+
+        for (unsigned i = num_slots; i < Width; ++i)
+        {
+            wn.set_empty(i);
+        }
+
+        nodes[item.second] = node_type(wn);
+    }
+
+    return result;
+}
+
+} // visionaray
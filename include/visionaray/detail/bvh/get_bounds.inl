@@ -4,14 +4,98 @@
 #include <type_traits>
 
 #include <visionaray/math/aabb.h>
+#include <visionaray/math/matrix.h>
 
 namespace visionaray
 {
+namespace detail
+{
+
+// Bounds of a node at motion key KEY (0 or 1), static nodes have the same
+// bounds at both keys
+VSNRAY_FUNC
+inline aabb get_key_bounds(bvh_node const& node, int /* key */)
+{
+    return node.get_bounds();
+}
+
+VSNRAY_FUNC
+inline aabb get_key_bounds(motion_bvh_node const& node, int key)
+{
+    return node.get_key_bounds(key);
+}
+
+// Transform center and half extent, cf. Arvo (1990): Transforming Axis-Aligned
+// Bounding Boxes. Same result as transforming the eight corners
+MATH_FUNC
+inline aabb transform_bounds(aabb const& bbox, mat4 const& trans)
+{
+    if (bbox.invalid())
+    {
+        return bbox;
+    }
+
+    vec3 c = (trans * vec4(bbox.center(), 1.0f)).xyz();
+    vec3 e = bbox.size() * 0.5f;
+
+    vec3 r;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        r[i] = abs(trans.col0[i]) * e.x + abs(trans.col1[i]) * e.y + abs(trans.col2[i]) * e.z;
+    }
+
+    return aabb(c - r, c + r);
+}
+
+// Bounds of an instance of a BVH with bounds BBOX, static instances
+template <typename Inst>
+MATH_FUNC
+inline aabb get_inst_bounds(Inst const& inst, aabb const& bbox, std::false_type /* motion */)
+{
+    return transform_bounds(bbox, inverse(inst.transform_inv()));
+}
+
+// Instances with transform motion
+template <typename Inst>
+MATH_FUNC
+inline aabb get_inst_bounds(Inst const& inst, aabb const& bbox, std::true_type /* motion */)
+{
+    if (!inst.has_motion())
+    {
+        return transform_bounds(bbox, inverse(inst.transform_inv()));
+    }
+
+    // Points move linearly between the transformed points at the keys
+    return combine(
+            transform_bounds(bbox, inst.transform(0)),
+            transform_bounds(bbox, inst.transform(1))
+            );
+}
+
+// Bounds at motion key KEY (0 or 1), static instances
+template <typename Inst>
+MATH_FUNC
+inline aabb get_inst_bounds(Inst const& inst, aabb const& bbox, int /* key */, std::false_type /* motion */)
+{
+    return transform_bounds(bbox, inverse(inst.transform_inv()));
+}
+
+// Instances with transform motion
+template <typename Inst>
+MATH_FUNC
+inline aabb get_inst_bounds(Inst const& inst, aabb const& bbox, int key, std::true_type /* motion */)
+{
+    return transform_bounds(bbox, inst.transform(key));
+}
+
+} // detail
+
 
 template <
     typename BVH,
     typename = typename std::enable_if<is_any_bvh<BVH>::value>::type,
-    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value>::type
+    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value && !is_wide_bvh<BVH>::value>::type
     >
 MATH_FUNC
 aabb get_bounds(BVH const& bvh)
@@ -37,22 +121,52 @@ template <
 MATH_FUNC
 aabb get_bounds(BVH const& bvh)
 {
-    auto trans = inverse(bvh.transform_inv());
+    return detail::get_inst_bounds(
+            bvh,
+            get_bounds(bvh.get_ref()),
+            typename is_bvh_motion_inst<BVH>::type{}
+            );
+}
+
 
-    aabb bbox = get_bounds(bvh.get_ref());
+//-------------------------------------------------------------------------------------------------
+// Bounds at motion key KEY (0 or 1), for motion BVHs over BVHs
+//
 
+template <
+    typename BVH,
+    typename = typename std::enable_if<is_any_bvh<BVH>::value>::type,
+    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value && !is_wide_bvh<BVH>::value>::type
+    >
+MATH_FUNC
+aabb get_bounds(BVH const& bvh, int key)
+{
     aabb result;
     result.invalidate();
 
-    auto vertices = compute_vertices(bbox);
-
-    for (vec3 v : vertices)
+    if (bvh.num_nodes() > 0)
     {
-        v = (trans * vec4(v, 1.0f)).xyz();
-        result.insert(v);
+        result = detail::get_key_bounds(bvh.node(0), key);
     }
 
     return result;
 }
 
+template <
+    typename BVH,
+    typename = typename std::enable_if<is_any_bvh<BVH>::value>::type,
+    typename = typename std::enable_if<is_any_bvh_inst<BVH>::value>::type,
+    typename = void
+    >
+MATH_FUNC
+aabb get_bounds(BVH const& bvh, int key)
+{
+    return detail::get_inst_bounds(
+            bvh,
+            get_bounds(bvh.get_ref()),
+            key,
+            typename is_bvh_motion_inst<BVH>::type{}
+            );
+}
+
 } // visionaray
@@ -61,11 +61,13 @@ struct hit_record_bvh_inst : hit_record_bvh<R, Base>
     VSNRAY_FUNC explicit hit_record_bvh_inst(
             hit_record_bvh<R, Base> const& base,
             int_type i,
-            matrix<4, 4, scalar_type> const& trans_inv
+            matrix<4, 4, scalar_type> const& trans_inv,
+            int_type id = int_type(0)
             )
         : hit_record_bvh<R, Base>(base)
         , primitive_list_index_inst(i)
         , transform_inv(trans_inv)
+        , inst_id(id)
     {
     }
 
@@ -77,9 +79,82 @@ struct hit_record_bvh_inst : hit_record_bvh<R, Base>
 
     // Inverse transformation matrix
     matrix<4, 4, scalar_type> transform_inv = matrix<4, 4, typename R::scalar_type>::identity();
+
+    // User-defined id of the instance, cf. bvh_inst_t::inst_id()
+    int_type inst_id = int_type(0);
 };
 
 
+//-------------------------------------------------------------------------------------------------
+// Number of nested instances of a hit record
+//
+
+namespace detail
+{
+
+template <typename HR>
+struct inst_depth : std::integral_constant<int, 0>
+{
+};
+
+template <typename R, typename Base>
+struct inst_depth<hit_record_bvh<R, Base>> : inst_depth<Base>
+{
+};
+
+template <typename R, typename Base>
+struct inst_depth<hit_record_bvh_inst<R, Base>> : std::integral_constant<int, inst_depth<Base>::value + 1>
+{
+};
+
+template <typename HR, typename I>
+VSNRAY_FUNC
+inline void get_inst_path(HR const& /* */, I* /* path */)
+{
+}
+
+template <typename R, typename Base, typename I>
+VSNRAY_FUNC
+inline void get_inst_path(hit_record_bvh_inst<R, Base> const& hr, I* path);
+
+template <typename R, typename Base, typename I>
+VSNRAY_FUNC
+inline void get_inst_path(hit_record_bvh<R, Base> const& hr, I* path)
+{
+    get_inst_path(static_cast<Base const&>(hr), path);
+}
+
+template <typename R, typename Base, typename I>
+VSNRAY_FUNC
+inline void get_inst_path(hit_record_bvh_inst<R, Base> const& hr, I* path)
+{
+    path[0] = hr.inst_id;
+    get_inst_path(static_cast<Base const&>(hr), path + 1);
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// get_inst_path()
+//
+// The inst_ids of the nested instances that contain the hit, from the
+// outermost to the innermost instance.
+//
+
+template <typename HR>
+VSNRAY_FUNC
+inline auto get_inst_path(HR const& hr)
+    -> array<typename HR::int_type, detail::inst_depth<HR>::value>
+{
+    static_assert(detail::inst_depth<HR>::value > 0, "Hit record does not belong to an instance");
+
+    array<typename HR::int_type, detail::inst_depth<HR>::value> result;
+    detail::get_inst_path(hr, result.data());
+    return result;
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // update_if() overload that dispatches to update_if() for Base in addition
 // to store BVH hit information
@@ -109,6 +184,7 @@ void update_if(
     update_if(static_cast<hit_record_bvh<R, Base>&>(dst), static_cast<hit_record_bvh<R, Base> const&>(src), cond);
     dst.primitive_list_index_inst = select( cond, src.primitive_list_index_inst, dst.primitive_list_index_inst );
     dst.transform_inv = select( cond, src.transform_inv, dst.transform_inv );
+    dst.inst_id = select( cond, src.inst_id, dst.inst_id );
 }
 
 
@@ -184,6 +260,9 @@ inline auto unpack(
 
     auto transform_inv = unpack(hr.transform_inv);
 
+    int_array inst_id = {};
+    store(inst_id, hr.inst_id);
+
     for (size_t i = 0; i < num_elements<FloatT>::value; ++i)
     {
         result[i] = hit_record_bvh_inst<ray, scalar_base_type>(
@@ -192,7 +271,8 @@ inline auto unpack(
                         primitive_list_index[i]
                         ),
                 primitive_list_index_inst[i],
-                transform_inv[i]
+                transform_inv[i],
+                inst_id[i]
                 );
     }
 
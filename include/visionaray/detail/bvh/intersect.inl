@@ -1,10 +1,12 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <cassert>
 #include <cstddef>
 #include <type_traits>
 #include <utility>
 
+#include <visionaray/math/simd/type_traits.h>
 #include <visionaray/math/limits.h>
 #include <visionaray/math/matrix.h>
 #include <visionaray/intersector.h>
@@ -19,43 +21,137 @@
 
 namespace visionaray
 {
+namespace detail
+{
 
 //-------------------------------------------------------------------------------------------------
-// Ray / BVH intersection
+// Sign of the ray direction, majority vote for ray packets
 //
 
+template <typename T, typename = typename std::enable_if<!simd::is_simd_vector<T>::value>::type>
+VSNRAY_FUNC
+inline bool is_negative_dir(T const& d)
+{
+    return d < T(0.0);
+}
+
 template <
-    detail::traversal_type Traversal,
-    size_t MultiHitMax = 1,             // Max hits for multi-hit traversal
+    typename T,
+    typename = typename std::enable_if<simd::is_simd_vector<T>::value>::type,
+    typename = void
+    >
+inline bool is_negative_dir(T const& d)
+{
+    simd::aligned_array_t<T> arr;
+    store(arr, d);
+
+    size_t num_negative = 0;
+
+    for (size_t i = 0; i < simd::num_elements<T>::value; ++i)
+    {
+        if (arr[i] < 0.0f)
+        {
+            ++num_negative;
+        }
+    }
+
+    return num_negative * 2 > simd::num_elements<T>::value;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Determine which of the two children of an inner node to visit first
+//
+
+template <bvh_child_order Order>
+struct bvh_child_ordering;
+
+template <>
+struct bvh_child_ordering<bvh_child_order::distance>
+{
+    template <typename R>
+    VSNRAY_FUNC explicit bvh_child_ordering(R const& /* ray */)
+    {
+    }
+
+    template <typename HR>
+    VSNRAY_FUNC unsigned near_child(bvh_node const& /* node */, HR const& hr1, HR const& hr2) const
+    {
+        return all( hr1.tnear < hr2.tnear ) ? 0 : 1;
+    }
+};
+
+template <>
+struct bvh_child_ordering<bvh_child_order::split_axis>
+{
+    template <typename R>
+    VSNRAY_FUNC explicit bvh_child_ordering(R const& ray)
+    {
+        dir_neg[0] = is_negative_dir(ray.dir.x);
+        dir_neg[1] = is_negative_dir(ray.dir.y);
+        dir_neg[2] = is_negative_dir(ray.dir.z);
+    }
+
+    template <typename HR>
+    VSNRAY_FUNC unsigned near_child(bvh_node const& node, HR const& /* hr1 */, HR const& /* hr2 */) const
+    {
+        unsigned low = node.get_low_child();
+        return dir_neg[node.get_split_axis()] ? 1 - low : low;
+    }
+
+    bool dir_neg[3];
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Bounds of a node at the time of the ray
+//
+
+template <typename T>
+VSNRAY_FUNC
+inline aabb const& get_bounds_at(bvh_node const& node, T const& /* time */)
+{
+    return node.get_bounds();
+}
+
+template <typename T>
+VSNRAY_FUNC
+inline basic_aabb<T> get_bounds_at(motion_bvh_node const& node, T const& time)
+{
+    return node.get_bounds_at(time);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Ray / BVH intersection with a full traversal stack
+//
+
+template <
+    traversal_type Traversal,
+    size_t MultiHitMax,
+    typename Strategy,
+    typename RT,
+    typename HR,
     typename R,
     typename BVH,
-    typename = typename std::enable_if<is_any_bvh<BVH>::value>::type,
-    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value>::type,
     typename Intersector,
-    typename T = typename R::scalar_type,
-    typename Cond = is_closer_t
+    typename T,
+    typename Cond
     >
 VSNRAY_FUNC
-inline auto intersect(
+inline RT intersect_bvh(
         R const&     ray,
         BVH const&   b,
         Intersector& isect,
-        T            max_t = numeric_limits<T>::max(),
-        Cond         update_cond = Cond()
+        T            max_t,
+        Cond         update_cond,
+        std::integral_constant<bvh_stack_mode, bvh_stack_mode::full> /* */
         )
-    -> typename detail::traversal_result< hit_record_bvh<
-            R,
-            decltype( isect(ray, std::declval<typename BVH::primitive_type>()) )
-            >, Traversal, MultiHitMax>::type
 {
-
-    using namespace detail;
-    using HR = hit_record_bvh<R, decltype(isect(ray, std::declval<typename BVH::primitive_type>()))>;
-
-    using RT = typename detail::traversal_result<HR, Traversal, MultiHitMax>::type;
-
     RT result;
 
+    bvh_child_ordering<Strategy::order> ordering(ray);
+
     stack<32> st;
     st.push(0); // address of root node
 
@@ -74,15 +170,15 @@ next:
         {
             auto children = &b.node(node.get_child(0));
 
-            auto hr1 = isect(ray, children[0].get_bounds(), inv_dir);
-            auto hr2 = isect(ray, children[1].get_bounds(), inv_dir);
+            auto hr1 = isect(ray, get_bounds_at(children[0], ray.time), inv_dir);
+            auto hr2 = isect(ray, get_bounds_at(children[1], ray.time), inv_dir);
 
             auto b1 = any( is_closer(hr1, result, max_t) );
             auto b2 = any( is_closer(hr2, result, max_t) );
 
             if (b1 && b2)
             {
-                unsigned near_addr = all( hr1.tnear < hr2.tnear ) ? 0 : 1;
+                unsigned near_addr = ordering.near_child(node, hr1, hr2);
                 st.push(node.get_child(!near_addr));
                 node = b.node(node.get_child(near_addr));
             }
@@ -133,11 +229,327 @@ next:
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Ray / BVH intersection with a short stack and restart trail
+//
+// cf. Laine (2010): Restart Trail for Stackless BVH Traversal
+//
+// Bit L of the trail belongs to the inner node at depth 63 - L on the current
+// path. If it is set, the near child of that node was finished (or missed) and
+// the far child is visited. When a subtree is finished, the trail is incremented
+// at the level of its parent; the carry marks ancestors whose far child is done.
+// The far child to continue with is then taken from the short stack, or found
+// by restarting from the root and following the trail. The near/far order is
+// deterministic and the set of children that are hit can only shrink while the
+// closest hit moves closer, so no subtree is visited twice.
+//
+// Inner nodes 64 levels below the root of the current subtree have no bit left
+// in the trail, their subtree is traversed with a trail of its own. The state
+// of the enclosing subtree (root, trail and level) is saved in a fixed array
+// and restored when the inner subtree is finished, the short stack is cleared
+// on both occasions. Up to MaxSubtrees subtrees can be nested, i.e. trees up
+// to 64 * (MaxSubtrees + 1) levels deep are traversed, deeper subtrees are
+// skipped. Returns true if traversal exited early.
+//
+
+template <
+    traversal_type Traversal,
+    typename Strategy,
+    typename RT,
+    typename HR,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename Cond,
+    typename Ordering,
+    typename V
+    >
+VSNRAY_FUNC
+inline bool intersect_bvh_restart(
+        R const&        ray,
+        BVH const&      b,
+        Intersector&    isect,
+        T const&        max_t,
+        Cond            update_cond,
+        Ordering const& ordering,
+        V const&        inv_dir,
+        unsigned        root,
+        RT&             result
+        )
+{
+    using trail_type = unsigned long long;
+
+    enum { MaxSubtrees = 8 };
+
+    struct subtree
+    {
+        unsigned root;
+        trail_type trail;
+        trail_type level;
+    };
+
+    trail_type const root_level = trail_type(1) << 63;
+    unsigned const no_node = ~0U;
+
+    // Stores far children, tagged with the level of their parent. Near children
+    // without a far sibling push no_node, so that popping them needs no restart
+    short_stack<Strategy::short_stack_size, unsigned, trail_type> st;
+
+    // Enclosing subtrees of trees deeper than the trail
+    subtree outer[MaxSubtrees];
+    int num_outer = 0;
+
+    trail_type trail = 0;
+    trail_type level = root_level;
+    unsigned index = root;
+
+    for (;;)
+    {
+        auto const& node = b.node(index);
+
+        if (is_inner(node) && level == 0)
+        {
+            // Tree too deep for the trail, continue with the subtree
+            if (num_outer < MaxSubtrees)
+            {
+                outer[num_outer++] = { root, trail, level };
+
+                st.clear();
+                root = index;
+                trail = 0;
+                level = root_level;
+                continue;
+            }
+
+            assert(0 && "BVH too deep for restart trail traversal");
+        }
+        else if (is_inner(node))
+        {
+            auto children = &b.node(node.get_child(0));
+
+            auto hr1 = isect(ray, get_bounds_at(children[0], ray.time), inv_dir);
+            auto hr2 = isect(ray, get_bounds_at(children[1], ray.time), inv_dir);
+
+            bool hit[] = {
+                    any( is_closer(hr1, result, max_t) ),
+                    any( is_closer(hr2, result, max_t) )
+                    };
+
+            unsigned near_addr = ordering.near_child(node, hr1, hr2);
+            unsigned far_addr = !near_addr;
+
+            if ((trail & level) == 0)
+            {
+                if (hit[near_addr])
+                {
+                    st.push(hit[far_addr] ? node.get_child(far_addr) : no_node, level);
+                    index = node.get_child(near_addr);
+                    level >>= 1;
+                    continue;
+                }
+
+                trail |= level;
+            }
+
+            if (hit[far_addr])
+            {
+                index = node.get_child(far_addr);
+                level >>= 1;
+                continue;
+            }
+        }
+        else
+        {
+            // while node contains untested primitives
+            //     perform a ray-primitive intersection test
+
+            for (auto i = node.get_indices().first; i != node.get_indices().last; ++i)
+            {
+                auto prim = b.primitive(i);
+
+                auto hr = HR(isect(ray, prim), i);
+                auto closer = update_cond(hr, result, max_t);
+
+#ifndef __CUDA_ARCH__
+                if (!any(closer))
+                {
+                    continue;
+                }
+#endif
+
+                update_if(result, hr, closer);
+
+                exit_traversal<Traversal> early_exit;
+                if (early_exit.check(result))
+                {
+                    return true;
+                }
+            }
+        }
+
+        // Current node is finished, find the next one
+        for (;;)
+        {
+            // Level 0: node 64 levels below the root, its parent has bit 0
+            trail_type parent_level = level != 0 ? level << 1 : 1;
+
+            bool subtree_done = level == root_level;
+
+            if (!subtree_done)
+            {
+                trail &= ~(parent_level - 1);
+                trail += parent_level;
+
+                // Carry beyond the root, all nodes were visited
+                subtree_done = trail == 0;
+            }
+
+            if (subtree_done)
+            {
+                if (num_outer == 0)
+                {
+                    return false;
+                }
+
+                // The root of the subtree is finished in the enclosing one
+                --num_outer;
+                root = outer[num_outer].root;
+                trail = outer[num_outer].trail;
+                level = outer[num_outer].level;
+
+                st.clear();
+                continue;
+            }
+
+            level = trail & (~trail + 1);
+
+            if (!st.empty() && st.top_tag() == level)
+            {
+                index = st.pop();
+                level >>= 1;
+
+                if (index == no_node)
+                {
+                    continue;
+                }
+            }
+            else
+            {
+                // Restart
+                st.clear();
+                index = root;
+                level = root_level;
+            }
+
+            break;
+        }
+    }
+
+    return false;
+}
+
+template <
+    traversal_type Traversal,
+    size_t MultiHitMax,
+    typename Strategy,
+    typename RT,
+    typename HR,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename Cond
+    >
+VSNRAY_FUNC
+inline RT intersect_bvh(
+        R const&     ray,
+        BVH const&   b,
+        Intersector& isect,
+        T            max_t,
+        Cond         update_cond,
+        std::integral_constant<bvh_stack_mode, bvh_stack_mode::restart> /* */
+        )
+{
+    RT result;
+
+    if (b.num_nodes() == 0)
+    {
+        return result;
+    }
+
+    bvh_child_ordering<Strategy::order> ordering(ray);
+
+    auto inv_dir = T(1.0) / ray.dir;
+
+    intersect_bvh_restart<Traversal, Strategy, RT, HR>(
+            ray,
+            b,
+            isect,
+            max_t,
+            update_cond,
+            ordering,
+            inv_dir,
+            0,
+            result
+            );
+
+    return result;
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Ray / BVH intersection
+//
+
+template <
+    detail::traversal_type Traversal,
+    size_t MultiHitMax = 1,             // Max hits for multi-hit traversal
+    typename Strategy = default_bvh_traversal,
+    typename R,
+    typename BVH,
+    typename = typename std::enable_if<is_any_bvh<BVH>::value>::type,
+    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value && !is_wide_bvh<BVH>::value>::type,
+    typename Intersector,
+    typename T = typename R::scalar_type,
+    typename Cond = is_closer_t
+    >
+VSNRAY_FUNC
+inline auto intersect(
+        R const&     ray,
+        BVH const&   b,
+        Intersector& isect,
+        T            max_t = numeric_limits<T>::max(),
+        Cond         update_cond = Cond()
+        )
+    -> typename detail::traversal_result< hit_record_bvh<
+            R,
+            decltype( isect(ray, std::declval<typename BVH::primitive_type>()) )
+            >, Traversal, MultiHitMax>::type
+{
+    using HR = hit_record_bvh<R, decltype(isect(ray, std::declval<typename BVH::primitive_type>()))>;
+
+    using RT = typename detail::traversal_result<HR, Traversal, MultiHitMax>::type;
+
+    return detail::intersect_bvh<Traversal, MultiHitMax, Strategy, RT, HR>(
+            ray,
+            b,
+            isect,
+            max_t,
+            update_cond,
+            std::integral_constant<bvh_stack_mode, Strategy::mode>{}
+            );
+}
+
+
 // Overload for instances ---------------------------------
 
 template <
     detail::traversal_type Traversal,
     size_t MultiHitMax = 1,             // Max hits for multi-hit traversal
+    typename Strategy = default_bvh_traversal,
     typename R,
     typename BVH,
     typename = typename std::enable_if<is_any_bvh_inst<BVH>::value>::type,
@@ -163,12 +575,14 @@ inline auto intersect(
 
     using RT = typename detail::traversal_result<HR, Traversal, MultiHitMax>::type;
 
+    auto transform_inv = b.transform_inv(ray.time);
+
     R transformed_ray = ray;
-    transformed_ray.ori = (matrix<4, 4, T>(b.transform_inv()) * vector<4, T>(ray.ori, T(1.0))).xyz();
-    transformed_ray.dir = (matrix<4, 4, T>(b.transform_inv()) * vector<4, T>(ray.dir, T(0.0))).xyz();
+    transformed_ray.ori = (transform_inv * vector<4, T>(ray.ori, T(1.0))).xyz();
+    transformed_ray.dir = (transform_inv * vector<4, T>(ray.dir, T(0.0))).xyz();
     // NOTE: dir is in general *not* normalized!
 
-    auto hr = intersect<Traversal, MultiHitMax>(
+    auto hr = intersect<Traversal, MultiHitMax, Strategy>(
             transformed_ray,
             b.get_ref(),
             isect,
@@ -176,7 +590,14 @@ inline auto intersect(
             update_cond
             );
 
-    return RT(hr, hr.primitive_list_index, matrix<4, 4, T>(b.transform_inv()));
+    using I = simd::int_type_t<T>;
+
+    if (b.geom_id() != ~0U)
+    {
+        hr.geom_id = I(static_cast<int>(b.geom_id()));
+    }
+
+    return RT(hr, hr.primitive_list_index, transform_inv, I(static_cast<int>(b.inst_id())));
 }
 
 
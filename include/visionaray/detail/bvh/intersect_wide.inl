@@ -0,0 +1,209 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+#include <visionaray/math/simd/type_traits.h>
+#include <visionaray/math/intersect.h>
+#include <visionaray/math/limits.h>
+#include <visionaray/math/ray.h>
+#include <visionaray/intersector.h>
+#include <visionaray/update_if.h>
+
+#include "../exit_traversal.h"
+#include "../macros.h"
+#include "../multi_hit.h"
+#include "../stack.h"
+#include "../tags.h"
+#include "../traversal_result.h"
+#include "hit_record.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Intersect a ray with all children of a wide node
+//
+
+// Single ray: one SIMD slab test for all children --------
+
+template <typename Node, typename HR>
+inline void intersect_children(
+        basic_ray<float> const& ray,
+        Node const&             node,
+        vector<3, float> const& inv_dir,
+        HR*                     hrs
+        )
+{
+    using F = simd::float_from_simd_width_t<Node::width>;
+
+    vector<3, F> bmin;
+    vector<3, F> bmax;
+    node.get_bounds(bmin, bmax);
+
+    vector<3, F> ori(ray.ori);
+    vector<3, F> idir(inv_dir);
+
+    vector<3, F> t1 = (bmin - ori) * idir;
+    vector<3, F> t2 = (bmax - ori) * idir;
+
+    F tnear = min_max( t1.x, t2.x, min_max(t1.y, t2.y, min(t1.z, t2.z)) );
+    F tfar  = max_min( t1.x, t2.x, max_min(t1.y, t2.y, max(t1.z, t2.z)) );
+
+    VSNRAY_ALIGN(32) float tn[Node::width];
+    VSNRAY_ALIGN(32) float tf[Node::width];
+
+    store(tn, tnear);
+    store(tf, tfar);
+
+    for (unsigned i = 0; i < Node::width; ++i)
+    {
+        hrs[i].tnear = tn[i];
+        hrs[i].tfar  = tf[i];
+        hrs[i].hit   = tf[i] >= tn[i];
+    }
+}
+
+// Ray packets: test the children one after another -------
+
+template <typename R, typename Node, typename HR>
+inline void intersect_children(
+        R const&                                    ray,
+        Node const&                                 node,
+        vector<3, typename R::scalar_type> const&   inv_dir,
+        HR*                                         hrs
+        )
+{
+    for (unsigned i = 0; i < Node::width; ++i)
+    {
+        hrs[i] = intersect(ray, node.get_bounds(i), inv_dir);
+    }
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Ray / wide BVH intersection
+//
+// Leaf children are intersected right away, inner children that were hit are
+// pushed onto the stack in far-to-near order. Strategy is ignored, wide nodes
+// always order their children by distance and use a full stack.
+//
+
+template <
+    detail::traversal_type Traversal,
+    size_t MultiHitMax = 1,             // Max hits for multi-hit traversal
+    typename Strategy = default_bvh_traversal,
+    typename R,
+    typename BVH,
+    typename = typename std::enable_if<is_wide_bvh<BVH>::value>::type,
+    typename Intersector,
+    typename T = typename R::scalar_type,
+    typename Cond = is_closer_t,
+    typename = void
+    >
+inline auto intersect(
+        R const&     ray,
+        BVH const&   b,
+        Intersector& isect,
+        T            max_t = numeric_limits<T>::max(),
+        Cond         update_cond = Cond()
+        )
+    -> typename detail::traversal_result< hit_record_bvh<
+            R,
+            decltype( isect(ray, std::declval<typename BVH::primitive_type>()) )
+            >, Traversal, MultiHitMax>::type
+{
+
+    using namespace detail;
+    using HR = hit_record_bvh<R, decltype(isect(ray, std::declval<typename BVH::primitive_type>()))>;
+    using HR_aabb = hit_record<R, aabb>;
+
+    using RT = typename detail::traversal_result<HR, Traversal, MultiHitMax>::type;
+
+    enum { Width = BVH::node_type::width };
+
+    RT result;
+
+    if (b.num_nodes() == 0)
+    {
+        return result;
+    }
+
+    stack<32 * (Width - 1)> st;
+    st.push(0); // address of root node
+
+    auto inv_dir = T(1.0) / ray.dir;
+
+    while (!st.empty())
+    {
+        auto const& node = b.node(st.pop());
+
+        HR_aabb hrs[Width];
+        intersect_children(ray, node, inv_dir, hrs);
+
+        // Inner children that were hit, sorted near to far
+        unsigned inner[Width];
+        unsigned num_inner = 0;
+
+        for (unsigned i = 0; i < Width && !node.is_empty(i); ++i)
+        {
+            if (!any( is_closer(hrs[i], result, max_t) ))
+            {
+                continue;
+            }
+
+            if (node.is_inner(i))
+            {
+                unsigned j = num_inner++;
+
+                for (; j > 0 && all( hrs[i].tnear < hrs[inner[j - 1]].tnear ); --j)
+                {
+                    inner[j] = inner[j - 1];
+                }
+
+                inner[j] = i;
+                continue;
+            }
+
+            // while leaf contains untested primitives
+            //     perform a ray-primitive intersection test
+
+            for (auto k = node.get_indices(i).first; k != node.get_indices(i).last; ++k)
+            {
+                auto prim = b.primitive(k);
+
+                auto hr = HR(isect(ray, prim), k);
+                auto closer = update_cond(hr, result, max_t);
+
+                if (!any(closer))
+                {
+                    continue;
+                }
+
+                update_if(result, hr, closer);
+
+                exit_traversal<Traversal> early_exit;
+                if (early_exit.check(result))
+                {
+                    return result;
+                }
+            }
+        }
+
+        for (unsigned j = num_inner; j > 0; --j)
+        {
+            st.push(node.get_child(inner[j - 1]));
+        }
+    }
+
+    return result;
+
+}
+
+} // visionaray
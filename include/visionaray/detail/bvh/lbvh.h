@@ -8,10 +8,22 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
+#include <visionaray/math/detail/math.h>
 #include <visionaray/aligned_vector.h>
 #include <visionaray/morton.h>
 
+#include "../algorithm.h"
+#include "../parallel_algorithm.h"
+#include "../parallel_for.h"
+#include "../thread_pool.h"
+#include "motion_bounds.h"
+
 #ifdef _WIN32
 #include <intrin.h>
 #endif
@@ -102,6 +114,40 @@ struct lbvh_builder
         Tree tree(primitives, num_prims);
 
         detail::build_top_down(tree, *this, primitives, primitives + num_prims, max_leaf_size);
+        detail::update_motion_bounds(tree);
+
+        return tree;
+    }
+
+    // Build in parallel on the given thread pool: parallel Morton encoding,
+    // parallel radix sort and Karras-style emission of the hierarchy. The
+    // result does not depend on the number of threads.
+    template <typename Tree, typename P>
+    Tree build(Tree /* */, P* primitives, size_t num_prims, thread_pool& pool, int max_leaf_size = -1)
+    {
+        Tree tree(primitives, num_prims);
+
+        if (max_leaf_size <= 0)
+        {
+            max_leaf_size = 4;
+        }
+
+        auto root = init(primitives, primitives + num_prims, pool);
+
+        tree.clear();
+
+        if (root.last - root.first <= max_leaf_size)
+        {
+            tree.nodes().emplace_back();
+            tree.nodes()[0].set_leaf(root.prim_bounds, 0, root.last - root.first);
+        }
+        else
+        {
+            emit_nodes(tree.nodes(), max_leaf_size, pool);
+        }
+
+        emit_indices(tree, pool, is_index_bvh<Tree>());
+        detail::update_motion_bounds(tree);
 
         return tree;
     }
@@ -163,6 +209,101 @@ struct lbvh_builder
         return { 0, static_cast<int>(last - first), scene_bounds };
     }
 
+    // Same as above, runs on the thread pool and sorts with a radix sort.
+    template <typename I>
+    leaf_info init(I first, I last, thread_pool& pool)
+    {
+        int n = static_cast<int>(last - first);
+
+        prim_bounds.resize(n);
+        prim_refs.resize(n);
+
+        int num_blocks = div_up(n, static_cast<int>(BlockSize));
+
+        aabb scene_bounds;
+        scene_bounds.invalidate();
+
+        aabb centroid_bounds;
+        centroid_bounds.invalidate();
+
+        if (n == 0)
+        {
+            return { 0, 0, scene_bounds };
+        }
+
+
+        // Calculate bounding boxes for all primitives and centroids per block
+
+        aligned_vector<aabb> block_bounds(num_blocks);
+        aligned_vector<aabb> block_centroid_bounds(num_blocks);
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+                block_bounds[b].invalidate();
+                block_centroid_bounds[b].invalidate();
+
+                for (int i = block_first; i != block_last; ++i)
+                {
+                    prim_bounds[i] = get_bounds(first[i]);
+                    block_bounds[b].insert(prim_bounds[i]);
+                    block_centroid_bounds[b].insert(prim_bounds[i].center());
+                }
+            }, static_cast<long>(num_blocks));
+
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            scene_bounds.insert(block_bounds[b]);
+            centroid_bounds.insert(block_centroid_bounds[b]);
+        }
+
+
+        // Calculate morton codes for centroids
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+                for (int i = block_first; i != block_last; ++i)
+                {
+                    vec3 centroid = prim_bounds[i].center();
+
+                    // Express centroid in [0..1] relative to bounding box
+                    centroid -= centroid_bounds.center();
+                    centroid = (centroid + centroid_bounds.size() * 0.5f) / centroid_bounds.size();
+
+                    // Quantize centroid to 10-bit
+                    centroid = min(max(centroid * 1024.0f, vec3(0.0f)), vec3(1023.0f));
+
+                    prim_refs[i].id = i;
+                    prim_refs[i].morton_code = morton_encode3D(
+                            static_cast<int>(centroid.x),
+                            static_cast<int>(centroid.y),
+                            static_cast<int>(centroid.z)
+                            );
+                }
+            }, static_cast<long>(num_blocks));
+
+
+        // Sort by morton codes (30-bit), stable like the serial version
+
+        aligned_vector<prim_ref> temp(n);
+
+        paralgo::radix_sort(
+                pool,
+                prim_refs.begin(),
+                prim_refs.end(),
+                temp.begin(),
+                30,
+                [](prim_ref const& ref) { return ref.morton_code; }
+                );
+
+        return { 0, n, scene_bounds };
+    }
+
     // Inserts primitive indices into INDICES.
     template <typename Indices>
     int insert_indices(Indices& indices, leaf_info const& leaf)
@@ -216,6 +357,312 @@ struct lbvh_builder
 
     // TODO:
     bool use_spatial_splits;
+
+private:
+
+    enum
+    {
+        // Number of primitives processed by a single task
+        BlockSize = 1 << 14
+    };
+
+    // Karras (2012): "Maximizing Parallelism in the Construction of BVHs,
+    // Octrees, and k-d Trees". Inner node i of the binary radix tree over
+    // the N sorted primitive references, 0 <= i < N - 1, 0 is the root.
+    struct radix_node
+    {
+        int first;    // First primitive reference (in sorted order)
+        int last;     // Last primitive reference (inclusive)
+        int child[2]; // Inner node index, or ~index of a primitive reference
+        int parent;   // Parent inner node, or -1 for the root
+    };
+
+    // Length of the longest common prefix of the keys at positions i and j.
+    // Morton codes are augmented with the position to resolve duplicates.
+    int delta(int i, int j) const
+    {
+        int n = static_cast<int>(prim_refs.size());
+
+        if (j < 0 || j >= n)
+        {
+            return -1;
+        }
+
+        unsigned code_i = prim_refs[i].morton_code;
+        unsigned code_j = prim_refs[j].morton_code;
+
+        if (code_i == code_j)
+        {
+            return 32 + static_cast<int>(detail::clz(static_cast<unsigned>(i ^ j)));
+        }
+
+        return static_cast<int>(detail::clz(code_i ^ code_j));
+    }
+
+    // Determine range and split position of inner node i.
+    void make_radix_node(radix_node* nodes, int* leaf_parents, int i) const
+    {
+        // Direction of the range
+        int d = delta(i, i + 1) - delta(i, i - 1) >= 0 ? 1 : -1;
+
+        // Upper bound for the length of the range
+        int delta_min = delta(i, i - d);
+        int lmax = 2;
+
+        while (delta(i, i + lmax * d) > delta_min)
+        {
+            lmax *= 2;
+        }
+
+        // Find the other end with binary search
+        int l = 0;
+
+        for (int t = lmax / 2; t >= 1; t /= 2)
+        {
+            if (delta(i, i + (l + t) * d) > delta_min)
+            {
+                l += t;
+            }
+        }
+
+        int j = i + l * d;
+
+        // Find the split position with binary search
+        int delta_node = delta(i, j);
+        int s = 0;
+        int t = l;
+
+        do
+        {
+            t = (t + 1) / 2;
+
+            if (delta(i, i + (s + t) * d) > delta_node)
+            {
+                s += t;
+            }
+        }
+        while (t > 1);
+
+        int gamma = i + s * d + std::min(d, 0);
+
+        auto& node = nodes[i];
+
+        node.first = std::min(i, j);
+        node.last = std::max(i, j);
+
+        if (node.first == gamma)
+        {
+            node.child[0] = ~gamma;
+            leaf_parents[gamma] = i;
+        }
+        else
+        {
+            node.child[0] = gamma;
+            nodes[gamma].parent = i;
+        }
+
+        if (node.last == gamma + 1)
+        {
+            node.child[1] = ~(gamma + 1);
+            leaf_parents[gamma + 1] = i;
+        }
+        else
+        {
+            node.child[1] = gamma + 1;
+            nodes[gamma + 1].parent = i;
+        }
+    }
+
+    // Emit the radix tree as bvh_nodes. Inner nodes with no more than
+    // max_leaf_size primitive references are collapsed into leaves. The
+    // children of the k-th (in index order) emitted inner node are stored
+    // at positions 2k+1 and 2k+2.
+    template <typename Nodes>
+    void emit_nodes(Nodes& result, int max_leaf_size, thread_pool& pool) const
+    {
+        int n = static_cast<int>(prim_refs.size());
+        int num_inner = n - 1;
+        int num_blocks = div_up(num_inner, static_cast<int>(BlockSize));
+
+        assert(num_inner > 0);
+
+        std::vector<radix_node> nodes(num_inner);
+        std::vector<int> leaf_parents(n);
+        aligned_vector<aabb> bounds(num_inner);
+        std::unique_ptr<std::atomic<int>[]> visited(new std::atomic<int>[num_inner]);
+
+        nodes[0].parent = -1;
+
+
+        // Build the hierarchy, one task per block of inner nodes
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), num_inner);
+
+                for (int i = block_first; i != block_last; ++i)
+                {
+                    make_radix_node(nodes.data(), leaf_parents.data(), i);
+                    visited[i] = 0;
+                }
+            }, static_cast<long>(num_blocks));
+
+
+        // Compute bounds bottom-up. The second thread that arrives
+        // at an inner node merges the bounds of its children.
+
+        auto child_bounds = [&](int c)
+        {
+            return c >= 0 ? bounds[c] : prim_bounds[prim_refs[~c].id];
+        };
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+                for (int i = block_first; i != block_last; ++i)
+                {
+                    int index = leaf_parents[i];
+
+                    while (index >= 0 && visited[index].fetch_add(1) == 1)
+                    {
+                        auto const& node = nodes[index];
+
+                        bounds[index] = combine(child_bounds(node.child[0]), child_bounds(node.child[1]));
+
+                        index = node.parent;
+                    }
+                }
+            }, static_cast<long>(div_up(n, static_cast<int>(BlockSize))));
+
+
+        // Assign output positions to the inner nodes that are not collapsed
+
+        auto is_inner = [&](int i)
+        {
+            return nodes[i].last - nodes[i].first + 1 > max_leaf_size;
+        };
+
+        std::vector<int> positions(num_inner);
+        std::vector<int> block_counts(num_blocks);
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), num_inner);
+
+                block_counts[b] = 0;
+
+                for (int i = block_first; i != block_last; ++i)
+                {
+                    block_counts[b] += is_inner(i) ? 1 : 0;
+                }
+            }, static_cast<long>(num_blocks));
+
+        int num_emitted = 0;
+
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            int count = block_counts[b];
+            block_counts[b] = num_emitted;
+            num_emitted += count;
+        }
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), num_inner);
+
+                int k = block_counts[b];
+
+                for (int i = block_first; i != block_last; ++i)
+                {
+                    positions[i] = is_inner(i) ? 2 * k++ + 1 : -1;
+                }
+            }, static_cast<long>(num_blocks));
+
+
+        // Emit nodes, each inner node writes its children
+
+        result.resize(1 + 2 * num_emitted);
+
+        result[0].set_inner(bounds[0], positions[0], child_bounds(nodes[0].child[0]), child_bounds(nodes[0].child[1]));
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), num_inner);
+
+                for (int i = block_first; i != block_last; ++i)
+                {
+                    if (positions[i] < 0)
+                    {
+                        continue;
+                    }
+
+                    for (int j = 0; j < 2; ++j)
+                    {
+                        int c = nodes[i].child[j];
+                        auto& out = result[positions[i] + j];
+
+                        if (c >= 0 && positions[c] >= 0)
+                        {
+                            out.set_inner(
+                                    bounds[c],
+                                    positions[c],
+                                    child_bounds(nodes[c].child[0]),
+                                    child_bounds(nodes[c].child[1])
+                                    );
+                        }
+                        else if (c >= 0)
+                        {
+                            out.set_leaf(bounds[c], nodes[c].first, nodes[c].last - nodes[c].first + 1);
+                        }
+                        else
+                        {
+                            out.set_leaf(child_bounds(c), ~c, 1);
+                        }
+                    }
+                }
+            }, static_cast<long>(num_blocks));
+    }
+
+    template <typename Tree>
+    void emit_indices(Tree& tree, thread_pool& pool, std::true_type /* is_index_bvh */) const
+    {
+        int n = static_cast<int>(prim_refs.size());
+
+        tree.indices().resize(n);
+
+        if (n == 0)
+        {
+            return;
+        }
+
+        parallel_for(pool, tiled_range1d<int>(0, n, BlockSize), [&](range1d<int> const& r)
+            {
+                for (int i = r.begin(); i != r.end(); ++i)
+                {
+                    tree.indices()[i] = prim_refs[i].id;
+                }
+            });
+    }
+
+    template <typename Tree>
+    void emit_indices(Tree& tree, thread_pool& /* pool */, std::false_type /* is_index_bvh */) const
+    {
+        aligned_vector<unsigned> indices(prim_refs.size());
+
+        for (size_t i = 0; i < prim_refs.size(); ++i)
+        {
+            indices[i] = prim_refs[i].id;
+        }
+
+        // Reorder the primitives according to the indices.
+        algo::reorder_n(indices.begin(), tree.primitives().begin(), indices.size());
+    }
 };
 
 } // visionaray
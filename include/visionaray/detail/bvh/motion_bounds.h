@@ -0,0 +1,133 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_BVH_MOTION_BOUNDS_H
+#define VSNRAY_DETAIL_BVH_MOTION_BOUNDS_H 1
+
+#include <type_traits>
+#include <utility>
+
+#include <visionaray/math/aabb.h>
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Bounds of a primitive at motion key KEY (0 or 1)
+//
+// Moving primitives implement get_bounds(prim, key), static primitives have
+// the same bounds at both keys.
+//
+
+template <typename P>
+struct has_key_bounds_impl
+{
+    template <typename U>
+    static std::true_type test(decltype(get_bounds(std::declval<U const&>(), 0))*);
+
+    template <typename U>
+    static std::false_type test(...);
+
+    using type = decltype( test<typename std::decay<P>::type>(nullptr) );
+};
+
+template <typename P>
+struct has_key_bounds : has_key_bounds_impl<P>::type
+{
+};
+
+template <
+    typename P,
+    typename = typename std::enable_if<has_key_bounds<P>::value>::type
+    >
+inline aabb get_prim_key_bounds(P const& prim, int key)
+{
+    return aabb(get_bounds(prim, key));
+}
+
+template <
+    typename P,
+    typename = typename std::enable_if<!has_key_bounds<P>::value>::type,
+    typename = void
+    >
+inline aabb get_prim_key_bounds(P const& prim, int /* key */)
+{
+    return aabb(get_bounds(prim));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Update the key bounds of the nodes of a motion BVH from its primitives
+//
+// Called by the builders and by refit(), no-op for static BVHs.
+//
+
+template <typename Tree>
+inline void update_motion_bounds(Tree& tree, unsigned index, aabb& key0, aabb& key1)
+{
+    auto& node = tree.nodes()[index];
+
+    key0.invalidate();
+    key1.invalidate();
+
+    if (node.is_leaf())
+    {
+        auto range = node.get_indices();
+
+        for (unsigned i = range.first; i != range.last; ++i)
+        {
+            key0.insert(get_prim_key_bounds(tree.primitive(i), 0));
+            key1.insert(get_prim_key_bounds(tree.primitive(i), 1));
+        }
+    }
+    else
+    {
+        aabb child_key0;
+        aabb child_key1;
+
+        for (unsigned i = 0; i < 2; ++i)
+        {
+            update_motion_bounds(tree, node.get_child(i), child_key0, child_key1);
+
+            key0.insert(child_key0);
+            key1.insert(child_key1);
+        }
+    }
+
+    node.set_key_bounds(0, key0);
+    node.set_key_bounds(1, key1);
+}
+
+template <typename Tree>
+inline void update_motion_bounds(Tree& tree, std::true_type /* motion */)
+{
+    if (tree.num_nodes() == 0)
+    {
+        return;
+    }
+
+    aabb key0;
+    aabb key1;
+
+    update_motion_bounds(tree, 0, key0, key1);
+}
+
+template <typename Tree>
+inline void update_motion_bounds(Tree& /* tree */, std::false_type /* motion */)
+{
+}
+
+template <typename Tree>
+inline void update_motion_bounds(Tree& tree)
+{
+    update_motion_bounds(tree, std::is_same<typename Tree::node_type, motion_bvh_node>{});
+}
+
+} // detail
+} // visionaray
+
+#endif // VSNRAY_DETAIL_BVH_MOTION_BOUNDS_H
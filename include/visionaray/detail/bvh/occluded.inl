@@ -0,0 +1,235 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <type_traits>
+
+#include <visionaray/math/simd/type_traits.h>
+#include <visionaray/math/aabb.h>
+#include <visionaray/math/matrix.h>
+#include <visionaray/intersector.h>
+#include <visionaray/update_if.h>
+
+#include "../macros.h"
+#include "../stack.h"
+#include "../tags.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Determine which of the two children of an inner node to visit first
+//
+
+template <bvh_occlusion_order Order>
+struct bvh_occlusion_ordering;
+
+template <>
+struct bvh_occlusion_ordering<bvh_occlusion_order::none>
+{
+    template <typename Node>
+    VSNRAY_FUNC unsigned first_child(Node const* /* children */) const
+    {
+        return 0;
+    }
+};
+
+template <>
+struct bvh_occlusion_ordering<bvh_occlusion_order::surface_area>
+{
+    template <typename Node>
+    VSNRAY_FUNC unsigned first_child(Node const* children) const
+    {
+        return surface_area(children[1].get_bounds()) > surface_area(children[0].get_bounds()) ? 1 : 0;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Occlusion of a single primitive, a BVH, or a BVH instance
+//
+// The mask is set for rays with a hit in [0..max_t). Hit records of BVHs are
+// never assembled, traversal ends as soon as all rays are occluded.
+//
+
+template <
+    bvh_occlusion_order Order,
+    typename R,
+    typename P,
+    typename Intersector,
+    typename T,
+    typename = typename std::enable_if<!is_any_bvh<P>::value>::type
+    >
+VSNRAY_FUNC
+inline auto occluded_prim(R const& ray, P const& prim, Intersector& isect, T const& max_t)
+    -> typename simd::mask_type<T>::type
+{
+    auto hr = isect(ray, prim);
+    return hr.hit && hr.t >= T(0.0) && hr.t < max_t;
+}
+
+template <
+    bvh_occlusion_order Order,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename = typename std::enable_if<is_bvh<BVH>::value || is_index_bvh<BVH>::value>::type,
+    typename = typename std::enable_if<!is_any_bvh_inst<BVH>::value>::type
+    >
+VSNRAY_FUNC
+inline auto occluded_prim(R const& ray, BVH const& b, Intersector& isect, T const& max_t)
+    -> typename simd::mask_type<T>::type;
+
+template <
+    bvh_occlusion_order Order,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename = typename std::enable_if<is_any_bvh_inst<BVH>::value>::type,
+    typename = void,
+    typename = void
+    >
+VSNRAY_FUNC
+inline auto occluded_prim(R const& ray, BVH const& b, Intersector& isect, T const& max_t)
+    -> typename simd::mask_type<T>::type;
+
+// Wide BVHs: any hit traversal
+template <
+    bvh_occlusion_order Order,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename = typename std::enable_if<is_wide_bvh<BVH>::value>::type,
+    typename = void,
+    typename = void,
+    typename = void
+    >
+VSNRAY_FUNC
+inline auto occluded_prim(R const& ray, BVH const& b, Intersector& isect, T const& max_t)
+    -> typename simd::mask_type<T>::type
+{
+    auto hr = isect(
+            std::integral_constant<int, AnyHit>{},
+            std::integral_constant<size_t, 1>{},
+            ray,
+            b,
+            max_t,
+            is_closer_t()
+            );
+
+    return hr.hit;
+}
+
+// Binary BVHs --------------------------------------------
+
+template <
+    bvh_occlusion_order Order,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename,
+    typename
+    >
+VSNRAY_FUNC
+inline auto occluded_prim(R const& ray, BVH const& b, Intersector& isect, T const& max_t)
+    -> typename simd::mask_type<T>::type
+{
+    using mask_type = typename simd::mask_type<T>::type;
+
+    mask_type result(false);
+
+    if (b.num_nodes() == 0)
+    {
+        return result;
+    }
+
+    bvh_occlusion_ordering<Order> ordering;
+
+    stack<32> st;
+    st.push(0); // address of root node
+
+    auto inv_dir = T(1.0) / ray.dir;
+
+next:
+    while (!st.empty())
+    {
+        auto node = b.node(st.pop());
+
+        while (!is_leaf(node))
+        {
+            auto children = &b.node(node.get_child(0));
+
+            auto hr1 = isect(ray, get_bounds_at(children[0], ray.time), inv_dir);
+            auto hr2 = isect(ray, get_bounds_at(children[1], ray.time), inv_dir);
+
+            // Only rays that are not occluded yet
+            bool hit[] = {
+                    any( hr1.hit && hr1.tfar >= T(0.0) && hr1.tnear < max_t && !result ),
+                    any( hr2.hit && hr2.tfar >= T(0.0) && hr2.tnear < max_t && !result )
+                    };
+
+            unsigned first = ordering.first_child(children);
+
+            if (hit[first] && hit[!first])
+            {
+                st.push(node.get_child(!first));
+                node = b.node(node.get_child(first));
+            }
+            else if (hit[first] || hit[!first])
+            {
+                node = b.node(node.get_child(hit[first] ? first : !first));
+            }
+            else
+            {
+                goto next;
+            }
+        }
+
+        for (auto i = node.get_indices().first; i != node.get_indices().last; ++i)
+        {
+            result = result || occluded_prim<Order>(ray, b.primitive(i), isect, max_t);
+
+            if (all(result))
+            {
+                return result;
+            }
+        }
+    }
+
+    return result;
+}
+
+// Instances ----------------------------------------------
+
+template <
+    bvh_occlusion_order Order,
+    typename R,
+    typename BVH,
+    typename Intersector,
+    typename T,
+    typename,
+    typename,
+    typename
+    >
+VSNRAY_FUNC
+inline auto occluded_prim(R const& ray, BVH const& b, Intersector& isect, T const& max_t)
+    -> typename simd::mask_type<T>::type
+{
+    auto transform_inv = b.transform_inv(ray.time);
+
+    // dir is not normalized, so that distances are preserved
+    R transformed_ray = ray;
+    transformed_ray.ori = (transform_inv * vector<4, T>(ray.ori, T(1.0))).xyz();
+    transformed_ray.dir = (transform_inv * vector<4, T>(ray.dir, T(0.0))).xyz();
+
+    return occluded_prim<Order>(transformed_ray, b.get_ref(), isect, max_t);
+}
+
+} // detail
+} // visionaray
@@ -0,0 +1,362 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <visionaray/math/detail/math.h>
+#include <visionaray/math/aabb.h>
+
+#include "../thread_pool.h"
+#include "motion_bounds.h"
+#include "statistics.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Treelet restructuring
+//
+// cf. Karras, Aila (2013): Fast Parallel Construction of High-Quality Bounding Volume Hierarchies
+//
+// A treelet is formed below an inner node by repeatedly expanding the treelet
+// leaf with the largest surface area. The topology with minimal SAH cost over
+// the treelet leaves is found by dynamic programming over all subsets of the
+// leaves. The treelet leaves (subtrees) are only moved, the inner nodes of the
+// treelet reuse the child pairs of the original inner nodes, so the node count
+// and the primitive order do not change.
+//
+
+template <typename Node>
+class treelet_optimizer
+{
+public:
+
+    enum { MaxTreeletSize = 8 };
+
+    treelet_optimizer(
+            Node*       nodes,
+            int*        parents,
+            float*      costs,
+            float       ci,
+            float       cp
+            )
+        : nodes_(nodes)
+        , parents_(parents)
+        , costs_(costs)
+        , ci_(ci)
+        , cp_(cp)
+    {
+    }
+
+    // SAH cost of a leaf
+    float leaf_cost(Node const& n) const
+    {
+        return cp_ * surface_area(n.get_bounds()) * static_cast<float>(n.get_num_primitives());
+    }
+
+    // SAH cost of an inner node, the costs of its children must be known
+    float inner_cost(Node const& n) const
+    {
+        return ci_ * surface_area(n.get_bounds()) + costs_[n.get_child(0)] + costs_[n.get_child(1)];
+    }
+
+    // Restructure the treelet below the inner node ROOT. The whole subtree
+    // must be owned by the calling thread
+    void restructure(int root, int treelet_size)
+    {
+        // Form treelet
+
+        num_leaves_ = 0;
+        num_pairs_ = 0;
+
+        pairs_[num_pairs_++] = nodes_[root].get_child(0);
+        leaves_[num_leaves_++] = nodes_[root].get_child(0);
+        leaves_[num_leaves_++] = nodes_[root].get_child(1);
+
+        while (num_leaves_ < treelet_size)
+        {
+            int largest = -1;
+            float largest_area = -1.0f;
+
+            for (int i = 0; i < num_leaves_; ++i)
+            {
+                auto const& n = nodes_[leaves_[i]];
+
+                if (n.is_inner() && surface_area(n.get_bounds()) > largest_area)
+                {
+                    largest = i;
+                    largest_area = surface_area(n.get_bounds());
+                }
+            }
+
+            if (largest < 0)
+            {
+                break;
+            }
+
+            auto const& n = nodes_[leaves_[largest]];
+
+            pairs_[num_pairs_++] = n.get_child(0);
+            leaves_[largest] = n.get_child(0);
+            leaves_[num_leaves_++] = n.get_child(1);
+        }
+
+        if (num_leaves_ < 3)
+        {
+            return;
+        }
+
+        // Find the optimal topology
+
+        unsigned num_subsets = 1U << num_leaves_;
+
+        for (int i = 0; i < num_leaves_; ++i)
+        {
+            leaf_nodes_[i] = nodes_[leaves_[i]];
+            leaf_costs_[i] = costs_[leaves_[i]];
+
+            bounds_[1U << i] = leaf_nodes_[i].get_bounds();
+            subset_costs_[1U << i] = leaf_costs_[i];
+        }
+
+        for (unsigned s = 1; s < num_subsets; ++s)
+        {
+            if ((s & (s - 1)) == 0)
+            {
+                continue;
+            }
+
+            // Subsets are visited in ascending order, all proper subsets are known
+            unsigned lowest = s & (~s + 1);
+            bounds_[s] = combine(bounds_[lowest], bounds_[s ^ lowest]);
+
+            float best = std::numeric_limits<float>::max();
+
+            // Visit each partition once: P contains the lowest leaf
+            for (unsigned p = (s - 1) & s; p != 0; p = (p - 1) & s)
+            {
+                if ((p & lowest) == 0)
+                {
+                    continue;
+                }
+
+                float c = subset_costs_[p] + subset_costs_[s ^ p];
+
+                if (c < best)
+                {
+                    best = c;
+                    splits_[s] = p;
+                }
+            }
+
+            subset_costs_[s] = ci_ * surface_area(bounds_[s]) + best;
+        }
+
+        // Only write back if the cost improves
+
+        unsigned all = num_subsets - 1;
+
+        if (subset_costs_[all] >= inner_cost(nodes_[root]))
+        {
+            return;
+        }
+
+        next_pair_ = 0;
+        emit(all, root);
+    }
+
+private:
+
+    Node*       nodes_;
+    int*        parents_;
+    float*      costs_;
+    float       ci_;
+    float       cp_;
+
+    int         leaves_[MaxTreeletSize];
+    int         num_leaves_;
+
+    // First indices of the child pairs of the treelet's inner nodes
+    int         pairs_[MaxTreeletSize - 1];
+    int         num_pairs_;
+    int         next_pair_;
+
+    Node        leaf_nodes_[MaxTreeletSize];
+    float       leaf_costs_[MaxTreeletSize];
+
+    aabb        bounds_[1 << MaxTreeletSize];
+    float       subset_costs_[1 << MaxTreeletSize];
+    unsigned    splits_[1 << MaxTreeletSize];
+
+    void emit(unsigned s, int index)
+    {
+        if ((s & (s - 1)) == 0)
+        {
+            int leaf = 0;
+            while ((s >> leaf) != 1)
+            {
+                ++leaf;
+            }
+
+            nodes_[index] = leaf_nodes_[leaf];
+            costs_[index] = leaf_costs_[leaf];
+
+            if (nodes_[index].is_inner())
+            {
+                parents_[nodes_[index].get_child(0)] = index;
+                parents_[nodes_[index].get_child(1)] = index;
+            }
+
+            return;
+        }
+
+        unsigned p = splits_[s];
+        int first_child = pairs_[next_pair_++];
+
+        emit(p, first_child);
+        emit(s ^ p, first_child + 1);
+
+        nodes_[index].set_inner(bounds_[s], first_child, bounds_[p], bounds_[s ^ p]);
+        costs_[index] = subset_costs_[s];
+
+        parents_[first_child] = index;
+        parents_[first_child + 1] = index;
+    }
+};
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// optimize()
+//
+// Each round walks the tree bottom-up like refit(). The second visitor of an
+// inner node restructures the treelet below it, so that all treelets in a
+// subtree were processed before the subtree is used in a treelet higher up.
+// Only treelets below nodes with at least GAMMA primitives are restructured,
+// GAMMA starts at the treelet size and is doubled after each round.
+//
+
+template <typename Tree>
+float optimize(Tree& tree, thread_pool& pool, int iterations, int treelet_size)
+{
+    static_assert(
+            is_bvh<Tree>::value || is_index_bvh<Tree>::value,
+            "optimize() requires bvh_t or index_bvh_t"
+            );
+
+    enum { BlockSize = 1 << 14 };
+
+    // Costs as in sah_cost()
+    static const float ci = 1.2f;
+    static const float cp = 1.0f;
+
+    using optimizer_type = detail::treelet_optimizer<typename Tree::node_type>;
+
+    auto& nodes = tree.nodes();
+
+    int num_nodes = static_cast<int>(nodes.size());
+    int num_blocks = div_up(num_nodes, static_cast<int>(BlockSize));
+
+    if (num_nodes == 0)
+    {
+        return 0.0f;
+    }
+
+    treelet_size = std::max(3, std::min(treelet_size, static_cast<int>(optimizer_type::MaxTreeletSize)));
+
+    std::vector<int> parents(num_nodes);
+    std::vector<int> num_prims(num_nodes);
+    std::vector<float> costs(num_nodes);
+    std::vector<char> leaves(num_nodes);
+    std::unique_ptr<std::atomic<int>[]> visited(new std::atomic<int>[num_nodes]);
+
+    parents[0] = -1;
+
+    int gamma = treelet_size;
+
+    for (int iteration = 0; iteration < iterations; ++iteration)
+    {
+        // Parent pointers, visit counters, and the leaves before restructuring
+
+        pool.run([&](long b)
+            {
+                int first = static_cast<int>(b) * BlockSize;
+                int last = std::min(first + static_cast<int>(BlockSize), num_nodes);
+
+                for (int i = first; i != last; ++i)
+                {
+                    visited[i] = 0;
+                    leaves[i] = nodes[i].is_leaf();
+
+                    if (nodes[i].is_inner())
+                    {
+                        parents[nodes[i].get_child(0)] = i;
+                        parents[nodes[i].get_child(1)] = i;
+                    }
+                }
+            }, static_cast<long>(num_blocks));
+
+        // Restructure bottom-up
+
+        pool.run([&](long b)
+            {
+                int first = static_cast<int>(b) * BlockSize;
+                int last = std::min(first + static_cast<int>(BlockSize), num_nodes);
+
+                optimizer_type optimizer(
+                        nodes.data(),
+                        parents.data(),
+                        costs.data(),
+                        ci,
+                        cp
+                        );
+
+                for (int i = first; i != last; ++i)
+                {
+                    // No other thread moves a leaf before its parent was visited
+                    if (!leaves[i])
+                    {
+                        continue;
+                    }
+
+                    num_prims[i] = static_cast<int>(nodes[i].get_num_primitives());
+                    costs[i] = optimizer.leaf_cost(nodes[i]);
+
+                    int index = parents[i];
+
+                    while (index >= 0 && visited[index].fetch_add(1) == 1)
+                    {
+                        auto const& n = nodes[index];
+
+                        num_prims[index] = num_prims[n.get_child(0)] + num_prims[n.get_child(1)];
+
+                        if (num_prims[index] >= gamma)
+                        {
+                            // Keeps the bounds and the primitive count of the node
+                            optimizer.restructure(index, treelet_size);
+                        }
+
+                        costs[index] = optimizer.inner_cost(n);
+
+                        index = parents[index];
+                    }
+                }
+            }, static_cast<long>(num_blocks));
+
+        gamma *= 2;
+    }
+
+    detail::update_motion_bounds(tree);
+
+    return sah_cost(tree);
+}
+
+} // visionaray
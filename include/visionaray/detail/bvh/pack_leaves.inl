@@ -0,0 +1,66 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <type_traits>
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// pack_leaves()
+//
+
+template <typename PacketBVH, typename BVH>
+PacketBVH pack_leaves(BVH const& b)
+{
+    static_assert(
+            is_bvh<BVH>::value || is_index_bvh<BVH>::value,
+            "pack_leaves() requires bvh_t or index_bvh_t"
+            );
+
+    static_assert(
+            std::is_same<typename BVH::primitive_type, basic_triangle<3, float>>::value,
+            "pack_leaves() requires a BVH over basic_triangle<3, float>"
+            );
+
+    using packet_type = typename PacketBVH::primitive_type;
+
+    PacketBVH result;
+
+    auto& nodes = result.nodes();
+    auto& packets = result.primitives();
+
+    nodes.resize(b.num_nodes());
+
+    for (size_t i = 0; i < b.num_nodes(); ++i)
+    {
+        auto const& n = b.node(i);
+
+        nodes[i] = n;
+
+        if (is_inner(n))
+        {
+            continue;
+        }
+
+        unsigned first = static_cast<unsigned>(packets.size());
+
+        for (auto j = n.get_indices().first; j != n.get_indices().last; ++j)
+        {
+            if (packets.size() == first || packets.back().count == packet_type::size)
+            {
+                packets.emplace_back();
+                packets.back().clear();
+            }
+
+            packets.back().push_back(b.primitive(j));
+        }
+
+        nodes[i].set_leaf(n.get_bounds(), first, static_cast<unsigned>(packets.size()) - first);
+    }
+
+    return result;
+}
+
+} // visionaray
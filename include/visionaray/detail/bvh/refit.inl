@@ -0,0 +1,151 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include <visionaray/math/detail/math.h>
+#include <visionaray/math/aabb.h>
+
+#include "../thread_pool.h"
+#include "motion_bounds.h"
+#include "statistics.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+// Bounds of the primitives of a leaf ---------------------
+
+template <typename Tree>
+inline aabb refit_leaf_bounds(Tree const& tree, bvh_node const& leaf, std::true_type /* is_index_bvh */)
+{
+    aabb result;
+    result.invalidate();
+
+    auto range = leaf.get_indices();
+
+    for (unsigned i = range.first; i != range.last; ++i)
+    {
+        result.insert(get_bounds(tree.primitives()[tree.indices()[i]]));
+    }
+
+    return result;
+}
+
+template <typename Tree>
+inline aabb refit_leaf_bounds(Tree const& tree, bvh_node const& leaf, std::false_type /* is_index_bvh */)
+{
+    aabb result;
+    result.invalidate();
+
+    auto range = leaf.get_indices();
+
+    for (unsigned i = range.first; i != range.last; ++i)
+    {
+        result.insert(get_bounds(tree.primitives()[i]));
+    }
+
+    return result;
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// refit()
+//
+// Leaves are refitted in parallel, then each task walks up the tree. Every
+// inner node is visited twice, the second visitor merges the children's bounds.
+//
+
+template <typename Tree>
+float refit(Tree& tree, thread_pool& pool, float reference_cost)
+{
+    static_assert(
+            is_bvh<Tree>::value || is_index_bvh<Tree>::value,
+            "refit() requires bvh_t or index_bvh_t"
+            );
+
+    enum { BlockSize = 1 << 14 };
+
+    auto& nodes = tree.nodes();
+
+    int num_nodes = static_cast<int>(nodes.size());
+    int num_blocks = div_up(num_nodes, static_cast<int>(BlockSize));
+
+    if (num_nodes == 0)
+    {
+        return 0.0f;
+    }
+
+    // Parent pointers and visit counters
+
+    std::vector<int> parents(num_nodes);
+    std::unique_ptr<std::atomic<int>[]> visited(new std::atomic<int>[num_nodes]);
+
+    parents[0] = -1;
+
+    pool.run([&](long b)
+        {
+            int first = static_cast<int>(b) * BlockSize;
+            int last = std::min(first + static_cast<int>(BlockSize), num_nodes);
+
+            for (int i = first; i != last; ++i)
+            {
+                visited[i] = 0;
+
+                if (nodes[i].is_inner())
+                {
+                    parents[nodes[i].get_child(0)] = i;
+                    parents[nodes[i].get_child(1)] = i;
+                }
+            }
+        }, static_cast<long>(num_blocks));
+
+    // Refit bottom-up
+
+    pool.run([&](long b)
+        {
+            int first = static_cast<int>(b) * BlockSize;
+            int last = std::min(first + static_cast<int>(BlockSize), num_nodes);
+
+            for (int i = first; i != last; ++i)
+            {
+                if (nodes[i].is_inner())
+                {
+                    continue;
+                }
+
+                nodes[i].set_bounds(detail::refit_leaf_bounds(tree, nodes[i], is_index_bvh<Tree>()));
+
+                int index = parents[i];
+
+                while (index >= 0 && visited[index].fetch_add(1) == 1)
+                {
+                    auto& n = nodes[index];
+
+                    auto const& left = nodes[n.get_child(0)].get_bounds();
+                    auto const& right = nodes[n.get_child(1)].get_bounds();
+
+                    // Also update the split axis, deformation may have changed it
+                    n.set_inner(combine(left, right), n.get_child(0), left, right);
+
+                    index = parents[index];
+                }
+            }
+        }, static_cast<long>(num_blocks));
+
+    detail::update_motion_bounds(tree);
+
+    auto cost = sah_cost(tree);
+
+    return reference_cost > 0.0f ? cost / reference_cost : cost;
+}
+
+} // visionaray
@@ -7,21 +7,144 @@
 #define VSNRAY_DETAIL_BVH_SAH_H 1
 
 #include <cassert>
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <cstddef>
+#include <memory>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#include <visionaray/math/detail/math.h>
 #include <visionaray/math/aabb.h>
+#include <visionaray/math/curve.h>
+#include <visionaray/math/motion_triangle.h>
 #include <visionaray/math/sphere.h>
 #include <visionaray/math/triangle.h>
+#include <visionaray/math/woop_triangle.h>
 
+#include "../aligned_allocator.h"
+#include "../thread_pool.h"
 #include "build_top_down.h"
+#include "motion_bounds.h"
 
 namespace visionaray
 {
 namespace detail
 {
 
+//-------------------------------------------------------------------------------------------------
+// Keeps track of the current and the peak number of allocated bytes
+//
+
+struct memory_counter
+{
+    std::atomic<size_t> current;
+    std::atomic<size_t> peak;
+
+    memory_counter()
+        : current(0)
+        , peak(0)
+    {
+    }
+
+    void allocate(size_t bytes)
+    {
+        auto cur = current.fetch_add(bytes) + bytes;
+        auto p = peak.load();
+
+        while (cur > p && !peak.compare_exchange_weak(p, cur))
+        {
+        }
+    }
+
+    void deallocate(size_t bytes)
+    {
+        current.fetch_sub(bytes);
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Aligned allocator that reports to a memory_counter
+//
+
+template <typename T, size_t A = 16>
+class counting_allocator
+{
+public:
+
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    counting_allocator() = default;
+
+    explicit counting_allocator(std::shared_ptr<memory_counter> counter)
+        : counter_(std::move(counter))
+    {
+    }
+
+    template <typename U>
+    counting_allocator(counting_allocator<U, A> const& rhs)
+        : counter_(rhs.counter())
+    {
+    }
+
+    template <typename U>
+    struct rebind
+    {
+        typedef counting_allocator<U, A> other;
+    };
+
+    pointer allocate(size_type n)
+    {
+        if (counter_)
+        {
+            counter_->allocate(n * sizeof(T));
+        }
+
+        return aligned_allocator<T, A>().allocate(n);
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+        if (counter_)
+        {
+            counter_->deallocate(n * sizeof(T));
+        }
+
+        aligned_allocator<T, A>().deallocate(p, n);
+    }
+
+    std::shared_ptr<memory_counter> const& counter() const
+    {
+        return counter_;
+    }
+
+    bool operator==(counting_allocator const& rhs) const
+    {
+        return counter_ == rhs.counter_;
+    }
+
+    bool operator!=(counting_allocator const& rhs) const
+    {
+        return !(*this == rhs);
+    }
+
+private:
+
+    std::shared_ptr<memory_counter> counter_;
+};
+
+
 inline void split_edge(aabb& L, aabb& R, vec3 const& v0, vec3 const& v1, float plane, int axis)
 {
     auto t0 = v0[axis];
@@ -65,6 +188,115 @@ void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_triangle<Dim
     detail::split_edge(L, R, v2, v0, plane, axis);
 }
 
+// Split the recovered triangle, padded like get_bounds(). Points of the exact
+// triangle left of the plane lie within the padding of points of the recovered
+// triangle left of plane + padding, and vice versa
+template <typename T, typename P>
+void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_woop_triangle<T, P> const& prim)
+{
+    auto tri = make_triangle(prim);
+    auto err = detail::recovery_error(prim, tri);
+    auto pad = vec3(err);
+
+    aabb unused;
+    split_primitive(L, unused, plane + err, axis, tri);
+    split_primitive(unused, R, plane - err, axis, tri);
+
+    if (L.valid())
+    {
+        L = aabb(L.min - pad, L.max + pad);
+    }
+
+    if (R.valid())
+    {
+        R = aabb(R.min - pad, R.max + pad);
+    }
+}
+
+// The triangle at any time lies in the convex hull of the six key vertices,
+// split the hull along all edges between them
+template <typename T, typename P>
+void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_motion_triangle<T, P> const& prim)
+{
+    vec3 v[6];
+
+    for (int k = 0; k < 2; ++k)
+    {
+        v[3 * k]     = prim.v1[k];
+        v[3 * k + 1] = prim.v1[k] + prim.e1[k];
+        v[3 * k + 2] = prim.v1[k] + prim.e2[k];
+    }
+
+    L.invalidate();
+    R.invalidate();
+
+    for (int i = 0; i < 6; ++i)
+    {
+        for (int j = i + 1; j < 6; ++j)
+        {
+            detail::split_edge(L, R, v[i], v[j], plane, axis);
+        }
+    }
+
+    // split_edge() only inserts the first vertex
+    detail::split_edge(L, R, v[5], v[0], plane, axis);
+}
+
+// Split the cones and spheres around the curve segments (cf. intersect()). Their
+// points left of the plane are within r of the segment part left of plane + r,
+// and vice versa
+template <typename T, typename P>
+void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_curve<T, P> const& prim)
+{
+    enum { N = basic_curve<T, P>::NumSegments };
+
+    L.invalidate();
+    R.invalidate();
+
+    auto p = prim.p0;
+
+    for (int i = 0; i < N; ++i)
+    {
+        auto q = curve_point(prim, T(i + 1) / T(N));
+
+        float r = max(p.w, q.w);
+
+        aabb LL;
+        aabb LR;
+        aabb RL;
+        aabb RR;
+
+        LL.invalidate();
+        LR.invalidate();
+        RL.invalidate();
+        RR.invalidate();
+
+        // split_edge() only inserts the first vertex, insert both
+        detail::split_edge(LL, LR, p.xyz(), q.xyz(), plane + r, axis);
+        detail::split_edge(LL, LR, q.xyz(), p.xyz(), plane + r, axis);
+        detail::split_edge(RL, RR, p.xyz(), q.xyz(), plane - r, axis);
+        detail::split_edge(RL, RR, q.xyz(), p.xyz(), plane - r, axis);
+
+        if (LL.valid())
+        {
+            LL.min -= vec3(r);
+            LL.max += vec3(r);
+            LL.max[axis] = min(LL.max[axis], plane);
+            L.insert(LL);
+        }
+
+        if (RR.valid())
+        {
+            RR.min -= vec3(r);
+            RR.max += vec3(r);
+            RR.min[axis] = max(RR.min[axis], plane);
+            R.insert(RR);
+        }
+
+        p = q;
+    }
+}
+
 template <typename T, typename P>
 void split_primitive(aabb& L, aabb& R, float plane, int axis, basic_sphere<T, P> const& prim)
 {
@@ -184,7 +416,7 @@ struct binned_sah_builder
         }
     };
 
-    using prim_refs = aligned_vector<prim_ref>;
+    using prim_refs = std::vector<prim_ref, detail::counting_allocator<prim_ref>>;
 
     template <typename Tree, typename P>
     Tree build(Tree /* */, P* primitives, size_t num_prims, int max_leaf_size = -1)
@@ -192,6 +424,25 @@ struct binned_sah_builder
         Tree tree(primitives, num_prims);
 
         detail::build_top_down(tree, *this, primitives, primitives + num_prims, max_leaf_size);
+        detail::update_motion_bounds(tree);
+
+        release();
+
+        return tree;
+    }
+
+    // Build in parallel on the given thread pool. The resulting tree does not
+    // depend on the number of threads, but generally differs from the tree
+    // built by the serial overload.
+    template <typename Tree, typename P>
+    Tree build(Tree /* */, P* primitives, size_t num_prims, thread_pool& pool, int max_leaf_size = -1)
+    {
+        Tree tree(primitives, num_prims);
+
+        detail::build_top_down_parallel(tree, *this, primitives, primitives + num_prims, pool, max_leaf_size);
+        detail::update_motion_bounds(tree);
+
+        release();
 
         return tree;
     }
@@ -218,6 +469,14 @@ struct binned_sah_builder
         NumBins = 16
     };
 
+    enum
+    {
+        // Leaves with more references are binned and partitioned in parallel
+        // when building on a thread pool. Fixed chunk size, so that the result
+        // does not depend on the number of threads.
+        ChunkSize = 1 << 14
+    };
+
     struct bin
     {
         // TODO:
@@ -300,17 +559,20 @@ struct binned_sah_builder
         aabb prim_bounds; // Primitive bounds
         aabb cent_bounds; // Centroid bounds
         int first;        // Index of first primitive reference in this leaf
+        int last;         // Index one past the last primitive reference in this leaf
+        int end;          // End of the space reserved for spatial splits (in-place mode)
     };
 
     using leaf_infos = std::array<leaf_info, 2>;
 
-    static float compute_leaf_cost(int size)
+    // Leaves are intersected packet_size primitives at a time
+    float compute_leaf_cost(int size) const
     {
-        return 3.0f * size;
+        return 3.0f * div_up(size, packet_size);
     }
 
-    static float compute_split_cost(
-        aabb const& bounds_left, int size_left, aabb const& bounds_right, int size_right, float hsa_parent)
+    float compute_split_cost(
+        aabb const& bounds_left, int size_left, aabb const& bounds_right, int size_right, float hsa_parent) const
     {
         auto hsa_left = safe_half_surface_area(bounds_left);
         auto hsa_right = safe_half_surface_area(bounds_right);
@@ -333,7 +595,7 @@ struct binned_sah_builder
 
     // Uses the given list of bins to find the best split.
     // Returns the information needed to build the left/right subtrees.
-    static split_result find_split(bin_list const& bins, aabb const& bounds)
+    split_result find_split(bin_list const& bins, aabb const& bounds) const
     {
         auto hsa_parent = safe_half_surface_area(bounds);
         assert(hsa_parent > 0);
@@ -394,6 +656,57 @@ struct binned_sah_builder
         return sr;
     }
 
+    //--------------------------------------------------------------------------
+    // parallel binning
+    //
+
+    static int num_chunks(int first, int last)
+    {
+        return div_up(last - first, static_cast<int>(ChunkSize));
+    }
+
+    // Bins the references of LEAF in chunks on the thread pool and merges
+    // the per-chunk bins. func(bins, ref) projects a single reference.
+    template <typename Func>
+    static bin_list bin_parallel(prim_refs const& refs, leaf_info const& leaf, thread_pool& pool, Func func)
+    {
+        auto first = leaf.first;
+        auto last = leaf.last;
+
+        std::vector<bin_list> chunk_bins(num_chunks(first, last));
+
+        pool.run([&](long c)
+            {
+                auto& bins = chunk_bins[c];
+
+                for (auto& b : bins)
+                {
+                    b.clear();
+                }
+
+                auto I = refs.begin() + first + c * ChunkSize;
+                auto E = refs.begin() + std::min(first + static_cast<int>(c + 1) * ChunkSize, last);
+
+                for (; I != E; ++I)
+                {
+                    func(bins, *I);
+                }
+
+            }, static_cast<long>(chunk_bins.size()));
+
+        bin_list bins = chunk_bins[0];
+
+        for (size_t c = 1; c < chunk_bins.size(); ++c)
+        {
+            for (int i = 0; i < NumBins; ++i)
+            {
+                bins[i] = merge(bins[i], chunk_bins[c][i]);
+            }
+        }
+
+        return bins;
+    }
+
     //--------------------------------------------------------------------------
     // object partition
     //
@@ -412,7 +725,7 @@ struct binned_sah_builder
     }
 
     // Find the best object split.
-    static split_result find_object_split(prim_refs& refs, leaf_info const& leaf, projection pr)
+    split_result find_object_split(prim_refs& refs, leaf_info const& leaf, projection pr) const
     {
         bin_list bins;
 
@@ -421,7 +734,7 @@ struct binned_sah_builder
             b.clear();
         }
 
-        for (auto I = refs.begin() + leaf.first, E = refs.end(); I != E; ++I)
+        for (auto I = refs.begin() + leaf.first, E = refs.begin() + leaf.last; I != E; ++I)
         {
             project_object(bins, *I, pr);
         }
@@ -429,6 +742,17 @@ struct binned_sah_builder
         return find_split(bins, leaf.prim_bounds);
     }
 
+    // Find the best object split, bin on the thread pool.
+    split_result find_object_split(prim_refs& refs, leaf_info const& leaf, projection pr, thread_pool& pool) const
+    {
+        auto bins = bin_parallel(refs, leaf, pool, [&](bin_list& b, prim_ref const& ref)
+            {
+                project_object(b, ref, pr);
+            });
+
+        return find_split(bins, leaf.prim_bounds);
+    }
+
     // Partition the given list of objects
     static void perform_object_partition(
         leaf_infos& childs, split_result const& sr, prim_refs& refs, leaf_info const& leaf, projection pr)
@@ -440,7 +764,7 @@ struct binned_sah_builder
 
         auto pivot = std::partition(
             refs.begin() + leaf.first,
-            refs.end(),
+            refs.begin() + leaf.last,
             [&](prim_ref const& x)
             {
                 return pr.project_unsafe(x.bounds.center()) < sr.index;
@@ -448,7 +772,106 @@ struct binned_sah_builder
         );
 
         childs[0].first = leaf.first;
-        childs[1].first = static_cast<int>(pivot - refs.begin());
+        childs[0].last = static_cast<int>(pivot - refs.begin());
+        childs[0].end = childs[0].last;
+        childs[1].first = childs[0].last;
+        childs[1].last = leaf.last;
+        childs[1].end = childs[1].last;
+    }
+
+    // Partition the given list of objects on the thread pool.
+    // Stable partition: count per chunk, then scatter to a temporary list.
+    static void perform_object_partition(
+        leaf_infos& childs, split_result const& sr, prim_refs& refs, leaf_info const& leaf, projection pr, thread_pool& pool)
+    {
+        childs[0].prim_bounds = sr.prim_bounds[0];
+        childs[0].cent_bounds = sr.cent_bounds[0];
+        childs[1].prim_bounds = sr.prim_bounds[1];
+        childs[1].cent_bounds = sr.cent_bounds[1];
+
+        auto is_left = [&](prim_ref const& x)
+        {
+            return pr.project_unsafe(x.bounds.center()) < sr.index;
+        };
+
+        auto first = leaf.first;
+        auto last = leaf.last;
+        auto n = num_chunks(first, last);
+
+        auto chunk_first = [&](long c) { return first + static_cast<int>(c) * ChunkSize; };
+        auto chunk_last  = [&](long c) { return std::min(first + static_cast<int>(c + 1) * ChunkSize, last); };
+
+        // Count references that go to the left per chunk
+
+        std::vector<int> counts(n);
+
+        pool.run([&](long c)
+            {
+                counts[c] = static_cast<int>(std::count_if(
+                        refs.begin() + chunk_first(c),
+                        refs.begin() + chunk_last(c),
+                        is_left
+                        ));
+            }, static_cast<long>(n));
+
+        // Exclusive scans, offsets are relative to leaf.first
+
+        std::vector<int> offsets_left(n);
+        std::vector<int> offsets_right(n);
+
+        int num_left = 0;
+
+        for (int c = 0; c < n; ++c)
+        {
+            offsets_left[c] = num_left;
+            num_left += counts[c];
+        }
+
+        int num_right = num_left;
+
+        for (int c = 0; c < n; ++c)
+        {
+            offsets_right[c] = num_right;
+            num_right += chunk_last(c) - chunk_first(c) - counts[c];
+        }
+
+        // Scatter
+
+        prim_refs temp(last - first, prim_ref(), refs.get_allocator());
+
+        pool.run([&](long c)
+            {
+                auto l = offsets_left[c];
+                auto r = offsets_right[c];
+
+                for (auto i = chunk_first(c); i != chunk_last(c); ++i)
+                {
+                    if (is_left(refs[i]))
+                    {
+                        temp[l++] = refs[i];
+                    }
+                    else
+                    {
+                        temp[r++] = refs[i];
+                    }
+                }
+            }, static_cast<long>(n));
+
+        pool.run([&](long c)
+            {
+                std::copy(
+                        temp.begin() + (chunk_first(c) - first),
+                        temp.begin() + (chunk_last(c) - first),
+                        refs.begin() + chunk_first(c)
+                        );
+            }, static_cast<long>(n));
+
+        childs[0].first = first;
+        childs[0].last = first + num_left;
+        childs[0].end = childs[0].last;
+        childs[1].first = childs[0].last;
+        childs[1].last = last;
+        childs[1].end = childs[1].last;
     }
 
     //--------------------------------------------------------------------------
@@ -509,8 +932,8 @@ struct binned_sah_builder
     }
 
     template <typename Data>
-    static split_result
-    find_spatial_split(prim_refs const& refs, leaf_info const& leaf, projection pr, Data const& data)
+    split_result
+    find_spatial_split(prim_refs const& refs, leaf_info const& leaf, projection pr, Data const& data) const
     {
         bin_list bins;
 
@@ -519,7 +942,7 @@ struct binned_sah_builder
             b.clear();
         }
 
-        for (auto I = refs.begin() + leaf.first, E = refs.end(); I != E; ++I)
+        for (auto I = refs.begin() + leaf.first, E = refs.begin() + leaf.last; I != E; ++I)
         {
             split_object(bins, *I, pr, data);
         }
@@ -527,6 +950,27 @@ struct binned_sah_builder
         return find_split(bins, leaf.prim_bounds);
     }
 
+    template <typename Data>
+    split_result find_spatial_split(
+            prim_refs const&    refs,
+            leaf_info const&    leaf,
+            projection          pr,
+            Data const&         data,
+            thread_pool&        pool
+            ) const
+    {
+        auto bins = bin_parallel(refs, leaf, pool, [&](bin_list& b, prim_ref const& ref)
+            {
+                split_object(b, ref, pr, data);
+            });
+
+        return find_split(bins, leaf.prim_bounds);
+    }
+
+    // Partition the given list of references and split the references that
+    // straddle the splitting plane. In in-place mode, the duplicated references
+    // are written to the space reserved behind the leaf. When that space is
+    // exhausted, straddling references are moved to the side of their centroid.
     template <typename Data>
     static void perform_spatial_split(
             leaf_infos&         childs,
@@ -534,14 +978,16 @@ struct binned_sah_builder
             prim_refs&          refs,
             leaf_info const&    leaf,
             projection          pr,
-            Data const&         data
+            Data const&         data,
+            bool                in_place
             )
     {
         auto plane = pr.unproject(sr.index);
 
         auto pivot = leaf.first;
         auto i = leaf.first;
-        auto last = static_cast<int>(refs.size());
+        auto last = leaf.last;
+        auto tail = leaf.last; // Next free slot for duplicated references
 
         childs[0].prim_bounds.invalidate();
         childs[0].cent_bounds.invalidate();
@@ -553,7 +999,17 @@ struct binned_sah_builder
             auto pmin = refs[i].bounds.min[pr.axis];
             auto pmax = refs[i].bounds.max[pr.axis];
 
-            if (pmax <= plane)
+            bool left = pmax <= plane;
+            bool straddles = !left && pmin < plane;
+
+            if (straddles && in_place && tail == leaf.end)
+            {
+                // Out of budget, don't split the reference
+                left = refs[i].bounds.center()[pr.axis] < plane;
+                straddles = false;
+            }
+
+            if (left)
             {
                 // Triangle lies completely to the left of the splitting plane.
                 // Swap current reference with current pivot to move it to the correct place.
@@ -577,7 +1033,7 @@ struct binned_sah_builder
                 //         ^      ^
                 //         p      i
             }
-            else if (pmin >= plane)
+            else if (!straddles)
             {
                 // Triamgle lies completely to the right of the splitting plane.
                 // Reference is already at the correct place.
@@ -621,14 +1077,20 @@ struct binned_sah_builder
                 //        ^      ^
                 //        p      i
 
-                refs.push_back(L);
+                if (!in_place)
+                {
+                    refs.emplace_back();
+                }
+
+                refs[tail] = L;
 
                 // xxxxxxxyyyyyyyy.......x
                 //        ^      ^
                 //        p      i
 
-                std::swap(refs[pivot], refs.back());
+                std::swap(refs[pivot], refs[tail]);
 
+                ++tail;
                 ++pivot;
                 ++i;
 
@@ -639,7 +1101,11 @@ struct binned_sah_builder
         }
 
         childs[0].first = leaf.first;
+        childs[0].last = pivot;
+        childs[0].end = pivot;
         childs[1].first = pivot;
+        childs[1].last = tail;
+        childs[1].end = tail;
     }
 
     //--------------------------------------------------------------------------
@@ -657,6 +1123,13 @@ struct binned_sah_builder
     float alpha = 1.0e-5f;
     // Whether to use spatial splits
     bool use_spatial_splits = false;
+    // Whether to partition a single, preallocated list of references in place
+    bool in_place = false;
+    // Number of references reserved for spatial splits in in-place mode,
+    // relative to the number of primitives
+    float spatial_split_budget = 0.25f;
+    // Number of primitives that are intersected with a single test
+    int packet_size = 1;
 
     void set_alpha(float value)
     {
@@ -668,35 +1141,124 @@ struct binned_sah_builder
         use_spatial_splits = enable;
     }
 
+    // In-place mode: the references are stored in a single list that is
+    // allocated once and is never copied. Each leaf owns a range of that list
+    // and the space reserved for its spatial splits, subtrees that are built in
+    // parallel work on disjoint ranges. Spatial splits are only performed
+    // while the budget of the leaf suffices, so that the builder's memory is
+    // bounded by (1 + spatial_split_budget) * num_prims references.
+    void enable_in_place(bool enable)
+    {
+        in_place = enable;
+    }
+
+    void set_spatial_split_budget(float budget)
+    {
+        spatial_split_budget = budget;
+    }
+
+    // For leaves that are intersected packet-wise (cf. pack_leaves()): the
+    // SAH leaf cost counts packets instead of primitives, so that leaves with
+    // up to SIZE primitives are preferred. Build with max_leaf_size = SIZE.
+    void set_packet_size(int size)
+    {
+        packet_size = std::max(size, 1);
+    }
+
+    // Peak number of bytes allocated for primitive references (including
+    // temporary lists) during the last build.
+    size_t peak_memory_usage() const
+    {
+        return memory_ ? memory_->peak.load() : 0;
+    }
+
     template <typename I>
     leaf_info init(I first, I last)
     {
         aabb prim_bounds;
         aabb cent_bounds;
 
+        auto count = static_cast<int>(std::distance(first, last));
+        auto budget = in_place && use_spatial_splits
+                    ? static_cast<int>(count * std::max(spatial_split_budget, 0.0f))
+                    : 0;
+
+        memory_ = std::make_shared<detail::memory_counter>();
+        parent_refs_ = nullptr;
+
+        refs = prim_refs(prim_refs::allocator_type(memory_));
+        refs.reserve(count + budget);
+
         init(refs, prim_bounds, cent_bounds, first, last);
 
+        if (in_place)
+        {
+            refs.resize(count + budget);
+        }
+
         sa_threshold = alpha * safe_surface_area(prim_bounds);
 
-        return { prim_bounds, cent_bounds, 0 };
+        return { prim_bounds, cent_bounds, 0, count, count + budget };
+    }
+
+    // Returns the number of primitive references in the given leaf.
+    int leaf_size(leaf_info const& leaf) const
+    {
+        return leaf.last - leaf.first;
+    }
+
+    // Moves the primitive references of LEAF to a new builder that can construct
+    // the subtree independently. SUBTREE_ROOT is the leaf info of that subtree.
+    // In in-place mode, the new builder refers to the references of this builder.
+    binned_sah_builder detach(leaf_info const& leaf, leaf_info& subtree_root)
+    {
+        binned_sah_builder result;
+
+        result.sa_threshold = sa_threshold;
+        result.alpha = alpha;
+        result.use_spatial_splits = use_spatial_splits;
+        result.in_place = in_place;
+        result.spatial_split_budget = spatial_split_budget;
+        result.packet_size = packet_size;
+        result.memory_ = memory_;
+
+        if (in_place)
+        {
+            result.parent_refs_ = &storage();
+
+            subtree_root = leaf;
+        }
+        else
+        {
+            result.refs = prim_refs(refs.begin() + leaf.first, refs.begin() + leaf.last, refs.get_allocator());
+
+            refs.resize(leaf.first);
+
+            subtree_root = { leaf.prim_bounds, leaf.cent_bounds, 0, leaf.last - leaf.first, leaf.last - leaf.first };
+        }
+
+        return result;
     }
 
     // Inserts primitive indices into INDICES and removes them from the current list.
     template <typename Indices>
     int insert_indices(Indices& indices, leaf_info const& leaf)
     {
-        int leaf_size = static_cast<int>(refs.size() - leaf.first);
+        auto& refs = storage();
 
         // Insert indices
-        for (int i = leaf.first; i != (int)refs.size(); ++i)
+        for (int i = leaf.first; i != leaf.last; ++i)
         {
             indices.push_back(refs[i].index);
         }
 
         // Erase the no longer used primitive references
-        refs.resize(leaf.first);
+        if (!in_place)
+        {
+            refs.resize(leaf.first);
+        }
 
-        return leaf_size;
+        return leaf.last - leaf.first;
     }
 
     // Return true if the leaf should be split into two new leaves. In this case
@@ -704,18 +1266,86 @@ struct binned_sah_builder
     // method returns true. If the leaf should not be split, returns false.
     template <typename Data>
     bool split(leaf_infos& childs, leaf_info const& leaf, Data const& data, int max_leaf_size)
+    {
+        return split_impl(childs, leaf, data, max_leaf_size, nullptr);
+    }
+
+    // Same as above, large leaves are binned and partitioned on the thread pool.
+    template <typename Data>
+    bool split(leaf_infos& childs, leaf_info const& leaf, Data const& data, int max_leaf_size, thread_pool& pool)
+    {
+        return split_impl(childs, leaf, data, max_leaf_size, &pool);
+    }
+
+private:
+
+    // References of the builder this builder was detached from (in-place mode)
+    prim_refs* parent_refs_ = nullptr;
+    // Allocation statistics of the current build
+    std::shared_ptr<detail::memory_counter> memory_;
+
+    prim_refs& storage()
+    {
+        return parent_refs_ ? *parent_refs_ : refs;
+    }
+
+    // Frees the references after the build, keeps the statistics
+    void release()
+    {
+        prim_refs(refs.get_allocator()).swap(refs);
+    }
+
+    // In-place mode: the space reserved behind LEAF is shared by its children,
+    // proportional to their number of references. The right child's references
+    // are moved back to make room for the left child's share.
+    void distribute_budget(leaf_infos& childs, leaf_info const& leaf)
+    {
+        auto& refs = storage();
+
+        auto size0 = static_cast<long long>(childs[0].last - childs[0].first);
+        auto size1 = static_cast<long long>(childs[1].last - childs[1].first);
+        auto budget = static_cast<long long>(leaf.end - childs[1].last);
+
+        auto budget0 = use_spatial_splits ? static_cast<int>(budget * size0 / (size0 + size1)) : 0;
+
+        if (budget0 > 0)
+        {
+            std::copy_backward(
+                    refs.begin() + childs[1].first,
+                    refs.begin() + childs[1].last,
+                    refs.begin() + childs[1].last + budget0
+                    );
+
+            childs[1].first += budget0;
+            childs[1].last += budget0;
+        }
+
+        childs[0].end = childs[0].last + budget0;
+        childs[1].end = leaf.end;
+    }
+
+    template <typename Data>
+    bool split_impl(leaf_infos& childs, leaf_info const& leaf, Data const& data, int max_leaf_size, thread_pool* pool)
     {
         // FIXME:
         // Create a leaf if max_depth is reached...
         // Or check this in build_tree?
 
-        auto leaf_size = static_cast<int>(refs.size() - leaf.first);
+        auto& refs = storage();
+
+        auto leaf_size = leaf.last - leaf.first;
 
         if (leaf_size <= max_leaf_size)
         {
             return false;
         }
 
+        // Use the thread pool only if there is enough work
+        if (leaf_size <= ChunkSize)
+        {
+            pool = nullptr;
+        }
+
         // Find the split axis (TODO: Test all axes...)
 
         // Using centroid bounds for object partitioning...
@@ -731,13 +1361,13 @@ struct binned_sah_builder
 
         projection pr(leaf.cent_bounds, static_cast<int>(axis));
 
-        auto sr = find_object_split(refs, leaf, pr);
+        auto sr = pool ? find_object_split(refs, leaf, pr, *pool) : find_object_split(refs, leaf, pr);
 
         // Spatial split -------------------------------------------------------
 
         bool do_spatial_split = false;
 
-        if (use_spatial_splits)
+        if (use_spatial_splits && (!in_place || leaf.end > leaf.last))
         {
             auto sa = safe_surface_area(intersect(sr.prim_bounds[0], sr.prim_bounds[1]));
 
@@ -754,9 +1384,14 @@ struct binned_sah_builder
 
                 projection pr2(leaf.prim_bounds, static_cast<int>(axis));
 
-                auto sr2 = find_spatial_split(refs, leaf, pr2, data);
+                auto sr2 = pool
+                    ? find_spatial_split(refs, leaf, pr2, data, *pool)
+                    : find_spatial_split(refs, leaf, pr2, data);
 
-                if (sr2.cost < sr.cost /* && (sr2.count[0] + sr2.count[1] < 1.5 * leaf_size) */)
+                // Number of references that are duplicated by the spatial split
+                auto num_splits = sr2.count[0] + sr2.count[1] - leaf_size;
+
+                if (sr2.cost < sr.cost && (!in_place || num_splits <= leaf.end - leaf.last))
                 {
                     do_spatial_split = true;
                     pr = pr2;
@@ -779,13 +1414,23 @@ struct binned_sah_builder
 
         if (do_spatial_split)
         {
-            perform_spatial_split(childs, sr, refs, leaf, pr, data);
+            perform_spatial_split(childs, sr, refs, leaf, pr, data, in_place);
+        }
+        else if (pool && !in_place)
+        {
+            // The parallel partition needs a temporary list
+            perform_object_partition(childs, sr, refs, leaf, pr, *pool);
         }
         else
         {
             perform_object_partition(childs, sr, refs, leaf, pr);
         }
 
+        if (in_place)
+        {
+            distribute_budget(childs, leaf);
+        }
+
         return true;
     }
 };
@@ -7,6 +7,10 @@
 #include <visionaray/aligned_vector.h>
 
 #include "color_conversion.h"
+#include "numa.h"
+#include "parallel_for.h"
+#include "range.h"
+#include "thread_pool.h"
 
 
 namespace visionaray
@@ -23,8 +27,33 @@ struct cpu_buffer_rt<ColorFormat, DepthFormat>::impl
 
     std::unique_ptr<gl::depth_compositor>   compositor;
 
+    bool                                    first_touch = false;
+    thread_pool*                            pool = nullptr;
+
     aligned_vector<color_type>              color_buffer;
     aligned_vector<depth_type>              depth_buffer;
+
+    template <typename T>
+    void fill(aligned_vector<T>& buffer, T const& value, int w, int h)
+    {
+        if (!first_touch || pool == nullptr || buffer.size() != static_cast<size_t>(w * h))
+        {
+            std::fill(buffer.begin(), buffer.end(), value);
+            return;
+        }
+
+        // Same tiles as tiled_sched, so that each page is touched first by
+        // the node that renders it
+        T* data = buffer.data();
+
+        parallel_for(*pool, tiled_range2d<int>(0, w, 16, 0, h, 16), [=](range2d<int> const& r)
+            {
+                for (int y = r.cols().begin(); y != r.cols().end(); ++y)
+                {
+                    std::fill(data + y * w + r.rows().begin(), data + y * w + r.rows().end(), value);
+                }
+            });
+    }
 };
 
 
@@ -83,7 +112,7 @@ void cpu_buffer_rt<ColorFormat, DepthFormat>::clear_color_buffer(vec4 const& c)
         c
         );
 
-    std::fill(impl_->color_buffer.begin(), impl_->color_buffer.end(), cc);
+    impl_->fill(impl_->color_buffer, cc, width(), height());
 }
 
 template <pixel_format ColorFormat, pixel_format DepthFormat>
@@ -98,7 +127,7 @@ void cpu_buffer_rt<ColorFormat, DepthFormat>::clear_depth_buffer(float d)
         d
         );
 
-    std::fill(impl_->depth_buffer.begin(), impl_->depth_buffer.end(), dd);
+    impl_->fill(impl_->depth_buffer, dd, width(), height());
 }
 
 template <pixel_format ColorFormat, pixel_format DepthFormat>
@@ -126,6 +155,12 @@ void cpu_buffer_rt<ColorFormat, DepthFormat>::resize(int w, int h)
         impl_->depth_buffer.resize(w * h);
     }
 
+    if (impl_->first_touch)
+    {
+        release_pages(impl_->color_buffer.data(), impl_->color_buffer.size() * sizeof(color_type));
+        release_pages(impl_->depth_buffer.data(), impl_->depth_buffer.size() * sizeof(depth_type));
+    }
+
     if (!impl_->compositor)
     {
         impl_->compositor.reset(new gl::depth_compositor);
@@ -146,6 +181,19 @@ void cpu_buffer_rt<ColorFormat, DepthFormat>::resize(int w, int h)
     }
 }
 
+template <pixel_format ColorFormat, pixel_format DepthFormat>
+void cpu_buffer_rt<ColorFormat, DepthFormat>::set_first_touch(bool enable, thread_pool* pool)
+{
+    impl_->first_touch = enable;
+    impl_->pool = pool;
+}
+
+template <pixel_format ColorFormat, pixel_format DepthFormat>
+bool cpu_buffer_rt<ColorFormat, DepthFormat>::get_first_touch() const
+{
+    return impl_->first_touch;
+}
+
 template <pixel_format ColorFormat, pixel_format DepthFormat>
 void cpu_buffer_rt<ColorFormat, DepthFormat>::display_color_buffer() const
 {
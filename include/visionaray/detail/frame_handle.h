@@ -0,0 +1,203 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_FRAME_HANDLE_H
+#define VSNRAY_DETAIL_FRAME_HANDLE_H 1
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../math/forward.h"
+#include "../math/rectangle.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// State of a frame that is rendered asynchronously
+//
+// The rendering thread only holds a raw pointer, the destructor joins it
+// before any member is destroyed. end_frame() of the render target and the
+// camera runs on the thread that calls finish() or destroys the last handle,
+// never on the rendering thread.
+//
+
+struct frame_state
+{
+    frame_state() = default;
+
+    frame_state(frame_state const&) = delete;
+    frame_state& operator=(frame_state const&) = delete;
+
+   ~frame_state()
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+
+        if (end_frame)
+        {
+            end_frame();
+        }
+    }
+
+    // Wait for the frame and call end_frame, only the first call has an effect
+    void finish()
+    {
+        std::function<void()> f;
+
+        {
+            std::unique_lock<std::mutex> l(mutex);
+            cond.wait(l, [this]() { return done; });
+            std::swap(f, end_frame);
+        }
+
+        if (f)
+        {
+            f();
+        }
+    }
+
+    // Called from the thread that rendered the last packet of TILE
+    void complete_tile(recti const& tile)
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        finished.push_back(tile);
+        ++num_completed;
+    }
+
+    // Called from the rendering thread when the frame has finished or was canceled
+    void complete_frame()
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        done = true;
+        cond.notify_all();
+    }
+
+    std::atomic<bool> canceled{false};
+
+    size_t num_tiles = 0;
+    size_t num_completed = 0;
+
+    // Packets per tile that were not rendered yet
+    std::unique_ptr<std::atomic<int>[]> pending;
+
+    // Completed tiles that were not polled yet
+    std::vector<recti> finished;
+
+    bool done = false;
+
+    // Calls end_frame() of the render target and the camera
+    std::function<void()> end_frame;
+
+    mutable std::mutex mutex;
+    mutable std::condition_variable cond;
+
+    std::thread thread;
+};
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Handle to a frame that is rendered asynchronously, cf. basic_sched::frame_async()
+//
+// Tiles are reported when their last packet was rendered, either through the
+// callback passed to frame_async() or with poll(). After cancel(), packets
+// that have not started yet are skipped and their tiles are never reported.
+// finish() waits for the frame and ends it on the render target, so that e.g.
+// mapped GL or CUDA resources are released by the calling thread. Handles can
+// be copied, destroying the last one finishes the frame.
+//
+
+class frame_handle
+{
+public:
+
+    frame_handle() = default;
+
+    explicit frame_handle(std::shared_ptr<detail::frame_state> state)
+        : state_(std::move(state))
+    {
+    }
+
+    // Handle refers to a frame
+    bool valid() const
+    {
+        return state_ != nullptr;
+    }
+
+    // Frame has finished, all tiles were rendered or the frame was canceled
+    bool ready() const
+    {
+        std::unique_lock<std::mutex> l(state_->mutex);
+        return state_->done;
+    }
+
+    void wait() const
+    {
+        std::unique_lock<std::mutex> l(state_->mutex);
+        state_->cond.wait(l, [this]() { return state_->done; });
+    }
+
+    // Wait for the frame and call end_frame() on the render target and camera
+    void finish()
+    {
+        state_->finish();
+    }
+
+    // Drop the remaining work, e.g. because the camera has moved
+    void cancel()
+    {
+        state_->canceled = true;
+    }
+
+    bool canceled() const
+    {
+        return state_->canceled;
+    }
+
+    size_t num_tiles() const
+    {
+        return state_->num_tiles;
+    }
+
+    size_t num_completed_tiles() const
+    {
+        std::unique_lock<std::mutex> l(state_->mutex);
+        return state_->num_completed;
+    }
+
+    // Append the tiles that were completed since the last call to TILES, return their number
+    size_t poll(std::vector<recti>& tiles)
+    {
+        std::unique_lock<std::mutex> l(state_->mutex);
+
+        size_t n = state_->finished.size();
+        tiles.insert(tiles.end(), state_->finished.begin(), state_->finished.end());
+        state_->finished.clear();
+
+        return n;
+    }
+
+private:
+
+    std::shared_ptr<detail::frame_state> state_;
+
+};
+
+} // visionaray
+
+#endif // VSNRAY_DETAIL_FRAME_HANDLE_H
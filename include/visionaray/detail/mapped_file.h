@@ -0,0 +1,201 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_MAPPED_FILE_H
+#define VSNRAY_DETAIL_MAPPED_FILE_H 1
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "platform.h"
+
+#if defined(VSNRAY_OS_WIN32)
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Read-only memory mapping of a whole file
+//
+
+class mapped_file
+{
+public:
+
+    mapped_file() = default;
+
+    mapped_file(mapped_file const&) = delete;
+    mapped_file& operator=(mapped_file const&) = delete;
+
+    mapped_file(mapped_file&& rhs)
+    {
+        swap(rhs);
+    }
+
+    mapped_file& operator=(mapped_file&& rhs)
+    {
+        close();
+        swap(rhs);
+        return *this;
+    }
+
+   ~mapped_file()
+    {
+        close();
+    }
+
+    bool open(std::string const& filename)
+    {
+        close();
+
+#if defined(VSNRAY_OS_WIN32)
+        file_ = CreateFileA(
+                filename.c_str(),
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr
+                );
+
+        if (file_ == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        LARGE_INTEGER size;
+
+        if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (mapping_ == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        data_ = static_cast<char const*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        size_ = static_cast<size_t>(size.QuadPart);
+#else
+        int fd = ::open(filename.c_str(), O_RDONLY);
+
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat st;
+
+        if (fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        void* ptr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+        // The mapping stays valid after the file descriptor was closed
+        ::close(fd);
+
+        if (ptr != MAP_FAILED)
+        {
+            data_ = static_cast<char const*>(ptr);
+            size_ = static_cast<size_t>(st.st_size);
+        }
+#endif
+
+        if (data_ == nullptr)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+#if defined(VSNRAY_OS_WIN32)
+        if (data_ != nullptr)
+        {
+            UnmapViewOfFile(data_);
+        }
+
+        if (mapping_ != nullptr)
+        {
+            CloseHandle(mapping_);
+        }
+
+        if (file_ != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(file_);
+        }
+
+        mapping_ = nullptr;
+        file_ = INVALID_HANDLE_VALUE;
+#else
+        if (data_ != nullptr)
+        {
+            munmap(const_cast<char*>(data_), size_);
+        }
+#endif
+
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    bool is_open() const { return data_ != nullptr; }
+
+    char const* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+
+    char const* data_ = nullptr;
+    size_t size_ = 0;
+
+#if defined(VSNRAY_OS_WIN32)
+    HANDLE file_ = INVALID_HANDLE_VALUE;
+    HANDLE mapping_ = nullptr;
+#endif
+
+    void swap(mapped_file& rhs)
+    {
+        std::swap(data_, rhs.data_);
+        std::swap(size_, rhs.size_);
+#if defined(VSNRAY_OS_WIN32)
+        std::swap(file_, rhs.file_);
+        std::swap(mapping_, rhs.mapping_);
+#endif
+    }
+
+};
+
+} // detail
+} // visionaray
+
+#endif // VSNRAY_DETAIL_MAPPED_FILE_H
@@ -32,6 +32,24 @@ inline mat4 const& matrix_camera::get_proj_matrix() const
     return proj_;
 }
 
+inline void matrix_camera::set_shutter(float open, float close)
+{
+    shutter_open_ = open;
+    shutter_close_ = close;
+}
+
+VSNRAY_FUNC
+inline float matrix_camera::shutter_open() const
+{
+    return shutter_open_;
+}
+
+VSNRAY_FUNC
+inline float matrix_camera::shutter_close() const
+{
+    return shutter_close_;
+}
+
 inline void matrix_camera::begin_frame()
 {
     view_inv_ = inverse(view_);
@@ -0,0 +1,352 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_NUMA_H
+#define VSNRAY_DETAIL_NUMA_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "platform.h"
+
+#if defined(VSNRAY_OS_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// NUMA topology
+//
+// On Linux, nodes and their CPUs are read from sysfs, restricted to the CPUs
+// the process may run on. Other platforms report a single node.
+//
+
+struct numa_topology
+{
+    // CPUs per node
+    std::vector<std::vector<unsigned>> cpus;
+
+    unsigned num_nodes() const
+    {
+        return static_cast<unsigned>(cpus.size());
+    }
+
+    // Node of CPU, 0 if unknown
+    unsigned node_of_cpu(unsigned cpu) const
+    {
+        for (unsigned n = 0; n < cpus.size(); ++n)
+        {
+            for (unsigned c : cpus[n])
+            {
+                if (c == cpu)
+                {
+                    return n;
+                }
+            }
+        }
+
+        return 0;
+    }
+};
+
+namespace detail
+{
+
+// Parse a sysfs cpu or node list, e.g. "0-7,16-23"
+inline std::vector<unsigned> parse_id_list(std::string const& str)
+{
+    std::vector<unsigned> result;
+
+    std::istringstream stream(str);
+    std::string range;
+
+    while (std::getline(stream, range, ','))
+    {
+        size_t dash = range.find('-');
+
+        unsigned first = 0;
+        unsigned last = 0;
+
+        try
+        {
+            first = static_cast<unsigned>(std::stoul(range.substr(0, dash)));
+            last = dash == std::string::npos ? first : static_cast<unsigned>(std::stoul(range.substr(dash + 1)));
+        }
+        catch (...)
+        {
+            continue;
+        }
+
+        for (unsigned i = first; i <= last; ++i)
+        {
+            result.push_back(i);
+        }
+    }
+
+    return result;
+}
+
+inline std::string read_line(std::string const& filename)
+{
+    std::ifstream file(filename);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+inline numa_topology make_numa_topology()
+{
+    numa_topology result;
+
+#if defined(VSNRAY_OS_LINUX)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool have_allowed = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    auto nodes = parse_id_list(read_line("/sys/devices/system/node/online"));
+
+    for (unsigned n : nodes)
+    {
+        auto cpus = parse_id_list(read_line("/sys/devices/system/node/node" + std::to_string(n) + "/cpulist"));
+
+        std::vector<unsigned> usable;
+
+        for (unsigned c : cpus)
+        {
+            if (!have_allowed || (c < CPU_SETSIZE && CPU_ISSET(c, &allowed)))
+            {
+                usable.push_back(c);
+            }
+        }
+
+        // Skip memory-only nodes and nodes we may not run on
+        if (!usable.empty())
+        {
+            result.cpus.push_back(usable);
+        }
+    }
+#endif
+
+    if (result.cpus.empty())
+    {
+        result.cpus.resize(1);
+
+        for (unsigned c = 0; c < std::thread::hardware_concurrency(); ++c)
+        {
+            result.cpus[0].push_back(c);
+        }
+    }
+
+    return result;
+}
+
+// Node the calling thread was pinned to, -1 if not pinned
+inline int& this_thread_numa_node()
+{
+    static thread_local int node = -1;
+    return node;
+}
+
+} // detail
+
+
+// Topology is determined once
+inline numa_topology const& get_numa_topology()
+{
+    static numa_topology const topology = detail::make_numa_topology();
+    return topology;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Restrict the calling thread to the CPUs of NODE, returns false if that is not supported
+//
+
+inline bool pin_this_thread_to_numa_node(unsigned node)
+{
+#if defined(VSNRAY_OS_LINUX)
+    auto const& topology = get_numa_topology();
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    node %= topology.num_nodes();
+
+    for (unsigned c : topology.cpus[node])
+    {
+        if (c < CPU_SETSIZE)
+        {
+            CPU_SET(c, &set);
+        }
+    }
+
+    if (CPU_COUNT(&set) == 0 || pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    {
+        return false;
+    }
+
+    detail::this_thread_numa_node() = static_cast<int>(node);
+    return true;
+#else
+    (void)node;
+    return false;
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Node of the CPU the calling thread currently runs on
+//
+
+inline unsigned current_numa_node()
+{
+    // Pinned threads stay on their node
+    if (detail::this_thread_numa_node() >= 0)
+    {
+        return static_cast<unsigned>(detail::this_thread_numa_node());
+    }
+
+#if defined(VSNRAY_OS_LINUX)
+    int cpu = sched_getcpu();
+    return cpu < 0 ? 0 : get_numa_topology().node_of_cpu(static_cast<unsigned>(cpu));
+#else
+    return 0;
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Return the pages in [ptr..ptr+size) to the OS
+//
+// The memory reads as zeros afterwards, the pages are mapped again on the
+// NUMA node of the thread that touches them first. Only pages that lie
+// completely inside the range are released. No-op if not supported.
+//
+
+inline void release_pages(void* ptr, size_t size)
+{
+#if defined(VSNRAY_OS_LINUX)
+    uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+
+    uintptr_t first = (reinterpret_cast<uintptr_t>(ptr) + page_size - 1) & ~(page_size - 1);
+    uintptr_t last = (reinterpret_cast<uintptr_t>(ptr) + size) & ~(page_size - 1);
+
+    if (first < last)
+    {
+        madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+    }
+#else
+    (void)ptr;
+    (void)size;
+#endif
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Read-only data replicated per NUMA node
+//
+// Each copy is made by a thread that runs on its node, so that its memory
+// (e.g. the node and primitive arrays of a BVH, or texture data) is local to
+// that node. local() returns the copy for the calling thread. Copies of a
+// numa_replicated share the replicas.
+//
+// A numa_replicated kernel can be passed to tiled_sched and adaptive_sched,
+// each packet is then rendered with the kernel of the node it runs on. Make
+// the per-node kernels with generate(), so that each one refers to the data
+// replicated for its node.
+//
+
+template <typename T>
+class numa_replicated
+{
+public:
+
+    explicit numa_replicated(T const& value)
+    {
+        init([&](unsigned /* node */) { return value; });
+    }
+
+    // FUNC(unsigned node) returns the replica for NODE
+    template <typename Func>
+    static numa_replicated generate(Func func)
+    {
+        numa_replicated result;
+        result.init(func);
+        return result;
+    }
+
+    unsigned size() const
+    {
+        return static_cast<unsigned>(replicas_.size());
+    }
+
+    T const& operator[](unsigned node) const
+    {
+        return *replicas_[node];
+    }
+
+    T const& local() const
+    {
+        return *replicas_[current_numa_node() % replicas_.size()];
+    }
+
+private:
+
+    std::vector<std::shared_ptr<T>> replicas_;
+
+    numa_replicated() = default;
+
+    template <typename Func>
+    void init(Func func)
+    {
+        unsigned num_nodes = get_numa_topology().num_nodes();
+
+        replicas_.resize(num_nodes);
+
+        for (unsigned n = 0; n < num_nodes; ++n)
+        {
+            std::thread t([&, n]()
+            {
+                pin_this_thread_to_numa_node(n);
+                replicas_[n] = std::make_shared<T>(func(n));
+            });
+
+            t.join();
+        }
+    }
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Replica for the calling thread, VALUE itself if it is not replicated
+//
+
+template <typename T>
+inline T const& local_replica(T const& value)
+{
+    return value;
+}
+
+template <typename T>
+inline T const& local_replica(numa_replicated<T> const& value)
+{
+    return value.local();
+}
+
+} // visionaray
+
+#endif // VSNRAY_DETAIL_NUMA_H
@@ -9,17 +9,21 @@
 #include <visionaray/config.h>
 
 #include <algorithm>
+#include <cstddef>
 #include <functional>
 #include <iterator>
 #include <type_traits>
+#include <vector>
 
 #if VSNRAY_HAVE_TBB
 #include <tbb/blocked_range.h>
 #include <tbb/parallel_reduce.h>
 #endif
 
+#include "../math/detail/math.h"
 #include "algorithm.h"
 #include "macros.h"
+#include "thread_pool.h"
 
 namespace visionaray
 {
@@ -167,6 +171,277 @@ void counting_sort(InputIt first, InputIt last, OutputIt out, Counts& counts, Ke
 
 #endif // VSNRAY_HAVE_TBB
 
+
+//-------------------------------------------------------------------------------------------------
+// counting_sort
+//
+// Sorts items based on integer keys in [0..k). Stable. Parallelized on a thread
+// pool: the input is split into blocks of fixed size, each block is counted and
+// scattered by a single task.
+//
+// [in] POOL
+//      Thread pool to run on.
+//
+// [in] FIRST
+//      Start of the input sequence.
+//
+// [in] LAST
+//      End of the input sequence.
+//
+// [out] OUT
+//      Start of the output sequence.
+//
+// [in,out] COUNTS
+//      Modifiable counts sequence, contains inclusive prefix sums of the counts on return.
+//
+// [in] KEY
+//      Sort key function object.
+//
+// Complexity: O(n/p + k * n/BlockSize)
+//
+
+template <
+    typename InputIt,
+    typename OutputIt,
+    typename Counts,
+    typename Key = visionaray::algo::detail::trivial_key
+    >
+void counting_sort(thread_pool& pool, InputIt first, InputIt last, OutputIt out, Counts& counts, Key key = Key())
+{
+    static_assert(
+            std::is_integral<decltype(key(*first))>::value,
+            "parallel_counting_sort requires integral key type"
+            );
+
+    enum { BlockSize = 1 << 16 };
+
+    int n = static_cast<int>(last - first);
+    int k = static_cast<int>(counts.size());
+    int num_blocks = div_up(n, static_cast<int>(BlockSize));
+
+    std::fill(std::begin(counts), std::end(counts), 0);
+
+    if (num_blocks == 0)
+    {
+        return;
+    }
+
+    // Histograms per block, key-major: offsets[m * num_blocks + b]
+    std::vector<int> offsets(k * num_blocks);
+
+    pool.run([&](long b)
+        {
+            int block_first = static_cast<int>(b) * BlockSize;
+            int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+            for (int i = block_first; i != block_last; ++i)
+            {
+                ++offsets[key(first[i]) * num_blocks + b];
+            }
+        }, static_cast<long>(num_blocks));
+
+    // Exclusive scan over keys and blocks
+    int sum = 0;
+
+    for (int m = 0; m < k; ++m)
+    {
+        for (int b = 0; b < num_blocks; ++b)
+        {
+            int count = offsets[m * num_blocks + b];
+            offsets[m * num_blocks + b] = sum;
+            sum += count;
+        }
+
+        counts[m] = sum;
+    }
+
+    // Each block scatters its items in order
+    pool.run([&](long b)
+        {
+            int block_first = static_cast<int>(b) * BlockSize;
+            int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+            for (int i = block_first; i != block_last; ++i)
+            {
+                out[offsets[key(first[i]) * num_blocks + b]++] = first[i];
+            }
+        }, static_cast<long>(num_blocks));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// copy_if
+//
+// Stream compaction, copies the items for which PRED returns true and keeps
+// their order. Parallelized on a thread pool: the input is split into blocks
+// of fixed size, each block is counted and copied by a single task. The
+// output offsets of the blocks are an exclusive prefix sum over their counts.
+//
+// [in] POOL
+//      Thread pool to run on.
+//
+// [in] FIRST
+//      Start of the input sequence.
+//
+// [in] LAST
+//      End of the input sequence.
+//
+// [out] OUT
+//      Start of the output sequence.
+//
+// [in] PRED
+//      Unary predicate, called twice per item.
+//
+// Returns the end of the output sequence.
+//
+// Complexity: O(n/p + n/BlockSize)
+//
+
+template <
+    typename InputIt,
+    typename OutputIt,
+    typename Pred
+    >
+OutputIt copy_if(thread_pool& pool, InputIt first, InputIt last, OutputIt out, Pred pred)
+{
+    enum { BlockSize = 1 << 12 };
+
+    int n = static_cast<int>(last - first);
+    int num_blocks = div_up(n, static_cast<int>(BlockSize));
+
+    if (num_blocks == 0)
+    {
+        return out;
+    }
+
+    std::vector<int> offsets(num_blocks + 1);
+
+    pool.run([&](long b)
+        {
+            int block_first = static_cast<int>(b) * BlockSize;
+            int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+            int count = 0;
+
+            for (int i = block_first; i != block_last; ++i)
+            {
+                if (pred(first[i]))
+                {
+                    ++count;
+                }
+            }
+
+            offsets[b + 1] = count;
+        }, static_cast<long>(num_blocks));
+
+    // Exclusive scan over blocks
+    for (int b = 0; b < num_blocks; ++b)
+    {
+        offsets[b + 1] += offsets[b];
+    }
+
+    pool.run([&](long b)
+        {
+            int block_first = static_cast<int>(b) * BlockSize;
+            int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+            OutputIt dst = out + offsets[b];
+
+            for (int i = block_first; i != block_last; ++i)
+            {
+                if (pred(first[i]))
+                {
+                    *dst++ = first[i];
+                }
+            }
+        }, static_cast<long>(num_blocks));
+
+    return out + offsets[num_blocks];
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// radix_sort
+//
+// LSD radix sort on unsigned integer keys. Each pass sorts Bits bits of the keys
+// with the stable parallel counting_sort from above.
+//
+// [in] POOL
+//      Thread pool to run on.
+//
+// [in,out] FIRST
+//      Start of the input sequence.
+//
+// [in,out] LAST
+//      End of the input sequence.
+//
+// [in] TEMP
+//      Start of a temporary sequence with the same length as the input sequence.
+//
+// [in] NUM_BITS
+//      Number of (least significant) key bits to sort by.
+//
+// [in] KEY
+//      Sort key function object.
+//
+
+template <
+    unsigned Bits = 8,
+    typename RandIt,
+    typename TempIt,
+    typename Key = visionaray::algo::detail::trivial_key
+    >
+void radix_sort(thread_pool& pool, RandIt first, RandIt last, TempIt temp, unsigned num_bits = 32, Key key = Key())
+{
+    static_assert(Bits > 0 && Bits <= 16, "radix_sort: invalid number of bits per pass");
+
+    if (first == last)
+    {
+        return;
+    }
+
+    std::vector<int> counts(1 << Bits);
+
+    unsigned mask = (1U << Bits) - 1;
+
+    bool in_temp = false;
+
+    for (unsigned shift = 0; shift < num_bits; shift += Bits)
+    {
+        auto digit = [&](typename std::iterator_traits<RandIt>::value_type const& item)
+        {
+            return (static_cast<unsigned>(key(item)) >> shift) & mask;
+        };
+
+        if (in_temp)
+        {
+            counting_sort(pool, temp, temp + (last - first), first, counts, digit);
+        }
+        else
+        {
+            counting_sort(pool, first, last, temp, counts, digit);
+        }
+
+        in_temp = !in_temp;
+    }
+
+    if (in_temp)
+    {
+        enum { BlockSize = 1 << 16 };
+
+        int n = static_cast<int>(last - first);
+        int num_blocks = div_up(n, static_cast<int>(BlockSize));
+
+        pool.run([&](long b)
+            {
+                int block_first = static_cast<int>(b) * BlockSize;
+                int block_last = std::min(block_first + static_cast<int>(BlockSize), n);
+
+                std::copy(temp + block_first, temp + block_last, first + block_first);
+            }, static_cast<long>(num_blocks));
+    }
+}
+
 } // namespace paralgo
 } // namespace visionaray
 
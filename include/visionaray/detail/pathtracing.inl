@@ -19,6 +19,138 @@ namespace visionaray
 namespace pathtracing
 {
 
+//-------------------------------------------------------------------------------------------------
+// Per-bounce math, shared by kernel and wavefront_sched
+//
+
+// Light from emissive surfaces that were hit by sampling the BRDF is weighted
+// with the power heuristic against light sampling. USE_MIS is false on the
+// first bounce and after specular bounces. AREA() returns the area of the hit
+// primitive, it is only called if a lane hit an emissive surface
+template <typename M, typename S, typename I, typename V, typename Surface, typename AreaFunc>
+VSNRAY_FUNC
+inline S emission_mis_weight(
+        M const&        use_mis,
+        S const&        brdf_pdf,
+        I const&        inter,
+        V const&        ray_ori,
+        V const&        isect_pos,
+        Surface const&  surf,
+        AreaFunc        area,
+        int             num_lights
+        )
+{
+    S light_pdf(0.0);
+
+    if (num_lights > 0 && any(inter == surface_interaction::Emission))
+    {
+        auto A = area();
+        auto ld = length(isect_pos - ray_ori);
+        auto L = normalize(isect_pos - ray_ori);
+        auto n = surf.geometric_normal;
+        auto ldotln = abs(dot(-L, n));
+        auto solid_angle = (ldotln * A) / (ld * ld);
+
+        light_pdf = select(
+            inter == surface_interaction::Emission,
+            S(1.0) / solid_angle,
+            S(0.0)
+            );
+    }
+
+    return select(
+        num_lights > 0 && use_mis,
+        power_heuristic(brdf_pdf, light_pdf / static_cast<float>(num_lights)),
+        S(1.0)
+        );
+}
+
+// Shadow ray to a random light source and the light it carries if unoccluded
+template <typename R, typename C>
+struct light_sample_record
+{
+    using scalar_type = typename R::scalar_type;
+    using mask_type   = simd::mask_type_t<scalar_type>;
+
+    R           shadow_ray;
+    scalar_type max_t;      // Occlusion test distance
+    C           contrib;    // MIS weighted, valid where valid is set
+    mask_type   valid;      // Light is in front of the surface and faces it
+};
+
+template <typename R, typename V, typename Surface, typename I, typename C, typename Light, typename Generator>
+VSNRAY_FUNC
+inline light_sample_record<R, C> sample_light(
+        R const&        ray,
+        V const&        isect_pos,
+        V const&        n,
+        Surface&        surf,
+        I const&        inter,
+        C const&        throughput,
+        Light           lights_begin,
+        Light           lights_end,
+        float           epsilon,
+        Generator&      gen
+        )
+{
+    using S = typename R::scalar_type;
+
+    auto num_lights = lights_end - lights_begin;
+
+    V view_dir = -ray.dir;
+
+    auto ls = sample_random_light(lights_begin, lights_end, gen);
+
+    auto ld = length(ls.pos - isect_pos);
+    auto L = normalize(ls.pos - isect_pos);
+
+    auto ln = select(ls.delta_light, -L, ls.normal);
+#if 1
+    ln = faceforward( ln, -L, ln );
+#endif
+    auto ldotn = dot(L, n);
+    auto ldotln = abs(dot(-L, ln));
+
+    light_sample_record<R, C> result;
+
+    result.shadow_ray = R(
+        isect_pos + L * S(epsilon),
+        L,
+        ray.time
+        );
+
+    result.max_t = ld - S(2.0f * epsilon);
+
+    auto brdf_pdf = surf.pdf(view_dir, L, inter);
+    auto prob = max_element(throughput.samples());
+    brdf_pdf *= prob;
+
+    // TODO: inv_pi / dot(n, wi) factor only valid for plastic and matte
+    auto src = surf.shade(view_dir, L, ls.intensity) * constants::inv_pi<S>() / ldotn;
+    auto solid_angle = (ldotln * ls.area);
+    solid_angle = select(!ls.delta_light, solid_angle / (ld * ld), solid_angle);
+    auto light_pdf = S(1.0) / solid_angle;
+
+    S mis_weight = power_heuristic(light_pdf / static_cast<float>(num_lights), brdf_pdf);
+
+    result.valid = ldotn > S(0.0) && ldotln > S(0.0);
+    result.contrib = mis_weight * throughput * src * (ldotn / light_pdf) * S(static_cast<float>(num_lights));
+
+    return result;
+}
+
+// Terminate paths with low throughput, boost the survivors
+template <typename C, typename M, typename Generator>
+VSNRAY_FUNC
+inline void russian_roulette(C& throughput, M& active_rays, Generator& gen)
+{
+    auto prob = max_element(throughput.samples());
+    auto terminate = gen.next() > prob;
+    active_rays &= !terminate;
+    throughput /= prob;
+}
+
+
 template <typename Params>
 struct kernel
 {
@@ -94,29 +226,17 @@ struct kernel
 
             auto zero_pdf = brdf_pdf <= S(0.0);
 
-            S light_pdf(0.0);
-            auto num_lights = params.lights.end - params.lights.begin;
-
-            if (num_lights > 0 && any(inter == surface_interaction::Emission))
-            {
-                auto A = get_area(params.prims.begin, hit_rec);
-                auto ld = length(hit_rec.isect_pos - ray.ori);
-                auto L = normalize(hit_rec.isect_pos - ray.ori);
-                auto n = surf.geometric_normal;
-                auto ldotln = abs(dot(-L, n));
-                auto solid_angle = (ldotln * A) / (ld * ld);
-
-                light_pdf = select(
-                    inter == surface_interaction::Emission,
-                    S(1.0) / solid_angle,
-                    S(0.0)
-                    );
-            }
-
-            S mis_weight = select(
-                bounce > 0 && num_lights > 0 && !last_specular,
-                power_heuristic(brdf_pdf, light_pdf / static_cast<float>(num_lights)),
-                S(1.0)
+            auto num_lights = static_cast<int>(params.lights.end - params.lights.begin);
+
+            S mis_weight = emission_mis_weight(
+                bounce > 0 && !last_specular,
+                brdf_pdf,
+                inter,
+                ray.ori,
+                hit_rec.isect_pos,
+                surf,
+                [&]() { return get_area(params.prims.begin, hit_rec, isect); },
+                num_lights
                 );
 
             intensity += select(
@@ -135,40 +255,24 @@ struct kernel
 
             if (num_lights > 0)
             {
-                auto ls = sample_random_light(params.lights.begin, params.lights.end, gen);
-
-                auto ld = length(ls.pos - hit_rec.isect_pos);
-                auto L = normalize(ls.pos - hit_rec.isect_pos);
-
-                auto ln = select(ls.delta_light, -L, ls.normal);
-#if 1
-                ln = faceforward( ln, -L, ln );
-#endif
-                auto ldotn = dot(L, n);
-                auto ldotln = abs(dot(-L, ln));
-
-                R shadow_ray(
-                    hit_rec.isect_pos + L * S(params.epsilon),
-                    L
-                    );
-
-                auto lhr = any_hit(shadow_ray, params.prims.begin, params.prims.end, ld - S(2.0f * params.epsilon), isect);
-
-                auto brdf_pdf = surf.pdf(view_dir, L, inter);
-                auto prob = max_element(throughput.samples());
-                brdf_pdf *= prob;
-
-                // TODO: inv_pi / dot(n, wi) factor only valid for plastic and matte
-                auto src = surf.shade(view_dir, L, ls.intensity) * constants::inv_pi<S>() / ldotn;
-                auto solid_angle = (ldotln * ls.area);
-                solid_angle = select(!ls.delta_light, solid_angle / (ld * ld), solid_angle);
-                auto light_pdf = S(1.0) / solid_angle;
-
-                S mis_weight = power_heuristic(light_pdf / static_cast<float>(num_lights), brdf_pdf);
+                auto ls = sample_light(
+                        ray,
+                        hit_rec.isect_pos,
+                        n,
+                        surf,
+                        inter,
+                        throughput,
+                        params.lights.begin,
+                        params.lights.end,
+                        params.epsilon,
+                        gen
+                        );
+
+                auto shadowed = occluded(ls.shadow_ray, params.prims.begin, params.prims.end, ls.max_t, isect);
 
                 intensity += select(
-                    active_rays && !lhr.hit && ldotn > S(0.0) && ldotln > S(0.0),
-                    mis_weight * throughput * src * (ldotn / light_pdf) * S(static_cast<float>(num_lights)),
+                    active_rays && !shadowed && ls.valid,
+                    ls.contrib,
                     C(0.0)
                     );
             }
@@ -178,11 +282,7 @@ struct kernel
 
             if (bounce >= 2)
             {
-                // Russian roulette
-                auto prob = max_element(throughput.samples());
-                auto terminate = gen.next() > prob;
-                active_rays &= !terminate;
-                throughput /= prob;
+                russian_roulette(throughput, active_rays, gen);
 
                 if (!any(active_rays))
                 {
@@ -0,0 +1,452 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include <visionaray/math/simd/simd.h>
+
+#include "macros.h"
+
+namespace visionaray
+{
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Breadth-first stream traversal
+//
+// cf. Tsakok (2009): Faster Incoherent Rays: Multi-BVH Ray Stream Tracing
+//     Fuetterling et al. (2015): Efficient Ray Tracing Kernels for Modern CPU Architectures
+//
+// Each stack entry holds a node and the indices of the rays that hit its
+// bounds. The index lists are kept on a second stack: when an entry is
+// popped, all lists above its own were already consumed.
+//
+// Buffers live in the scratch level of the traversal's depth, instances are
+// traversed with the next level.
+//
+
+template <bool AnyHit>
+class ray_stream_traversal
+{
+public:
+
+    ray_stream_traversal(ray_stream const& rays, hit_stream& hits, ray_stream_scratch& scratch, size_t depth = 0)
+        : rays_(rays)
+        , hits_(hits)
+        , scratch_(scratch)
+        , depth_(depth)
+        , inv_x_(scratch.get_level(depth).inv_x)
+        , inv_y_(scratch.get_level(depth).inv_y)
+        , inv_z_(scratch.get_level(depth).inv_z)
+        , max_t_(scratch.get_level(depth).max_t)
+        , indices_(scratch.get_level(depth).indices)
+        , stack_(scratch.get_level(depth).stack)
+    {
+        inv_x_.resize(rays.size());
+        inv_y_.resize(rays.size());
+        inv_z_.resize(rays.size());
+        max_t_.assign(rays.max_t.begin(), rays.max_t.end());
+
+        hits_.resize(rays.size());
+
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            inv_x_[i] = 1.0f / rays.dir_x[i];
+            inv_y_[i] = 1.0f / rays.dir_y[i];
+            inv_z_[i] = 1.0f / rays.dir_z[i];
+
+            hits_.hit[i] = 0;
+        }
+    }
+
+    template <typename BVH, typename Intersector>
+    void traverse(BVH const& b, Intersector& isect)
+    {
+        static_assert(
+                is_bvh<BVH>::value || is_index_bvh<BVH>::value,
+                "Ray stream traversal requires [index_]bvh_ref_t or [index_]bvh_inst_t"
+                );
+
+        if (b.num_nodes() == 0)
+        {
+            return;
+        }
+
+        indices_.clear();
+
+        for (size_t i = 0; i < rays_.size(); ++i)
+        {
+            // Rays with a hit are done with any hit traversal
+            if (max_t_[i] >= 0.0f)
+            {
+                indices_.push_back(static_cast<unsigned>(i));
+            }
+        }
+
+        traverse_impl(b, isect, typename is_any_bvh_inst<BVH>::type{});
+    }
+
+private:
+
+    using frame = ray_stream_scratch::frame;
+
+    ray_stream const&           rays_;
+    hit_stream&                 hits_;
+
+    ray_stream_scratch&         scratch_;
+    size_t                      depth_;
+
+    aligned_vector<float, 64>&  inv_x_;
+    aligned_vector<float, 64>&  inv_y_;
+    aligned_vector<float, 64>&  inv_z_;
+
+    // Closest hit so far, or -1 for any hit rays that are done
+    aligned_vector<float, 64>&  max_t_;
+
+    std::vector<unsigned>&      indices_;
+    std::vector<frame>&         stack_;
+
+    // Traverse BVH instances with the rays on indices_
+    template <typename BVH, typename Intersector>
+    void traverse_impl(BVH const& b, Intersector& isect, std::true_type /* instance */)
+    {
+        intersect_instance(b, indices_.data(), indices_.size(), isect);
+    }
+
+    template <typename BVH, typename Intersector>
+    void traverse_impl(BVH const& b, Intersector& isect, std::false_type /* instance */)
+    {
+        stack_.clear();
+        stack_.push_back({ 0, 0, indices_.size() });
+
+        while (!stack_.empty())
+        {
+            auto f = stack_.back();
+            stack_.pop_back();
+
+            indices_.resize(f.first + f.count);
+
+            auto const& node = b.node(f.addr);
+
+            if (is_leaf(node))
+            {
+                intersect_leaf(b, node, f, isect);
+                continue;
+            }
+
+            // Visit the near child first, majority vote of the ray directions
+            unsigned axis = node.get_split_axis();
+            auto const& dir = axis == 0 ? rays_.dir_x : axis == 1 ? rays_.dir_y : rays_.dir_z;
+
+            size_t num_negative = 0;
+
+            for (size_t i = 0; i < f.count; ++i)
+            {
+                if (dir[indices_[f.first + i]] < 0.0f)
+                {
+                    ++num_negative;
+                }
+            }
+
+            unsigned low = node.get_low_child();
+            unsigned near_child = num_negative * 2 > f.count ? 1 - low : low;
+
+            // Room for the index lists of both children, pointers stay valid.
+            // The list of the near child goes on top, it is consumed first
+            indices_.reserve(indices_.size() + 2 * f.count);
+
+            frame children[2];
+
+            for (unsigned c : { 1 - near_child, near_child })
+            {
+                children[c].addr = node.get_child(c);
+                children[c].first = indices_.size();
+                children[c].count = filter(b.node(children[c].addr).get_bounds(), f);
+            }
+
+            if (children[!near_child].count > 0)
+            {
+                stack_.push_back(children[!near_child]);
+            }
+
+            if (children[near_child].count > 0)
+            {
+                stack_.push_back(children[near_child]);
+            }
+        }
+    }
+
+    // Append the rays of F that hit BOX to the index stack, return their number
+    size_t filter(aabb const& box, frame const& f)
+    {
+        using simd::float4;
+        using simd::int4;
+
+        float4 min_x(box.min.x);
+        float4 min_y(box.min.y);
+        float4 min_z(box.min.z);
+        float4 max_x(box.max.x);
+        float4 max_y(box.max.y);
+        float4 max_z(box.max.z);
+
+        unsigned const* in = indices_.data() + f.first;
+
+        size_t count = 0;
+
+        for (size_t i = 0; i < f.count; i += 4)
+        {
+            size_t n = std::min(f.count - i, size_t(4));
+
+            // Pad with the last ray
+            int idx[4];
+
+            for (size_t j = 0; j < 4; ++j)
+            {
+                idx[j] = static_cast<int>(in[i + std::min(j, n - 1)]);
+            }
+
+            int4 index(idx[0], idx[1], idx[2], idx[3]);
+
+            float4 ox = gather(rays_.ori_x.data(), index);
+            float4 oy = gather(rays_.ori_y.data(), index);
+            float4 oz = gather(rays_.ori_z.data(), index);
+            float4 ix = gather(inv_x_.data(), index);
+            float4 iy = gather(inv_y_.data(), index);
+            float4 iz = gather(inv_z_.data(), index);
+            float4 mt = gather(max_t_.data(), index);
+
+            float4 t1x = (min_x - ox) * ix;
+            float4 t2x = (max_x - ox) * ix;
+            float4 t1y = (min_y - oy) * iy;
+            float4 t2y = (max_y - oy) * iy;
+            float4 t1z = (min_z - oz) * iz;
+            float4 t2z = (max_z - oz) * iz;
+
+            float4 tnear = max( max(min(t1x, t2x), min(t1y, t2y)), min(t1z, t2z) );
+            float4 tfar  = min( min(max(t1x, t2x), max(t1y, t2y)), max(t1z, t2z) );
+
+            auto hit = tnear <= tfar && tfar >= float4(0.0f) && max(tnear, float4(0.0f)) < mt;
+
+            if (!any(hit))
+            {
+                continue;
+            }
+
+            VSNRAY_ALIGN(16) float mask[4];
+            store(mask, select(hit, float4(1.0f), float4(0.0f)));
+
+            for (size_t j = 0; j < n; ++j)
+            {
+                if (mask[j] != 0.0f)
+                {
+                    indices_.push_back(static_cast<unsigned>(idx[j]));
+                    ++count;
+                }
+            }
+        }
+
+        return count;
+    }
+
+    template <typename BVH, typename Node, typename Intersector>
+    void intersect_leaf(BVH const& b, Node const& node, frame const& f, Intersector& isect)
+    {
+        using P = typename BVH::primitive_type;
+
+        for (auto p = node.get_indices().first; p != node.get_indices().last; ++p)
+        {
+            intersect_primitive(b.primitive(p), f, isect, typename is_any_bvh_inst<P>::type{});
+        }
+    }
+
+    template <typename Primitive, typename Intersector>
+    void intersect_primitive(Primitive const& prim, frame const& f, Intersector& isect, std::false_type /* instance */)
+    {
+        for (size_t i = 0; i < f.count; ++i)
+        {
+            unsigned r = indices_[f.first + i];
+
+            if (AnyHit && max_t_[r] < 0.0f)
+            {
+                continue;
+            }
+
+            auto hr = isect(rays_.get_ray(r), prim);
+
+            if (!hr.hit || hr.t < 0.0f || hr.t >= max_t_[r])
+            {
+                continue;
+            }
+
+            hits_.hit[r]     = 1;
+            hits_.t[r]       = hr.t;
+            hits_.u[r]       = hr.u;
+            hits_.v[r]       = hr.v;
+            hits_.prim_id[r] = hr.prim_id;
+            hits_.geom_id[r] = hr.geom_id;
+            hits_.inst_id[r] = 0;
+
+            max_t_[r] = AnyHit ? -1.0f : hr.t;
+        }
+    }
+
+    template <typename Inst, typename Intersector>
+    void intersect_primitive(Inst const& inst, frame const& f, Intersector& isect, std::true_type /* instance */)
+    {
+        intersect_instance(inst, indices_.data() + f.first, f.count, isect);
+    }
+
+    // Transform the rays RAYS[0..count) into the object space of INST and
+    // traverse the instanced BVH with them as a stream of its own. The
+    // directions are not normalized, so that hit distances stay the same
+    template <typename Inst, typename Intersector>
+    void intersect_instance(Inst const& inst, unsigned const* rays, size_t count, Intersector& isect)
+    {
+        auto& level = scratch_.get_level(depth_);
+
+        auto& local_rays = level.instance_rays;
+        local_rays.clear();
+        local_rays.reserve(count);
+
+        auto& ids = level.instance_ids;
+        ids.clear();
+        ids.reserve(count);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            unsigned r = rays[i];
+
+            if (max_t_[r] < 0.0f)
+            {
+                continue;
+            }
+
+            auto ray = rays_.get_ray(r);
+            auto transform_inv = inst.transform_inv(ray.time);
+
+            ray.ori = (transform_inv * vec4(ray.ori, 1.0f)).xyz();
+            ray.dir = (transform_inv * vec4(ray.dir, 0.0f)).xyz();
+
+            local_rays.push_back(ray, max_t_[r]);
+            ids.push_back(r);
+        }
+
+        if (local_rays.empty())
+        {
+            return;
+        }
+
+        auto& local_hits = level.instance_hits;
+        ray_stream_traversal<AnyHit> traversal(local_rays, local_hits, scratch_, depth_ + 1);
+        traversal.traverse(inst.get_ref(), isect);
+
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            unsigned r = ids[i];
+
+            if (!local_hits.hit[i] || local_hits.t[i] >= max_t_[r])
+            {
+                continue;
+            }
+
+            hits_.hit[r]     = 1;
+            hits_.t[r]       = local_hits.t[i];
+            hits_.u[r]       = local_hits.u[i];
+            hits_.v[r]       = local_hits.v[i];
+            hits_.prim_id[r] = local_hits.prim_id[i];
+            hits_.geom_id[r] = inst.geom_id() != ~0U ? inst.geom_id() : local_hits.geom_id[i];
+            hits_.inst_id[r] = inst.inst_id();
+
+            max_t_[r] = AnyHit ? -1.0f : local_hits.t[i];
+        }
+    }
+};
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Ray stream traversal interface
+//
+
+template <typename Primitives, typename Intersector>
+void closest_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect,
+        ray_stream_scratch& scratch
+        )
+{
+    detail::ray_stream_traversal<false> traversal(rays, hits, scratch);
+
+    for (auto it = begin; it != end; ++it)
+    {
+        traversal.traverse(*it, isect);
+    }
+}
+
+template <typename Primitives, typename Intersector>
+void closest_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect
+        )
+{
+    ray_stream_scratch scratch;
+    closest_hit_stream(rays, hits, begin, end, isect, scratch);
+}
+
+template <typename Primitives>
+void closest_hit_stream(ray_stream const& rays, hit_stream& hits, Primitives begin, Primitives end)
+{
+    default_intersector ignore;
+    closest_hit_stream(rays, hits, begin, end, ignore);
+}
+
+template <typename Primitives, typename Intersector>
+void any_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect,
+        ray_stream_scratch& scratch
+        )
+{
+    detail::ray_stream_traversal<true> traversal(rays, hits, scratch);
+
+    for (auto it = begin; it != end; ++it)
+    {
+        traversal.traverse(*it, isect);
+    }
+}
+
+template <typename Primitives, typename Intersector>
+void any_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect
+        )
+{
+    ray_stream_scratch scratch;
+    any_hit_stream(rays, hits, begin, end, isect, scratch);
+}
+
+template <typename Primitives>
+void any_hit_stream(ray_stream const& rays, hit_stream& hits, Primitives begin, Primitives end)
+{
+    default_intersector ignore;
+    any_hit_stream(rays, hits, begin, end, ignore);
+}
+
+} // visionaray
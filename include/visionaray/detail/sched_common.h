@@ -6,6 +6,7 @@
 #ifndef VSNRAY_DETAIL_SCHED_COMMON_H
 #define VSNRAY_DETAIL_SCHED_COMMON_H 1
 
+#include <type_traits>
 #include <utility>
 
 #include <visionaray/math/array.h>
@@ -73,6 +74,67 @@ inline auto invoke_kernel(K kernel, R r, Generator& gen, int x, int y)
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Sample the ray time from the shutter interval of the camera
+//
+// Cameras without a shutter generate rays at time 0. No random numbers are
+// drawn while the shutter interval is empty
+//
+
+template <typename Camera>
+struct has_shutter_impl
+{
+    template <typename U>
+    static std::true_type test(decltype(&U::shutter_open)*);
+
+    template <typename U>
+    static std::false_type test(...);
+
+    using type = decltype( test<typename std::decay<Camera>::type>(nullptr) );
+};
+
+template <typename Camera>
+struct has_shutter : has_shutter_impl<Camera>::type
+{
+};
+
+template <
+    typename R,
+    typename Camera,
+    typename Generator,
+    typename = typename std::enable_if<!has_shutter<Camera>::value>::type
+    >
+VSNRAY_FUNC
+inline void sample_ray_time(R& /* r */, Camera const& /* cam */, Generator& /* gen */)
+{
+}
+
+template <
+    typename R,
+    typename Camera,
+    typename Generator,
+    typename = typename std::enable_if<has_shutter<Camera>::value>::type,
+    typename = void
+    >
+VSNRAY_FUNC
+inline void sample_ray_time(R& r, Camera const& cam, Generator& gen)
+{
+    using T = typename R::scalar_type;
+
+    float open = cam.shutter_open();
+    float close = cam.shutter_close();
+
+    if (close > open)
+    {
+        r.time = T(open) + gen.next() * T(close - open);
+    }
+    else
+    {
+        r.time = T(open);
+    }
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Invoke cam::primary_ray()
 //
@@ -93,9 +155,9 @@ inline auto invoke_cam_primary_ray(
         )
     -> decltype(cam.primary_ray(R{}, x, y, width, height))
 {
-    VSNRAY_UNUSED(gen);
-
-    return cam.primary_ray(R{}, x, y, width, height);
+    auto r = cam.primary_ray(R{}, x, y, width, height);
+    sample_ray_time(r, cam, gen);
+    return r;
 }
 
 template <typename R, typename Camera, typename Generator, typename T, typename = void>
@@ -111,7 +173,9 @@ inline auto invoke_cam_primary_ray(
         )
     -> decltype(cam.primary_ray(R{}, gen, x, y, width, height))
 {
-    return cam.primary_ray(R{}, gen, x, y, width, height);
+    auto r = cam.primary_ray(R{}, gen, x, y, width, height);
+    sample_ray_time(r, cam, gen);
+    return r;
 }
 
 
@@ -50,6 +50,81 @@ struct stack
     unsigned ptr;
 };
 
+
+//-------------------------------------------------------------------------------------------------
+// Short stack
+//
+// Fixed size stack that discards its oldest entry when an element is pushed
+// while it is full. Stores a tag with each entry that callers can use to tell
+// if the entry they expect was discarded. N may be 0.
+//
+
+template <unsigned N, typename T = unsigned, typename Tag = unsigned>
+struct short_stack
+{
+    VSNRAY_FUNC short_stack()
+        : data()
+        , tags()
+        , first(0)
+        , count(0)
+    {
+    }
+
+    VSNRAY_FUNC bool empty() const
+    {
+        return count == 0;
+    }
+
+    VSNRAY_FUNC unsigned size() const
+    {
+        return count;
+    }
+
+    VSNRAY_FUNC void clear()
+    {
+        count = 0;
+    }
+
+    VSNRAY_FUNC void push(T v, Tag t)
+    {
+        if (N == 0)
+        {
+            return;
+        }
+
+        unsigned i = (first + count) % Capacity;
+
+        data[i] = v;
+        tags[i] = t;
+
+        if (count < N)
+        {
+            ++count;
+        }
+        else
+        {
+            first = (first + 1) % Capacity;
+        }
+    }
+
+    VSNRAY_FUNC T pop()
+    {
+        return data[(first + --count) % Capacity];
+    }
+
+    VSNRAY_FUNC Tag top_tag() const
+    {
+        return tags[(first + count - 1) % Capacity];
+    }
+
+    enum { Capacity = N > 0 ? N : 1 };
+
+    T data[Capacity];
+    Tag tags[Capacity];
+    unsigned first;
+    unsigned count;
+};
+
 } // detail
 } // visionaray
 
@@ -7,14 +7,13 @@
 #define VSNRAY_DETAIL_THREAD_POOL_H 1
 
 #include <atomic>
-#include <cassert>
 #include <condition_variable>
-#include <functional>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <vector>
 
-#include "semaphore.h"
+#include "numa.h"
 
 namespace visionaray
 {
@@ -22,15 +21,31 @@ namespace visionaray
 //-------------------------------------------------------------------------------------------------
 // Thread pool
 //
+// Work-stealing pool with one deque per worker thread and one that is shared
+// by the threads outside the pool. run(func, n) calls func(i) for i in [0..n)
+// and returns when all calls have finished. The range is split in halves on
+// demand: the executing thread keeps the lower half and pushes the upper half
+// to its deque, idle threads steal the largest ranges from the other end.
+//
+// The thread that called run() executes work while it waits, so run() may be
+// called from inside func (nested parallelism), and several threads may share
+// a pool. Idle workers spin for a while before they are parked. Jobs live on
+// the stack of run(), dispatching them requires no memory allocation.
+//
+// In NUMA mode, workers are distributed round-robin over the NUMA nodes and
+// pinned to the CPUs of their node, and they steal from workers on their own
+// node first. run() called from outside the pool hands one contiguous part
+// of the range to each node, so that a node always renders the same image
+// region and the memory it touches first stays local, cf. cpu_buffer_rt.
+//
 
 class thread_pool
 {
 public:
 
-    explicit thread_pool(unsigned num_threads)
+    explicit thread_pool(unsigned num_threads, bool numa = false)
+        : numa_(numa)
     {
-        sync_params.start_threads = false;
-        sync_params.join_threads = false;
         reset(num_threads);
     }
 
@@ -43,25 +58,35 @@ public:
     {
         join_threads();
 
+        // One deque per worker, the last one is shared by threads outside the pool
+        queues_.reset(new work_queue[num_threads + 1]);
+
+        stop_ = false;
+
+        init_nodes(num_threads);
+
         threads.reset(new std::thread[num_threads]);
         this->num_threads = num_threads;
 
         for (unsigned i = 0; i < num_threads; ++i)
         {
-            threads[i] = std::thread([this](){ thread_loop(); });
+            threads[i] = std::thread([this, i](){ thread_loop(i); });
         }
     }
 
     void join_threads()
     {
-        if (num_threads == 0)
+        if (threads == nullptr)
         {
             return;
         }
 
-        sync_params.start_threads = true;
-        sync_params.join_threads = true;
-        sync_params.threads_start.notify_all();
+        {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            stop_ = true;
+        }
+
+        park_cond_.notify_all();
 
         for (unsigned i = 0; i < num_threads; ++i)
         {
@@ -71,31 +96,65 @@ public:
             }
         }
 
-        sync_params.start_threads = false;
-        sync_params.join_threads = false;
         threads.reset(nullptr);
+        num_threads = 0;
     }
 
     template <typename Func>
     void run(Func f, long queue_length)
     {
-        // Set worker function
-        func = f;
+        if (queue_length <= 0)
+        {
+            return;
+        }
+
+        job j;
+        j.invoke = &invoke<Func>;
+        j.func = &f;
+        j.pending = queue_length;
 
-        // Set counters
-        sync_params.num_work_items = queue_length;
-        sync_params.work_item_counter = 0;
-        sync_params.work_items_finished_counter = 0;
+        unsigned self = current_queue();
 
-        // Activate persistent threads
-        sync_params.start_threads = true;
-        sync_params.threads_start.notify_all();
+        if (self == num_threads && leaders_.size() > 1)
+        {
+            // One part per node, pushed to the first worker of that node
+            long num_nodes = static_cast<long>(leaders_.size());
+
+            for (long n = 0; n < num_nodes; ++n)
+            {
+                task t{ &j, queue_length * n / num_nodes, queue_length * (n + 1) / num_nodes };
 
-        // Wait for all threads to finish
-        sync_params.threads_ready.wait();
+                if (t.first != t.last && !queues_[leaders_[n]].push(t))
+                {
+                    execute(t, self);
+                }
+            }
 
-        // Idle w/o work
-        sync_params.start_threads = false;
+            notify();
+        }
+        else if (queues_[self].push({ &j, 0, queue_length }))
+        {
+            notify();
+        }
+        else
+        {
+            execute({ &j, 0, queue_length }, self);
+        }
+
+        // Help until all work items have finished
+        unsigned spins = 0;
+
+        while (j.pending.load(std::memory_order_acquire) > 0)
+        {
+            if (try_execute(self))
+            {
+                spins = 0;
+            }
+            else if (++spins > SpinCount)
+            {
+                std::this_thread::yield();
+            }
+        }
     }
 
     std::unique_ptr<std::thread[]> threads;
@@ -103,69 +162,292 @@ public:
 
 private:
 
-    using func_t = std::function<void(unsigned)>;
-    func_t func;
+    enum { QueueCapacity = 256 };   // Ranges per deque, enough for 2^64 items at each nesting level
+    enum { SpinCount = 1024 };      // Idle iterations before parking or yielding
 
+    struct job
+    {
+        void (*invoke)(void*, long);
+        void* func;
+        std::atomic<long> pending;  // Work items that have not finished yet
+    };
 
-    struct
+    struct task
+    {
+        job* j;
+        long first;
+        long last;
+    };
+
+    // Deque of ranges, the owner pushes and pops at the bottom, thieves take
+    // from the top. Operations are short, a spin lock protects them
+    class work_queue
     {
-        std::mutex              mutex;
-        std::condition_variable threads_start;
-        visionaray::semaphore   threads_ready;
+    public:
 
-        std::atomic<bool>       start_threads;
-        std::atomic<bool>       join_threads;
+        bool push(task const& t)
+        {
+            lock();
 
-        std::atomic<long>       num_work_items;
-        std::atomic<long>       work_item_counter;
-        std::atomic<long>       work_items_finished_counter;
-    } sync_params;
+            bool result = bottom_ - top_ < QueueCapacity;
 
-    void thread_loop()
-    {
-        for (;;)
+            if (result)
+            {
+                tasks_[bottom_ % QueueCapacity] = t;
+                bottom_.store(bottom_ + 1, std::memory_order_relaxed);
+            }
+
+            unlock();
+            return result;
+        }
+
+        bool pop(task& t)
+        {
+            return take(t, true);
+        }
+
+        bool steal(task& t)
+        {
+            return take(t, false);
+        }
+
+    private:
+
+        task tasks_[QueueCapacity];
+
+        std::atomic<long> top_{0};
+        std::atomic<long> bottom_{0};
+
+        std::atomic<bool> locked_{false};
+
+        bool take(task& t, bool from_bottom)
         {
-            // Wait until activated
+            // Avoid the lock for empty deques
+            if (top_.load(std::memory_order_relaxed) == bottom_.load(std::memory_order_relaxed))
             {
-                std::unique_lock<std::mutex> lock(sync_params.mutex);
-                sync_params.threads_start.wait(
-                        lock,
-                        [this]()
-                            -> std::atomic<bool> const&
-                        {
-                            return sync_params.start_threads;
-                        }
-                        );
+                return false;
             }
 
-            // Exit?
-            if (sync_params.join_threads)
+            lock();
+
+            bool result = top_ != bottom_;
+
+            if (result && from_bottom)
             {
-                break;
+                bottom_.store(bottom_ - 1, std::memory_order_relaxed);
+                t = tasks_[bottom_ % QueueCapacity];
+            }
+            else if (result)
+            {
+                t = tasks_[top_ % QueueCapacity];
+                top_.store(top_ + 1, std::memory_order_relaxed);
             }
 
+            unlock();
+            return result;
+        }
 
-            // Perform work in queue
-            for (;;)
+        void lock()
+        {
+            while (locked_.exchange(true, std::memory_order_acquire))
             {
-                auto work_item = sync_params.work_item_counter.fetch_add(1);
+                std::this_thread::yield();
+            }
+        }
 
-                if (work_item >= sync_params.num_work_items)
+        void unlock()
+        {
+            locked_.store(false, std::memory_order_release);
+        }
+    };
+
+    std::unique_ptr<work_queue[]> queues_;
+
+    bool numa_ = false;
+
+    // Node of each worker
+    std::vector<unsigned> nodes_;
+
+    // First worker of each node, only in NUMA mode with more than one node
+    std::vector<unsigned> leaders_;
+
+    // Per queue, the other queues in the order they are stolen from
+    std::vector<unsigned> victims_;
+
+    std::atomic<bool> stop_{false};
+
+    // Incremented whenever work is pushed, parked workers wait for a change
+    std::atomic<unsigned> epoch_{0};
+    std::atomic<unsigned> num_parked_{0};
+
+    std::mutex park_mutex_;
+    std::condition_variable park_cond_;
+
+    template <typename Func>
+    static void invoke(void* func, long i)
+    {
+        (*static_cast<Func*>(func))(i);
+    }
+
+    void init_nodes(unsigned num_threads)
+    {
+        unsigned num_nodes = numa_ ? get_numa_topology().num_nodes() : 1;
+
+        nodes_.resize(num_threads);
+        leaders_.clear();
+
+        for (unsigned i = 0; i < num_threads; ++i)
+        {
+            nodes_[i] = i % num_nodes;
+
+            if (numa_ && num_nodes > 1 && i < num_nodes)
+            {
+                leaders_.push_back(i);
+            }
+        }
+
+        // Own node first, then the other workers, then the shared queue
+        victims_.clear();
+
+        for (unsigned self = 0; self <= num_threads; ++self)
+        {
+            for (unsigned i = 1; i <= num_threads; ++i)
+            {
+                unsigned v = (self + i) % (num_threads + 1);
+
+                if (self < num_threads && v < num_threads && nodes_[v] == nodes_[self])
+                {
+                    victims_.push_back(v);
+                }
+            }
+
+            for (unsigned i = 1; i <= num_threads; ++i)
+            {
+                unsigned v = (self + i) % (num_threads + 1);
+
+                if (self == num_threads || v == num_threads || nodes_[v] != nodes_[self])
                 {
-                    break;
+                    victims_.push_back(v);
                 }
+            }
+        }
+    }
+
+    unsigned current_queue() const
+    {
+        auto id = std::this_thread::get_id();
+
+        for (unsigned i = 0; i < num_threads; ++i)
+        {
+            if (threads[i].get_id() == id)
+            {
+                return i;
+            }
+        }
+
+        return num_threads;
+    }
+
+    void notify()
+    {
+        epoch_.fetch_add(1);
+
+        if (num_parked_.load() > 0)
+        {
+            std::unique_lock<std::mutex> lock(park_mutex_);
+            park_cond_.notify_all();
+        }
+    }
+
+    void execute(task t, unsigned self)
+    {
+        // Split until a single work item is left, thieves take the upper halves
+        while (t.last - t.first > 1)
+        {
+            long mid = t.first + (t.last - t.first) / 2;
+
+            if (!queues_[self].push({ t.j, mid, t.last }))
+            {
+                break;
+            }
+
+            notify();
+            t.last = mid;
+        }
+
+        for (long i = t.first; i != t.last; ++i)
+        {
+            t.j->invoke(t.j->func, i);
+        }
+
+        // Last access to the job, it may be destroyed afterwards
+        t.j->pending.fetch_sub(t.last - t.first, std::memory_order_release);
+    }
+
+    bool try_execute(unsigned self)
+    {
+        task t;
+
+        if (queues_[self].pop(t))
+        {
+            execute(t, self);
+            return true;
+        }
+
+        unsigned const* victims = victims_.data() + self * num_threads;
+
+        for (unsigned i = 0; i < num_threads; ++i)
+        {
+            if (queues_[victims[i]].steal(t))
+            {
+                execute(t, self);
+                return true;
+            }
+        }
 
-                func(work_item);
+        return false;
+    }
+
+    void thread_loop(unsigned self)
+    {
+        if (numa_)
+        {
+            pin_this_thread_to_numa_node(nodes_[self]);
+        }
 
-                auto finished = sync_params.work_items_finished_counter.fetch_add(1);
+        for (;;)
+        {
+            unsigned epoch = epoch_.load();
+
+            if (try_execute(self))
+            {
+                continue;
+            }
 
-                if (finished >= sync_params.num_work_items - 1)
+            // Spin, then park until new work is pushed
+            for (unsigned i = 0; i < SpinCount && epoch_.load() == epoch && !stop_; ++i)
+            {
+                if (i >= SpinCount / 2)
                 {
-                    assert(finished == sync_params.num_work_items - 1);
-                    sync_params.threads_ready.notify();
-                    break;
+                    std::this_thread::yield();
                 }
             }
+
+            if (epoch_.load() != epoch)
+            {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(park_mutex_);
+
+            if (stop_)
+            {
+                break;
+            }
+
+            ++num_parked_;
+            park_cond_.wait(lock, [&]() { return epoch_.load() != epoch || stop_; });
+            --num_parked_;
         }
     }
 };
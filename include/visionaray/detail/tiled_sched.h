@@ -6,6 +6,8 @@
 #ifndef VSNRAY_DETAIL_TILED_SCHED_H
 #define VSNRAY_DETAIL_TILED_SCHED_H 1
 
+#include <memory>
+
 #include "basic_sched.h"
 #include "parallel_for.h"
 #include "range.h"
@@ -17,13 +19,29 @@ namespace visionaray
 struct tiled_sched_backend
 {
     explicit tiled_sched_backend(unsigned num_threads)
-        : pool_(num_threads)
+        : own_pool_(new thread_pool(num_threads))
+        , pool_(own_pool_.get())
+    {
+    }
+
+    // Share POOL with other users, e.g. BVH builds. The pool must outlive the scheduler
+    explicit tiled_sched_backend(thread_pool& pool)
+        : pool_(&pool)
     {
     }
 
+    // Use a pool of its own with NUM_THREADS threads, also if a pool was shared before
     void reset(unsigned num_threads)
     {
-        pool_.reset(num_threads);
+        if (own_pool_ != nullptr)
+        {
+            own_pool_->reset(num_threads);
+        }
+        else
+        {
+            own_pool_.reset(new thread_pool(num_threads));
+            pool_ = own_pool_.get();
+        }
     }
 
     template <typename Func>
@@ -35,7 +53,7 @@ struct tiled_sched_backend
             )
     {
         visionaray::parallel_for(
-            pool_,
+            *pool_,
             tr,
             [=](range2d<int> const& r)
             {
@@ -49,7 +67,8 @@ struct tiled_sched_backend
             });
     }
 
-    thread_pool pool_;
+    std::unique_ptr<thread_pool> own_pool_;
+    thread_pool* pool_;
 };
 
 template <typename R>
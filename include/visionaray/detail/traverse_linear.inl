@@ -6,6 +6,7 @@
 #include <type_traits>
 #include <utility>
 
+#include <visionaray/math/simd/type_traits.h>
 #include <visionaray/bvh.h>
 #include <visionaray/intersector.h>
 #include <visionaray/update_if.h>
@@ -273,6 +274,67 @@ inline auto any_hit(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// occluded
+//
+// Occlusion query for shadow rays. Returns a mask with the rays that hit any
+// primitive in [0..max_t). Other than any_hit(), no hit records are assembled
+// and BVH traversal does not order the children by distance. Order selects the
+// child order for BVHs, cf. bvh_occlusion_order.
+//
+
+template <
+    bvh_occlusion_order Order = bvh_occlusion_order::none,
+    typename R,
+    typename Primitives,
+    typename Intersector
+    >
+VSNRAY_FUNC
+inline auto occluded(
+        R const&                        r,
+        Primitives                      begin,
+        Primitives                      end,
+        typename R::scalar_type const&  max_t,
+        Intersector&                    isect
+        )
+    -> typename simd::mask_type<typename R::scalar_type>::type
+{
+    using mask_type = typename simd::mask_type<typename R::scalar_type>::type;
+
+    mask_type result(false);
+
+    for (Primitives it = begin; it != end; ++it)
+    {
+        result = result || detail::occluded_prim<Order>(r, *it, isect, max_t);
+
+        if (all(result))
+        {
+            break;
+        }
+    }
+
+    return result;
+}
+
+template <
+    bvh_occlusion_order Order = bvh_occlusion_order::none,
+    typename R,
+    typename Primitives
+    >
+VSNRAY_FUNC
+inline auto occluded(
+        R const&                        r,
+        Primitives                      begin,
+        Primitives                      end,
+        typename R::scalar_type const&  max_t
+        )
+    -> typename simd::mask_type<typename R::scalar_type>::type
+{
+    default_intersector ignore;
+    return occluded<Order>(r, begin, end, max_t, ignore);
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // closest hit
 //
@@ -0,0 +1,136 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_DETAIL_WAVEFRONT_SCHED_H
+#define VSNRAY_DETAIL_WAVEFRONT_SCHED_H 1
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include <visionaray/aligned_vector.h>
+#include <visionaray/kernels.h>
+#include <visionaray/result_record.h>
+#include <visionaray/spectrum.h>
+
+#include "thread_pool.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Wavefront path tracing scheduler
+//
+// cf. Laine et al. (2013): Megakernels Considered Harmful: Wavefront Path Tracing on GPUs
+//
+// Renders pathtracing::kernel with one path per pixel. Instead of running
+// the whole bounce loop per ray packet, all paths of the frame advance one
+// bounce at a time in stages:
+//
+//  extend  - trace the active paths, misses are terminated
+//  sort    - order the hits by material (geom_id)
+//  shade   - sample the materials, emit shadow rays, roulette
+//  shadow  - trace the shadow rays, add unoccluded light
+//
+// Path state is kept in per-field arrays, and the queue of active paths is
+// compacted between bounces. Sorting and compaction run on the thread pool.
+// Each stage gathers full packets of type R from the queues, so SIMD lanes
+// stay busy however many paths terminate, and the packets in the shade stage
+// mostly share one material.
+//
+// Supports the uniform and jittered pixel samplers and their blend variants.
+// The result is identical to the pathtracing kernel up to random numbers.
+//
+
+template <typename R>
+class wavefront_sched
+{
+public:
+
+    explicit wavefront_sched(unsigned num_threads);
+
+    // Share POOL with other users, e.g. BVH builds. The pool must outlive the scheduler
+    explicit wavefront_sched(thread_pool& pool);
+
+    template <typename Params, typename SP>
+    void frame(pathtracing::kernel<Params> kernel, SP sched_params);
+
+    // Use a pool of its own with NUM_THREADS threads, also if a pool was shared before
+    void reset(unsigned num_threads);
+
+private:
+
+    using color_type = spectrum<float>;
+
+    std::unique_ptr<thread_pool> own_pool_;
+    thread_pool* pool_;
+
+    // Used to seed the random number generators
+    unsigned frame_num_ = 0;
+
+    // Hit records of the paths, their type depends on the kernel params
+    class hit_buffer
+    {
+    public:
+
+        template <typename HR>
+        aligned_vector<HR>& get()
+        {
+            if (type_ != &type_id<HR>)
+            {
+                data_ = std::shared_ptr<void>(
+                        new aligned_vector<HR>,
+                        [](void* ptr) { delete static_cast<aligned_vector<HR>*>(ptr); }
+                        );
+                type_ = &type_id<HR>;
+            }
+
+            return *static_cast<aligned_vector<HR>*>(data_.get());
+        }
+
+    private:
+
+        template <typename HR>
+        static void type_id() {}
+
+        std::shared_ptr<void> data_;
+        void (*type_)() = nullptr;
+    };
+
+    // Path state, one path per pixel of the scissor box
+    aligned_vector<basic_ray<float>>    rays_;
+    aligned_vector<color_type>          throughput_;
+    aligned_vector<color_type>          intensity_;
+    aligned_vector<float>               last_specular_;
+    aligned_vector<int>                 alive_;
+    aligned_vector<result_record<float>> results_;
+    hit_buffer                          hits_;
+
+    // Shadow rays, max_t < 0 if the path has none
+    aligned_vector<basic_ray<float>>    shadow_rays_;
+    aligned_vector<float>               shadow_max_t_;
+    aligned_vector<color_type>          shadow_contrib_;
+
+    // Queues of path indices
+    aligned_vector<unsigned>            active_;
+    aligned_vector<unsigned>            shade_;
+    aligned_vector<unsigned>            shadow_queue_;
+
+    // Material sort
+    aligned_vector<unsigned>            sort_temp_;
+    std::vector<int>                    sort_counts_;
+    std::vector<int>                    chunk_max_keys_;
+
+    // Run FUNC(first, last) over [0..n) in chunks
+    template <typename Func>
+    void for_each_chunk(size_t n, size_t chunk_size, Func const& func);
+
+};
+
+} // visionaray
+
+#include "wavefront_sched.inl"
+
+#endif // VSNRAY_DETAIL_WAVEFRONT_SCHED_H
@@ -0,0 +1,641 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <visionaray/math/simd/simd.h>
+#include <visionaray/get_area.h>
+#include <visionaray/get_surface.h>
+#include <visionaray/intersector.h>
+#include <visionaray/make_generator.h>
+#include <visionaray/random_generator.h>
+#include <visionaray/sampling.h>
+#include <visionaray/surface_interaction.h>
+#include <visionaray/traverse.h>
+
+#include "parallel_algorithm.h"
+#include "sched_common.h"
+
+namespace visionaray
+{
+namespace wavefront_sched_impl
+{
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+enum { ChunkPackets = 16 };     // Packets per task
+
+// Seed of the random generator of one ray or lane
+inline unsigned make_seed(unsigned frame, unsigned stage, size_t index)
+{
+    unsigned h = frame * 0x9E3779B9U ^ stage * 0x85EBCA6BU ^ static_cast<unsigned>(index) * 0xC2B2AE35U;
+
+    h ^= h >> 16;
+    h *= 0x7FEB352DU;
+    h ^= h >> 15;
+    h *= 0x846CA68BU;
+    h ^= h >> 16;
+
+    return h;
+}
+
+// Lanes of mask M as ints
+template <typename M>
+inline array<int, simd::num_elements<M>::value> mask_to_array(M const& m)
+{
+    simd::aligned_array_t<simd::int_type_t<M>> tmp;
+    store(tmp, convert_to_int(m));
+
+    array<int, simd::num_elements<M>::value> result;
+
+    for (size_t i = 0; i < simd::num_elements<M>::value; ++i)
+    {
+        result[i] = tmp[i];
+    }
+
+    return result;
+}
+
+template <size_t N>
+inline spectrum<simd::float_from_simd_width_t<N>> pack_spectrum(array<spectrum<float>, N> const& colors)
+{
+    array<vector<spectrum<float>::num_samples, float>, N> samples;
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        samples[i] = colors[i].samples();
+    }
+
+    return spectrum<simd::float_from_simd_width_t<N>>(simd::pack(samples));
+}
+
+template <typename S>
+inline array<spectrum<float>, simd::num_elements<S>::value> unpack_spectrum(spectrum<S> const& c)
+{
+    auto samples = simd::unpack(c.samples());
+
+    array<spectrum<float>, simd::num_elements<S>::value> result;
+
+    for (size_t i = 0; i < simd::num_elements<S>::value; ++i)
+    {
+        result[i] = spectrum<float>(samples[i]);
+    }
+
+    return result;
+}
+
+// Intersector from the sched params, or the default intersector
+template <typename SP>
+inline auto get_intersector(SP& sparams, std::true_type /* has intersector */)
+    -> decltype((sparams.intersector))
+{
+    return sparams.intersector;
+}
+
+template <typename SP>
+inline default_intersector get_intersector(SP& /* sparams */, std::false_type /* has intersector */)
+{
+    return default_intersector{};
+}
+
+// Returns the result that was computed for pixel (x,y), used to write it with sample_pixel()
+struct resolve_kernel
+{
+    result_record<float> const* results;
+    int x0;
+    int y0;
+    int width;
+
+    result_record<float> operator()(basic_ray<float> const& /* ray */, int x, int y) const
+    {
+        return results[(y - y0) * width + (x - x0)];
+    }
+};
+
+} // wavefront_sched_impl
+
+
+//-------------------------------------------------------------------------------------------------
+// wavefront_sched implementation
+//
+
+template <typename R>
+wavefront_sched<R>::wavefront_sched(unsigned num_threads)
+    : own_pool_(new thread_pool(num_threads))
+    , pool_(own_pool_.get())
+{
+}
+
+template <typename R>
+wavefront_sched<R>::wavefront_sched(thread_pool& pool)
+    : pool_(&pool)
+{
+}
+
+template <typename R>
+void wavefront_sched<R>::reset(unsigned num_threads)
+{
+    if (own_pool_ != nullptr)
+    {
+        own_pool_->reset(num_threads);
+    }
+    else
+    {
+        own_pool_.reset(new thread_pool(num_threads));
+        pool_ = own_pool_.get();
+    }
+}
+
+template <typename R>
+template <typename Func>
+void wavefront_sched<R>::for_each_chunk(size_t n, size_t chunk_size, Func const& func)
+{
+    size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+
+    pool_->run([&](long chunk)
+        {
+            size_t first = static_cast<size_t>(chunk) * chunk_size;
+            size_t last = std::min(first + chunk_size, n);
+
+            func(first, last);
+
+        }, static_cast<long>(num_chunks));
+}
+
+template <typename R>
+template <typename Params, typename SP>
+void wavefront_sched<R>::frame(pathtracing::kernel<Params> kernel, SP sched_params)
+{
+    using namespace wavefront_sched_impl;
+
+    using S = typename R::scalar_type;
+    using I = simd::int_type_t<S>;
+    using M = simd::mask_type_t<S>;
+    using V = vector<3, S>;
+    using C = spectrum<S>;
+
+    static_assert(simd::is_simd_vector<S>::value, "wavefront_sched requires SIMD ray packets");
+
+    static size_t const lanes = simd::num_elements<S>::value;
+
+    Params const& params = kernel.params;
+
+    auto&& isect = get_intersector(
+            sched_params,
+            typename detail::sched_params_has_intersector<SP>::type()
+            );
+
+    // Scalar hit record as returned by closest_hit()
+    using hit_record_type = typename decltype(
+            simd::unpack(closest_hit(std::declval<R>(), params.prims.begin, params.prims.end, isect))
+            )::value_type;
+
+    sched_params.cam.begin_frame();
+
+    sched_params.rt.begin_frame();
+
+    int x0 = sched_params.scissor_box.x;
+    int y0 = sched_params.scissor_box.y;
+    int w  = sched_params.scissor_box.w;
+    int h  = sched_params.scissor_box.h;
+
+    size_t num_paths = static_cast<size_t>(std::max(w, 0) * std::max(h, 0));
+
+    rays_.resize(num_paths);
+    throughput_.resize(num_paths);
+    intensity_.resize(num_paths);
+    last_specular_.resize(num_paths);
+    alive_.resize(num_paths);
+    results_.resize(num_paths);
+    shadow_rays_.resize(num_paths);
+    shadow_max_t_.resize(num_paths);
+    shadow_contrib_.resize(num_paths);
+    active_.resize(num_paths);
+
+    auto& hits = hits_.get<hit_record_type>();
+    hits.resize(num_paths);
+
+    size_t const chunk_size = lanes * ChunkPackets;
+
+    unsigned frame_num = frame_num_++;
+
+    auto num_lights = params.lights.end - params.lights.begin;
+    float eps = params.epsilon;
+
+
+    // Generate primary rays
+
+    for_each_chunk(num_paths, chunk_size, [&](size_t first, size_t last)
+    {
+        auto gen = make_generator(
+                float{},
+                sched_params.sample_params,
+                make_seed(frame_num, 0, first)
+                );
+
+        for (size_t p = first; p != last; ++p)
+        {
+            int x = x0 + static_cast<int>(p % w);
+            int y = y0 + static_cast<int>(p / w);
+
+            rays_[p] = detail::make_primary_rays(
+                    basic_ray<float>{},
+                    sched_params.sample_params,
+                    gen,
+                    x,
+                    y,
+                    sched_params.rt.width(),
+                    sched_params.rt.height(),
+                    sched_params.cam
+                    );
+
+            throughput_[p]      = color_type(1.0f);
+            intensity_[p]       = color_type(0.0f);
+            last_specular_[p]   = 1.0f;
+            results_[p]         = result_record<float>();
+            results_[p].hit     = false;
+            results_[p].color   = params.bg_color;
+
+            active_[p] = static_cast<unsigned>(p);
+        }
+    });
+
+    for (unsigned bounce = 0; bounce < params.num_bounces && !active_.empty(); ++bounce)
+    {
+        // Extend: trace the active paths, terminate misses
+
+        chunk_max_keys_.resize(div_up(active_.size(), chunk_size));
+
+        for_each_chunk(active_.size(), chunk_size, [&](size_t first, size_t last)
+        {
+            // Largest material key of the chunk, used to size the sort
+            int max_key = -1;
+
+            for (size_t k = first; k < last; k += lanes)
+            {
+                size_t count = std::min(last - k, lanes);
+
+                // Pad with the last path
+                array<basic_ray<float>, lanes> rays;
+
+                for (size_t i = 0; i < lanes; ++i)
+                {
+                    rays[i] = rays_[active_[k + std::min(i, count - 1)]];
+                }
+
+                auto hrs = simd::unpack(closest_hit(simd::pack(rays), params.prims.begin, params.prims.end, isect));
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    unsigned p = active_[k + i];
+
+                    hrs[i].isect_pos = rays[i].ori + rays[i].dir * hrs[i].t;
+                    hits[p] = hrs[i];
+
+                    if (!hrs[i].hit)
+                    {
+                        intensity_[p] += color_type(from_rgba(params.ambient_color)) * throughput_[p];
+                    }
+                    else
+                    {
+                        max_key = std::max(max_key, static_cast<int>(hrs[i].geom_id));
+
+                        if (bounce == 0)
+                        {
+                            results_[p].hit = true;
+                            results_[p].isect_pos = hrs[i].isect_pos;
+                        }
+                    }
+                }
+            }
+
+            chunk_max_keys_[first / chunk_size] = max_key;
+        });
+
+
+        // Sort the hits by material (geom_id), drop the misses
+
+        int max_key = -1;
+
+        for (int key : chunk_max_keys_)
+        {
+            max_key = std::max(max_key, key);
+        }
+
+        auto is_hit = [&](unsigned p) { return static_cast<bool>(hits[p].hit); };
+        auto geom_id = [&](unsigned p) { return static_cast<int>(hits[p].geom_id); };
+
+        sort_temp_.resize(active_.size());
+        shade_.resize(active_.size());
+
+        if (max_key < 0)
+        {
+            shade_.clear();
+        }
+        else if (static_cast<size_t>(max_key) < active_.size() + 1024)
+        {
+            auto last = paralgo::copy_if(*pool_, active_.begin(), active_.end(), sort_temp_.begin(), is_hit);
+
+            shade_.resize(last - sort_temp_.begin());
+            sort_counts_.resize(max_key + 1);
+
+            paralgo::counting_sort(*pool_, sort_temp_.begin(), last, shade_.begin(), sort_counts_, geom_id);
+        }
+        else
+        {
+            // Sparse keys, sort by the significant bits only
+            auto last = paralgo::copy_if(*pool_, active_.begin(), active_.end(), shade_.begin(), is_hit);
+
+            shade_.resize(last - shade_.begin());
+
+            unsigned num_bits = 0;
+
+            while (num_bits < 32 && (static_cast<unsigned>(max_key) >> num_bits) != 0)
+            {
+                ++num_bits;
+            }
+
+            paralgo::radix_sort(*pool_, shade_.begin(), shade_.end(), sort_temp_.begin(), num_bits, geom_id);
+        }
+
+
+        // Shade: sample materials, emit shadow rays
+
+        for_each_chunk(shade_.size(), chunk_size, [&](size_t first, size_t last)
+        {
+            for (size_t k = first; k < last; k += lanes)
+            {
+                size_t count = std::min(last - k, lanes);
+
+                array<unsigned, lanes> seeds;
+                array<basic_ray<float>, lanes> rays;
+                array<vec3, lanes> isect_positions;
+                array<color_type, lanes> throughputs;
+                array<hit_record_type, lanes> hrs;
+                simd::aligned_array_t<S> last_specular_arr;
+                simd::aligned_array_t<S> lane_arr;
+
+                typename detail::simd_decl_surface<Params, S>::array_type surfs;
+
+                for (size_t i = 0; i < lanes; ++i)
+                {
+                    unsigned p = shade_[k + std::min(i, count - 1)];
+
+                    seeds[i]                = make_seed(frame_num, bounce + 1, k + i);
+                    rays[i]                 = rays_[p];
+                    hrs[i]                  = hits[p];
+                    isect_positions[i]      = hits[p].isect_pos;
+                    throughputs[i]          = throughput_[p];
+                    last_specular_arr[i]    = last_specular_[p];
+                    lane_arr[i]             = static_cast<float>(i);
+
+                    surfs[i] = get_surface(hrs[i], params);
+                }
+
+                random_generator<S> gen(seeds);
+
+                R ray = simd::pack(rays);
+                V isect_pos = simd::pack(isect_positions);
+                C throughput = pack_spectrum(throughputs);
+                auto surf = simd::pack(surfs);
+
+                M active_rays = S(lane_arr) < S(static_cast<float>(count));
+                M last_specular = S(last_specular_arr) > S(0.0);
+
+                C intensity(0.0);
+
+                V refl_dir(0.0);
+                V view_dir = -ray.dir;
+
+                S brdf_pdf(0.0);
+
+                I inter = 0;
+                auto src = surf.sample(view_dir, refl_dir, brdf_pdf, inter, gen);
+
+                auto zero_pdf = brdf_pdf <= S(0.0);
+
+                S mis_weight = pathtracing::emission_mis_weight(
+                    bounce > 0 && !last_specular,
+                    brdf_pdf,
+                    inter,
+                    ray.ori,
+                    isect_pos,
+                    surf,
+                    [&]()
+                    {
+                        simd::aligned_array_t<S> areas;
+
+                        for (size_t i = 0; i < lanes; ++i)
+                        {
+                            areas[i] = get_area(params.prims.begin, hrs[i], isect);
+                        }
+
+                        return S(areas);
+                    },
+                    static_cast<int>(num_lights)
+                    );
+
+                intensity += select(
+                    active_rays && inter == surface_interaction::Emission,
+                    mis_weight * throughput * src,
+                    C(0.0)
+                    );
+
+                active_rays &= inter != surface_interaction::Emission;
+                active_rays &= !zero_pdf;
+
+                auto n = surf.shading_normal;
+                n = faceforward( n, view_dir, surf.geometric_normal );
+
+                M has_shadow_ray(false);
+
+                if (num_lights > 0)
+                {
+                    auto ls = pathtracing::sample_light(
+                            ray,
+                            isect_pos,
+                            n,
+                            surf,
+                            inter,
+                            throughput,
+                            params.lights.begin,
+                            params.lights.end,
+                            eps,
+                            gen
+                            );
+
+                    has_shadow_ray = active_rays && ls.valid;
+
+                    auto contrib = select(has_shadow_ray, ls.contrib, C(0.0));
+
+                    auto shadow_rays = simd::unpack(ls.shadow_ray);
+                    simd::aligned_array_t<S> max_t;
+                    store(max_t, ls.max_t);
+                    auto contribs = unpack_spectrum(contrib);
+
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        unsigned p = shade_[k + i];
+
+                        shadow_rays_[p]     = shadow_rays[i];
+                        shadow_max_t_[p]    = max_t[i];
+                        shadow_contrib_[p]  = contribs[i];
+                    }
+                }
+
+                throughput *= src * (dot(n, refl_dir) / brdf_pdf);
+                throughput = select(zero_pdf, C(0.0), throughput);
+
+                if (bounce >= 2)
+                {
+                    pathtracing::russian_roulette(throughput, active_rays, gen);
+                }
+
+                ray.ori = isect_pos + refl_dir * S(eps);
+                ray.dir = refl_dir;
+
+                last_specular = inter == surface_interaction::SpecularReflection ||
+                                inter == surface_interaction::SpecularTransmission;
+
+
+                // Write back
+
+                auto next_rays = simd::unpack(ray);
+                auto throughputs_out = unpack_spectrum(throughput);
+                auto intensities = unpack_spectrum(intensity);
+                auto alive = mask_to_array(active_rays);
+                auto specular = mask_to_array(last_specular);
+                auto shadow = mask_to_array(has_shadow_ray);
+
+                for (size_t i = 0; i < count; ++i)
+                {
+                    unsigned p = shade_[k + i];
+
+                    rays_[p]            = next_rays[i];
+                    throughput_[p]      = throughputs_out[i];
+                    intensity_[p]      += intensities[i];
+                    last_specular_[p]   = specular[i] ? 1.0f : 0.0f;
+                    alive_[p]           = alive[i] != 0;
+
+                    if (!shadow[i])
+                    {
+                        shadow_max_t_[p] = -1.0f;
+                    }
+                }
+            }
+        });
+
+
+        // Shadow: compact the shadow rays, add light where unoccluded
+
+        if (num_lights > 0)
+        {
+            shadow_queue_.resize(shade_.size());
+
+            auto queue_end = paralgo::copy_if(
+                    *pool_,
+                    shade_.begin(),
+                    shade_.end(),
+                    shadow_queue_.begin(),
+                    [&](unsigned p) { return shadow_max_t_[p] >= 0.0f; }
+                    );
+
+            shadow_queue_.resize(queue_end - shadow_queue_.begin());
+
+            for_each_chunk(shadow_queue_.size(), chunk_size, [&](size_t first, size_t last)
+            {
+                for (size_t k = first; k < last; k += lanes)
+                {
+                    size_t count = std::min(last - k, lanes);
+
+                    array<basic_ray<float>, lanes> rays;
+                    simd::aligned_array_t<S> max_t;
+
+                    for (size_t i = 0; i < lanes; ++i)
+                    {
+                        unsigned p = shadow_queue_[k + std::min(i, count - 1)];
+
+                        rays[i] = shadow_rays_[p];
+                        max_t[i] = shadow_max_t_[p];
+                    }
+
+                    auto shadowed = mask_to_array(
+                            occluded(simd::pack(rays), params.prims.begin, params.prims.end, S(max_t), isect)
+                            );
+
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        unsigned p = shadow_queue_[k + i];
+
+                        if (!shadowed[i])
+                        {
+                            intensity_[p] += shadow_contrib_[p];
+                        }
+                    }
+                }
+            });
+        }
+
+
+        // Compact the queue of active paths
+
+        active_.resize(shade_.size());
+
+        auto queue_end = paralgo::copy_if(*pool_, shade_.begin(), shade_.end(), active_.begin(), [&](unsigned p)
+        {
+            return alive_[p] != 0;
+        });
+
+        active_.resize(queue_end - active_.begin());
+    }
+
+
+    // Resolve: write the results to the render target
+
+    for_each_chunk(num_paths, chunk_size, [&](size_t first, size_t last)
+    {
+        resolve_kernel resolve{ results_.data(), x0, y0, w };
+
+        auto gen = make_generator(
+                float{},
+                sched_params.sample_params,
+                make_seed(frame_num, ~0U, first)
+                );
+
+        for (size_t p = first; p != last; ++p)
+        {
+            if (results_[p].hit)
+            {
+                results_[p].color = to_rgba(intensity_[p]);
+            }
+
+            int x = x0 + static_cast<int>(p % w);
+            int y = y0 + static_cast<int>(p / w);
+
+            sample_pixel(
+                    resolve,
+                    sched_params.sample_params,
+                    rays_[p],
+                    gen,
+                    sched_params.rt.ref(),
+                    x,
+                    y,
+                    sched_params.rt.width(),
+                    sched_params.rt.height(),
+                    sched_params.cam
+                    );
+        }
+    });
+
+    sched_params.rt.end_frame();
+
+    sched_params.cam.end_frame();
+}
+
+} // visionaray
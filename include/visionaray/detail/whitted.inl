@@ -271,11 +271,12 @@ struct kernel
 
                 R shadow_ray(
                         hit_rec.isect_pos + light_dir * S(params.epsilon),
-                        light_dir
+                        light_dir,
+                        ray.time
                         );
 
                 // only cast a shadow if occluder between light source and hit pos
-                auto shadow_rec = any_hit(
+                auto shadowed = occluded(
                         shadow_ray,
                         params.prims.begin,
                         params.prims.end,
@@ -284,7 +285,7 @@ struct kernel
                         );
 
                 shaded_clr += select(
-                        hit_rec.hit & !shadow_rec.hit,
+                        hit_rec.hit & !shadowed,
                         clr,
                         C(0.0)
                         );
@@ -299,7 +300,8 @@ struct kernel
                 auto dir = bounce.reflected_dir;
                 ray = R(
                     hit_rec.isect_pos + dir * S(params.epsilon),
-                    dir
+                    dir,
+                    ray.time
                     );
                 hit_rec = closest_hit(ray, params.prims.begin, params.prims.end, isect);
             }
@@ -12,7 +12,9 @@
 
 #include "detail/macros.h"
 #include "math/simd/type_traits.h"
+#include "math/indexed_triangle.h"
 #include "bvh.h"
+#include "intersector.h"
 
 namespace visionaray
 {
@@ -32,32 +34,58 @@ inline vector<3, U> sample_surface(P, Generator&)
 }
 #endif
 
+namespace detail
+{
+
+// Indexed triangles are looked up in the vertex array of the intersector
+// they were traversed with
+
+template <typename Primitive, typename Intersector>
+VSNRAY_FUNC
+inline auto primitive_area(Primitive const& prim, Intersector const& /* isect */)
+    -> decltype( area(prim) )
+{
+    return area(prim);
+}
+
+template <typename T, typename P, typename Intersector>
+VSNRAY_FUNC
+inline auto primitive_area(basic_indexed_triangle<T, P> const& prim, Intersector const& isect)
+    -> decltype( area(prim, isect.vertices) )
+{
+    return area(prim, isect.vertices);
+}
+
+} // detail
+
 // No BVH, no SIMD
 template <
     typename Primitives,
     typename HR,
+    typename Intersector,
     typename Primitive = typename std::iterator_traits<Primitives>::value_type,
     typename = typename std::enable_if<!is_any_bvh<Primitive>::value>::type,
     typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
     >
 VSNRAY_FUNC
-inline auto get_area(Primitives const& prims, HR const& hr)
-    -> decltype(area(std::declval<Primitive>()))
+inline auto get_area(Primitives const& prims, HR const& hr, Intersector const& isect)
+    -> decltype(detail::primitive_area(std::declval<Primitive>(), isect))
 {
-    return area(prims[hr.prim_id]);
+    return detail::primitive_area(prims[hr.prim_id], isect);
 }
 
 // No BVH, SIMD
 template <
     typename Primitives,
     typename HR,
+    typename Intersector,
     typename Primitive = typename std::iterator_traits<Primitives>::value_type,
     typename = typename std::enable_if<!is_any_bvh<Primitive>::value>::type,
     typename = typename std::enable_if<simd::is_simd_vector<typename HR::scalar_type>::value>::type,
     typename = void
     >
 VSNRAY_FUNC
-inline auto get_area(Primitives const& prims, HR const& hr)
+inline auto get_area(Primitives const& prims, HR const& hr, Intersector const& isect)
     -> typename HR::scalar_type
 {
     using T = typename HR::scalar_type;
@@ -71,7 +99,7 @@ inline auto get_area(Primitives const& prims, HR const& hr)
 
     for (size_t i = 0; i < simd::num_elements<T>::value; ++i)
     {
-        result[i] = area(prims[prim_id[i]]);
+        result[i] = detail::primitive_area(prims[prim_id[i]], isect);
     }
 
     return T(result);
@@ -81,6 +109,7 @@ inline auto get_area(Primitives const& prims, HR const& hr)
 template <
     typename Primitives,
     typename HR,
+    typename Intersector,
     typename Primitive = typename std::iterator_traits<Primitives>::value_type,
     typename = typename std::enable_if<is_any_bvh<Primitive>::value>::type,
     typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type,
@@ -88,8 +117,8 @@ template <
     typename = void
     >
 VSNRAY_FUNC
-inline auto get_area(Primitives const& prims, HR const& hr)
-    -> decltype(area(std::declval<typename Primitive::primitive_type>()))
+inline auto get_area(Primitives const& prims, HR const& hr, Intersector const& isect)
+    -> decltype(detail::primitive_area(std::declval<typename Primitive::primitive_type>(), isect))
 {
     // Find the BVH that contains prim_id
     size_t num_primitives_total = 0;
@@ -100,19 +129,20 @@ inline auto get_area(Primitives const& prims, HR const& hr)
         num_primitives_total += prims[i++].num_primitives();
     }
 
-    return area(prims[i].primitive(hr.primitive_list_index));
+    return detail::primitive_area(prims[i].primitive(hr.primitive_list_index), isect);
 }
 
 // BVH, SIMD
 template <
     typename Primitives,
     typename HR,
+    typename Intersector,
     typename Primitive = typename std::iterator_traits<Primitives>::value_type,
     typename = typename std::enable_if<is_any_bvh<Primitive>::value && !is_any_bvh_inst<typename Primitive::primitive_type>::value>::type,
     typename = typename std::enable_if<simd::is_simd_vector<typename HR::scalar_type>::value>::type
     >
 VSNRAY_FUNC
-inline auto get_area(Primitives const& prims, HR const& hr)
+inline auto get_area(Primitives const& prims, HR const& hr, Intersector const& isect)
     -> typename HR::scalar_type
 {
     using T = typename HR::scalar_type;
@@ -137,7 +167,7 @@ inline auto get_area(Primitives const& prims, HR const& hr)
         {
             num_primitives_total += prims[j++].num_primitives();
         }
-        result[i] = area(prims[j].primitive(primitive_list_index[i]));
+        result[i] = detail::primitive_area(prims[j].primitive(primitive_list_index[i]), isect);
     }
 
     return T(result);
@@ -147,32 +177,34 @@ inline auto get_area(Primitives const& prims, HR const& hr)
 template <
     typename Primitives,
     typename HR,
+    typename Intersector,
     typename Primitive = typename std::iterator_traits<Primitives>::value_type,
     typename = typename std::enable_if<is_any_bvh<Primitive>::value && is_any_bvh_inst<typename Primitive::primitive_type>::value>::type,
     typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
     >
 VSNRAY_FUNC
-inline auto get_area(Primitives const& prims, HR const& hr, void* = nullptr)
+inline auto get_area(Primitives const& prims, HR const& hr, Intersector const& isect, void* = nullptr)
     -> typename HR::scalar_type
 {
     auto& b = prims[0]; // TODO: currently only two levels supported (i.e. one top-level BVH)
 
     auto& inst = b.primitive(hr.primitive_list_index);
 
-    return area(inst.primitive(hr.primitive_list_index_inst));
+    return detail::primitive_area(inst.primitive(hr.primitive_list_index_inst), isect);
 }
 
 // BVH instance, SIMD
 template <
     typename Primitives,
     typename HR,
+    typename Intersector,
     typename Primitive = typename std::iterator_traits<Primitives>::value_type,
     typename = typename std::enable_if<is_any_bvh<Primitive>::value && is_any_bvh_inst<typename Primitive::primitive_type>::value>::type,
     typename = typename std::enable_if<simd::is_simd_vector<typename HR::scalar_type>::value>::type,
     typename = void
     >
 VSNRAY_FUNC
-inline auto get_area(Primitives const& prims, HR const& hr, void* = nullptr)
+inline auto get_area(Primitives const& prims, HR const& hr, Intersector const& isect, void* = nullptr)
     -> typename HR::scalar_type
 {
     using T = typename HR::scalar_type;
@@ -196,12 +228,21 @@ inline auto get_area(Primitives const& prims, HR const& hr, void* = nullptr)
 
         auto& inst = b.primitive(primitive_list_index[i]);
 
-        result[i] = area(inst.primitive(primitive_list_index_inst[i]));
+        result[i] = detail::primitive_area(inst.primitive(primitive_list_index_inst[i]), isect);
     }
 
     return T(result);
 }
 
+// Primitives that don't depend on the intersector
+template <typename Primitives, typename HR>
+VSNRAY_FUNC
+inline auto get_area(Primitives const& prims, HR const& hr)
+    -> decltype( get_area(prims, hr, default_intersector{}) )
+{
+    return get_area(prims, hr, default_intersector{});
+}
+
 } // visionaray
 
 #endif // VSNRAY_GET_AREA_H
@@ -12,8 +12,10 @@
 #include "detail/macros.h"
 #include "math/simd/type_traits.h"
 #include "math/array.h"
+#include "math/indexed_triangle.h"
 #include "math/triangle.h"
 #include "math/vector.h"
+#include "math/woop_triangle.h"
 #include "tags.h"
 
 namespace visionaray
@@ -207,6 +209,53 @@ inline auto get_color(
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Woop triangle, colors per vertex
+//
+
+template <typename Colors, typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_color(
+        Colors                      colors,
+        HR const&                   hr,
+        basic_woop_triangle<T>      /* */,
+        colors_per_vertex_binding   /* */
+        )
+    -> decltype(get_color(colors, hr, basic_triangle<3, T>{}, colors_per_vertex_binding{}))
+{
+    return get_color(colors, hr, basic_triangle<3, T>{}, colors_per_vertex_binding{});
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Indexed triangle, colors per vertex are looked up with the vertex indices
+//
+
+template <
+    typename Colors,
+    typename HR,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_color(
+        Colors                              colors,
+        HR const&                           hr,
+        basic_indexed_triangle<T> const&    triangle,
+        colors_per_vertex_binding           /* */
+        )
+    -> typename std::iterator_traits<Colors>::value_type
+{
+    return lerp(
+            colors[triangle.i1],
+            colors[triangle.i2],
+            colors[triangle.i3],
+            hr.u,
+            hr.v
+            );
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Gather N vertex colors from array
 //
@@ -12,10 +12,14 @@
 
 #include "detail/macros.h"
 #include "math/simd/type_traits.h"
+#include "math/curve.h"
+#include "math/indexed_triangle.h"
+#include "math/motion_triangle.h"
 #include "math/plane.h"
 #include "math/sphere.h"
 #include "math/triangle.h"
 #include "math/vector.h"
+#include "math/woop_triangle.h"
 #include "prim_traits.h"
 #include "tags.h"
 
@@ -116,6 +120,101 @@ inline vector<3, T> get_normal(HR const& hr, basic_triangle<3, T> const& triangl
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Woop triangles use the same per-face data layout as triangles
+//
+
+template <typename Normals, typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_normal(
+        Normals                     normals,
+        HR const&                   hr,
+        basic_woop_triangle<T>      /* */
+        )
+    -> decltype(get_normal(normals, hr, basic_triangle<3, T>{}))
+{
+    return get_normal(normals, hr, basic_triangle<3, T>{});
+}
+
+template <typename HR, typename T>
+VSNRAY_FUNC
+inline vector<3, T> get_normal(HR const& hr, basic_woop_triangle<T> const& triangle)
+{
+    VSNRAY_UNUSED(hr);
+
+    return normalize(triangle.plane_n.xyz());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Indexed triangles use the same per-face data layout as triangles, the
+// geometric normal is computed from the shared VERTICES
+//
+
+template <typename Normals, typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_normal(
+        Normals                     normals,
+        HR const&                   hr,
+        basic_indexed_triangle<T>   /* */
+        )
+    -> decltype(get_normal(normals, hr, basic_triangle<3, T>{}))
+{
+    return get_normal(normals, hr, basic_triangle<3, T>{});
+}
+
+template <typename HR, typename T>
+VSNRAY_FUNC
+inline vector<3, T> get_normal(
+        HR const&                           hr,
+        basic_indexed_triangle<T> const&    triangle,
+        vector<3, T> const*                 vertices
+        )
+{
+    VSNRAY_UNUSED(hr);
+
+    vector<3, T> v1 = vertices[triangle.i1];
+
+    return normalize(cross(vertices[triangle.i2] - v1, vertices[triangle.i3] - v1));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Get normal of motion triangle at the time of the hit
+//
+
+template <typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_normal(HR const& hr, basic_motion_triangle<T> const& triangle)
+    -> vector<3, typename HR::scalar_type>
+{
+    auto tri = interpolate(triangle, get_time(triangle, hr.isect_pos, hr.u, hr.v));
+
+    return normalize(cross(tri.e1, tri.e2));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Get normal on curve (tube) surface
+//
+
+template <typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_normal(HR const& hr, basic_curve<T> const& curve)
+    -> vector<3, typename HR::scalar_type>
+{
+    using S = typename HR::scalar_type;
+
+    auto tangent = curve_tangent(curve, hr.u);
+    auto n = hr.isect_pos - curve_point(curve, hr.u).xyz();
+
+    // Remove the component along the axis
+    n -= tangent * (dot(n, tangent) / max(dot(tangent, tangent), numeric_limits<S>::min()));
+
+    return normalize(n);
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Get normal from plane primitive
 //
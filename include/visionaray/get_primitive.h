@@ -13,6 +13,60 @@
 
 namespace visionaray
 {
+namespace detail
+{
+
+//-------------------------------------------------------------------------------------------------
+// Primitive type of (nested) instances
+//
+
+template <typename P, typename = void>
+struct inst_primitive
+{
+    using type = P;
+};
+
+template <typename P>
+struct inst_primitive<P, typename std::enable_if<is_any_bvh_inst<P>::value>::type>
+{
+    using type = typename inst_primitive<typename P::primitive_type>::type;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Primitive of a hit in a (nested) instance, HR is the hit record of the instance
+//
+
+template <
+    typename Inst,
+    typename HR,
+    typename = typename std::enable_if<!is_any_bvh_inst<typename Inst::primitive_type>::value>::type
+    >
+VSNRAY_FUNC
+inline typename inst_primitive<Inst>::type const& get_inst_primitive(Inst const& inst, HR const& hr)
+{
+    return inst.primitive(hr.primitive_list_index_inst);
+}
+
+template <
+    typename Inst,
+    typename HR,
+    typename = typename std::enable_if<is_any_bvh_inst<typename Inst::primitive_type>::value>::type,
+    typename = void
+    >
+VSNRAY_FUNC
+inline typename inst_primitive<Inst>::type const& get_inst_primitive(Inst const& inst, HR const& hr)
+{
+    using Base = typename HR::base_type;
+
+    return get_inst_primitive(
+            inst.primitive(hr.primitive_list_index_inst),
+            static_cast<Base const&>(hr)
+            );
+}
+
+} // detail
+
 
 //-------------------------------------------------------------------------------------------------
 // Get primitive from params
@@ -63,10 +117,13 @@ template <
     >
 VSNRAY_FUNC
 inline auto get_primitive(Params const& params, HR const& hr)
-    -> typename P::primitive_type::primitive_type const&
+    -> typename detail::inst_primitive<typename P::primitive_type>::type const&
 {
     // Assume we only have one top-level BVH (TODO?)
-    return params.prims.begin[0].primitive(hr.primitive_list_index).primitive(hr.primitive_list_index_inst);
+    return detail::get_inst_primitive(
+            params.prims.begin[0].primitive(hr.primitive_list_index),
+            static_cast<Base const&>(hr)
+            );
 }
 
 } // visionaray
@@ -13,7 +13,9 @@
 #include "detail/macros.h"
 #include "math/detail/math.h"
 #include "math/simd/type_traits.h"
+#include "math/indexed_triangle.h"
 #include "math/triangle.h"
+#include "math/woop_triangle.h"
 #include "get_normal.h"
 #include "prim_traits.h"
 #include "tags.h"
@@ -175,6 +177,55 @@ inline auto get_shading_normal(
     return normalize( lerp(n1, n2, n3, hr.u, hr.v) );
 }
 
+
+//-------------------------------------------------------------------------------------------------
+// get_shading_normal for woop triangles with normals_per_vertex_binding
+//
+
+template <typename Normals, typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_shading_normal(
+        Normals                     normals,
+        HR const&                   hr,
+        basic_woop_triangle<T>      /* */,
+        normals_per_vertex_binding  /* */
+        )
+    -> decltype(get_shading_normal(normals, hr, basic_triangle<3, T>{}, normals_per_vertex_binding{}))
+{
+    return get_shading_normal(normals, hr, basic_triangle<3, T>{}, normals_per_vertex_binding{});
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// get_shading_normal for indexed triangles with normals_per_vertex_binding
+//
+// Normals are shared like the vertices and looked up with the vertex indices
+//
+
+template <
+    typename Normals,
+    typename HR,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_shading_normal(
+        Normals                             normals,
+        HR const&                           hr,
+        basic_indexed_triangle<T> const&    triangle,
+        normals_per_vertex_binding          /* */
+        )
+    -> typename std::iterator_traits<Normals>::value_type
+{
+    return normalize( lerp(
+            normals[triangle.i1],
+            normals[triangle.i2],
+            normals[triangle.i3],
+            hr.u,
+            hr.v
+            ) );
+}
+
 } // visionaray
 
 #endif // VSNRAY_GET_SHADING_NORMAL_H
@@ -10,6 +10,7 @@
 #include <utility>
 
 #include "math/array.h"
+#include "math/indexed_triangle.h"
 #include "texture/texture_traits.h"
 #include "bvh.h"
 #include "get_color.h"
@@ -51,6 +52,27 @@ public:
 };
 
 
+// geometric normal ---------------------------------------
+
+// From the per-face normals if present, otherwise from the primitive
+template <typename Normals, typename HR, typename Primitive>
+VSNRAY_FUNC
+inline auto get_geometric_normal(Normals normals, HR const& hr, Primitive const& prim)
+    -> decltype( get_normal(normals, hr, prim) )
+{
+    return normals ? get_normal(normals, hr, prim) : get_normal(hr, prim);
+}
+
+// Indexed triangles don't know their vertices, per-face normals are required
+template <typename Normals, typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_geometric_normal(Normals normals, HR const& hr, basic_indexed_triangle<T> const& prim)
+    -> decltype( get_normal(normals, hr, prim) )
+{
+    return get_normal(normals, hr, prim);
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Sample textures
 //
@@ -144,7 +166,7 @@ inline auto get_surface_impl(HR const& hr, Params const& params)
     auto const& gns = params.geometric_normals;
     auto const& sns = params.shading_normals;
 
-    auto gn    = gns ? get_normal(gns, hr, prim) : get_normal(hr, prim);
+    auto gn    = get_geometric_normal(gns, hr, prim);
     auto sn    = sns ? get_shading_normal(sns, hr, prim, typename Params::normal_binding{}) : gn;
     auto color = params.colors ? get_color(params.colors, hr, prim, typename Params::color_binding{}) : C(1.0);
     auto tc    = params.tex_coords && params.textures ? get_tex_color(
@@ -14,9 +14,12 @@
 #include "math/simd/type_traits.h"
 #include "math/array.h"
 #include "math/constants.h"
+#include "math/curve.h"
+#include "math/indexed_triangle.h"
 #include "math/sphere.h"
 #include "math/triangle.h"
 #include "math/vector.h"
+#include "math/woop_triangle.h"
 
 
 namespace visionaray
@@ -114,6 +117,43 @@ inline auto get_tex_coord(TexCoords tex_coords, HR const& hr, basic_triangle<3,
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Woop triangle, same tex coord layout as triangle
+//
+
+template <typename TexCoords, typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_tex_coord(TexCoords tex_coords, HR const& hr, basic_woop_triangle<T> /* */)
+    -> decltype(get_tex_coord(tex_coords, hr, basic_triangle<3, T>{}))
+{
+    return get_tex_coord(tex_coords, hr, basic_triangle<3, T>{});
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Indexed triangle, tex coords are looked up with the vertex indices
+//
+
+template <
+    typename TexCoords,
+    typename HR,
+    typename T,
+    typename = typename std::enable_if<!simd::is_simd_vector<typename HR::scalar_type>::value>::type
+    >
+VSNRAY_FUNC
+inline auto get_tex_coord(TexCoords tex_coords, HR const& hr, basic_indexed_triangle<T> const& triangle)
+    -> typename std::iterator_traits<TexCoords>::value_type
+{
+    return lerp(
+            tex_coords[triangle.i1],
+            tex_coords[triangle.i2],
+            tex_coords[triangle.i3],
+            hr.u,
+            hr.v
+            );
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Sphere
 //
@@ -138,6 +178,19 @@ inline auto get_tex_coord(HR const& hr, basic_sphere<T> const& sphere)
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Curve, parameter along the curve and distance from the axis
+//
+
+template <typename HR, typename T>
+VSNRAY_FUNC
+inline auto get_tex_coord(HR const& hr, basic_curve<T> const& /* */)
+    -> vector<2, typename HR::scalar_type>
+{
+    return vector<2, typename HR::scalar_type>(hr.u, hr.v);
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Gather N texture coordinates from array
 //
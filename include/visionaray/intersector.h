@@ -11,6 +11,10 @@
 
 #include "detail/macros.h"
 #include "detail/tags.h"
+#include "math/indexed_triangle.h"
+#include "math/intersect.h"
+#include "math/triangle.h"
+#include "math/vector.h"
 #include "bvh.h"
 
 namespace visionaray
@@ -19,8 +23,10 @@ namespace visionaray
 //-------------------------------------------------------------------------------------------------
 // Base type for custom intersectors
 //
+// BVHTraversal selects the BVH traversal strategy, cf. bvh_traversal
+//
 
-template <typename Derived>
+template <typename Derived, typename BVHTraversal = default_bvh_traversal>
 struct basic_intersector
 {
     template <size_t N>
@@ -41,9 +47,9 @@ struct basic_intersector
     template <typename R, typename P, typename = typename std::enable_if<is_any_bvh<P>::value>::type>
     VSNRAY_FUNC
     auto operator()(R const& ray, P const& prim)
-        -> decltype( intersect(ray, prim, std::declval<Derived&>()) )
+        -> decltype( intersect<detail::ClosestHit, 1, BVHTraversal>(ray, prim, std::declval<Derived&>()) )
     {
-        return intersect(ray, prim, *static_cast<Derived*>(this));
+        return intersect<detail::ClosestHit, 1, BVHTraversal>(ray, prim, *static_cast<Derived*>(this));
     }
 
 
@@ -64,9 +70,9 @@ struct basic_intersector
             typename R::scalar_type max_t,
             Cond                    update_cond = Cond()
             )
-        -> decltype( intersect<detail::AnyHit>(ray, prim, std::declval<Derived&>(), max_t, update_cond) )
+        -> decltype( intersect<detail::AnyHit, 1, BVHTraversal>(ray, prim, std::declval<Derived&>(), max_t, update_cond) )
     {
-        return intersect<detail::AnyHit>(ray, prim, *static_cast<Derived*>(this), max_t, update_cond);
+        return intersect<detail::AnyHit, 1, BVHTraversal>(ray, prim, *static_cast<Derived*>(this), max_t, update_cond);
     }
 
 
@@ -87,9 +93,9 @@ struct basic_intersector
             typename R::scalar_type max_t,
             Cond                    update_cond = Cond()
             )
-        -> decltype( intersect<detail::ClosestHit>(ray, prim, std::declval<Derived&>(), max_t, update_cond) )
+        -> decltype( intersect<detail::ClosestHit, 1, BVHTraversal>(ray, prim, std::declval<Derived&>(), max_t, update_cond) )
     {
-        return intersect<detail::ClosestHit>(ray, prim, *static_cast<Derived*>(this), max_t, update_cond);
+        return intersect<detail::ClosestHit, 1, BVHTraversal>(ray, prim, *static_cast<Derived*>(this), max_t, update_cond);
     }
 
 
@@ -111,9 +117,9 @@ struct basic_intersector
             typename R::scalar_type max_t,
             Cond                    update_cond = Cond()
             )
-        -> decltype( intersect<detail::MultiHit, N>(ray, prim, std::declval<Derived&>(), max_t, update_cond) )
+        -> decltype( intersect<detail::MultiHit, N, BVHTraversal>(ray, prim, std::declval<Derived&>(), max_t, update_cond) )
     {
-        return intersect<detail::MultiHit, N>(ray, prim, *static_cast<Derived*>(this), max_t, update_cond);
+        return intersect<detail::MultiHit, N, BVHTraversal>(ray, prim, *static_cast<Derived*>(this), max_t, update_cond);
     }
 };
 
@@ -126,6 +132,92 @@ struct default_intersector : basic_intersector<default_intersector>
 {
 };
 
+
+//-------------------------------------------------------------------------------------------------
+// Indexed triangle intersector
+//
+// Intersects basic_indexed_triangle primitives with the shared vertex array
+// passed on construction, which must be accessible where the rays are traced
+// (i.e. a device pointer for GPU traversal). Other primitives use intersect().
+//
+
+template <typename BVHTraversal = default_bvh_traversal>
+struct basic_indexed_triangle_intersector
+    : basic_intersector<basic_indexed_triangle_intersector<BVHTraversal>, BVHTraversal>
+{
+    using basic_intersector<basic_indexed_triangle_intersector<BVHTraversal>, BVHTraversal>::operator();
+
+    basic_indexed_triangle_intersector() = default;
+
+    VSNRAY_FUNC
+    explicit basic_indexed_triangle_intersector(vec3 const* vertices)
+        : vertices(vertices)
+    {
+    }
+
+    template <typename R>
+    VSNRAY_FUNC
+    auto operator()(R const& ray, basic_indexed_triangle<float> const& tri)
+        -> decltype( intersect(ray, tri, std::declval<vec3 const*>()) )
+    {
+        return intersect(ray, tri, vertices);
+    }
+
+    vec3 const* vertices = nullptr;
+};
+
+using indexed_triangle_intersector = basic_indexed_triangle_intersector<>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Watertight intersector
+//
+// Tests triangles with intersect_watertight(), so rays don't leak through the
+// shared edges of adjacent triangles. Other primitives use intersect().
+// Indexed triangles are intersected with the vertex array passed on
+// construction, cf. indexed_triangle_intersector.
+//
+// Only primitives that share their vertices are supported. basic_triangle
+// stores edges, adjacent triangles reconstruct their shared vertices with
+// different rounding errors, so rays can still leak between them.
+//
+
+template <typename BVHTraversal = default_bvh_traversal>
+struct basic_watertight_intersector : basic_intersector<basic_watertight_intersector<BVHTraversal>, BVHTraversal>
+{
+    using basic_intersector<basic_watertight_intersector<BVHTraversal>, BVHTraversal>::operator();
+
+    basic_watertight_intersector() = default;
+
+    VSNRAY_FUNC
+    explicit basic_watertight_intersector(vec3 const* vertices)
+        : vertices(vertices)
+    {
+    }
+
+    template <typename R, typename S>
+    VSNRAY_FUNC
+    auto operator()(R const& ray, basic_triangle<3, S> const& tri)
+        -> decltype( intersect_watertight(ray, tri) )
+    {
+        static_assert(sizeof(S) == 0, "watertight_intersector requires shared vertices, use basic_indexed_triangle");
+
+        return intersect_watertight(ray, tri);
+    }
+
+    template <typename R>
+    VSNRAY_FUNC
+    auto operator()(R const& ray, basic_indexed_triangle<float> const& tri)
+        -> decltype( intersect_watertight(ray, tri, std::declval<vec3 const*>()) )
+    {
+        return intersect_watertight(ray, tri, vertices);
+    }
+
+    vec3 const* vertices = nullptr;
+};
+
+using watertight_intersector = basic_watertight_intersector<>;
+
 } // visionaray
 
 #endif // VSNRAY_INTERSECTOR_H
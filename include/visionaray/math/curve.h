@@ -0,0 +1,60 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_MATH_CURVE_H
+#define VSNRAY_MATH_CURVE_H 1
+
+#include "config.h"
+#include "primitive.h"
+#include "vector.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Cubic Bezier curve with varying radius, e.g. for hair and fur
+//
+// The control points store the position in xyz and the radius in w, the
+// radius along the curve is interpolated with the same basis. B-spline
+// control points can be converted with make_bspline_curve().
+//
+// The curve is intersected as a tube of NumSegments truncated cones between
+// points on the curve, joined by spheres (cf. intersect()). The points are
+// evaluated at fixed parameters, so SIMD rays take the same code path as
+// single rays. Hit records store the curve parameter in u and the distance of
+// the ray from the axis relative to the radius in v.
+//
+
+template <typename T, typename P>
+class basic_curve : public primitive<P>
+{
+public:
+
+    using scalar_type = T;
+    using vec_type    = vector<3, T>;
+
+    enum { NumSegments = 8 };
+
+public:
+
+    basic_curve() = default;
+    MATH_FUNC basic_curve(
+            vector<4, T> const& p0,
+            vector<4, T> const& p1,
+            vector<4, T> const& p2,
+            vector<4, T> const& p3
+            );
+
+    vector<4, T> p0;
+    vector<4, T> p1;
+    vector<4, T> p2;
+    vector<4, T> p3;
+};
+
+} // MATH_NAMESPACE
+
+#include "detail/curve.inl"
+
+#endif // VSNRAY_MATH_CURVE_H
@@ -0,0 +1,111 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include "../aabb.h"
+#include "math.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Curve members
+//
+
+template <typename T, typename P>
+MATH_FUNC
+inline basic_curve<T, P>::basic_curve(
+        vector<4, T> const& p0,
+        vector<4, T> const& p1,
+        vector<4, T> const& p2,
+        vector<4, T> const& p3
+        )
+    : p0(p0)
+    , p1(p1)
+    , p2(p2)
+    , p3(p3)
+{
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Convert uniform cubic B-spline control points to Bezier control points
+//
+
+template <typename T>
+MATH_FUNC
+inline basic_curve<T> make_bspline_curve(
+        vector<4, T> const& b0,
+        vector<4, T> const& b1,
+        vector<4, T> const& b2,
+        vector<4, T> const& b3
+        )
+{
+    return basic_curve<T>(
+            (b0 + b1 * T(4.0) + b2) / T(6.0),
+            (b1 * T(2.0) + b2) / T(3.0),
+            (b1 + b2 * T(2.0)) / T(3.0),
+            (b1 + b2 * T(4.0) + b3) / T(6.0)
+            );
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Position (xyz) and radius (w) at parameter u
+//
+
+template <typename T, typename P, typename S>
+MATH_FUNC
+inline vector<4, S> curve_point(basic_curve<T, P> const& c, S const& u)
+{
+    S v = S(1.0) - u;
+
+    return vector<4, S>(c.p0) * (v * v * v)
+         + vector<4, S>(c.p1) * (S(3.0) * u * v * v)
+         + vector<4, S>(c.p2) * (S(3.0) * u * u * v)
+         + vector<4, S>(c.p3) * (u * u * u);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Tangent (not normalized) at parameter u
+//
+
+template <typename T, typename P, typename S>
+MATH_FUNC
+inline vector<3, S> curve_tangent(basic_curve<T, P> const& c, S const& u)
+{
+    S v = S(1.0) - u;
+
+    return vector<3, S>(c.p1.xyz() - c.p0.xyz()) * (S(3.0) * v * v)
+         + vector<3, S>(c.p2.xyz() - c.p1.xyz()) * (S(6.0) * u * v)
+         + vector<3, S>(c.p3.xyz() - c.p2.xyz()) * (S(3.0) * u * u);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Geometric functions
+//
+
+// The curve lies in the convex hull of its control points, the radius
+// never exceeds the largest control point radius
+template <typename T, typename P>
+MATH_FUNC
+inline basic_aabb<T> get_bounds(basic_curve<T, P> const& c)
+{
+    basic_aabb<T> bounds;
+
+    bounds.invalidate();
+    bounds.insert(c.p0.xyz());
+    bounds.insert(c.p1.xyz());
+    bounds.insert(c.p2.xyz());
+    bounds.insert(c.p3.xyz());
+
+    T r = max(max(c.p0.w, c.p1.w), max(c.p2.w, c.p3.w));
+
+    bounds.min -= vector<3, T>(r);
+    bounds.max += vector<3, T>(r);
+
+    return bounds;
+}
+
+} // MATH_NAMESPACE
@@ -0,0 +1,68 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include "../aabb.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Indexed triangle members
+//
+
+template <typename T, typename P>
+MATH_FUNC
+basic_indexed_triangle<T, P>::basic_indexed_triangle(unsigned i1, unsigned i2, unsigned i3)
+    : i1(i1)
+    , i2(i2)
+    , i3(i3)
+{
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Fetch the vertices
+//
+
+template <typename T, typename P>
+MATH_FUNC
+inline basic_triangle<3, T, P> make_triangle(basic_indexed_triangle<T, P> const& t, vector<3, T> const* vertices)
+{
+    vector<3, T> v1 = vertices[t.i1];
+
+    basic_triangle<3, T, P> result(v1, vertices[t.i2] - v1, vertices[t.i3] - v1);
+
+    result.prim_id = t.prim_id;
+    result.geom_id = t.geom_id;
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Geometric functions
+//
+
+template <typename T, typename P>
+MATH_FUNC
+inline T area(basic_indexed_triangle<T, P> const& t, vector<3, T> const* vertices)
+{
+    return area(make_triangle(t, vertices));
+}
+
+template <typename T, typename P>
+MATH_FUNC
+basic_aabb<T> get_bounds(basic_indexed_triangle<T, P> const& t, vector<3, T> const* vertices)
+{
+    // Bounds of the triangle that is actually intersected
+    return get_bounds(make_triangle(t, vertices));
+}
+
+template <typename T, typename P, typename Generator, typename U = typename Generator::value_type>
+MATH_FUNC
+inline vector<3, U> sample_surface(basic_indexed_triangle<T, P> const& t, vector<3, T> const* vertices, Generator& gen)
+{
+    return sample_surface(make_triangle(t, vertices), gen);
+}
+
+} // MATH_NAMESPACE
@@ -0,0 +1,112 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include "../aabb.h"
+#include "../limits.h"
+#include "math.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Motion triangle members
+//
+
+template <typename T, typename P>
+MATH_FUNC
+inline basic_motion_triangle<T, P>::basic_motion_triangle(
+        basic_triangle<3, T, P> const& key0,
+        basic_triangle<3, T, P> const& key1
+        )
+{
+    v1[0] = key0.v1;
+    e1[0] = key0.e1;
+    e2[0] = key0.e2;
+
+    v1[1] = key1.v1;
+    e1[1] = key1.e1;
+    e2[1] = key1.e2;
+
+    this->prim_id = key0.prim_id;
+    this->geom_id = key0.geom_id;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Triangle at TIME (clamped to [0..1])
+//
+// The edges are interpolated like the vertices, S may be a SIMD type.
+//
+
+template <typename T, typename P, typename S>
+MATH_FUNC
+inline basic_triangle<3, S, P> interpolate(basic_motion_triangle<T, P> const& t, S const& time)
+{
+    S x = saturate(time);
+
+    basic_triangle<3, S, P> result(
+            lerp(vector<3, S>(t.v1[0]), vector<3, S>(t.v1[1]), x),
+            lerp(vector<3, S>(t.e1[0]), vector<3, S>(t.e1[1]), x),
+            lerp(vector<3, S>(t.e2[0]), vector<3, S>(t.e2[1]), x)
+            );
+
+    result.prim_id = t.prim_id;
+    result.geom_id = t.geom_id;
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Time at which the point with barycentric coordinates (u,v) is at POS
+//
+// Hit records do not store the ray time, surface queries use this to recover
+// it from the hit position. Static triangles return 0.
+//
+
+template <typename T, typename P, typename S>
+MATH_FUNC
+inline S get_time(basic_motion_triangle<T, P> const& t, vector<3, S> const& pos, S const& u, S const& v)
+{
+    auto p0 = vector<3, S>(t.v1[0]) + vector<3, S>(t.e1[0]) * u + vector<3, S>(t.e2[0]) * v;
+    auto p1 = vector<3, S>(t.v1[1]) + vector<3, S>(t.e1[1]) * u + vector<3, S>(t.e2[1]) * v;
+
+    auto d = p1 - p0;
+    auto len2 = dot(d, d);
+
+    return select(
+            len2 > S(0.0),
+            saturate(dot(pos - p0, d) / max(len2, numeric_limits<S>::min())),
+            S(0.0)
+            );
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Geometric functions
+//
+
+// Bounds at motion key KEY (0 or 1)
+template <typename T, typename P>
+MATH_FUNC
+inline basic_aabb<T> get_bounds(basic_motion_triangle<T, P> const& t, int key)
+{
+    basic_aabb<T> bounds;
+
+    bounds.invalidate();
+    bounds.insert(t.v1[key]);
+    bounds.insert(t.v1[key] + t.e1[key]);
+    bounds.insert(t.v1[key] + t.e2[key]);
+
+    return bounds;
+}
+
+// The triangle at any time lies in the convex hull of the vertices at the keys
+template <typename T, typename P>
+MATH_FUNC
+inline basic_aabb<T> get_bounds(basic_motion_triangle<T, P> const& t)
+{
+    return combine(get_bounds(t, 0), get_bounds(t, 1));
+}
+
+} // MATH_NAMESPACE
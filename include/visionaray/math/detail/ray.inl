@@ -14,6 +14,16 @@ MATH_FUNC
 inline basic_ray<T>::basic_ray(vector<3, T> const& o, vector<3, T> const& d)
     : ori(o)
     , dir(d)
+    , time(0.0)
+{
+}
+
+template <typename T>
+MATH_FUNC
+inline basic_ray<T>::basic_ray(vector<3, T> const& o, vector<3, T> const& d, T const& t)
+    : ori(o)
+    , dir(d)
+    , time(t)
 {
 }
 
@@ -42,6 +52,8 @@ inline auto pack(array<basic_ray<T>, N> const& rays)
     float_array dir_y;
     float_array dir_z;
 
+    float_array time;
+
     for (size_t i = 0; i < N; ++i)
     {
         ori_x[i] = rays[i].ori.x;
@@ -51,11 +63,14 @@ inline auto pack(array<basic_ray<T>, N> const& rays)
         dir_x[i] = rays[i].dir.x;
         dir_y[i] = rays[i].dir.y;
         dir_z[i] = rays[i].dir.z;
+
+        time[i] = rays[i].time;
     }
 
     return basic_ray<U>(
             vector<3, U>(ori_x, ori_y, ori_z),
-            vector<3, U>(dir_x, dir_y, dir_z)
+            vector<3, U>(dir_x, dir_y, dir_z),
+            U(time)
             );
 }
 
@@ -114,6 +129,8 @@ inline auto unpack(basic_ray<FloatT> const& ray)
     float_array dir_y;
     float_array dir_z;
 
+    float_array time;
+
     store(ori_x, ray.ori.x);
     store(ori_y, ray.ori.y);
     store(ori_z, ray.ori.z);
@@ -122,6 +139,8 @@ inline auto unpack(basic_ray<FloatT> const& ray)
     store(dir_y, ray.dir.y);
     store(dir_z, ray.dir.z);
 
+    store(time, ray.time);
+
     array<basic_ray<float>, num_elements<FloatT>::value> result;
 
     for (int i = 0; i < num_elements<FloatT>::value; ++i)
@@ -133,6 +152,8 @@ inline auto unpack(basic_ray<FloatT> const& ray)
         result[i].dir.x = dir_x[i];
         result[i].dir.y = dir_y[i];
         result[i].dir.z = dir_z[i];
+
+        result[i].time = time[i];
     }
 
     return result;
@@ -0,0 +1,178 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include "../aabb.h"
+#include "../limits.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Woop triangle members
+//
+
+template <typename T, typename P>
+MATH_FUNC
+basic_woop_triangle<T, P>::basic_woop_triangle(
+        vector<3, T> const& v1,
+        vector<3, T> const& e1,
+        vector<3, T> const& e2
+        )
+{
+    // Invert the matrix with columns e1, e2, n and translation v1
+    vector<3, T> n = cross(e1, e2);
+    T det = dot(n, n);
+
+    if (det == T(0.0))
+    {
+        plane_u = vector<4, T>(T(0.0), T(0.0), T(0.0), v1.x);
+        plane_v = vector<4, T>(T(0.0), T(0.0), T(0.0), v1.y);
+        plane_n = vector<4, T>(T(0.0), T(0.0), T(0.0), v1.z);
+        return;
+    }
+
+    vector<3, T> u = cross(e2, n) / det;
+    vector<3, T> v = cross(n, e1) / det;
+    n /= det;
+
+    plane_u = vector<4, T>(u, -dot(u, v1));
+    plane_v = vector<4, T>(v, -dot(v, v1));
+    plane_n = vector<4, T>(n, -dot(n, v1));
+}
+
+template <typename T, typename P>
+MATH_FUNC
+basic_woop_triangle<T, P>::basic_woop_triangle(basic_triangle<3, T, P> const& t)
+    : basic_woop_triangle(t.v1, t.e1, t.e2)
+{
+    this->prim_id = t.prim_id;
+    this->geom_id = t.geom_id;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Recover the triangle from the transform
+//
+
+template <typename T, typename P>
+MATH_FUNC
+inline basic_triangle<3, T, P> make_triangle(basic_woop_triangle<T, P> const& t)
+{
+    basic_triangle<3, T, P> result;
+
+    result.prim_id = t.prim_id;
+    result.geom_id = t.geom_id;
+
+    vector<3, T> u = t.plane_u.xyz();
+    vector<3, T> v = t.plane_v.xyz();
+    vector<3, T> n = t.plane_n.xyz();
+
+    vector<3, T> uv = cross(u, v);
+    T det = dot(uv, n);
+
+    if (det == T(0.0))
+    {
+        result.v1 = vector<3, T>(t.plane_u.w, t.plane_v.w, t.plane_n.w);
+        result.e1 = vector<3, T>(T(0.0));
+        result.e2 = vector<3, T>(T(0.0));
+        return result;
+    }
+
+    // Columns of the inverse
+    result.e1 = cross(v, n) / det;
+    result.e2 = cross(n, u) / det;
+    vector<3, T> normal = uv / det;
+
+    result.v1 = -(result.e1 * t.plane_u.w + result.e2 * t.plane_v.w + normal * t.plane_n.w);
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Bound on the distance between the vertices recovered by make_triangle() and
+// the vertices of the triangle that the intersection test accepts
+//
+// The residuals of the recovered vertices w.r.t. the transform, including the
+// rounding error of computing them, are mapped back to world space with the
+// inverse transform, whose columns are e1, e2 and cross(e1, e2). The recovered
+// inverse is only accurate to first order, so the bound is doubled.
+//
+
+namespace detail
+{
+
+template <typename T, typename P>
+MATH_FUNC
+inline T recovery_error(basic_woop_triangle<T, P> const& t, basic_triangle<3, T, P> const& tri)
+{
+    if (tri.e1 == vector<3, T>(T(0.0)) && tri.e2 == vector<3, T>(T(0.0)))
+    {
+        // Degenerate, never hit
+        return T(0.0);
+    }
+
+    T gamma = T(4.0) * numeric_limits<T>::epsilon();
+
+    vector<3, T> c = cross(tri.e1, tri.e2);
+
+    vector<3, T> verts[] = { tri.v1, tri.v1 + tri.e1, tri.v1 + tri.e2 };
+    vector<3, T> uvn[]   = { vector<3, T>(T(0.0)), vector<3, T>(T(1.0), T(0.0), T(0.0)), vector<3, T>(T(0.0), T(1.0), T(0.0)) };
+    vector<4, T> rows[]  = { t.plane_u, t.plane_v, t.plane_n };
+    T lengths[]          = { length(tri.e1), length(tri.e2), length(c) };
+
+    T result = T(0.0);
+
+    for (int i = 0; i < 3; ++i)
+    {
+        T err = T(0.0);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            vector<3, T> row = rows[j].xyz();
+            T residual = abs(dot(row, verts[i]) + rows[j].w - uvn[i][j]);
+            T magnitude = abs(row.x * verts[i].x) + abs(row.y * verts[i].y) + abs(row.z * verts[i].z);
+            T rounding = gamma * (magnitude + abs(rows[j].w) + T(1.0));
+            err += lengths[j] * (residual + rounding);
+        }
+
+        result = max(result, err);
+    }
+
+    return T(2.0) * result;
+}
+
+} // detail
+
+
+//-------------------------------------------------------------------------------------------------
+// Geometric functions
+//
+
+template <typename T, typename P>
+MATH_FUNC
+inline T area(basic_woop_triangle<T, P> const& t)
+{
+    return area(make_triangle(t));
+}
+
+// Bounds of the recovered vertices, padded by the recovery error
+template <typename T, typename P>
+MATH_FUNC
+basic_aabb<T> get_bounds(basic_woop_triangle<T, P> const& t)
+{
+    auto tri = make_triangle(t);
+    auto pad = vector<3, T>(detail::recovery_error(t, tri));
+
+    auto box = get_bounds(tri);
+    return basic_aabb<T>(box.min - pad, box.max + pad);
+}
+
+template <typename T, typename P, typename Generator, typename U = typename Generator::value_type>
+MATH_FUNC
+inline vector<3, U> sample_surface(basic_woop_triangle<T, P> const& t, Generator& gen)
+{
+    return sample_surface(make_triangle(t), gen);
+}
+
+} // MATH_NAMESPACE
@@ -0,0 +1,56 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_MATH_INDEXED_TRIANGLE_H
+#define VSNRAY_MATH_INDEXED_TRIANGLE_H 1
+
+#include "config.h"
+#include "primitive.h"
+#include "triangle.h"
+#include "vector.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Triangle that references its vertices in a shared vertex array
+//
+// Stores the indices of its three vertices instead of the vertex positions, so
+// that the vertices of a mesh are stored only once. The vertex array is not
+// referenced by the triangle, but passed to the functions that need the
+// vertices (intersect(), get_bounds(), ...). BVHs over indexed triangles are
+// built with build_indexed_triangles() and traversed with an intersector that
+// holds the vertex array, cf. indexed_triangle_intersector. The triangles
+// contain no pointers, so they stay valid when the vertices are copied to the
+// GPU and can be stored in BVH files.
+//
+// Per-vertex normals, colors and texture coordinates are looked up with the
+// vertex indices, per-face data with prim_id. The barycentric coordinates u
+// and v refer to the second and third vertex, as with basic_triangle.
+//
+
+template <typename T, typename P>
+class basic_indexed_triangle : public primitive<P>
+{
+public:
+
+    using scalar_type =  T;
+    using vec_type    =  vector<3, T>;
+
+public:
+
+    basic_indexed_triangle() = default;
+    MATH_FUNC basic_indexed_triangle(unsigned i1, unsigned i2, unsigned i3);
+
+    unsigned i1;
+    unsigned i2;
+    unsigned i3;
+};
+
+} // MATH_NAMESPACE
+
+#include "detail/indexed_triangle.inl"
+
+#endif // VSNRAY_MATH_INDEXED_TRIANGLE_H
@@ -12,12 +12,16 @@
 
 #include "aabb.h"
 #include "array.h"
+#include "curve.h"
+#include "indexed_triangle.h"
 #include "limits.h"
+#include "motion_triangle.h"
 #include "plane.h"
 #include "ray.h"
 #include "sphere.h"
 #include "triangle.h"
 #include "vector.h"
+#include "woop_triangle.h"
 
 namespace MATH_NAMESPACE
 {
@@ -157,6 +161,210 @@ inline hit_record<R, primitive<unsigned>> intersect(R const& ray, basic_triangle
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// ray / triangle, watertight
+//
+// cf. Woop, Benthin, Wald (2013): Watertight Ray/Triangle Intersection
+//
+// The vertices are transformed into a ray-aligned space (dimensions permuted
+// so that the ray is longest along z, then sheared so that it points along
+// z), where the test reduces to the signs of three 2D edge functions. Edges
+// shared by adjacent triangles are evaluated with the same operands, so a ray
+// cannot pass between them. Rays exactly on an edge hit both triangles
+// (the double precision fallback of the paper is omitted).
+//
+// Hit records are the same as with intersect(). The test is only watertight
+// if adjacent triangles yield bitwise identical shared vertices, i.e. for
+// basic_indexed_triangle, which passes the shared vertices as is. With
+// basic_triangle the vertices are reconstructed as v1 + e1 and v1 + e2, which
+// rounds differently in adjacent triangles, so rays can leak through shared
+// edges. The test is still robust for the single triangle, but watertight
+// meshes must be indexed (cf. watertight_intersector).
+//
+
+namespace detail
+{
+
+// Move the largest dimension of the ray direction to z
+template <typename M, typename T>
+MATH_FUNC
+inline vector<3, T> watertight_permute(vector<3, T> const& v, M const& z_is_x, M const& z_is_y)
+{
+    return select(
+            z_is_x,
+            vector<3, T>(v.y, v.z, v.x),
+            select(z_is_y, vector<3, T>(v.z, v.x, v.y), v)
+            );
+}
+
+template <typename R, typename V>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect_watertight(
+        R const& ray,
+        V const& v1,
+        V const& v2,
+        V const& v3
+        )
+{
+    using T = typename R::scalar_type;
+    using vec_type = vector<3, T>;
+
+    hit_record<R, primitive<unsigned>> result;
+    result.t = T(-1.0);
+
+    // Ray-aligned space, per ray in case of SIMD rays
+
+    T dx = abs(ray.dir.x);
+    T dy = abs(ray.dir.y);
+    T dz = abs(ray.dir.z);
+
+    auto z_is_x = dx >= dy && dx >= dz;
+    auto z_is_y = !z_is_x && dy >= dz;
+
+    vec_type dir = watertight_permute(ray.dir, z_is_x, z_is_y);
+
+    T sz = T(1.0) / dir.z;
+    T sx = dir.x * sz;
+    T sy = dir.y * sz;
+
+    vec_type a = watertight_permute(vec_type(v1) - ray.ori, z_is_x, z_is_y);
+    vec_type b = watertight_permute(vec_type(v2) - ray.ori, z_is_x, z_is_y);
+    vec_type c = watertight_permute(vec_type(v3) - ray.ori, z_is_x, z_is_y);
+
+    T ax = a.x - sx * a.z;
+    T ay = a.y - sy * a.z;
+    T bx = b.x - sx * b.z;
+    T by = b.y - sy * b.z;
+    T cx = c.x - sx * c.z;
+    T cy = c.y - sy * c.z;
+
+    // Scaled barycentric coordinates
+    T u = cx * by - cy * bx;
+    T v = ax * cy - ay * cx;
+    T w = bx * ay - by * ax;
+
+    result.hit = !( (u < T(0.0) || v < T(0.0) || w < T(0.0)) && (u > T(0.0) || v > T(0.0) || w > T(0.0)) );
+
+    T det = u + v + w;
+
+    result.hit &= ( det != T(0.0) );
+
+    if ( !any(result.hit) )
+    {
+        return result;
+    }
+
+    T inv_det = T(1.0) / det;
+
+    result.t = (u * a.z + v * b.z + w * c.z) * sz * inv_det;
+    result.u = v * inv_det;
+    result.v = w * inv_det;
+    return result;
+}
+
+} // detail
+
+template <typename R, typename U>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect_watertight(R const& ray, basic_triangle<3, U, unsigned> const& tri)
+{
+    auto result = detail::intersect_watertight(ray, tri.v1, tri.v1 + tri.e1, tri.v1 + tri.e2);
+
+    result.prim_id = tri.prim_id;
+    result.geom_id = tri.geom_id;
+    return result;
+}
+
+template <typename R, typename U>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect_watertight(
+        R const&                                    ray,
+        basic_indexed_triangle<U, unsigned> const&  tri,
+        vector<3, U> const*                         vertices
+        )
+{
+    auto result = detail::intersect_watertight(ray, vertices[tri.i1], vertices[tri.i2], vertices[tri.i3]);
+
+    result.prim_id = tri.prim_id;
+    result.geom_id = tri.geom_id;
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// ray / woop triangle
+//
+
+template <typename R, typename U>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect(R const& ray, basic_woop_triangle<U, unsigned> const& tri)
+{
+    using T = typename R::scalar_type;
+    using vec_type = vector<3, T>;
+
+    hit_record<R, primitive<unsigned>> result;
+    result.t = T(-1.0);
+
+    // Distance to the triangle plane in unit triangle space
+    vec_type n(tri.plane_n.xyz());
+    T dn = dot(n, ray.dir);
+
+    result.hit = ( dn != T(0.0) );
+
+    if ( !any(result.hit) )
+    {
+        return result;
+    }
+
+    T t = -(dot(n, ray.ori) + T(tri.plane_n.w)) / dn;
+
+    vec_type p = ray.ori + ray.dir * t;
+
+    T b1 = dot(vec_type(tri.plane_u.xyz()), p) + T(tri.plane_u.w);
+
+    result.hit &= ( b1 >= T(0.0) && b1 <= T(1.0) );
+
+    if ( !any(result.hit) )
+    {
+        return result;
+    }
+
+    T b2 = dot(vec_type(tri.plane_v.xyz()), p) + T(tri.plane_v.w);
+
+    result.hit &= ( b2 >= T(0.0) && b1 + b2 <= T(1.0) );
+
+    if ( !any(result.hit) )
+    {
+        return result;
+    }
+
+    result.prim_id = tri.prim_id;
+    result.geom_id = tri.geom_id;
+    result.t = t;
+    result.u = b1;
+    result.v = b2;
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// ray / indexed triangle
+//
+// VERTICES is the vertex array that the triangle indexes into
+//
+
+template <typename R, typename U>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect(
+        R const&                                    ray,
+        basic_indexed_triangle<U, unsigned> const&  tri,
+        vector<3, U> const*                         vertices
+        )
+{
+    return intersect(ray, make_triangle(tri, vertices));
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // ray / sphere
 //
@@ -198,6 +406,200 @@ inline hit_record<R, primitive<unsigned>> intersect(R const& ray, basic_sphere<U
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// ray / curve
+//
+// The tube around the curve is approximated by NumSegments truncated cones
+// between points on the curve, with spheres of the respective radius at these
+// points to close the gaps where the cones meet. Cones and spheres are
+// intersected exactly, so the only error is that of the linear approximation
+// of the curve and its radius, which is well below the radius for thin,
+// smoothly bent curves like hair. The hit record stores the curve parameter
+// of the point on the axis in u, v is the distance of the ray from the axis
+// (or from the sphere center) relative to the radius, i.e. 0 for rays through
+// the center of the tube and 1 for grazing rays.
+//
+
+namespace detail
+{
+
+// Closest hit with the cone around A + s * E, 0 <= s <= 1, the radius varies
+// linearly from R0 to R1. S is the axis parameter of the hit
+template <typename R, typename U>
+MATH_FUNC
+inline void intersect_cone(
+        R const&                    ray,
+        vector<3, U> const&         a,
+        vector<3, U> const&         e,
+        U const&                    r0,
+        U const&                    r1,
+        typename R::scalar_type&    t,
+        typename R::scalar_type&    s,
+        typename R::scalar_type&    v
+        )
+{
+    using S = typename R::scalar_type;
+    using vec_type = vector<3, S>;
+
+    vec_type w = ray.ori - vec_type(a);
+    vec_type ev(e);
+
+    S ee(dot(e, e));
+    S we = dot(w, ev) / ee;
+    S de = dot(ray.dir, ev) / ee;
+
+    // Components perpendicular to the axis
+    vec_type wp = w - ev * we;
+    vec_type dp = ray.dir - ev * de;
+
+    // The radius along the ray is rr + g * t
+    S g  = S(r1 - r0) * de;
+    S rr = S(r0) + S(r1 - r0) * we;
+
+    S A = dot(dp, dp) - g * g;
+    S B = dot(wp, dp) - rr * g;
+    S C = dot(wp, wp) - rr * rr;
+
+    S disc = B * B - A * C;
+    auto valid = disc >= S(0.0) && A != S(0.0);
+
+    S root_disc = sqrt( select(valid, disc, S(0.0)) );
+    S inv_a = S(1.0) / select(valid, A, S(1.0));
+
+    S t1 = (-B - root_disc) * inv_a;
+    S t2 = (-B + root_disc) * inv_a;
+
+    // Only the part of the (double) cone where 0 <= s <= 1 and the radius is positive
+    S s1 = we + de * t1;
+    S s2 = we + de * t2;
+
+    auto hit1 = valid && t1 > S(0.0) && s1 >= S(0.0) && s1 <= S(1.0) && rr + g * t1 >= S(0.0);
+    auto hit2 = valid && t2 > S(0.0) && s2 >= S(0.0) && s2 <= S(1.0) && rr + g * t2 >= S(0.0);
+
+    hit2 = hit2 && (!hit1 || t2 < t1);
+
+    t = select( hit2, t2, select(hit1, t1, S(-1.0)) );
+    s = we + de * t;
+
+    S dd = dot(dp, dp);
+    S dist2 = dot(wp, wp) - select( dd > S(0.0), dot(wp, dp) * dot(wp, dp) / select(dd > S(0.0), dd, S(1.0)), S(0.0) );
+    v = sqrt( max(dist2, S(0.0)) ) / max(rr + g * t, numeric_limits<S>::min());
+}
+
+// Closest hit with the sphere with center C and radius RADIUS
+template <typename R, typename U>
+MATH_FUNC
+inline void intersect_joint(
+        R const&                    ray,
+        vector<3, U> const&         c,
+        U const&                    radius,
+        typename R::scalar_type&    t,
+        typename R::scalar_type&    v
+        )
+{
+    using S = typename R::scalar_type;
+    using vec_type = vector<3, S>;
+
+    vec_type w = ray.ori - vec_type(c);
+
+    S A = dot(ray.dir, ray.dir);
+    S B = dot(w, ray.dir);
+    S C = dot(w, w) - S(radius) * S(radius);
+
+    S disc = B * B - A * C;
+    auto valid = disc >= S(0.0);
+
+    S root_disc = sqrt( select(valid, disc, S(0.0)) );
+
+    S t1 = (-B - root_disc) / A;
+    S t2 = (-B + root_disc) / A;
+
+    t = select( valid && t1 > S(0.0), t1, select(valid && t2 > S(0.0), t2, S(-1.0)) );
+
+    S dist2 = dot(w, w) - B * B / A;
+    v = sqrt( max(dist2, S(0.0)) ) / max(S(radius), numeric_limits<S>::min());
+}
+
+} // detail
+
+template <typename R, typename U>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect(R const& ray, basic_curve<U, unsigned> const& curve)
+{
+    using T = typename R::scalar_type;
+
+    enum { N = basic_curve<U, unsigned>::NumSegments };
+
+    hit_record<R, primitive<unsigned>> result;
+    result.hit = false;
+    result.t = numeric_limits<T>::max();
+
+    vector<4, U> p = curve.p0;
+
+    T t;
+    T v;
+
+    detail::intersect_joint(ray, p.xyz(), p.w, t, v);
+
+    auto hit = t > T(0.0);
+
+    result.hit |= hit;
+    result.t = select( hit, t, result.t );
+    result.u = select( hit, T(0.0), result.u );
+    result.v = select( hit, v, result.v );
+
+    for (int i = 0; i < N; ++i)
+    {
+        vector<4, U> q = curve_point(curve, U(i + 1) / U(N));
+
+        T s;
+
+        detail::intersect_cone(ray, p.xyz(), vector<3, U>(q.xyz() - p.xyz()), p.w, q.w, t, s, v);
+
+        hit = t > T(0.0) && t < result.t;
+
+        result.hit |= hit;
+        result.t = select( hit, t, result.t );
+        result.u = select( hit, (T(i) + s) / T(N), result.u );
+        result.v = select( hit, v, result.v );
+
+        detail::intersect_joint(ray, q.xyz(), q.w, t, v);
+
+        hit = t > T(0.0) && t < result.t;
+
+        result.hit |= hit;
+        result.t = select( hit, t, result.t );
+        result.u = select( hit, T(i + 1) / T(N), result.u );
+        result.v = select( hit, v, result.v );
+
+        p = q;
+    }
+
+    result.prim_id = curve.prim_id;
+    result.geom_id = curve.geom_id;
+    result.t = select( result.hit, result.t, T(-1.0) );
+    result.isect_pos = ray.ori + ray.dir * result.t;
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// ray / motion triangle
+//
+// Intersect the triangle at the time of the ray. The hit position is set, so
+// that the time can be recovered for surface queries (cf. get_time())
+//
+
+template <typename R, typename U>
+MATH_FUNC
+inline hit_record<R, primitive<unsigned>> intersect(R const& ray, basic_motion_triangle<U, unsigned> const& tri)
+{
+    auto result = intersect(ray, interpolate(tri, ray.time));
+    result.isect_pos = ray.ori + ray.dir * result.t;
+    return result;
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // ray / plane
 //
@@ -14,11 +14,14 @@
 #include "axis.h"
 #include "constants.h"
 #include "coordinates.h"
+#include "curve.h"
 #include "fixed.h"
+#include "indexed_triangle.h"
 #include "intersect.h"
 #include "io.h"
 #include "limits.h"
 #include "matrix.h"
+#include "motion_triangle.h"
 #include "norm.h"
 #include "plane.h"
 #include "primitive.h"
@@ -32,5 +35,6 @@
 #include "triangle.h"
 #include "unorm.h"
 #include "vector.h"
+#include "woop_triangle.h"
 
 #endif // VSNRAY_MATH_H
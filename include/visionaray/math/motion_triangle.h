@@ -0,0 +1,50 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_MATH_MOTION_TRIANGLE_H
+#define VSNRAY_MATH_MOTION_TRIANGLE_H 1
+
+#include "config.h"
+#include "primitive.h"
+#include "triangle.h"
+#include "vector.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Triangle with linear vertex motion, for deformation motion blur
+//
+// Stores the triangle at the motion keys (time 0 and 1) in the layout of
+// basic_triangle. The vertices move linearly between the keys, rays are
+// intersected with the triangle at their time (cf. basic_ray::time).
+//
+
+template <typename T, typename P>
+class basic_motion_triangle : public primitive<P>
+{
+public:
+
+    using scalar_type = T;
+    using vec_type    = vector<3, T>;
+
+public:
+
+    basic_motion_triangle() = default;
+    MATH_FUNC basic_motion_triangle(
+            basic_triangle<3, T, P> const& key0,
+            basic_triangle<3, T, P> const& key1
+            );
+
+    vec_type v1[2];
+    vec_type e1[2];
+    vec_type e2[2];
+};
+
+} // MATH_NAMESPACE
+
+#include "detail/motion_triangle.inl"
+
+#endif // VSNRAY_MATH_MOTION_TRIANGLE_H
@@ -12,6 +12,13 @@
 namespace MATH_NAMESPACE
 {
 
+//-------------------------------------------------------------------------------------------------
+// Ray with origin, direction, and a time for motion blur
+//
+// Moving primitives, BVH instances and motion BVH nodes interpolate linearly
+// between their keys at time 0 and 1, the time is clamped to [0..1].
+//
+
 template <typename T>
 class basic_ray
 {
@@ -24,9 +31,11 @@ public:
 
     vec_type ori;
     vec_type dir;
+    T time = T(0.0);
 
     basic_ray() = default;
     MATH_FUNC basic_ray(vector<3, T> const& o, vector<3, T> const& d);
+    MATH_FUNC basic_ray(vector<3, T> const& o, vector<3, T> const& d, T const& t);
 
 };
 
@@ -0,0 +1,63 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_MATH_WOOP_TRIANGLE_H
+#define VSNRAY_MATH_WOOP_TRIANGLE_H 1
+
+#include "config.h"
+#include "primitive.h"
+#include "triangle.h"
+#include "vector.h"
+
+namespace MATH_NAMESPACE
+{
+
+//-------------------------------------------------------------------------------------------------
+// Triangle with a precomputed affine transform to the unit triangle
+//
+// cf. Woop (2004): A Ray Tracing Hardware Architecture for Dynamic Scenes
+//
+// The rows of the transform map a point to the barycentric coordinates u and v
+// w.r.t. e1 and e2 (as with basic_triangle) and to the distance from the
+// triangle plane in units of the normal. The ray / triangle test reduces to
+// dot products, no cross products are computed per test.
+//
+// The vertices can be recovered from the transform (cf. make_triangle()), this
+// is only done for building and sampling. Bounds and spatial splits are padded
+// by a bound on the recovery error, so they contain the triangle that the
+// intersection test accepts. Degenerate triangles are never hit, they store
+// their first vertex in the translational part of the transform.
+//
+
+template <typename T, typename P>
+class basic_woop_triangle : public primitive<P>
+{
+public:
+
+    using scalar_type =  T;
+    using vec_type    =  vector<3, T>;
+
+public:
+
+    basic_woop_triangle() = default;
+    MATH_FUNC basic_woop_triangle(
+            vector<3, T> const& v1,
+            vector<3, T> const& e1,
+            vector<3, T> const& e2
+            );
+
+    // Also copies prim_id and geom_id
+    MATH_FUNC explicit basic_woop_triangle(basic_triangle<3, T, P> const& t);
+
+    vector<4, T> plane_u;
+    vector<4, T> plane_v;
+    vector<4, T> plane_n;
+};
+
+} // MATH_NAMESPACE
+
+#include "detail/woop_triangle.inl"
+
+#endif // VSNRAY_MATH_WOOP_TRIANGLE_H
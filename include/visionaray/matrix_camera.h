@@ -28,6 +28,12 @@ public:
     VSNRAY_FUNC
     mat4 const& get_proj_matrix() const;
 
+    // Shutter interval, same semantics as pinhole_camera::set_shutter()
+    void set_shutter(float open, float close);
+
+    VSNRAY_FUNC float shutter_open() const;
+    VSNRAY_FUNC float shutter_close() const;
+
     // Call before rendering.
     void begin_frame();
 
@@ -46,6 +52,9 @@ private:
     mat4 view_inv_;
     mat4 proj_inv_;
 
+    float shutter_open_ = 0.0f;
+    float shutter_close_ = 0.0f;
+
 };
 
 } // visionaray
@@ -40,6 +40,12 @@ namespace visionaray
 //      sphere along the current viewing direction and looking to the center of
 //      the sphere
 //
+//  - pinhole_camera::set_shutter()
+//      specify the interval [open..close) in which the shutter is open, as times
+//      between the motion keys at 0 and 1 (cf. basic_ray::time). The schedulers
+//      sample the time of each primary ray from this interval. The default
+//      interval is empty, all rays have time 0 and there is no motion blur
+//
 //
 //-------------------------------------------------------------------------------------------------
 
@@ -74,6 +80,11 @@ public:
 
     float distance() const { return distance_; }
 
+    void set_shutter(float open, float close) { shutter_open_ = open; shutter_close_ = close; }
+
+    VSNRAY_FUNC float shutter_open() const { return shutter_open_; }
+    VSNRAY_FUNC float shutter_close() const { return shutter_close_; }
+
     // Call before rendering.
     void begin_frame();
 
@@ -104,6 +115,9 @@ private:
 
     recti viewport_;
 
+    float shutter_open_ = 0.0f;
+    float shutter_close_ = 0.0f;
+
     // Precalculated for rendering
     vec3 U;
     vec3 V;
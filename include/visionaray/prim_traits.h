@@ -8,9 +8,13 @@
 
 #include <cstddef>
 
+#include <visionaray/math/curve.h>
+#include <visionaray/math/indexed_triangle.h>
+#include <visionaray/math/motion_triangle.h>
 #include <visionaray/math/plane.h>
 #include <visionaray/math/sphere.h>
 #include <visionaray/math/triangle.h>
+#include <visionaray/math/woop_triangle.h>
 
 #include <visionaray/tags.h>
 
@@ -75,6 +79,30 @@ struct scalar_type<basic_triangle<Dim, T, P>>
     using type = T;
 };
 
+template <typename T, typename P>
+struct scalar_type<basic_woop_triangle<T, P>>
+{
+    using type = T;
+};
+
+template <typename T, typename P>
+struct scalar_type<basic_indexed_triangle<T, P>>
+{
+    using type = T;
+};
+
+template <typename T, typename P>
+struct scalar_type<basic_curve<T, P>>
+{
+    using type = T;
+};
+
+template <typename T, typename P>
+struct scalar_type<basic_motion_triangle<T, P>>
+{
+    using type = T;
+};
+
 //-------------------------------------------------------------------------------------------------
 // Number of vertices
 //
@@ -95,6 +123,18 @@ struct num_vertices<basic_triangle<Dim, T, P>>
     enum { value = 3 };
 };
 
+template <typename T, typename P>
+struct num_vertices<basic_woop_triangle<T, P>>
+{
+    enum { value = 3 };
+};
+
+template <typename T, typename P>
+struct num_vertices<basic_indexed_triangle<T, P>>
+{
+    enum { value = 3 };
+};
+
 
 //-------------------------------------------------------------------------------------------------
 // Number of precalculated normals
@@ -122,6 +162,30 @@ struct num_normals<basic_triangle<Dim, T, P>, normals_per_vertex_binding>
     enum { value = 3 };
 };
 
+template <typename T, typename P>
+struct num_normals<basic_woop_triangle<T, P>, normals_per_face_binding>
+{
+    enum { value = 1 };
+};
+
+template <typename T, typename P>
+struct num_normals<basic_woop_triangle<T, P>, normals_per_vertex_binding>
+{
+    enum { value = 3 };
+};
+
+template <typename T, typename P>
+struct num_normals<basic_indexed_triangle<T, P>, normals_per_face_binding>
+{
+    enum { value = 1 };
+};
+
+template <typename T, typename P>
+struct num_normals<basic_indexed_triangle<T, P>, normals_per_vertex_binding>
+{
+    enum { value = 3 };
+};
+
 
 //-------------------------------------------------------------------------------------------------
 // Number of texture coordinates
@@ -143,6 +207,18 @@ struct num_tex_coords<basic_triangle<Dim, T, P>>
     enum { value = 3 };
 };
 
+template <typename T, typename P>
+struct num_tex_coords<basic_woop_triangle<T, P>>
+{
+    enum { value = 3 };
+};
+
+template <typename T, typename P>
+struct num_tex_coords<basic_indexed_triangle<T, P>>
+{
+    enum { value = 3 };
+};
+
 } // visionaray
 
 #endif // VSNRAY_PRIM_TRAITS_H
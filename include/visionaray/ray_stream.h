@@ -0,0 +1,292 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_RAY_STREAM_H
+#define VSNRAY_RAY_STREAM_H 1
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "math/limits.h"
+#include "math/ray.h"
+#include "math/vector.h"
+#include "aligned_vector.h"
+#include "bvh.h"
+#include "intersector.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// ray_stream
+//
+// Large batch of single rays in SoA layout, e.g. all secondary rays of a
+// bounce. Each ray has a maximum hit distance, so that streams of shadow
+// rays can be tested against the distance to the light source, and a time
+// for motion blur (cf. basic_ray).
+//
+
+struct ray_stream
+{
+    aligned_vector<float, 64> ori_x;
+    aligned_vector<float, 64> ori_y;
+    aligned_vector<float, 64> ori_z;
+    aligned_vector<float, 64> dir_x;
+    aligned_vector<float, 64> dir_y;
+    aligned_vector<float, 64> dir_z;
+    aligned_vector<float, 64> time;
+    aligned_vector<float, 64> max_t;
+
+    size_t size() const
+    {
+        return ori_x.size();
+    }
+
+    bool empty() const
+    {
+        return ori_x.empty();
+    }
+
+    void clear()
+    {
+        resize(0);
+    }
+
+    void resize(size_t n)
+    {
+        ori_x.resize(n);
+        ori_y.resize(n);
+        ori_z.resize(n);
+        dir_x.resize(n);
+        dir_y.resize(n);
+        dir_z.resize(n);
+        time.resize(n, 0.0f);
+        max_t.resize(n, numeric_limits<float>::max());
+    }
+
+    void reserve(size_t n)
+    {
+        ori_x.reserve(n);
+        ori_y.reserve(n);
+        ori_z.reserve(n);
+        dir_x.reserve(n);
+        dir_y.reserve(n);
+        dir_z.reserve(n);
+        time.reserve(n);
+        max_t.reserve(n);
+    }
+
+    void push_back(basic_ray<float> const& r, float t = numeric_limits<float>::max())
+    {
+        resize(size() + 1);
+        set_ray(size() - 1, r, t);
+    }
+
+    void set_ray(size_t i, basic_ray<float> const& r, float t = numeric_limits<float>::max())
+    {
+        assert(i < size());
+
+        ori_x[i] = r.ori.x;
+        ori_y[i] = r.ori.y;
+        ori_z[i] = r.ori.z;
+        dir_x[i] = r.dir.x;
+        dir_y[i] = r.dir.y;
+        dir_z[i] = r.dir.z;
+        time[i]  = r.time;
+        max_t[i] = t;
+    }
+
+    basic_ray<float> get_ray(size_t i) const
+    {
+        assert(i < size());
+
+        return basic_ray<float>(
+                vec3(ori_x[i], ori_y[i], ori_z[i]),
+                vec3(dir_x[i], dir_y[i], dir_z[i]),
+                time[i]
+                );
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// hit_stream
+//
+// Hit records for a ray_stream in SoA layout. t, u, v, prim_id, geom_id and
+// inst_id are only valid where hit is set. inst_id is the id of the outermost
+// instance that was hit (cf. bvh_inst_t::inst_id()), 0 for hits outside of
+// instances.
+//
+
+struct hit_stream
+{
+    aligned_vector<int, 64>      hit;
+    aligned_vector<float, 64>    t;
+    aligned_vector<float, 64>    u;
+    aligned_vector<float, 64>    v;
+    aligned_vector<unsigned, 64> prim_id;
+    aligned_vector<unsigned, 64> geom_id;
+    aligned_vector<unsigned, 64> inst_id;
+
+    size_t size() const
+    {
+        return hit.size();
+    }
+
+    void resize(size_t n)
+    {
+        hit.resize(n);
+        t.resize(n);
+        u.resize(n);
+        v.resize(n);
+        prim_id.resize(n);
+        geom_id.resize(n);
+        inst_id.resize(n);
+    }
+
+    // Hit record of ray I, as returned by closest_hit() for a single ray
+    hit_record<basic_ray<float>, primitive<unsigned>> get_hit_record(ray_stream const& rays, size_t i) const
+    {
+        assert(i < size() && i < rays.size());
+
+        hit_record<basic_ray<float>, primitive<unsigned>> result;
+
+        result.hit = hit[i] != 0;
+        result.t = hit[i] ? t[i] : -1.0f;
+        result.u = u[i];
+        result.v = v[i];
+        result.prim_id = prim_id[i];
+        result.geom_id = geom_id[i];
+
+        auto r = rays.get_ray(i);
+        result.isect_pos = r.ori + r.dir * result.t;
+
+        return result;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// ray_stream_scratch
+//
+// Buffers of the stream traversal, one set per instance level. They grow to
+// the largest stream and are reused for all instances of a level. Pass the
+// same scratch to consecutive traversals on a thread to allocate them only
+// once, concurrent traversals need scratches of their own.
+//
+
+struct ray_stream_scratch
+{
+    struct frame
+    {
+        unsigned addr;
+        size_t   first;             // Index list on indices
+        size_t   count;
+    };
+
+    struct level
+    {
+        aligned_vector<float, 64>   inv_x;
+        aligned_vector<float, 64>   inv_y;
+        aligned_vector<float, 64>   inv_z;
+
+        // Closest hit so far, or -1 for any hit rays that are done
+        aligned_vector<float, 64>   max_t;
+
+        std::vector<unsigned>       indices;
+        std::vector<frame>          stack;
+
+        // Rays of the instance that is traversed from this level, in object space
+        ray_stream                  instance_rays;
+        hit_stream                  instance_hits;
+        std::vector<unsigned>       instance_ids;
+    };
+
+    level& get_level(size_t depth)
+    {
+        while (levels.size() <= depth)
+        {
+            levels.emplace_back(new level);
+        }
+
+        return *levels[depth];
+    }
+
+    // Pointers, so that references to levels stay valid
+    std::vector<std::unique_ptr<level>> levels;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Ray stream traversal
+//
+// Traverse BVHs (refs) [begin..end) with all rays of a stream at once. Nodes
+// are visited once per stream and tested against all active rays, a child is
+// only descended into with the rays that hit its bounds (active ray
+// compaction). Leaves are intersected with all of their active rays one
+// primitive after another, so that the primitives are read only once.
+//
+// closest_hit_stream() writes the closest hit closer than max_t of each ray.
+// any_hit_stream() stops traversing a ray after its first hit closer than
+// max_t, the hit record then stores that hit. Both resize HITS to the size
+// of the stream.
+//
+// BVH instances, at the top or as primitives of a BVH, are traversed with the
+// sub-stream of their active rays transformed into object space. Nested
+// instances recurse. The overloads w/o a ray_stream_scratch use one of their
+// own for the whole call.
+//
+
+template <typename Primitives, typename Intersector>
+void closest_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect,
+        ray_stream_scratch& scratch
+        );
+
+template <typename Primitives, typename Intersector>
+void closest_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect
+        );
+
+template <typename Primitives>
+void closest_hit_stream(ray_stream const& rays, hit_stream& hits, Primitives begin, Primitives end);
+
+template <typename Primitives, typename Intersector>
+void any_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect,
+        ray_stream_scratch& scratch
+        );
+
+template <typename Primitives, typename Intersector>
+void any_hit_stream(
+        ray_stream const&   rays,
+        hit_stream&         hits,
+        Primitives          begin,
+        Primitives          end,
+        Intersector&        isect
+        );
+
+template <typename Primitives>
+void any_hit_stream(ray_stream const& rays, hit_stream& hits, Primitives begin, Primitives end);
+
+} // visionaray
+
+#include "detail/ray_stream.inl"
+
+#endif // VSNRAY_RAY_STREAM_H
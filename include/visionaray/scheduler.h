@@ -212,7 +212,9 @@ auto make_sched_params(First first, Args&&... args)
 #endif
 #include "detail/simple_sched.h"
 #if !defined(__MINGW32__) && !defined(__MINGW64__)
+#include "detail/adaptive_sched.h"
 #include "detail/tiled_sched.h"
+#include "detail/wavefront_sched.h"
 #endif
 #if VSNRAY_HAVE_TBB
 #include "detail/tbb_sched.h"
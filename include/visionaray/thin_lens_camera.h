@@ -14,6 +14,9 @@ namespace visionaray
 //-------------------------------------------------------------------------------------------------
 // Thin lens camera class
 //
+// Inherits the viewing parameters and the shutter interval from pinhole_camera,
+// cf. pinhole_camera::set_shutter()
+//
 //-------------------------------------------------------------------------------------------------
 
 class thin_lens_camera : public pinhole_camera
@@ -0,0 +1,333 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_TRIANGLE_PACKET_H
+#define VSNRAY_TRIANGLE_PACKET_H 1
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+
+#include "detail/macros.h"
+#include "math/simd/type_traits.h"
+#include "math/aabb.h"
+#include "math/intersect.h"
+#include "math/limits.h"
+#include "math/ray.h"
+#include "math/triangle.h"
+#include "math/vector.h"
+#include "aligned_vector.h"
+#include "bvh.h"
+#include "get_color.h"
+#include "get_normal.h"
+#include "get_shading_normal.h"
+#include "get_tex_coord.h"
+#include "tags.h"
+#include "update_if.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// triangle_packet
+//
+// Up to Size triangles in SoA layout, so that a single ray can be tested
+// against all of them with one SIMD Moeller-Trumbore test. The hit record
+// reports the closest of the triangles that were hit, with its prim_id and
+// geom_id. Unused slots at the end store degenerate triangles that are never hit.
+//
+// Packets are the primitives of BVHs with packed leaves, cf. pack_leaves().
+//
+
+template <unsigned Size>
+struct VSNRAY_ALIGN(64) triangle_packet
+{
+    static_assert(Size == 4 || Size == 8 || Size == 16, "triangle_packet: Size must be 4, 8 or 16");
+
+    enum { size = Size };
+
+    float v1[3][Size];
+    float e1[3][Size];
+    float e2[3][Size];
+    unsigned prim_id[Size];
+    unsigned geom_id[Size];
+    unsigned count;             // Number of used slots
+
+    void clear()
+    {
+        for (unsigned d = 0; d < 3; ++d)
+        {
+            for (unsigned i = 0; i < Size; ++i)
+            {
+                v1[d][i] = 0.0f;
+                e1[d][i] = 0.0f;
+                e2[d][i] = 0.0f;
+            }
+        }
+
+        for (unsigned i = 0; i < Size; ++i)
+        {
+            prim_id[i] = 0;
+            geom_id[i] = 0;
+        }
+
+        count = 0;
+    }
+
+    void push_back(basic_triangle<3, float> const& t)
+    {
+        assert(count < Size);
+
+        for (unsigned d = 0; d < 3; ++d)
+        {
+            v1[d][count] = t.v1[d];
+            e1[d][count] = t.e1[d];
+            e2[d][count] = t.e2[d];
+        }
+
+        prim_id[count] = t.prim_id;
+        geom_id[count] = t.geom_id;
+
+        ++count;
+    }
+
+    basic_triangle<3, float> get_triangle(unsigned i) const
+    {
+        assert(i < count);
+
+        basic_triangle<3, float> t(
+                vec3(v1[0][i], v1[1][i], v1[2][i]),
+                vec3(e1[0][i], e1[1][i], e1[2][i]),
+                vec3(e2[0][i], e2[1][i], e2[2][i])
+                );
+
+        t.prim_id = prim_id[i];
+        t.geom_id = geom_id[i];
+
+        return t;
+    }
+
+    // Index of the slot with the given prim_id, or count
+    unsigned find(unsigned id) const
+    {
+        unsigned i = 0;
+
+        while (i < count && prim_id[i] != id)
+        {
+            ++i;
+        }
+
+        return i;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Typedefs
+//
+
+using triangle_packet4  = triangle_packet<4>;
+using triangle_packet8  = triangle_packet<8>;
+using triangle_packet16 = triangle_packet<16>;
+
+template <unsigned Size>
+using packet_bvh        = bvh_t<aligned_vector<triangle_packet<Size>, 64>, aligned_vector<bvh_node, 32>>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Ray / packet intersection
+//
+
+// Single ray: one SIMD test for all triangles ------------
+
+template <unsigned Size>
+inline hit_record<basic_ray<float>, primitive<unsigned>> intersect(
+        basic_ray<float> const&         ray,
+        triangle_packet<Size> const&    packet
+        )
+{
+    using F = simd::float_from_simd_width_t<Size>;
+    using vec_type = vector<3, F>;
+
+    hit_record<basic_ray<float>, primitive<unsigned>> result;
+    result.t = -1.0f;
+
+    vec_type v1(F(packet.v1[0]), F(packet.v1[1]), F(packet.v1[2]));
+    vec_type e1(F(packet.e1[0]), F(packet.e1[1]), F(packet.e1[2]));
+    vec_type e2(F(packet.e2[0]), F(packet.e2[1]), F(packet.e2[2]));
+
+    vec_type ori(ray.ori);
+    vec_type dir(ray.dir);
+
+    vec_type s1 = cross(dir, e2);
+    F div = dot(s1, e1);
+    F inv_div = F(1.0) / div;
+
+    vec_type d = ori - v1;
+    F b1 = dot(d, s1) * inv_div;
+
+    vec_type s2 = cross(d, e1);
+    F b2 = dot(dir, s2) * inv_div;
+
+    F t = dot(e2, s2) * inv_div;
+
+    auto hit = div != F(0.0)
+            && b1 >= F(0.0)
+            && b2 >= F(0.0)
+            && b1 + b2 <= F(1.0)
+            && t >= F(0.0);
+
+    if (!any(hit))
+    {
+        return result;
+    }
+
+    // Find the closest triangle
+    VSNRAY_ALIGN(64) float ts[Size];
+    VSNRAY_ALIGN(64) float us[Size];
+    VSNRAY_ALIGN(64) float vs[Size];
+
+    store(ts, select(hit, t, F(numeric_limits<float>::max())));
+    store(us, b1);
+    store(vs, b2);
+
+    unsigned closest = 0;
+
+    for (unsigned i = 1; i < Size; ++i)
+    {
+        if (ts[i] < ts[closest])
+        {
+            closest = i;
+        }
+    }
+
+    result.hit = true;
+    result.prim_id = packet.prim_id[closest];
+    result.geom_id = packet.geom_id[closest];
+    result.t = ts[closest];
+    result.u = us[closest];
+    result.v = vs[closest];
+    return result;
+}
+
+// Ray packets: test the triangles one after another ------
+
+template <typename R, unsigned Size>
+inline hit_record<R, primitive<unsigned>> intersect(R const& ray, triangle_packet<Size> const& packet)
+{
+    using T = typename R::scalar_type;
+
+    hit_record<R, primitive<unsigned>> result;
+
+    for (unsigned i = 0; i < packet.count; ++i)
+    {
+        auto hr = intersect(ray, packet.get_triangle(i));
+        update_if(result, hr, is_closer(hr, result));
+    }
+
+    result.t = select( result.hit, result.t, T(-1.0) );
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// get_bounds()
+//
+
+template <unsigned Size>
+inline aabb get_bounds(triangle_packet<Size> const& packet)
+{
+    aabb result;
+    result.invalidate();
+
+    for (unsigned i = 0; i < packet.count; ++i)
+    {
+        result.insert(get_bounds(packet.get_triangle(i)));
+    }
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Surface properties
+//
+// The geometric normal is computed from the triangle with the hit record's
+// prim_id. Per-face and per-vertex data is looked up by prim_id, as with
+// basic_triangle.
+//
+
+template <typename HR, unsigned Size>
+inline vector<3, float> get_normal(HR const& hr, triangle_packet<Size> const& packet)
+{
+    auto i = packet.find(hr.prim_id);
+
+    if (i == packet.count)
+    {
+        return vector<3, float>(0.0f);
+    }
+
+    auto t = packet.get_triangle(i);
+    return normalize(cross(t.e1, t.e2));
+}
+
+template <typename Normals, typename HR, unsigned Size>
+inline auto get_normal(Normals normals, HR const& hr, triangle_packet<Size> /* */)
+    -> decltype(get_normal(normals, hr, basic_triangle<3, float>{}))
+{
+    return get_normal(normals, hr, basic_triangle<3, float>{});
+}
+
+template <typename Normals, typename HR, unsigned Size>
+inline auto get_shading_normal(
+        Normals                     normals,
+        HR const&                   hr,
+        triangle_packet<Size>       /* */,
+        normals_per_vertex_binding  /* */
+        )
+    -> decltype(get_shading_normal(normals, hr, basic_triangle<3, float>{}, normals_per_vertex_binding{}))
+{
+    return get_shading_normal(normals, hr, basic_triangle<3, float>{}, normals_per_vertex_binding{});
+}
+
+template <typename Colors, typename HR, unsigned Size>
+inline auto get_color(
+        Colors                      colors,
+        HR const&                   hr,
+        triangle_packet<Size>       /* */,
+        colors_per_vertex_binding   /* */
+        )
+    -> decltype(get_color(colors, hr, basic_triangle<3, float>{}, colors_per_vertex_binding{}))
+{
+    return get_color(colors, hr, basic_triangle<3, float>{}, colors_per_vertex_binding{});
+}
+
+template <typename TexCoords, typename HR, unsigned Size>
+inline auto get_tex_coord(TexCoords tex_coords, HR const& hr, triangle_packet<Size> /* */)
+    -> decltype(get_tex_coord(tex_coords, hr, basic_triangle<3, float>{}))
+{
+    return get_tex_coord(tex_coords, hr, basic_triangle<3, float>{});
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// pack_leaves() interface
+//
+// Convert a bvh_t or index_bvh_t over basic_triangle<3, float> into a BVH over
+// triangle packets, e.g. pack_leaves<packet_bvh<8>>(tree). The nodes are kept,
+// the triangles of each leaf are packed into as few packets as possible.
+// Build the source tree with binned_sah_builder::set_packet_size(Size) and
+// max_leaf_size = Size to get one packet per leaf.
+//
+
+template <typename PacketBVH, typename BVH>
+PacketBVH pack_leaves(BVH const& b);
+
+} // visionaray
+
+#include "detail/bvh/pack_leaves.inl"
+
+#endif // VSNRAY_TRIANGLE_PACKET_H
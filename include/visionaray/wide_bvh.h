@@ -0,0 +1,542 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_WIDE_BVH_H
+#define VSNRAY_WIDE_BVH_H 1
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "math/simd/type_traits.h"
+#include "math/aabb.h"
+#include "math/forward.h"
+#include "math/limits.h"
+#include "math/vector.h"
+#include "aligned_vector.h"
+#include "bvh.h"
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// wide_bvh_node
+//
+// Node with up to Width children. The child bounds are stored in SoA layout, so
+// that a ray can be tested against all of them with a single SIMD slab test.
+// Leaves are stored inline in their parent node. Children are packed to the
+// front, unused slots at the end are marked empty.
+//
+
+template <unsigned Width>
+struct VSNRAY_ALIGN(32) wide_bvh_node
+{
+    static_assert(Width == 4 || Width == 8, "wide_bvh_node: Width must be 4 or 8");
+
+    enum { width = Width };
+
+    float bbox_min_x[Width];
+    float bbox_min_y[Width];
+    float bbox_min_z[Width];
+    float bbox_max_x[Width];
+    float bbox_max_y[Width];
+    float bbox_max_z[Width];
+    unsigned child[Width];      // Inner: index of the child node, leaf: index of the first primitive
+    unsigned num_prims[Width];  // 0 for inner nodes and empty slots
+
+    VSNRAY_FUNC bool is_empty(unsigned i) const { return num_prims[i] == 0 && child[i] == ~0U; }
+    VSNRAY_FUNC bool is_inner(unsigned i) const { return num_prims[i] == 0 && child[i] != ~0U; }
+    VSNRAY_FUNC bool is_leaf(unsigned i) const { return num_prims[i] != 0; }
+
+    VSNRAY_FUNC aabb get_bounds(unsigned i) const
+    {
+        return aabb(
+                vec3(bbox_min_x[i], bbox_min_y[i], bbox_min_z[i]),
+                vec3(bbox_max_x[i], bbox_max_y[i], bbox_max_z[i])
+                );
+    }
+
+    // Bounds of all children as SIMD vectors
+    template <typename F>
+    void get_bounds(vector<3, F>& bmin, vector<3, F>& bmax) const
+    {
+        static_assert(simd::num_elements<F>::value == Width, "Size mismatch");
+
+        bmin = vector<3, F>(F(bbox_min_x), F(bbox_min_y), F(bbox_min_z));
+        bmax = vector<3, F>(F(bbox_max_x), F(bbox_max_y), F(bbox_max_z));
+    }
+
+    VSNRAY_FUNC unsigned get_child(unsigned i) const
+    {
+        assert(is_inner(i));
+        return child[i];
+    }
+
+    VSNRAY_FUNC bvh_node::index_range get_indices(unsigned i) const
+    {
+        assert(is_leaf(i));
+        return { child[i], child[i] + num_prims[i] };
+    }
+
+    VSNRAY_FUNC void set_inner(unsigned i, aabb const& bounds, unsigned child_index)
+    {
+        set_bounds(i, bounds);
+        child[i] = child_index;
+        num_prims[i] = 0;
+    }
+
+    VSNRAY_FUNC void set_leaf(unsigned i, aabb const& bounds, unsigned first_primitive_index, unsigned count)
+    {
+        assert(count > 0);
+
+        set_bounds(i, bounds);
+        child[i] = first_primitive_index;
+        num_prims[i] = count;
+    }
+
+    VSNRAY_FUNC void set_empty(unsigned i)
+    {
+        // Traversal stops at the first empty slot, just move the box out of the way
+        vec3 far_away(numeric_limits<float>::max());
+        set_bounds(i, aabb(far_away, far_away));
+        child[i] = ~0U;
+        num_prims[i] = 0;
+    }
+
+    VSNRAY_FUNC void set_bounds(unsigned i, aabb const& bounds)
+    {
+        bbox_min_x[i] = bounds.min.x;
+        bbox_min_y[i] = bounds.min.y;
+        bbox_min_z[i] = bounds.min.z;
+        bbox_max_x[i] = bounds.max.x;
+        bbox_max_y[i] = bounds.max.y;
+        bbox_max_z[i] = bounds.max.z;
+    }
+};
+
+static_assert( sizeof(wide_bvh_node<4>) == 128, "Size mismatch" );
+static_assert( sizeof(wide_bvh_node<8>) == 256, "Size mismatch" );
+
+
+//-------------------------------------------------------------------------------------------------
+// compressed_wide_bvh_node
+//
+// Wide node with child bounds quantized to 8 or 16 bits (Q = uint8_t or uint16_t)
+// relative to the bounds of the node itself, cf. Ylitie et al. (2017): Efficient
+// Incoherent Ray Traversal on GPUs Through Compressed Wide BVHs.
+//
+// The quantization grid has a power of two spacing and its origin is a multiple
+// of the spacing, so decoding is exact. Lower bounds are rounded down and upper
+// bounds are rounded up, decoded boxes thus always contain the original ones.
+//
+// Provides the same interface as wide_bvh_node and can be traversed with the
+// same code. Constructed from a wide_bvh_node, cf. collapse(). Throws
+// std::range_error if the bounds are not finite or too large for the grid,
+// and std::length_error if a leaf has more than 65535 primitives.
+//
+
+template <unsigned Width, typename Q = uint8_t>
+struct VSNRAY_ALIGN(16) compressed_wide_bvh_node
+{
+    static_assert(Width == 4 || Width == 8, "compressed_wide_bvh_node: Width must be 4 or 8");
+    static_assert(
+            std::is_same<Q, uint8_t>::value || std::is_same<Q, uint16_t>::value,
+            "compressed_wide_bvh_node: Q must be uint8_t or uint16_t"
+            );
+
+    enum { width = Width };
+
+    float origin[3];
+    int8_t exponent[3];         // Grid spacing along each axis is 2^exponent
+    Q qmin_x[Width];
+    Q qmin_y[Width];
+    Q qmin_z[Width];
+    Q qmax_x[Width];
+    Q qmax_y[Width];
+    Q qmax_z[Width];
+    unsigned child[Width];      // Inner: index of the child node, leaf: index of the first primitive
+    uint16_t num_prims[Width];  // 0 for inner nodes and empty slots
+
+    compressed_wide_bvh_node() = default;
+
+    explicit compressed_wide_bvh_node(wide_bvh_node<Width> const& n)
+    {
+        aabb bounds;
+        bounds.invalidate();
+
+        for (unsigned i = 0; i < Width && !n.is_empty(i); ++i)
+        {
+            bounds.insert(n.get_bounds(i));
+        }
+
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (bounds.invalid())
+            {
+                // No children
+                origin[axis] = 0.0f;
+                exponent[axis] = 0;
+                continue;
+            }
+
+            init_grid(axis, bounds.min[axis], bounds.max[axis]);
+        }
+
+        for (unsigned i = 0; i < Width; ++i)
+        {
+            if (n.num_prims[i] > 0xFFFF)
+            {
+                throw std::length_error("compressed_wide_bvh_node: too many primitives in leaf");
+            }
+
+            child[i] = n.child[i];
+            num_prims[i] = static_cast<uint16_t>(n.num_prims[i]);
+
+            if (n.is_empty(i))
+            {
+                qmin_x[i] = qmin_y[i] = qmin_z[i] = Q(0);
+                qmax_x[i] = qmax_y[i] = qmax_z[i] = Q(0);
+                continue;
+            }
+
+            aabb b = n.get_bounds(i);
+
+            qmin_x[i] = quantize(b.min.x, 0, false);
+            qmin_y[i] = quantize(b.min.y, 1, false);
+            qmin_z[i] = quantize(b.min.z, 2, false);
+            qmax_x[i] = quantize(b.max.x, 0, true);
+            qmax_y[i] = quantize(b.max.y, 1, true);
+            qmax_z[i] = quantize(b.max.z, 2, true);
+        }
+    }
+
+    VSNRAY_FUNC bool is_empty(unsigned i) const { return num_prims[i] == 0 && child[i] == ~0U; }
+    VSNRAY_FUNC bool is_inner(unsigned i) const { return num_prims[i] == 0 && child[i] != ~0U; }
+    VSNRAY_FUNC bool is_leaf(unsigned i) const { return num_prims[i] != 0; }
+
+    VSNRAY_FUNC float scale(int axis) const
+    {
+        return ldexp(1.0f, exponent[axis]);
+    }
+
+    VSNRAY_FUNC aabb get_bounds(unsigned i) const
+    {
+        vec3 org(origin[0], origin[1], origin[2]);
+        vec3 s(scale(0), scale(1), scale(2));
+
+        return aabb(
+                org + vec3(qmin_x[i], qmin_y[i], qmin_z[i]) * s,
+                org + vec3(qmax_x[i], qmax_y[i], qmax_z[i]) * s
+                );
+    }
+
+    // Decode the bounds of all children to SIMD vectors
+    template <typename F>
+    void get_bounds(vector<3, F>& bmin, vector<3, F>& bmax) const
+    {
+        static_assert(simd::num_elements<F>::value == Width, "Size mismatch");
+
+        VSNRAY_ALIGN(32) float q[6][Width];
+
+        for (unsigned i = 0; i < Width; ++i)
+        {
+            q[0][i] = qmin_x[i];
+            q[1][i] = qmin_y[i];
+            q[2][i] = qmin_z[i];
+            q[3][i] = qmax_x[i];
+            q[4][i] = qmax_y[i];
+            q[5][i] = qmax_z[i];
+        }
+
+        vector<3, F> org(origin[0], origin[1], origin[2]);
+        vector<3, F> s(scale(0), scale(1), scale(2));
+
+        bmin = org + vector<3, F>(F(q[0]), F(q[1]), F(q[2])) * s;
+        bmax = org + vector<3, F>(F(q[3]), F(q[4]), F(q[5])) * s;
+    }
+
+    VSNRAY_FUNC unsigned get_child(unsigned i) const
+    {
+        assert(is_inner(i));
+        return child[i];
+    }
+
+    VSNRAY_FUNC bvh_node::index_range get_indices(unsigned i) const
+    {
+        assert(is_leaf(i));
+        return { child[i], child[i] + num_prims[i] };
+    }
+
+private:
+
+    // Choose the smallest grid spacing so that [lo..hi] is covered by the
+    // quantized range and all grid points are representable as floats
+    void init_grid(int axis, float lo, float hi)
+    {
+        if (!std::isfinite(lo) || !std::isfinite(hi))
+        {
+            throw std::range_error("compressed_wide_bvh_node: bounds are not finite");
+        }
+
+        float max_q = static_cast<float>(numeric_limits<Q>::max());
+
+        // Lower bounds for the exponent from the extent and from the magnitude,
+        // the extent may overflow float
+        int e = -126;
+        int e_extent = 0;
+        int e_magnitude = 0;
+
+        if (hi > lo)
+        {
+            std::frexp((static_cast<double>(hi) - lo) / max_q, &e_extent);
+            e = std::max(e, e_extent - 1);
+        }
+
+        if (lo != 0.0f)
+        {
+            std::frexp(lo, &e_magnitude);
+            e = std::max(e, e_magnitude - 23);
+        }
+
+        // Spacing and origin must be finite, the exponent must fit into int8_t
+        for (; e <= 127; ++e)
+        {
+            float s = std::ldexp(1.0f, e);
+            float org = std::floor(lo / s) * s;
+
+            if (std::isfinite(org)
+             && static_cast<double>(org) + static_cast<double>(max_q) * s >= hi
+             && std::abs(org / s) + max_q < 16777216.0f /* 2^24 */)
+            {
+                origin[axis] = org;
+                exponent[axis] = static_cast<int8_t>(e);
+                return;
+            }
+        }
+
+        throw std::range_error("compressed_wide_bvh_node: bounds too large to quantize");
+    }
+
+    // Round to the next grid point below (or above) v. The initial guess
+    // may be off by one due to rounding, decoding is exact though
+    Q quantize(float v, int axis, bool round_up) const
+    {
+        float max_q = static_cast<float>(numeric_limits<Q>::max());
+        float s = scale(axis);
+        float q = (v - origin[axis]) / s;
+
+        q = std::min(std::max(round_up ? std::ceil(q) : std::floor(q), 0.0f), max_q);
+
+        while (!round_up && q > 0.0f && origin[axis] + q * s > v)
+        {
+            q -= 1.0f;
+        }
+
+        while (round_up && q < max_q && origin[axis] + q * s < v)
+        {
+            q += 1.0f;
+        }
+
+        return static_cast<Q>(q);
+    }
+};
+
+static_assert( sizeof(compressed_wide_bvh_node<4>) == 64, "Size mismatch" );
+static_assert( sizeof(compressed_wide_bvh_node<8>) == 112, "Size mismatch" );
+
+
+//-------------------------------------------------------------------------------------------------
+// wide_bvh_ref_t
+//
+
+template <typename PrimitiveType, typename NodeType>
+class wide_bvh_ref_t
+{
+public:
+
+    using primitive_type = PrimitiveType;
+    using node_type = NodeType;
+
+private:
+
+    using P = const PrimitiveType;
+    using N = const NodeType;
+
+    P* primitives_first;
+    P* primitives_last;
+    N* nodes_first;
+    N* nodes_last;
+
+public:
+
+    wide_bvh_ref_t() = default;
+
+    wide_bvh_ref_t(P* p0, P* p1, N* n0, N* n1)
+        : primitives_first(p0)
+        , primitives_last(p1)
+        , nodes_first(n0)
+        , nodes_last(n1)
+    {
+    }
+
+    VSNRAY_FUNC size_t num_primitives() const { return primitives_last - primitives_first; }
+    VSNRAY_FUNC size_t num_nodes() const { return nodes_last - nodes_first; }
+
+    VSNRAY_FUNC P& primitive(size_t index) const
+    {
+        return primitives_first[index];
+    }
+
+    VSNRAY_FUNC N& node(size_t index) const
+    {
+        return nodes_first[index];
+    }
+
+    VSNRAY_FUNC bool operator==(wide_bvh_ref_t const& rhs) const
+    {
+        return primitives_first == rhs.primitives_first
+            && primitives_last  == rhs.primitives_last
+            && nodes_first      == rhs.nodes_first
+            && nodes_last       == rhs.nodes_last;
+    }
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// wide_bvh_t
+//
+// Primitives are stored in leaf order, wide BVHs have no index indirection.
+// Construct with collapse() from a binary [index_]bvh_t.
+//
+
+template <typename PrimitiveVector, typename NodeVector>
+class wide_bvh_t
+{
+public:
+
+    using primitive_type    = typename PrimitiveVector::value_type;
+    using primitive_vector  = PrimitiveVector;
+    using node_type         = typename NodeVector::value_type;
+    using node_vector       = NodeVector;
+
+    using bvh_ref = wide_bvh_ref_t<primitive_type, node_type>;
+
+    enum { width = node_type::width };
+
+public:
+
+    wide_bvh_t() = default;
+
+    primitive_vector const& primitives() const  { return primitives_; }
+    primitive_vector&       primitives()        { return primitives_; }
+
+    node_vector const&      nodes() const       { return nodes_; }
+    node_vector&            nodes()             { return nodes_; }
+
+    size_t num_primitives() const               { return primitives_.size(); }
+    size_t num_nodes() const                    { return nodes_.size(); }
+
+    bvh_ref ref() const
+    {
+        auto p0 = detail::get_pointer(primitives());
+        auto p1 = p0 + primitives().size();
+
+        auto n0 = detail::get_pointer(nodes());
+        auto n1 = n0 + nodes().size();
+
+        return { p0, p1, n0, n1 };
+    }
+
+    primitive_type const& primitive(size_t index) const
+    {
+        return primitives_[index];
+    }
+
+    node_type const& node(size_t index) const
+    {
+        return nodes_[index];
+    }
+
+private:
+
+    primitive_vector primitives_;
+    node_vector nodes_;
+
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// wide bvh traits
+//
+
+template <typename T1, typename T2>
+struct is_wide_bvh<wide_bvh_t<T1, T2>> : std::true_type {};
+
+template <typename T1, typename T2>
+struct is_wide_bvh<wide_bvh_ref_t<T1, T2>> : std::true_type {};
+
+
+//-------------------------------------------------------------------------------------------------
+// get_bounds()
+//
+
+template <
+    typename BVH,
+    typename = typename std::enable_if<is_wide_bvh<BVH>::value>::type
+    >
+aabb get_bounds(BVH const& bvh)
+{
+    aabb result;
+    result.invalidate();
+
+    if (bvh.num_nodes() > 0)
+    {
+        auto const& root = bvh.node(0);
+
+        for (unsigned i = 0; i < BVH::node_type::width && !root.is_empty(i); ++i)
+        {
+            result.insert(root.get_bounds(i));
+        }
+    }
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Typedefs
+//
+
+template <typename P>
+using bvh4              = wide_bvh_t<aligned_vector<P>, aligned_vector<wide_bvh_node<4>, 32>>;
+template <typename P>
+using bvh8              = wide_bvh_t<aligned_vector<P>, aligned_vector<wide_bvh_node<8>, 32>>;
+template <typename P>
+using compressed_bvh4   = wide_bvh_t<aligned_vector<P>, aligned_vector<compressed_wide_bvh_node<4>, 16>>;
+template <typename P>
+using compressed_bvh8   = wide_bvh_t<aligned_vector<P>, aligned_vector<compressed_wide_bvh_node<8>, 16>>;
+
+
+//-------------------------------------------------------------------------------------------------
+// collapse() interface
+//
+// Collapse a binary [index_]bvh_t into a wide BVH. Child nodes with the largest
+// surface area are opened until a wide node has Width children. Works with both
+// uncompressed and compressed node types, e.g. collapse<compressed_bvh8<P>>(tree).
+//
+
+template <typename WideBVH, typename BVH>
+WideBVH collapse(BVH const& b);
+
+} // visionaray
+
+#include "detail/bvh/collapse.inl"
+#include "detail/bvh/intersect_wide.inl"
+
+#endif // VSNRAY_WIDE_BVH_H
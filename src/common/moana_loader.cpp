@@ -9,6 +9,7 @@
 #include <memory>
 #include <ostream>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include <boost/iostreams/device/mapped_file.hpp>
@@ -94,8 +95,8 @@ static void store_faces(
     size_t last = 2;
     auto i1 = remap_index(faces[0].vertex_index, num_vertices);
 
-    // simply construct new vertices for each obj face we encounter
-    // ..too hard to keep track of v/vn combinations..
+    // Store the v/vn indices of the triangle fan, vertices and normals are
+    // shared by all meshes of the obj file
     while (last != faces.size())
     {
         // triangle indices
@@ -765,6 +766,13 @@ struct reset_flags_visitor : sg::node_visitor
 
         node_visitor::apply(tm);
     }
+
+    void apply(sg::indexed_triangle_mesh& itm)
+    {
+        itm.flags() = 0;
+
+        node_visitor::apply(itm);
+    }
 };
 
 
@@ -864,7 +872,40 @@ struct statistics_visitor : sg::node_visitor
         apply(static_cast<sg::node&>(tm));
     }
 
+    void apply(sg::indexed_triangle_mesh& itm)
+    {
+        if (itm.flags() == 0)
+        {
+            // Vertex and normal arrays are shared by the meshes of an obj file
+            if (itm.vertices != nullptr && vertex_arrays.insert(itm.vertices.get()).second)
+            {
+                vertices_bytes += itm.vertices->size() * sizeof(vec3);
+            }
+
+            if (itm.normals != nullptr && normal_arrays.insert(itm.normals.get()).second)
+            {
+                normals_bytes += itm.normals->size() * sizeof(vec3);
+            }
+
+            indices_bytes += itm.vertex_indices.size() * sizeof(int);
+            indices_bytes += itm.normal_indices.size() * sizeof(int);
+            indices_bytes += itm.tex_coord_indices.size() * sizeof(int);
+            face_ids_bytes += itm.face_ids.size() * sizeof(int);
+
+            mesh_node_bytes += sizeof(sg::indexed_triangle_mesh);
+            node_bytes_total += sizeof(sg::indexed_triangle_mesh);
+
+            itm.flags() = ~itm.flags(); // Don't count twice
+        }
+
+        apply(static_cast<sg::node&>(itm));
+    }
+
+    std::unordered_set<void const*> vertex_arrays;
+    std::unordered_set<void const*> normal_arrays;
+
     size_t vertices_bytes = 0;
+    size_t indices_bytes = 0;
     size_t normals_bytes = 0;
     size_t tex_coords_bytes = 0;
     size_t face_ids_bytes = 0;
@@ -1098,6 +1139,8 @@ void load_moana(std::vector<std::string> const& filenames, model& mod)
                 {
                     // No. Rather the default case, add the top level
                     // json file's geomObjFile content as an instance
+                    // (the nodes are shared, the viewer flattens them into
+                    // one mesh instance per path)
                     for (auto c : base_transform->children())
                     {
                         transform->add_child(c);
@@ -1151,6 +1194,7 @@ void load_moana(std::vector<std::string> const& filenames, model& mod)
 
     std::cout << "Vertices            (MB): " << stats_visitor.vertices_bytes / MB << '\n';
     std::cout << "Normals             (MB): " << stats_visitor.normals_bytes / MB << '\n';
+    std::cout << "Indices             (MB): " << stats_visitor.indices_bytes / MB << '\n';
     std::cout << "Texture coordinates (MB): " << stats_visitor.tex_coords_bytes / MB << '\n';
     std::cout << "Face IDs            (MB): " << stats_visitor.face_ids_bytes / MB << '\n';
     std::cout << "Matrices            (MB): " << stats_visitor.matrix_bytes / MB << '\n';
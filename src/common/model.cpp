@@ -198,4 +198,22 @@ bool model::load(std::vector<std::string> const& filenames)
     return false;
 }
 
+
+//-------------------------------------------------------------------------------------------------
+// make_woop_triangles()
+//
+
+model::woop_triangle_list make_woop_triangles(model::triangle_list const& triangles)
+{
+    model::woop_triangle_list result;
+    result.reserve(triangles.size());
+
+    for (auto const& t : triangles)
+    {
+        result.emplace_back(t);
+    }
+
+    return result;
+}
+
 } // visionaray
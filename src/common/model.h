@@ -17,6 +17,7 @@
 #include <visionaray/math/triangle.h>
 #include <visionaray/math/unorm.h>
 #include <visionaray/math/vector.h>
+#include <visionaray/math/woop_triangle.h>
 #include <visionaray/texture/forward.h>
 #include <visionaray/texture/texture.h>
 #include <visionaray/aligned_vector.h>
@@ -36,21 +37,23 @@ class model : public file_base
 {
 public:
 
-    using material_type     = sg::obj_material;
+    using material_type      = sg::obj_material;
 
-    using triangle_type     = basic_triangle<3, float>;
-    using normal_type       = vector<3, float>;
-    using tex_coord_type    = vector<2, float>;
-    using color_type        = vector<3, float>;
-    using texture_type      = texture<vector<4, unorm<8>>, 2>;
+    using triangle_type      = basic_triangle<3, float>;
+    using woop_triangle_type = basic_woop_triangle<float>;
+    using normal_type        = vector<3, float>;
+    using tex_coord_type     = vector<2, float>;
+    using color_type         = vector<3, float>;
+    using texture_type       = texture<vector<4, unorm<8>>, 2>;
 
-    using triangle_list     = aligned_vector<triangle_type>;
-    using normal_list       = aligned_vector<normal_type>;
-    using tex_coord_list    = aligned_vector<tex_coord_type>;
-    using color_list        = aligned_vector<color_type>;
-    using mat_list          = aligned_vector<material_type>;
-    using tex_map           = std::map<std::string, texture_type>;
-    using tex_list          = aligned_vector<typename texture_type::ref_type>;
+    using triangle_list      = aligned_vector<triangle_type>;
+    using woop_triangle_list = aligned_vector<woop_triangle_type>;
+    using normal_list        = aligned_vector<normal_type>;
+    using tex_coord_list     = aligned_vector<tex_coord_type>;
+    using color_list         = aligned_vector<color_type>;
+    using mat_list           = aligned_vector<material_type>;
+    using tex_map            = std::map<std::string, texture_type>;
+    using tex_list           = aligned_vector<typename texture_type::ref_type>;
 
 public:
 
@@ -83,6 +86,14 @@ public:
     aabb            bbox;
 };
 
+
+//-------------------------------------------------------------------------------------------------
+// Convert triangles to triangles with precomputed intersection transforms,
+// prim_id and geom_id are kept
+//
+
+model::woop_triangle_list make_woop_triangles(model::triangle_list const& triangles);
+
 } // visionaray
 
 #endif // VSNRAY_COMMON_MODEL_H
@@ -7,6 +7,7 @@
 #include <visionaray/math/simd/type_traits.h>
 #include <visionaray/math/array.h>
 #include <visionaray/math/forward.h>
+#include <visionaray/math/indexed_triangle.h>
 #include <visionaray/math/triangle.h>
 #include <visionaray/math/vector.h>
 #include <visionaray/texture/texture_traits.h>
@@ -168,6 +169,18 @@ inline auto get_tex_coord(
     return simd::pack(coords);
 }
 
+// Indexed triangles, face ids are looked up by prim_id like with triangles
+template <typename HR, typename T>
+inline auto get_tex_coord(
+        ptex::face_id_t const*      face_ids,
+        HR const&                   hr,
+        basic_indexed_triangle<T>   /* */
+        )
+    -> decltype( get_tex_coord(face_ids, hr, basic_triangle<3, T>{}) )
+{
+    return get_tex_coord(face_ids, hr, basic_triangle<3, T>{});
+}
+
 template <>
 struct texture_dimensions<ptex::texture>
 {
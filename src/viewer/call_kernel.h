@@ -21,7 +21,7 @@ namespace visionaray
 //-------------------------------------------------------------------------------------------------
 // Convenience functions to call built-in or custom kernels with a scheduler
 //
-// This basically wraps sched.frame()
+// This basically wraps sched.frame(), pass an async_sched_ref to render asynchronously
 // Determines pixel-sampler types based on the algorithm chosen
 // Handles SSAA
 //
@@ -32,11 +32,31 @@ namespace visionaray
 enum algorithm { Simple, Whitted, Pathtracing };
 
 
+//-------------------------------------------------------------------------------------------------
+// Scheduler that submits frames with SCHED.frame_async() and stores the frame in HANDLE
+//
+
+template <typename Sched>
+struct async_sched_ref
+{
+    template <typename K, typename SP>
+    void frame(K kernel, SP sched_params)
+    {
+        handle = sched.frame_async(kernel, sched_params);
+    }
+
+    Sched&        sched;
+    frame_handle& handle;
+};
+
+
 //-------------------------------------------------------------------------------------------------
 // Pinhole camera vs. thin lens camera
 //
+// Trailing ARGS (e.g. an intersector) are passed on to make_sched_params()
+//
 
-template <typename Sched, typename KParams, typename RT>
+template <typename Sched, typename KParams, typename RT, typename ...Args>
 inline void call_kernel(
         algorithm                                        algo,
         Sched&                                           sched,
@@ -44,7 +64,8 @@ inline void call_kernel(
         unsigned&                                        frame_num,
         unsigned                                         ssaa_samples,
         variant<pinhole_camera, thin_lens_camera> const& cam,
-        RT&                                              rt
+        RT&                                              rt,
+        Args&&...                                        args
         )
 {
     if (cam.as<thin_lens_camera>())
@@ -56,7 +77,8 @@ inline void call_kernel(
                 frame_num,
                 ssaa_samples,
                 *cam.as<thin_lens_camera>(),
-                rt
+                rt,
+                std::forward<Args>(args)...
                 );
     }
     else
@@ -68,7 +90,8 @@ inline void call_kernel(
                 frame_num,
                 ssaa_samples,
                 *cam.as<pinhole_camera>(),
-                rt
+                rt,
+                std::forward<Args>(args)...
                 );
     }
 }
@@ -8,6 +8,8 @@
 
 #include <common/config.h>
 
+#include <memory>
+
 #ifdef __CUDACC__
 #include <thrust/device_vector.h>
 #endif
@@ -15,6 +17,7 @@
 #include <visionaray/math/simd/simd.h>
 #include <visionaray/math/forward.h>
 #include <visionaray/math/ray.h>
+#include <visionaray/math/indexed_triangle.h>
 //#include <visionaray/math/sphere.h>
 #include <visionaray/math/triangle.h>
 #include <visionaray/math/vector.h>
@@ -23,6 +26,7 @@
 #include <visionaray/bvh.h>
 #include <visionaray/generic_light.h>
 #include <visionaray/generic_material.h>
+#include <visionaray/intersector.h>
 #include <visionaray/material.h>
 #include <visionaray/pinhole_camera.h>
 #include <visionaray/point_light.h>
@@ -62,6 +66,7 @@ using ray_type_cpu              = basic_ray<scalar_type_cpu>;
 using ray_type_gpu              = basic_ray<scalar_type_gpu>;
 
 using camera_t = variant<pinhole_camera, thin_lens_camera>;
+using triangle_t = basic_indexed_triangle<float>;
 using plastic_t = plastic<float>;
 using generic_light_t = generic_light<
         point_light<float>,
@@ -87,53 +92,71 @@ template <typename R>
 using host_sched_t = tbb_sched<R>;
 #else
 template <typename R>
-using host_sched_t = tiled_sched<R>;
+using host_sched_t = adaptive_sched<R>;
 #endif
 
 
+//-------------------------------------------------------------------------------------------------
+// Frame that is rendered asynchronously with host_sched_t::frame_async()
+//
+// The kernel refers to BVH refs, lights and an intersector that are set up by
+// the render function, DATA keeps them alive until the frame has finished.
+// HANDLE is destroyed first, so that the frame finishes before DATA is released
+//
+
+struct async_frame
+{
+    std::shared_ptr<void> data;
+    frame_handle          handle;
+};
+
+
 //-------------------------------------------------------------------------------------------------
 // Render from lists, only material is plastic
 //
 
 void render_plastic_cpp(
-        index_bvh<basic_triangle<3, float>> const& bvh,
-        aligned_vector<vec3> const&                geometric_normals,
-        aligned_vector<vec3> const&                shading_normals,
-        aligned_vector<vec2> const&                tex_coords,
-        aligned_vector<plastic_t> const&           materials,
-        aligned_vector<texture_t> const&           textures,
-        aligned_vector<point_light<float>> const&  lights,
-        unsigned                                   bounces,
-        float                                      epsilon,
-        vec4                                       bgcolor,
-        vec4                                       ambient,
-        host_device_rt&                            rt,
-        host_sched_t<ray_type_cpu>&                sched,
-        camera_t const&                            cam,
-        unsigned&                                  frame_num,
-        algorithm                                  algo,
-        unsigned                                   ssaa_samples
+        index_bvh<triangle_t> const&              bvh,
+        aligned_vector<vec3> const&               vertices,
+        aligned_vector<vec3> const&               geometric_normals,
+        aligned_vector<vec3> const&               shading_normals,
+        aligned_vector<vec2> const&               tex_coords,
+        aligned_vector<plastic_t> const&          materials,
+        aligned_vector<texture_t> const&          textures,
+        aligned_vector<point_light<float>> const& lights,
+        unsigned                                  bounces,
+        float                                     epsilon,
+        vec4                                      bgcolor,
+        vec4                                      ambient,
+        host_device_rt&                           rt,
+        host_sched_t<ray_type_cpu>&               sched,
+        camera_t const&                           cam,
+        unsigned&                                 frame_num,
+        algorithm                                 algo,
+        unsigned                                  ssaa_samples,
+        async_frame*                              async
         );
 
 #ifdef __CUDACC__
 void render_plastic_cu(
-        cuda_index_bvh<basic_triangle<3, float>>&         bvh,
-        thrust::device_vector<vec3> const&                geometric_normals,
-        thrust::device_vector<vec3> const&                shading_normals,
-        thrust::device_vector<vec2> const&                tex_coords,
-        thrust::device_vector<plastic_t> const&           materials,
-        thrust::device_vector<cuda_texture_t> const&      textures,
-        aligned_vector<point_light<float>> const&         host_lights,
-        unsigned                                          bounces,
-        float                                             epsilon,
-        vec4                                              bgcolor,
-        vec4                                              ambient,
-        host_device_rt&                                   rt,
-        cuda_sched<ray_type_gpu>&                         sched,
-        camera_t const&                                   cam,
-        unsigned&                                         frame_num,
-        algorithm                                         algo,
-        unsigned                                          ssaa_samples
+        cuda_index_bvh<triangle_t>&                  bvh,
+        thrust::device_vector<vec3> const&           vertices,
+        thrust::device_vector<vec3> const&           geometric_normals,
+        thrust::device_vector<vec3> const&           shading_normals,
+        thrust::device_vector<vec2> const&           tex_coords,
+        thrust::device_vector<plastic_t> const&      materials,
+        thrust::device_vector<cuda_texture_t> const& textures,
+        aligned_vector<point_light<float>> const&    host_lights,
+        unsigned                                     bounces,
+        float                                        epsilon,
+        vec4                                         bgcolor,
+        vec4                                         ambient,
+        host_device_rt&                              rt,
+        cuda_sched<ray_type_gpu>&                    sched,
+        camera_t const&                              cam,
+        unsigned&                                    frame_num,
+        algorithm                                    algo,
+        unsigned                                     ssaa_samples
         );
 #endif
 
@@ -143,7 +166,8 @@ void render_plastic_cu(
 //
 
 void render_generic_material_cpp(
-        index_bvh<basic_triangle<3, float>> const&                         bvh,
+        index_bvh<triangle_t> const&                                       bvh,
+        aligned_vector<vec3> const&                                        vertices,
         aligned_vector<vec3> const&                                        geometric_normals,
         aligned_vector<vec3> const&                                        shading_normals,
         aligned_vector<vec2> const&                                        tex_coords,
@@ -159,12 +183,14 @@ void render_generic_material_cpp(
         camera_t const&                                                    cam,
         unsigned&                                                          frame_num,
         algorithm                                                          algo,
-        unsigned                                                           ssaa_samples
+        unsigned                                                           ssaa_samples,
+        async_frame*                                                       async
         );
 
 #ifdef __CUDACC__
 void render_generic_material_cu(
-        cuda_index_bvh<basic_triangle<3, float>>&                          bvh,
+        cuda_index_bvh<triangle_t>&                                        bvh,
+        thrust::device_vector<vec3> const&                                 vertices,
         thrust::device_vector<vec3> const&                                 geometric_normals,
         thrust::device_vector<vec3> const&                                 shading_normals,
         thrust::device_vector<vec2> const&                                 tex_coords,
@@ -190,69 +216,74 @@ void render_generic_material_cu(
 //
 
 void render_instances_cpp(
-        index_bvh<index_bvh<basic_triangle<3, float>>::bvh_inst>& bvh,
-        aligned_vector<vec3> const&                               /*geometric_normals*/,
-        aligned_vector<vec3> const&                               shading_normals,
-        aligned_vector<vec2> const&                               tex_coords,
-        aligned_vector<generic_material_t> const&                 materials,
-        aligned_vector<vec3> const&                               colors,
-        aligned_vector<texture_t> const&                          textures,
-        aligned_vector<generic_light_t> const&                    lights,
-        unsigned                                                  bounces,
-        float                                                     epsilon,
-        vec4                                                      bgcolor,
-        vec4                                                      ambient,
-        host_device_rt&                                           rt,
-        host_sched_t<ray_type_cpu>&                               sched,
-        camera_t const&                                           cam,
-        unsigned&                                                 frame_num,
-        algorithm                                                 algo,
-        unsigned                                                  ssaa_samples
+        index_bvh<index_bvh<triangle_t>::bvh_inst>& bvh,
+        aligned_vector<vec3> const&                 vertices,
+        aligned_vector<vec3> const&                 /*geometric_normals*/,
+        aligned_vector<vec3> const&                 shading_normals,
+        aligned_vector<vec2> const&                 tex_coords,
+        aligned_vector<generic_material_t> const&   materials,
+        aligned_vector<vec3> const&                 colors,
+        aligned_vector<texture_t> const&            textures,
+        aligned_vector<generic_light_t> const&      lights,
+        unsigned                                    bounces,
+        float                                       epsilon,
+        vec4                                        bgcolor,
+        vec4                                        ambient,
+        host_device_rt&                             rt,
+        host_sched_t<ray_type_cpu>&                 sched,
+        camera_t const&                             cam,
+        unsigned&                                   frame_num,
+        algorithm                                   algo,
+        unsigned                                    ssaa_samples,
+        async_frame*                                async
         );
 
 #ifdef __CUDACC__
 void render_instances_cu(
-        cuda_index_bvh<cuda_index_bvh<basic_triangle<3, float>>::bvh_inst>& bvh,
-        thrust::device_vector<vec3> const&                                  geometric_normals,
-        thrust::device_vector<vec3> const&                                  shading_normals,
-        thrust::device_vector<vec2> const&                                  tex_coords,
-        thrust::device_vector<generic_material_t> const&                    materials,
-        thrust::device_vector<vec3> const&                                  colors,
-        thrust::device_vector<cuda_texture_t> const&                        textures,
-        aligned_vector<generic_light_t> const&                              lights,
-        unsigned                                                            bounces,
-        float                                                               epsilon,
-        vec4                                                                bgcolor,
-        vec4                                                                ambient,
-        host_device_rt&                                                     rt,
-        cuda_sched<ray_type_gpu>&                                           sched,
-        camera_t const&                                                     cam,
-        unsigned&                                                           frame_num,
-        algorithm                                                           algo,
-        unsigned                                                            ssaa_samples
+        cuda_index_bvh<cuda_index_bvh<triangle_t>::bvh_inst>& bvh,
+        thrust::device_vector<vec3> const&                    vertices,
+        thrust::device_vector<vec3> const&                    geometric_normals,
+        thrust::device_vector<vec3> const&                    shading_normals,
+        thrust::device_vector<vec2> const&                    tex_coords,
+        thrust::device_vector<generic_material_t> const&      materials,
+        thrust::device_vector<vec3> const&                    colors,
+        thrust::device_vector<cuda_texture_t> const&          textures,
+        aligned_vector<generic_light_t> const&                lights,
+        unsigned                                              bounces,
+        float                                                 epsilon,
+        vec4                                                  bgcolor,
+        vec4                                                  ambient,
+        host_device_rt&                                       rt,
+        cuda_sched<ray_type_gpu>&                             sched,
+        camera_t const&                                       cam,
+        unsigned&                                             frame_num,
+        algorithm                                             algo,
+        unsigned                                              ssaa_samples
         );
 #endif
 
 #if VSNRAY_COMMON_HAVE_PTEX
 // With ptex textures
 void render_instances_ptex_cpp(
-        index_bvh<index_bvh<basic_triangle<3, float>>::bvh_inst>& bvh,
-        aligned_vector<vec3> const&                               /*geometric_normals*/,
-        aligned_vector<vec3> const&                               shading_normals,
-        aligned_vector<ptex::face_id_t> const&                    face_ids,
-        aligned_vector<generic_material_t> const&                 materials,
-        aligned_vector<ptex::texture> const&                      textures,
-        aligned_vector<generic_light_t> const&                    lights,
-        unsigned                                                  bounces,
-        float                                                     epsilon,
-        vec4                                                      bgcolor,
-        vec4                                                      ambient,
-        host_device_rt&                                           rt,
-        host_sched_t<ray_type_cpu>&                               sched,
-        camera_t const&                                           cam,
-        unsigned&                                                 frame_num,
-        algorithm                                                 algo,
-        unsigned                                                  ssaa_samples
+        index_bvh<index_bvh<triangle_t>::bvh_inst>& bvh,
+        aligned_vector<vec3> const&                 vertices,
+        aligned_vector<vec3> const&                 /*geometric_normals*/,
+        aligned_vector<vec3> const&                 shading_normals,
+        aligned_vector<ptex::face_id_t> const&      face_ids,
+        aligned_vector<generic_material_t> const&   materials,
+        aligned_vector<ptex::texture> const&        textures,
+        aligned_vector<generic_light_t> const&      lights,
+        unsigned                                    bounces,
+        float                                       epsilon,
+        vec4                                        bgcolor,
+        vec4                                        ambient,
+        host_device_rt&                             rt,
+        host_sched_t<ray_type_cpu>&                 sched,
+        camera_t const&                             cam,
+        unsigned&                                   frame_num,
+        algorithm                                   algo,
+        unsigned                                    ssaa_samples,
+        async_frame*                                async
         );
 #endif
 
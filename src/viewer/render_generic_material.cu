@@ -9,11 +9,12 @@ namespace visionaray
 {
 
 void render_generic_material_cu(
-        cuda_index_bvh<basic_triangle<3, float>>&                          bvh,
+        cuda_index_bvh<triangle_t>&                                        bvh,
+        thrust::device_vector<vec3> const&                                 vertices,
         thrust::device_vector<vec3> const&                                 geometric_normals,
         thrust::device_vector<vec3> const&                                 shading_normals,
         thrust::device_vector<vec2> const&                                 tex_coords,
-        thrust::device_vector<generic_material_t> const&                    materials,
+        thrust::device_vector<generic_material_t> const&                   materials,
         thrust::device_vector<cuda_texture_t> const&                       textures,
         aligned_vector<area_light<float, basic_triangle<3, float>>> const& host_lights,
         unsigned                                                           bounces,
@@ -28,7 +29,7 @@ void render_generic_material_cu(
         unsigned                                                           ssaa_samples
         )
 {
-    using bvh_ref = cuda_index_bvh<basic_triangle<3, float>>::bvh_ref;
+    using bvh_ref = cuda_index_bvh<triangle_t>::bvh_ref;
 
     thrust::device_vector<bvh_ref> primitives;
 
@@ -53,7 +54,9 @@ void render_generic_material_cu(
             ambient
             );
 
-    call_kernel( algo, sched, kparams, frame_num, ssaa_samples, cam, rt );
+    indexed_triangle_intersector isect(thrust::raw_pointer_cast(vertices.data()));
+
+    call_kernel( algo, sched, kparams, frame_num, ssaa_samples, cam, rt, isect );
 }
 
 } // visionaray
@@ -9,49 +9,72 @@ namespace visionaray
 {
 
 void render_plastic_cpp(
-        index_bvh<basic_triangle<3, float>> const& bvh,
-        aligned_vector<vec3> const&                geometric_normals,
-        aligned_vector<vec3> const&                shading_normals,
-        aligned_vector<vec2> const&                tex_coords,
-        aligned_vector<plastic_t> const&           materials,
-        aligned_vector<texture_t> const&           textures,
-        aligned_vector<point_light<float>> const&  lights,
-        unsigned                                   bounces,
-        float                                      epsilon,
-        vec4                                       bgcolor,
-        vec4                                       ambient,
-        host_device_rt&                            rt,
-        host_sched_t<ray_type_cpu>&                sched,
-        camera_t const&                            cam,
-        unsigned&                                  frame_num,
-        algorithm                                  algo,
-        unsigned                                   ssaa_samples
+        index_bvh<triangle_t> const&              bvh,
+        aligned_vector<vec3> const&               vertices,
+        aligned_vector<vec3> const&               geometric_normals,
+        aligned_vector<vec3> const&               shading_normals,
+        aligned_vector<vec2> const&               tex_coords,
+        aligned_vector<plastic_t> const&          materials,
+        aligned_vector<texture_t> const&          textures,
+        aligned_vector<point_light<float>> const& lights,
+        unsigned                                  bounces,
+        float                                     epsilon,
+        vec4                                      bgcolor,
+        vec4                                      ambient,
+        host_device_rt&                           rt,
+        host_sched_t<ray_type_cpu>&               sched,
+        camera_t const&                           cam,
+        unsigned&                                 frame_num,
+        algorithm                                 algo,
+        unsigned                                  ssaa_samples,
+        async_frame*                              async
         )
 {
-    using bvh_ref = index_bvh<basic_triangle<3, float>>::bvh_ref;
+    using bvh_ref = index_bvh<triangle_t>::bvh_ref;
 
-    aligned_vector<bvh_ref> primitives;
+    // Data the kernel refers to, must outlive an asynchronous frame
+    struct frame_data
+    {
+        aligned_vector<bvh_ref>            primitives;
+        aligned_vector<point_light<float>> lights;
+        indexed_triangle_intersector       isect;
+    };
 
-    primitives.push_back(bvh.ref());
+    auto data = std::make_shared<frame_data>(frame_data{
+            { bvh.ref() },
+            lights,
+            indexed_triangle_intersector(vertices.data())
+            });
 
     auto kparams = make_kernel_params(
             normals_per_vertex_binding{},
-            primitives.data(),
-            primitives.data() + primitives.size(),
+            data->primitives.data(),
+            data->primitives.data() + data->primitives.size(),
             geometric_normals.data(),
             shading_normals.data(),
             tex_coords.data(),
             materials.data(),
             textures.data(),
-            lights.data(),
-            lights.data() + lights.size(),
+            data->lights.data(),
+            data->lights.data() + data->lights.size(),
             bounces,
             epsilon,
             bgcolor,
             ambient
             );
 
-    call_kernel( algo, sched, kparams, frame_num, ssaa_samples, cam, rt );
+    if (async)
+    {
+        async_sched_ref<host_sched_t<ray_type_cpu>> async_sched{ sched, async->handle };
+
+        call_kernel( algo, async_sched, kparams, frame_num, ssaa_samples, cam, rt, data->isect );
+
+        async->data = data;
+    }
+    else
+    {
+        call_kernel( algo, sched, kparams, frame_num, ssaa_samples, cam, rt, data->isect );
+    }
 }
 
 } // visionaray
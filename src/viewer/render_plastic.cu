@@ -9,26 +9,27 @@ namespace visionaray
 {
 
 void render_plastic_cu(
-        cuda_index_bvh<basic_triangle<3, float>>&         bvh,
-        thrust::device_vector<vec3> const&                geometric_normals,
-        thrust::device_vector<vec3> const&                shading_normals,
-        thrust::device_vector<vec2> const&                tex_coords,
-        thrust::device_vector<plastic_t> const&           materials,
-        thrust::device_vector<cuda_texture_t> const&      textures,
-        aligned_vector<point_light<float>> const&         host_lights,
-        unsigned                                          bounces,
-        float                                             epsilon,
-        vec4                                              bgcolor,
-        vec4                                              ambient,
-        host_device_rt&                                   rt,
-        cuda_sched<ray_type_gpu>&                         sched,
-        camera_t const&                                   cam,
-        unsigned&                                         frame_num,
-        algorithm                                         algo,
-        unsigned                                          ssaa_samples
+        cuda_index_bvh<triangle_t>&                  bvh,
+        thrust::device_vector<vec3> const&           vertices,
+        thrust::device_vector<vec3> const&           geometric_normals,
+        thrust::device_vector<vec3> const&           shading_normals,
+        thrust::device_vector<vec2> const&           tex_coords,
+        thrust::device_vector<plastic_t> const&      materials,
+        thrust::device_vector<cuda_texture_t> const& textures,
+        aligned_vector<point_light<float>> const&    host_lights,
+        unsigned                                     bounces,
+        float                                        epsilon,
+        vec4                                         bgcolor,
+        vec4                                         ambient,
+        host_device_rt&                              rt,
+        cuda_sched<ray_type_gpu>&                    sched,
+        camera_t const&                              cam,
+        unsigned&                                    frame_num,
+        algorithm                                    algo,
+        unsigned                                     ssaa_samples
         )
 {
-    using bvh_ref = cuda_index_bvh<basic_triangle<3, float>>::bvh_ref;
+    using bvh_ref = cuda_index_bvh<triangle_t>::bvh_ref;
 
     thrust::device_vector<bvh_ref> primitives;
 
@@ -53,7 +54,9 @@ void render_plastic_cu(
             ambient
             );
 
-    call_kernel( algo, sched, kparams, frame_num, ssaa_samples, cam, rt );
+    indexed_triangle_intersector isect(thrust::raw_pointer_cast(vertices.data()));
+
+    call_kernel( algo, sched, kparams, frame_num, ssaa_samples, cam, rt, isect );
 }
 
 } // visionaray
@@ -6,24 +6,25 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
-#include <chrono>
 #include <cmath>
 #include <cstdint>
 #include <exception>
 #include <fstream>
-#include <future>
+#include <functional>
 #include <iomanip>
 #include <iostream>
 #include <istream>
 #include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
-#include <mutex>
 #include <new>
 #include <ostream>
 #include <set>
+#include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
 #include <boost/filesystem.hpp>
 
@@ -37,6 +38,7 @@
 #include <Support/CmdLine.h>
 #include <Support/CmdLineUtil.h>
 
+#include <visionaray/detail/thread_pool.h>
 #include <visionaray/gl/bvh_outline_renderer.h>
 #include <visionaray/gl/debug_callback.h>
 #include <visionaray/math/math.h>
@@ -44,6 +46,7 @@
 #include <visionaray/aligned_vector.h>
 #include <visionaray/area_light.h>
 #include <visionaray/bvh.h>
+#include <visionaray/bvh_file.h>
 #include <visionaray/generic_material.h>
 #include <visionaray/kernels.h>
 #include <visionaray/material.h>
@@ -88,7 +91,7 @@ using viewer_type = viewer_glut;
 
 struct renderer : viewer_type
 {
-    using primitive_type            = model::triangle_type;
+    using primitive_type            = triangle_t;
     using normal_type               = model::normal_type;
     using tex_coord_type            = model::tex_coord_type;
     using color_type                = model::color_type;
@@ -101,9 +104,10 @@ struct renderer : viewer_type
 
     enum bvh_build_strategy
     {
-        Binned = 0, // Binned SAH builder, no spatial splits
-        Split,      // Split BVH, also binned and with SAH
-        LBVH,       // LBVH builder on the CPU
+        Binned = 0,   // Binned SAH builder, no spatial splits
+        Split,        // Split BVH, also binned and with SAH
+        LBVH,         // LBVH builder on the CPU
+        SplitInPlace, // Split BVH, built in place with bounded memory
     };
 
     enum texture_format { Ptex, UV };
@@ -159,6 +163,7 @@ struct renderer : viewer_type
         add_cmdline_option( cl::makeOption<bvh_build_strategy&>({
                 { "default",            Binned,         "Binned SAH" },
                 { "split",              Split,          "Binned SAH with spatial splits" },
+                { "split_inplace",      SplitInPlace,   "Binned SAH with spatial splits, in place with bounded memory" },
                 { "lbvh",               LBVH,           "LBVH (CPU)" }
             },
             "bvh",
@@ -167,6 +172,14 @@ struct renderer : viewer_type
             cl::init(this->build_strategy)
             ) );
 
+        add_cmdline_option( cl::makeOption<std::string&>(
+            cl::Parser<>(),
+            "bvh_cache",
+            cl::Desc("Directory to cache BVHs in (no caching if empty)"),
+            cl::ArgRequired,
+            cl::init(this->bvh_cache)
+            ) );
+
         add_cmdline_option( cl::makeOption<unsigned&>({
                 { "1",      1,      "1x supersampling" },
                 { "2",      2,      "2x supersampling" },
@@ -309,12 +322,24 @@ struct renderer : viewer_type
                     {
                         build_strategy = Split;
                     }
+                    else if (bvh == "split_inplace")
+                    {
+                        build_strategy = SplitInPlace;
+                    }
                     else if (bvh == "lbvh")
                     {
                         build_strategy = LBVH;
                     }
                 }
 
+                // bvh cache
+                std::string bvh_cache = "";
+                err = ini.get_string("bvh_cache", bvh_cache);
+                if (err == inifile::Ok)
+                {
+                    this->bvh_cache = bvh_cache;
+                }
+
                 // color space
                 std::string colorspace = "";
                 err = ini.get_string("colorspace", colorspace);
@@ -417,6 +442,7 @@ struct renderer : viewer_type
     unsigned                                    ssaa_samples    = 1;
     algorithm                                   algo            = Simple;
     bvh_build_strategy                          build_strategy  = Binned;
+    std::string                                 bvh_cache;
     bool                                        use_headlight   = true;
     bool                                        use_dof         = false;
     bool                                        show_hud        = true;
@@ -432,6 +458,7 @@ struct renderer : viewer_type
 
     index_bvh<host_bvh_type::bvh_inst>          host_top_level_bvh;
     aligned_vector<host_bvh_type>               host_bvhs;
+    aligned_vector<vec3>                        vertices;
     aligned_vector<host_bvh_type::bvh_inst>     host_instances;
     aligned_vector<plastic<float>>              plastic_materials;
     aligned_vector<generic_material_t>          generic_materials;
@@ -446,6 +473,7 @@ struct renderer : viewer_type
 #ifdef __CUDACC__
     cuda_index_bvh<device_bvh_type::bvh_inst>   device_top_level_bvh;
     std::vector<device_bvh_type>                device_bvhs;
+    thrust::device_vector<vec3>                 device_vertices;
     thrust::device_vector<normal_type>          device_geometric_normals;
     thrust::device_vector<normal_type>          device_shading_normals;
     thrust::device_vector<tex_coord_type>       device_tex_coords;
@@ -481,8 +509,7 @@ struct renderer : viewer_type
     gl::debug_callback                          gl_debug_callback;
 
     bool                                        render_async  = false;
-    std::future<void>                           render_future;
-    std::mutex                                  display_mutex;
+    async_frame                                 host_frame;
 
     void build_scene();
 
@@ -499,8 +526,9 @@ private:
 
     void load_camera(std::string filename);
     void clear_frame();
+    void finish_frame(bool cancel = false);
     void render_hud();
-    void render_impl();
+    void render_impl(async_frame* async = nullptr);
 
 };
 
@@ -655,7 +683,8 @@ std::ostream& operator<<(std::ostream& out, pinhole_camera const& cam)
 
 struct icosahedron
 {
-    aligned_vector<basic_triangle<3, float>> triangles;
+    aligned_vector<triangle_t> triangles;   // Indices relative to the first vertex
+    aligned_vector<vec3> vertices;
     aligned_vector<vec3> normals;
 };
 
@@ -703,33 +732,22 @@ icosahedron make_icosahedron()
         { 7, 2, 11 }
         };
 
-    auto make_triangle = [&](int index)
-    {
-        vec3i idx = indices[index];
-        return basic_triangle<3, float>(
-                vertices[idx.x],
-                vertices[idx.y] - vertices[idx.x],
-                vertices[idx.z] - vertices[idx.x]
-                );
-    };
-
     icosahedron result;
     result.triangles.resize(20);
-    result.normals.resize(20 * 3);
+    result.vertices.resize(12);
+    result.normals.resize(12);
 
     for (int i = 0; i < 20; ++i)
     {
-        result.triangles[i] = make_triangle(i);
-
         vec3i idx = indices[i];
 
-        vec3 v1 = vertices[idx.x];
-        vec3 v2 = vertices[idx.y];
-        vec3 v3 = vertices[idx.z];
+        result.triangles[i] = triangle_t(idx.x, idx.y, idx.z);
+    }
 
-        result.normals[i * 3] = normalize(v1);
-        result.normals[i * 3 + 1] = normalize(v2);
-        result.normals[i * 3 + 2] = normalize(v3);
+    for (int i = 0; i < 12; ++i)
+    {
+        result.vertices[i] = vertices[i];
+        result.normals[i] = normalize(vertices[i]);
     }
 
     return result;
@@ -774,14 +792,136 @@ struct reset_flags_visitor : sg::node_visitor
 };
 
 
+//-------------------------------------------------------------------------------------------------
+// Build a BVH over the triangles, or load it from the BVH cache directory
+//
+// The triangles index into VERTICES, [first_vertex..first_vertex+num_vertices)
+// is the range they reference. Cache files are keyed by the triangles, that
+// vertex range and the build strategy. Cached BVHs are mapped and copied into
+// a host BVH, which also backs the area lights and the device BVHs.
+//
+
+renderer::host_bvh_type build_bvh(
+        renderer::primitive_type const* triangles,
+        size_t                          num_triangles,
+        vec3 const*                     vertices,
+        size_t                          first_vertex,
+        size_t                          num_vertices,
+        renderer::bvh_build_strategy    build_strategy,
+        std::string const&              bvh_cache,
+        thread_pool&                    build_pool
+        )
+{
+    using host_bvh_type = renderer::host_bvh_type;
+
+    host_bvh_type result;
+
+    std::string filename;
+    uint64_t key = 0;
+
+    if (!bvh_cache.empty())
+    {
+        key = bvh_cache_key(
+                vertices + first_vertex,
+                num_vertices,
+                bvh_cache_key(triangles, num_triangles, static_cast<uint64_t>(build_strategy))
+                );
+
+        std::ostringstream name;
+        name << std::hex << std::setw(16) << std::setfill('0') << key << ".bvh";
+
+        filename = (boost::filesystem::path(bvh_cache) / name.str()).string();
+
+        mapped_bvh<host_bvh_type> file;
+
+        if (file.open(filename, key))
+        {
+            result.primitives().assign(file.primitives().begin(), file.primitives().end());
+            result.nodes().assign(file.nodes().begin(), file.nodes().end());
+            result.indices().assign(file.indices().begin(), file.indices().end());
+
+            return result;
+        }
+    }
+
+    if (build_strategy == renderer::LBVH)
+    {
+        lbvh_builder builder;
+
+        build_indexed_triangles(result, builder, triangles, num_triangles, vertices, build_pool);
+    }
+    else
+    {
+        binned_sah_builder builder;
+        builder.enable_spatial_splits(build_strategy == renderer::Split || build_strategy == renderer::SplitInPlace);
+        builder.enable_in_place(build_strategy == renderer::SplitInPlace);
+
+        build_indexed_triangles(result, builder, triangles, num_triangles, vertices, build_pool);
+    }
+
+    if (!filename.empty())
+    {
+        boost::system::error_code ec;
+        boost::filesystem::create_directories(bvh_cache, ec);
+
+        if (!save_bvh(filename, result, key))
+        {
+            std::cerr << "Cannot write BVH cache file: " << filename << '\n';
+        }
+    }
+
+    return result;
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Instance
 //
+// The scene graph is flattened into a single instance level: a subgraph that
+// is shared by several transforms yields one instance per mesh and path, with
+// the transforms along the path concatenated. Mesh BVHs are shared, but the
+// top level BVH grows with the number of paths. Nested BVH instances would
+// need render kernels for each nesting depth, the viewer only has kernels
+// for a top level BVH over mesh instances.
+//
 
 struct instance
 {
     int index;
     mat4 transform;
+    unsigned geom_id;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Corner of an indexed triangle mesh (vertex, normal, tex coord and color index)
+//
+
+struct corner_key
+{
+    int v;
+    int n;
+    int t;
+    int c;
+
+    bool operator==(corner_key const& rhs) const
+    {
+        return v == rhs.v && n == rhs.n && t == rhs.t && c == rhs.c;
+    }
+};
+
+struct corner_hash
+{
+    size_t operator()(corner_key const& key) const
+    {
+        std::hash<int> h;
+
+        size_t seed = h(key.v);
+        seed = seed * 31 + h(key.n);
+        seed = seed * 31 + h(key.t);
+        seed = seed * 31 + h(key.c);
+        return seed;
+    }
 };
 
 
@@ -796,6 +936,7 @@ struct build_scene_visitor : sg::node_visitor
     build_scene_visitor(
             aligned_vector<renderer::host_bvh_type>& bvhs,
             aligned_vector<instance>& instances,
+            aligned_vector<vec3>& vertices,
             aligned_vector<vec3>& shading_normals,
             aligned_vector<vec3>& geometric_normals,
             aligned_vector<vec2>& tex_coords,
@@ -806,10 +947,13 @@ struct build_scene_visitor : sg::node_visitor
             aligned_vector<std::pair<std::string, thin_lens_camera>>& cameras,
             aligned_vector<point_light<float>>& point_lights,
             aligned_vector<spot_light<float>>& spot_lights,
-            renderer::bvh_build_strategy build_strategy
+            renderer::bvh_build_strategy build_strategy,
+            std::string const& bvh_cache,
+            thread_pool& build_pool
             )
         : bvhs_(bvhs)
         , instances_(instances)
+        , vertices_(vertices)
         , shading_normals_(shading_normals)
         , geometric_normals_(geometric_normals)
         , tex_coords_(tex_coords)
@@ -822,6 +966,8 @@ struct build_scene_visitor : sg::node_visitor
         , spot_lights_(spot_lights)
         , environment_map(nullptr)
         , build_strategy_(build_strategy)
+        , bvh_cache_(bvh_cache)
+        , build_pool_(build_pool)
     {
     }
 
@@ -884,7 +1030,12 @@ struct build_scene_visitor : sg::node_visitor
     {
         unsigned prev = current_geom_id_;
 
-        if (sp.flags() == 0 && sp.material() && sp.textures().find("diffuse") != sp.textures().end())
+        if (sp.flags() != 0)
+        {
+            // Visited before, meshes below that are instanced again need the geom_id
+            current_geom_id_ = static_cast<unsigned>(~sp.flags());
+        }
+        else if (sp.material() && sp.textures().find("diffuse") != sp.textures().end())
         {
             std::shared_ptr<sg::material> material = sp.material();
             std::shared_ptr<sg::texture> texture = sp.textures()["diffuse"];
@@ -902,7 +1053,7 @@ struct build_scene_visitor : sg::node_visitor
                 current_geom_id_ = static_cast<unsigned>(std::distance(surfaces.begin(), it));
             }
 
-            sp.flags() = ~sp.flags();
+            sp.flags() = ~static_cast<uint64_t>(current_geom_id_);
         }
 
         node_visitor::apply(sp);
@@ -916,42 +1067,43 @@ struct build_scene_visitor : sg::node_visitor
         {
             auto ico = make_icosahedron();
 
+            unsigned first_vertex = static_cast<unsigned>(vertices_.size());
+
+            vertices_.insert(vertices_.end(), ico.vertices.begin(), ico.vertices.end());
             shading_normals_.insert(shading_normals_.end(), ico.normals.begin(), ico.normals.end());
+            tex_coords_.resize(vertices_.size(), vec2(0.0f));
 
             for (size_t i = 0; i < ico.triangles.size(); ++i)
             {
                 auto& tri = ico.triangles[i];
 
+                tri.i1 += first_vertex;
+                tri.i2 += first_vertex;
+                tri.i3 += first_vertex;
                 tri.prim_id = current_prim_id_++;
                 tri.geom_id = current_geom_id_;
 
-                vec3 n = normalize(cross(tri.e1, tri.e2));
+                auto t = make_triangle(tri, vertices_.data());
 
-                geometric_normals_.emplace_back(n);
-                tex_coords_.emplace_back(0.0f, 0.0f);
-                tex_coords_.emplace_back(0.0f, 0.0f);
-                tex_coords_.emplace_back(0.0f, 0.0f);
+                geometric_normals_.emplace_back(normalize(cross(t.e1, t.e2)));
             }
 
             // Build single bvh
-            if (build_strategy_ == renderer::LBVH)
-            {
-                lbvh_builder builder;
-
-                bvhs_.emplace_back(builder.build(renderer::host_bvh_type{}, ico.triangles.data(), ico.triangles.size()));
-            }
-            else
-            {
-                binned_sah_builder builder;
-                builder.enable_spatial_splits(build_strategy_ == renderer::Split);
-
-                bvhs_.emplace_back(builder.build(renderer::host_bvh_type{}, ico.triangles.data(), ico.triangles.size()));
-            }
+            bvhs_.emplace_back(build_bvh(
+                    ico.triangles.data(),
+                    ico.triangles.size(),
+                    vertices_.data(),
+                    first_vertex,
+                    ico.vertices.size(),
+                    build_strategy_,
+                    bvh_cache_,
+                    build_pool_
+                    ));
 
             sph.flags() = ~(bvhs_.size() - 1);
         }
 
-        instances_.push_back({ static_cast<int>(~sph.flags()), current_transform_ });
+        instances_.push_back({ static_cast<int>(~sph.flags()), current_transform_, current_geom_id_ });
 
         node_visitor::apply(sph);
     }
@@ -962,22 +1114,37 @@ struct build_scene_visitor : sg::node_visitor
         {
             assert(tm.vertices.size() % 3 == 0);
 
-            aligned_vector<basic_triangle<3, float>> triangles(tm.vertices.size() / 3);
+            // Triangle soup, the vertices are not shared
+            size_t first_vertex = vertices_.size();
+            size_t num_vertices = tm.vertices.size();
+
+            assert(first_vertex + num_vertices <= std::numeric_limits<unsigned>::max());
 
-            size_t first_geometric_normal = geometric_normals_.size();
-            geometric_normals_.resize(geometric_normals_.size() + tm.vertices.size() / 3);
+            vertices_.insert(vertices_.end(), tm.vertices.begin(), tm.vertices.end());
 
-            shading_normals_.insert(shading_normals_.end(), tm.normals.begin(), tm.normals.end());
+            aligned_vector<triangle_t> triangles(num_vertices / 3);
 
-            tex_coords_.insert(tex_coords_.end(), tm.tex_coords.begin(), tm.tex_coords.end());
+            bool has_normals = tm.normals.size() == num_vertices;
 
-            size_t first_color = colors_.size();
-            if (tm.colors.size() > 0)
+            if (has_normals)
             {
-                colors_.resize(first_color + tm.colors.size());
+                shading_normals_.insert(shading_normals_.end(), tm.normals.begin(), tm.normals.end());
+            }
+
+            if (tm.tex_coords.size() == num_vertices)
+            {
+                tex_coords_.insert(tex_coords_.end(), tm.tex_coords.begin(), tm.tex_coords.end());
+            }
+
+            tex_coords_.resize(vertices_.size(), vec2(0.0f));
+
+            if (tm.colors.size() == num_vertices)
+            {
+                colors_.resize(first_vertex, vec3(1.0f));
+
                 for (size_t i = 0; i < tm.colors.size(); ++i)
                 {
-                    colors_[first_color + i] = vec3(tm.colors[i]);
+                    colors_.push_back(vec3(tm.colors[i]));
                 }
             }
 
@@ -985,41 +1152,44 @@ struct build_scene_visitor : sg::node_visitor
             face_ids_.insert(face_ids_.end(), tm.face_ids.begin(), tm.face_ids.end());
 #endif
 
-            for (size_t i = 0; i < tm.vertices.size(); i += 3)
+            for (size_t i = 0; i < num_vertices; i += 3)
             {
-                vec3 v1 = tm.vertices[i];
-                vec3 v2 = tm.vertices[i + 1];
-                vec3 v3 = tm.vertices[i + 2];
+                unsigned index = static_cast<unsigned>(first_vertex + i);
 
-                basic_triangle<3, float> tri(v1, v2 - v1, v3 - v1);
+                triangle_t tri(index, index + 1, index + 2);
                 tri.prim_id = current_prim_id_++;
                 tri.geom_id = current_geom_id_;
                 triangles[i / 3] = tri;
 
-                vec3 gn = normalize(cross(v2 - v1, v3 - v1));
+                auto t = make_triangle(tri, vertices_.data());
 
-                geometric_normals_[first_geometric_normal + i / 3] = gn;
-            }
+                vec3 gn = normalize(cross(t.e1, t.e2));
 
-            // Build single bvh
-            if (build_strategy_ == renderer::LBVH)
-            {
-                lbvh_builder builder;
+                geometric_normals_.emplace_back(gn);
 
-                bvhs_.emplace_back(builder.build(renderer::host_bvh_type{}, triangles.data(), triangles.size()));
+                if (!has_normals)
+                {
+                    // Flat shading
+                    shading_normals_.insert(shading_normals_.end(), 3, gn);
+                }
             }
-            else
-            {
-                binned_sah_builder builder;
-                builder.enable_spatial_splits(build_strategy_ == renderer::Split);
 
-                bvhs_.emplace_back(builder.build(renderer::host_bvh_type{}, triangles.data(), triangles.size()));
-            }
+            // Build single bvh
+            bvhs_.emplace_back(build_bvh(
+                    triangles.data(),
+                    triangles.size(),
+                    vertices_.data(),
+                    first_vertex,
+                    num_vertices,
+                    build_strategy_,
+                    bvh_cache_,
+                    build_pool_
+                    ));
 
             tm.flags() = ~(bvhs_.size() - 1);
         }
 
-        instances_.push_back({ static_cast<int>(~tm.flags()), current_transform_ });
+        instances_.push_back({ static_cast<int>(~tm.flags()), current_transform_, current_geom_id_ });
 
         node_visitor::apply(tm);
     }
@@ -1029,79 +1199,83 @@ struct build_scene_visitor : sg::node_visitor
         if (itm.flags() == 0 && itm.vertex_indices.size() > 0)
         {
             assert(itm.vertex_indices.size() % 3 == 0);
+            assert(itm.normal_indices.size() == 0 || itm.normal_indices.size() == itm.vertex_indices.size());
+            assert(itm.tex_coord_indices.size() == 0 || itm.tex_coord_indices.size() == itm.vertex_indices.size());
+            assert(itm.color_indices.size() == 0 || itm.color_indices.size() == itm.vertex_indices.size());
 
-            aligned_vector<basic_triangle<3, float>> triangles(itm.vertex_indices.size() / 3);
+            bool has_normals    = itm.normal_indices.size() > 0;
+            bool has_tex_coords = itm.tex_coord_indices.size() > 0;
+            bool has_colors     = itm.color_indices.size() > 0;
 
-            size_t first_geometric_normal = geometric_normals_.size();
-            geometric_normals_.resize(geometric_normals_.size() + itm.vertex_indices.size() / 3);
+            size_t first_vertex = vertices_.size();
+            size_t num_triangles = itm.vertex_indices.size() / 3;
 
-            size_t first_shading_normal = shading_normals_.size();
-            if (itm.normal_indices.size() > 0)
-            {
-                assert(itm.normal_indices.size() % 3 == 0);
-                shading_normals_.resize(shading_normals_.size() + itm.normal_indices.size());
-            }
-            else
-            {
-                shading_normals_.resize(shading_normals_.size() + itm.vertex_indices.size());
-            }
+            aligned_vector<triangle_t> triangles(num_triangles);
 
-            size_t first_tex_coord = tex_coords_.size();
-            if (itm.tex_coord_indices.size() > 0)
+            if (has_colors)
             {
-                assert(itm.tex_coord_indices.size() % 3 == 0);
-                tex_coords_.resize(tex_coords_.size() + itm.tex_coord_indices.size());
+                colors_.resize(first_vertex, vec3(1.0f));
             }
 
-            size_t first_color = colors_.size();
-            if (itm.color_indices.size() > 0)
-            {
-                assert(itm.color_indices.size() % 3 == 0);
-                colors_.resize(first_color + itm.color_indices.size());
-            }
+            // Corners with the same vertex, normal, texture coordinate and
+            // color indices are stored once. Without normals, the faces are
+            // shaded flat and don't share their corners
+            std::unordered_map<corner_key, unsigned, corner_hash> corners;
 
-            for (size_t i = 0; i < itm.vertex_indices.size(); i += 3)
+            for (size_t i = 0; i < num_triangles; ++i)
             {
-                vec3 v1 = (*itm.vertices)[itm.vertex_indices[i]];
-                vec3 v2 = (*itm.vertices)[itm.vertex_indices[i + 1]];
-                vec3 v3 = (*itm.vertices)[itm.vertex_indices[i + 2]];
-
-                basic_triangle<3, float> tri(v1, v2 - v1, v3 - v1);
-                tri.prim_id = current_prim_id_++;
-                tri.geom_id = current_geom_id_;
-                triangles[i / 3] = tri;
+                vec3 v1 = (*itm.vertices)[itm.vertex_indices[i * 3]];
+                vec3 v2 = (*itm.vertices)[itm.vertex_indices[i * 3 + 1]];
+                vec3 v3 = (*itm.vertices)[itm.vertex_indices[i * 3 + 2]];
 
                 vec3 gn = normalize(cross(v2 - v1, v3 - v1));
 
-                geometric_normals_[first_geometric_normal + i / 3] = gn;
+                geometric_normals_.emplace_back(gn);
+
+                unsigned indices[3];
 
-                if (itm.normal_indices.size() == 0)
+                for (size_t k = 0; k < 3; ++k)
                 {
-                    shading_normals_[first_shading_normal + i]     = gn;
-                    shading_normals_[first_shading_normal + i + 1] = gn;
-                    shading_normals_[first_shading_normal + i + 2] = gn;
-                }
-            }
+                    size_t j = i * 3 + k;
 
-            for (size_t i = 0; i < itm.normal_indices.size(); i += 3)
-            {
-                shading_normals_[first_shading_normal + i]     = (*itm.normals)[itm.normal_indices[i]];
-                shading_normals_[first_shading_normal + i + 1] = (*itm.normals)[itm.normal_indices[i + 1]];
-                shading_normals_[first_shading_normal + i + 2] = (*itm.normals)[itm.normal_indices[i + 2]];
-            }
+                    corner_key key = {
+                            itm.vertex_indices[j],
+                            has_normals    ? itm.normal_indices[j]    : -1,
+                            has_tex_coords ? itm.tex_coord_indices[j] : -1,
+                            has_colors     ? itm.color_indices[j]     : -1
+                            };
 
-            for (size_t i = 0; i < itm.tex_coord_indices.size(); i += 3)
-            {
-                tex_coords_[first_tex_coord + i]     = (*itm.tex_coords)[itm.tex_coord_indices[i]];
-                tex_coords_[first_tex_coord + i + 1] = (*itm.tex_coords)[itm.tex_coord_indices[i + 1]];
-                tex_coords_[first_tex_coord + i + 2] = (*itm.tex_coords)[itm.tex_coord_indices[i + 2]];
-            }
+                    unsigned index = static_cast<unsigned>(vertices_.size());
 
-            for (size_t i = 0; i < itm.color_indices.size(); i += 3)
-            {
-                colors_[first_color + i]     = vec3((*itm.colors)[itm.color_indices[i]]);
-                colors_[first_color + i + 1] = vec3((*itm.colors)[itm.color_indices[i + 1]]);
-                colors_[first_color + i + 2] = vec3((*itm.colors)[itm.color_indices[i + 2]]);
+                    if (has_normals)
+                    {
+                        auto it = corners.emplace(key, index);
+
+                        if (!it.second)
+                        {
+                            indices[k] = it.first->second;
+                            continue;
+                        }
+                    }
+
+                    assert(vertices_.size() < std::numeric_limits<unsigned>::max());
+
+                    vertices_.push_back((*itm.vertices)[key.v]);
+                    shading_normals_.push_back(has_normals ? (*itm.normals)[key.n] : gn);
+                    tex_coords_.push_back(has_tex_coords ? (*itm.tex_coords)[key.t] : vec2(0.0f));
+
+                    if (has_colors)
+                    {
+                        colors_.push_back(vec3((*itm.colors)[key.c]));
+                    }
+
+                    indices[k] = index;
+                }
+
+                triangle_t tri(indices[0], indices[1], indices[2]);
+                tri.prim_id = current_prim_id_++;
+                tri.geom_id = current_geom_id_;
+                triangles[i] = tri;
             }
 
 #if VSNRAY_COMMON_HAVE_PTEX
@@ -1110,24 +1284,21 @@ struct build_scene_visitor : sg::node_visitor
 
 
             // Build single bvh
-            if (build_strategy_ == renderer::LBVH)
-            {
-                lbvh_builder builder;
-
-                bvhs_.emplace_back(builder.build(renderer::host_bvh_type{}, triangles.data(), triangles.size()));
-            }
-            else
-            {
-                binned_sah_builder builder;
-                builder.enable_spatial_splits(build_strategy_ == renderer::Split);
-
-                bvhs_.emplace_back(builder.build(renderer::host_bvh_type{}, triangles.data(), triangles.size()));
-            }
+            bvhs_.emplace_back(build_bvh(
+                    triangles.data(),
+                    triangles.size(),
+                    vertices_.data(),
+                    first_vertex,
+                    vertices_.size() - first_vertex,
+                    build_strategy_,
+                    bvh_cache_,
+                    build_pool_
+                    ));
 
             itm.flags() = ~(bvhs_.size() - 1);
         }
 
-        instances_.push_back({ static_cast<int>(~itm.flags()), current_transform_ });
+        instances_.push_back({ static_cast<int>(~itm.flags()), current_transform_, current_geom_id_ });
 
         node_visitor::apply(itm);
     }
@@ -1142,9 +1313,12 @@ struct build_scene_visitor : sg::node_visitor
     // Storage bvhs
     aligned_vector<renderer::host_bvh_type>& bvhs_;
 
-    // Instances (BVH index + transform)
+    // Instances (BVH index + transform + geom_id)
     aligned_vector<instance>& instances_;
 
+    // Vertices shared by the triangles of all BVHs
+    aligned_vector<vec3>& vertices_;
+
     // Shading normals
     aligned_vector<vec3>& shading_normals_;
 
@@ -1183,6 +1357,12 @@ struct build_scene_visitor : sg::node_visitor
     // BVH build strategy
     renderer::bvh_build_strategy build_strategy_;
 
+    // BVH cache directory (no caching if empty)
+    std::string const& bvh_cache_;
+
+    // Thread pool for parallel BVH construction
+    thread_pool& build_pool_;
+
 };
 
 
@@ -1196,23 +1376,58 @@ void renderer::build_scene()
 
     std::cout << "Creating BVH...\n";
 
+    thread_pool build_pool(std::thread::hardware_concurrency());
+
     if (mod.scene_graph == nullptr)
     {
-        // Single BVH
-        host_bvhs.resize(1);
-        if (build_strategy == LBVH)
-        {
-            lbvh_builder builder;
+        // Triangle soup, the vertices of triangle i are 3 * i + 0..2, just
+        // like the per-vertex normals, tex coords and colors of the model
+        size_t num_triangles = mod.primitives.size();
+
+        assert(num_triangles * 3 <= std::numeric_limits<unsigned>::max());
+
+        aligned_vector<primitive_type> triangles(num_triangles);
+        vertices.resize(num_triangles * 3);
+
+        bool has_geometric_normals = mod.geometric_normals.size() == num_triangles;
 
-            host_bvhs[0] = builder.build(host_bvh_type{}, mod.primitives.data(), mod.primitives.size());
+        if (!has_geometric_normals)
+        {
+            mod.geometric_normals.resize(num_triangles);
         }
-        else
+
+        for (size_t i = 0; i < num_triangles; ++i)
         {
-            binned_sah_builder builder;
-            builder.enable_spatial_splits(build_strategy == Split);
+            auto const& tri = mod.primitives[i];
+
+            vertices[i * 3]     = tri.v1;
+            vertices[i * 3 + 1] = tri.v1 + tri.e1;
+            vertices[i * 3 + 2] = tri.v1 + tri.e2;
+
+            unsigned index = static_cast<unsigned>(i * 3);
 
-            host_bvhs[0] = builder.build(host_bvh_type{}, mod.primitives.data(), mod.primitives.size());
+            triangles[i] = primitive_type(index, index + 1, index + 2);
+            triangles[i].prim_id = tri.prim_id;
+            triangles[i].geom_id = tri.geom_id;
+
+            if (!has_geometric_normals)
+            {
+                mod.geometric_normals[i] = normalize(cross(tri.e1, tri.e2));
+            }
         }
+
+        // Single BVH
+        host_bvhs.resize(1);
+        host_bvhs[0] = build_bvh(
+                triangles.data(),
+                triangles.size(),
+                vertices.data(),
+                0,
+                vertices.size(),
+                build_strategy,
+                bvh_cache,
+                build_pool
+                );
     }
     else
     {
@@ -1224,6 +1439,7 @@ void renderer::build_scene()
         build_scene_visitor build_visitor(
                 host_bvhs,
                 instances,
+                vertices,
                 mod.shading_normals, // TODO!!!
                 mod.geometric_normals,
                 mod.tex_coords,
@@ -1234,15 +1450,29 @@ void renderer::build_scene()
                 cameras,
                 point_lights,
                 spot_lights,
-                build_strategy
+                build_strategy,
+                bvh_cache,
+                build_pool
                 );
         mod.scene_graph->accept(build_visitor);
 
+        // Only some meshes may have colors
+        if (mod.colors.size() > 0)
+        {
+            mod.colors.resize(vertices.size(), vec3(1.0f));
+        }
+
         host_instances.resize(instances.size());
         for (size_t i = 0; i < instances.size(); ++i)
         {
             size_t index = instances[i].index;
             host_instances[i] = host_bvhs[index].inst(instances[i].transform);
+
+            // Meshes can be instanced with different surface properties
+            host_instances[i].set_geom_id(instances[i].geom_id);
+
+            // Path through the scene graph, in traversal order
+            host_instances[i].set_inst_id(static_cast<unsigned>(i));
         }
 
         // Single BVH
@@ -1250,10 +1480,12 @@ void renderer::build_scene()
         {
             lbvh_builder builder;
 
-            host_top_level_bvh = builder.build(
-                    index_bvh<host_bvh_type::bvh_inst>{},
+            build_top_level(
+                    host_top_level_bvh,
+                    builder,
                     host_instances.data(),
-                    host_instances.size()
+                    host_instances.size(),
+                    build_pool
                     );
         }
         else
@@ -1261,10 +1493,12 @@ void renderer::build_scene()
             binned_sah_builder builder;
             builder.enable_spatial_splits(false);
 
-            host_top_level_bvh = builder.build(
-                    index_bvh<host_bvh_type::bvh_inst>{},
+            build_top_level(
+                    host_top_level_bvh,
+                    builder,
                     host_instances.data(),
-                    host_instances.size()
+                    host_instances.size(),
+                    build_pool
                     );
         }
 
@@ -1393,10 +1627,8 @@ void renderer::load_camera(std::string filename)
 
 void renderer::clear_frame()
 {
-    if (render_future.valid() && render_async)
-    {
-        render_future.wait();
-    }
+    // Drop what is left of a frame that was rendered with the old settings
+    finish_frame(true);
 
     frame_num = 0;
 
@@ -1407,6 +1639,29 @@ void renderer::clear_frame()
 }
 
 
+//-------------------------------------------------------------------------------------------------
+// Wait for the frame that is rendered asynchronously and end it on this thread,
+// with CANCEL, packets that have not started yet are skipped
+//
+
+void renderer::finish_frame(bool cancel)
+{
+    if (!host_frame.handle.valid())
+    {
+        return;
+    }
+
+    if (cancel)
+    {
+        host_frame.handle.cancel();
+    }
+
+    host_frame.handle.finish();
+
+    host_frame = {};
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // HUD
 //
@@ -1560,9 +1815,9 @@ void renderer::render_hud()
             ImGui::SameLine();
             if (ImGui::Checkbox("Render async", &render_async))
             {
-                if (render_future.valid() && !render_async)
+                if (!render_async)
                 {
-                    render_future.wait();
+                    finish_frame();
                 }
             }
             ImGui::SameLine();
@@ -1696,10 +1951,7 @@ void renderer::render_hud()
                         }
                         else if (i == 2)
                         {
-                            if (render_future.valid())
-                            {
-                                render_future.wait();
-                            }
+                            finish_frame(true);
                             // Double buffering does not work in case of pathtracing
                             // because destination and source buffers need to be the same
                             rt.set_double_buffering(false);
@@ -1893,7 +2145,7 @@ void renderer::render_hud()
     ImGui::End();
 }
 
-void renderer::render_impl()
+void renderer::render_impl(async_frame* async)
 {
     if (use_headlight)
     {
@@ -1950,6 +2202,7 @@ void renderer::render_impl()
             {
                 render_instances_cpp(
                         host_top_level_bvh,
+                        vertices,
                         mod.geometric_normals,
                         mod.shading_normals,
                         mod.tex_coords,
@@ -1966,7 +2219,8 @@ void renderer::render_impl()
                         camx,
                         frame_num,
                         algo,
-                        ssaa_samples
+                        ssaa_samples,
+                        async
                         );
             }
 #if VSNRAY_COMMON_HAVE_PTEX
@@ -1974,6 +2228,7 @@ void renderer::render_impl()
             {
                 render_instances_ptex_cpp(
                         host_top_level_bvh,
+                        vertices,
                         mod.geometric_normals,
                         mod.shading_normals,
                         ptex_tex_coords,
@@ -1989,7 +2244,8 @@ void renderer::render_impl()
                         camx,
                         frame_num,
                         algo,
-                        ssaa_samples
+                        ssaa_samples,
+                        async
                         );
             }
 #endif
@@ -1998,6 +2254,7 @@ void renderer::render_impl()
         {
             render_generic_material_cpp(
                     host_bvhs[0],
+                    vertices,
                     mod.geometric_normals,
                     mod.shading_normals,
                     mod.tex_coords,
@@ -2013,13 +2270,15 @@ void renderer::render_impl()
                     camx,
                     frame_num,
                     algo,
-                    ssaa_samples
+                    ssaa_samples,
+                    async
                     );
         }
         else
         {
             render_plastic_cpp(
                     host_bvhs[0],
+                    vertices,
                     mod.geometric_normals,
                     mod.shading_normals,
                     mod.tex_coords,
@@ -2035,7 +2294,8 @@ void renderer::render_impl()
                     camx,
                     frame_num,
                     algo,
-                    ssaa_samples
+                    ssaa_samples,
+                    async
                     );
         }
     }
@@ -2065,6 +2325,7 @@ void renderer::render_impl()
             {
                 render_instances_cu(
                         device_top_level_bvh,
+                        device_vertices,
                         device_geometric_normals,
                         device_shading_normals,
                         device_tex_coords,
@@ -2089,6 +2350,7 @@ void renderer::render_impl()
         {
             render_generic_material_cu(
                     device_bvhs[0],
+                    device_vertices,
                     device_geometric_normals,
                     device_shading_normals,
                     device_tex_coords,
@@ -2111,6 +2373,7 @@ void renderer::render_impl()
         {
             render_plastic_cu(
                     device_bvhs[0],
+                    device_vertices,
                     device_geometric_normals,
                     device_shading_normals,
                     device_tex_coords,
@@ -2157,6 +2420,8 @@ void renderer::render_impl()
 
 void renderer::on_close()
 {
+    finish_frame(true);
+
     outlines.destroy();
 }
 
@@ -2164,23 +2429,26 @@ void renderer::on_display()
 {
     if (render_async)
     {
-        if (!render_future.valid() || render_future.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+        if (host_frame.handle.valid() && host_frame.handle.ready())
         {
-            render_future = std::async(
-                    std::launch::async,
-                    [this]()
-                    {
-                        render_impl();
+            finish_frame();
 
-                        std::unique_lock<std::mutex> l(display_mutex);
-                        rt.swap_buffers();
-                    }
-                    );
+            rt.swap_buffers();
+        }
+
+        if (!host_frame.handle.valid())
+        {
+            render_impl(&host_frame);
+
+            // Only the CPU renders asynchronously, device frames have already finished
+            if (!host_frame.handle.valid())
+            {
+                rt.swap_buffers();
+            }
         }
 
         if (rt.width() == width() && rt.height() == height())
         {
-            std::unique_lock<std::mutex> l(display_mutex);
             rt.display_color_buffer();
         }
     }
@@ -2246,10 +2514,7 @@ void renderer::on_key_press(key_event const& event)
 
     case '3':
         std::cout << "Switching algorithm: path tracing\n";
-        if (render_future.valid())
-        {
-            render_future.wait();
-        }
+        finish_frame(true);
         // Double buffering does not work in case of pathtracing
         // because destination and source buffers need to be the same
         rt.set_double_buffering(false);
@@ -2450,10 +2715,7 @@ void renderer::on_space_mouse_move(visionaray::space_mouse_event const& event)
 
 void renderer::on_resize(int w, int h)
 {
-    if (render_future.valid() && algo != Pathtracing)
-    {
-        render_future.wait();
-    }
+    finish_frame(true);
 
     cam.set_viewport(0, 0, w, h);
     float fovy = cam.fovy();
@@ -2589,7 +2851,9 @@ int main(int argc, char** argv)
     {
         for (std::size_t i = r.begin; i != r.end; ++i)
         {
-            area_light<float, basic_triangle<3, float>> light(rend.host_bvhs[r.bvh_id].primitives()[i]);
+            area_light<float, basic_triangle<3, float>> light(
+                    make_triangle(rend.host_bvhs[r.bvh_id].primitives()[i], rend.vertices.data())
+                    );
             auto mat = *rend.generic_materials[r.geom_id].as<emissive<float>>();
             light.set_cl(to_rgb(mat.ce()));
             light.set_kl(mat.ls());
@@ -2635,10 +2899,16 @@ int main(int argc, char** argv)
 
                 int indirect_index = rend.host_top_level_bvh.indices()[i];
 
-                rend.device_top_level_bvh.primitives()[indirect_index] = {
+                auto const& host_inst = rend.host_top_level_bvh.primitive(i);
+
+                renderer::device_bvh_type::bvh_inst device_inst(
                         rend.device_bvhs[index].ref(),
-                        inverse(rend.host_top_level_bvh.primitive(i).transform_inv())
-                        };
+                        inverse(host_inst.transform_inv())
+                        );
+                device_inst.set_inst_id(host_inst.inst_id());
+                device_inst.set_geom_id(host_inst.geom_id());
+
+                rend.device_top_level_bvh.primitives()[indirect_index] = device_inst;
             }
 
             // Copy nodes and indices
@@ -2657,6 +2927,7 @@ int main(int argc, char** argv)
                     );
         }
 
+        rend.device_vertices = rend.vertices;
         rend.device_geometric_normals = rend.mod.geometric_normals;
         rend.device_shading_normals = rend.mod.shading_normals;
         rend.device_tex_coords = rend.mod.tex_coords;
@@ -2727,6 +2998,8 @@ int main(int argc, char** argv)
         std::cerr << "GPU memory allocation failed" << std::endl;
         rend.device_bvhs.clear();
         rend.device_bvhs.shrink_to_fit();
+        rend.device_vertices.clear();
+        rend.device_vertices.shrink_to_fit();
         rend.device_geometric_normals.clear();
         rend.device_geometric_normals.shrink_to_fit();
         rend.device_shading_normals.clear();
@@ -1,12 +1,26 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include <visionaray/detail/thread_pool.h>
 #include <visionaray/aligned_vector.h>
 #include <visionaray/array_ref.h>
 #include <visionaray/bvh.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/traverse.h>
+#include <visionaray/triangle_packet.h>
+#include <visionaray/wide_bvh.h>
 
 #include <gtest/gtest.h>
 
+#include "../fixtures.h"
+
 using namespace visionaray;
 
 
@@ -60,6 +74,73 @@ aligned_vector<sphere_t, 32> make_spheres()
 }
 
 
+// compare the structure of two trees, nodes may be laid out differently -----
+
+template <typename BVH>
+bool subtrees_equal(BVH const& a, unsigned index_a, BVH const& b, unsigned index_b)
+{
+    auto const& na = a.node(index_a);
+    auto const& nb = b.node(index_b);
+
+    if (na.is_leaf() != nb.is_leaf()
+     || na.get_bounds().min != nb.get_bounds().min
+     || na.get_bounds().max != nb.get_bounds().max)
+    {
+        return false;
+    }
+
+    if (na.is_leaf())
+    {
+        std::vector<unsigned> prims_a;
+        std::vector<unsigned> prims_b;
+
+        for (unsigned i = na.get_indices().first; i != na.get_indices().last; ++i)
+        {
+            prims_a.push_back(a.indices()[i]);
+        }
+
+        for (unsigned i = nb.get_indices().first; i != nb.get_indices().last; ++i)
+        {
+            prims_b.push_back(b.indices()[i]);
+        }
+
+        std::sort(prims_a.begin(), prims_a.end());
+        std::sort(prims_b.begin(), prims_b.end());
+
+        return prims_a == prims_b;
+    }
+
+    return subtrees_equal(a, na.get_child(0), b, nb.get_child(0))
+        && subtrees_equal(a, na.get_child(1), b, nb.get_child(1));
+}
+
+// compare two trees --------------------------------------
+
+template <typename Nodes>
+bool nodes_equal(Nodes const& a, Nodes const& b)
+{
+    if (a.size() != b.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i].num_prims != b[i].num_prims || a[i].first_child != b[i].first_child)
+        {
+            return false;
+        }
+
+        if (a[i].get_bounds().min != b[i].get_bounds().min || a[i].get_bounds().max != b[i].get_bounds().max)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
 //-------------------------------------------------------------------------------------------------
 // Test build methods for several BVH types
 //
@@ -120,3 +201,885 @@ TEST(BVH, BuildArrayRefBvh)
     EXPECT_TRUE(triangle_bvh.primitives().size() == triangles.size());
     EXPECT_TRUE(sphere_bvh.primitives().size()   == spheres.size());
 }
+
+
+// parallel build -----------------------------------------
+
+TEST(BVH, BuildParallel)
+{
+    auto triangles = make_random_triangles(100000, 100.0f, 1.0f);
+
+    binned_sah_builder builder;
+
+    auto serial_bvh = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    thread_pool pool1(1);
+    thread_pool pool4(4);
+
+    auto bvh1 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool1);
+    auto bvh4 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+
+    // Result must not depend on the number of threads
+    EXPECT_TRUE(nodes_equal(bvh1.nodes(), bvh4.nodes()));
+    EXPECT_TRUE(bvh1.indices() == bvh4.indices());
+
+    // All primitives referenced exactly once
+    auto indices = bvh4.indices();
+    std::sort(indices.begin(), indices.end());
+    EXPECT_TRUE(indices.size() == triangles.size());
+    for (size_t i = 0; i < indices.size(); ++i)
+    {
+        EXPECT_EQ(indices[i], i);
+    }
+
+    // Same hits as the serially built tree
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto ref_bvh = serial_bvh.ref();
+        auto par_bvh = bvh4.ref();
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1);
+        auto hr2 = closest_hit(r, &par_bvh, &par_bvh + 1);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit && hr2.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+    }
+
+
+    // Spatial splits, index bvh (non-index bvhs build without them)
+
+    builder.enable_spatial_splits(true);
+
+    auto split_bvh1 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool1);
+    auto split_bvh4 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+
+    EXPECT_TRUE(nodes_equal(split_bvh1.nodes(), split_bvh4.nodes()));
+    EXPECT_TRUE(split_bvh1.indices() == split_bvh4.indices());
+
+    auto plain_bvh = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+
+    EXPECT_TRUE(plain_bvh.primitives().size() == triangles.size());
+}
+
+
+// in-place build -----------------------------------------
+
+TEST(BVH, BuildInPlace)
+{
+    auto triangles = make_random_triangles(50000, 100.0f, 1.0f);
+
+    // Long triangles, so that there are lots of spatial splits
+    for (auto& t : triangles)
+    {
+        t.e1 *= 20.0f;
+    }
+
+    thread_pool pool1(1);
+    thread_pool pool4(4);
+
+    binned_sah_builder builder;
+    builder.enable_spatial_splits(true);
+
+    auto split_bvh = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+    auto split_peak = builder.peak_memory_usage();
+
+    builder.enable_in_place(true);
+    builder.set_spatial_split_budget(0.25f);
+
+    auto bvh1 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool1);
+    auto bvh4 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+    auto peak = builder.peak_memory_usage();
+
+    auto serial_bvh = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    // Result must not depend on the number of threads
+    EXPECT_TRUE(nodes_equal(bvh1.nodes(), bvh4.nodes()));
+    EXPECT_TRUE(bvh1.indices() == bvh4.indices());
+
+    // A single list of references, no temporary copies
+    size_t num_refs = triangles.size() + static_cast<size_t>(triangles.size() * 0.25f);
+    EXPECT_EQ(peak, num_refs * sizeof(binned_sah_builder::prim_ref));
+    EXPECT_EQ(builder.peak_memory_usage(), peak);
+    EXPECT_LT(peak, split_peak);
+
+    // No spatial splits and thus no budget for non-index BVHs
+    builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+    EXPECT_EQ(builder.peak_memory_usage(), triangles.size() * sizeof(binned_sah_builder::prim_ref));
+
+    builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size());
+    EXPECT_EQ(builder.peak_memory_usage(), triangles.size() * sizeof(binned_sah_builder::prim_ref));
+
+    // All primitives referenced, duplicates stay within the budget
+    EXPECT_GT(bvh4.indices().size(), triangles.size());
+    EXPECT_LE(bvh4.indices().size(), num_refs);
+
+    std::vector<int> covered(triangles.size(), 0);
+
+    for (auto i : bvh4.indices())
+    {
+        ++covered[i];
+    }
+
+    EXPECT_TRUE(std::all_of(covered.begin(), covered.end(), [](int c) { return c >= 1; }));
+
+    // Same hits as the tree built with unbounded spatial splits
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto ref_bvh = split_bvh.ref();
+        auto par_bvh = bvh4.ref();
+        auto ser_bvh = serial_bvh.ref();
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1);
+        auto hr2 = closest_hit(r, &par_bvh, &par_bvh + 1);
+        auto hr3 = closest_hit(r, &ser_bvh, &ser_bvh + 1);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+        EXPECT_EQ(hr1.hit, hr3.hit);
+
+        if (hr1.hit && hr2.hit && hr3.hit)
+        {
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+            EXPECT_FLOAT_EQ(hr1.t, hr3.t);
+        }
+    }
+}
+
+
+// parallel LBVH build ------------------------------------
+
+TEST(BVH, BuildLbvhParallel)
+{
+    auto triangles = make_random_triangles(100000, 100.0f, 1.0f);
+
+    lbvh_builder builder;
+
+    thread_pool pool1(1);
+    thread_pool pool4(4);
+
+    auto bvh1 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool1);
+    auto bvh4 = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+
+    // Result must not depend on the number of threads
+    EXPECT_TRUE(nodes_equal(bvh1.nodes(), bvh4.nodes()));
+    EXPECT_TRUE(bvh1.indices() == bvh4.indices());
+
+    // Leaves cover all primitives exactly once, child bounds are contained in parent bounds
+    std::vector<int> covered(triangles.size(), 0);
+
+    for (auto const& n : bvh4.nodes())
+    {
+        if (n.is_leaf())
+        {
+            EXPECT_TRUE(n.get_num_primitives() <= 4);
+
+            for (unsigned i = n.get_first_primitive(); i != n.get_first_primitive() + n.get_num_primitives(); ++i)
+            {
+                ++covered[bvh4.indices()[i]];
+            }
+        }
+        else
+        {
+            for (unsigned c = 0; c < 2; ++c)
+            {
+                auto const& child = bvh4.nodes()[n.get_child(c)];
+                auto bounds = n.get_bounds();
+                bounds.insert(child.get_bounds());
+                EXPECT_TRUE(bounds.min == n.get_bounds().min && bounds.max == n.get_bounds().max);
+            }
+        }
+    }
+
+    EXPECT_TRUE(std::all_of(covered.begin(), covered.end(), [](int c) { return c == 1; }));
+
+    // Same hits as the serially built tree
+    auto serial_bvh = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size());
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto ref_bvh = serial_bvh.ref();
+        auto par_bvh = bvh4.ref();
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1);
+        auto hr2 = closest_hit(r, &par_bvh, &par_bvh + 1);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit && hr2.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+    }
+
+    // Non-index bvh, tiny inputs
+    auto plain_bvh = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+    EXPECT_TRUE(plain_bvh.primitives().size() == triangles.size());
+
+    auto tiny = make_triangles();
+    auto tiny_bvh = builder.build(index_bvh<triangle_t>{}, tiny.data(), tiny.size(), pool4);
+    EXPECT_TRUE(tiny_bvh.nodes().size() == 1 && tiny_bvh.indices().size() == tiny.size());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test refit()
+//
+
+TEST(BVH, Refit)
+{
+    auto triangles = make_random_triangles(50000, 100.0f, 1.0f);
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+
+    auto index_tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+    auto tree = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+
+    float initial_cost = sah_cost(index_tree);
+
+    // Refitting an unmodified tree keeps the cost
+    EXPECT_FLOAT_EQ(refit(index_tree, pool, initial_cost), 1.0f);
+
+    // Deform
+    std::default_random_engine rng(2);
+    std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+    for (auto& t : index_tree.primitives())
+    {
+        t.v1 += vec3(dist(rng), dist(rng), dist(rng));
+    }
+
+    for (auto& t : tree.primitives())
+    {
+        t.v1 += vec3(dist(rng), dist(rng), dist(rng));
+    }
+
+    EXPECT_TRUE(refit(index_tree, pool, initial_cost) > 1.0f);
+    EXPECT_TRUE(refit(tree, pool) > 0.0f);
+
+    // Nodes bound their primitives and children
+    auto check = [](bvh_node const& n, aabb const& expected)
+    {
+        return n.get_bounds().min == expected.min && n.get_bounds().max == expected.max;
+    };
+
+    for (auto const& n : index_tree.nodes())
+    {
+        aabb expected;
+        expected.invalidate();
+
+        if (n.is_leaf())
+        {
+            for (unsigned i = n.get_indices().first; i != n.get_indices().last; ++i)
+            {
+                expected.insert(get_bounds(index_tree.primitives()[index_tree.indices()[i]]));
+            }
+        }
+        else
+        {
+            auto const& left = index_tree.nodes()[n.get_child(0)].get_bounds();
+            auto const& right = index_tree.nodes()[n.get_child(1)].get_bounds();
+
+            expected.insert(left);
+            expected.insert(right);
+
+            // Split axis and low child match the refitted children
+            bvh_node ref;
+            ref.set_inner(expected, n.get_child(0), left, right);
+
+            EXPECT_EQ(n.get_split_axis(), ref.get_split_axis());
+            EXPECT_EQ(n.get_low_child(), ref.get_low_child());
+        }
+
+        EXPECT_TRUE(check(n, expected));
+    }
+
+    for (auto const& n : tree.nodes())
+    {
+        if (n.is_leaf())
+        {
+            aabb expected;
+            expected.invalidate();
+
+            for (unsigned i = n.get_indices().first; i != n.get_indices().last; ++i)
+            {
+                expected.insert(get_bounds(tree.primitives()[i]));
+            }
+
+            EXPECT_TRUE(check(n, expected));
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test optimize()
+//
+
+TEST(BVH, Optimize)
+{
+    auto triangles = make_random_triangles(50000, 100.0f, 1.0f);
+
+    thread_pool pool1(1);
+    thread_pool pool4(4);
+
+    lbvh_builder builder;
+
+    auto lbvh = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+
+    auto tree1 = lbvh;
+    auto tree4 = lbvh;
+
+    float initial_cost = sah_cost(lbvh);
+
+    float cost1 = optimize(tree1, pool1);
+    float cost4 = optimize(tree4, pool4);
+
+    // Result must not depend on the number of threads
+    EXPECT_TRUE(nodes_equal(tree1.nodes(), tree4.nodes()));
+    EXPECT_FLOAT_EQ(cost1, cost4);
+    EXPECT_FLOAT_EQ(cost4, sah_cost(tree4));
+
+    EXPECT_TRUE(cost4 < initial_cost);
+
+    // More work gives better trees
+    auto tree = lbvh;
+    EXPECT_TRUE(optimize(tree, pool4, 1, 4) >= cost4);
+
+    // Node count and leaves are kept, child bounds are contained in parent bounds
+    EXPECT_EQ(tree4.nodes().size(), lbvh.nodes().size());
+    EXPECT_TRUE(tree4.indices() == lbvh.indices());
+
+    std::vector<int> covered(triangles.size(), 0);
+    std::vector<int> referenced(tree4.nodes().size(), 0);
+
+    for (auto const& n : tree4.nodes())
+    {
+        if (n.is_leaf())
+        {
+            for (unsigned i = n.get_first_primitive(); i != n.get_first_primitive() + n.get_num_primitives(); ++i)
+            {
+                ++covered[tree4.indices()[i]];
+            }
+        }
+        else
+        {
+            for (unsigned c = 0; c < 2; ++c)
+            {
+                auto const& child = tree4.nodes()[n.get_child(c)];
+                auto bounds = n.get_bounds();
+                bounds.insert(child.get_bounds());
+                EXPECT_TRUE(bounds.min == n.get_bounds().min && bounds.max == n.get_bounds().max);
+
+                ++referenced[n.get_child(c)];
+            }
+        }
+    }
+
+    EXPECT_TRUE(std::all_of(covered.begin(), covered.end(), [](int c) { return c == 1; }));
+    EXPECT_EQ(referenced[0], 0);
+    EXPECT_TRUE(std::all_of(referenced.begin() + 1, referenced.end(), [](int r) { return r == 1; }));
+
+    // Same hits as the original tree
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    auto ref1 = lbvh.ref();
+    auto ref2 = tree4.ref();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = closest_hit(r, &ref1, &ref1 + 1);
+        auto hr2 = closest_hit(r, &ref2, &ref2 + 1);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit && hr2.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+    }
+
+    // Non-index bvh
+    auto plain = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool4);
+    float plain_cost = sah_cost(plain);
+    EXPECT_TRUE(optimize(plain, pool4, 2) < plain_cost);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test collapse() to 4-wide and 8-wide BVHs
+//
+
+template <typename WideBVH, typename BVH>
+void test_collapse(BVH const& binary, size_t num_prims)
+{
+    auto wide = collapse<WideBVH>(binary);
+
+    EXPECT_TRUE(wide.num_primitives() == num_prims);
+    EXPECT_TRUE(wide.num_nodes() > 0);
+
+    aabb bounds = get_bounds(wide);
+    EXPECT_TRUE(all(bounds.min <= binary.node(0).get_bounds().min));
+    EXPECT_TRUE(all(bounds.max >= binary.node(0).get_bounds().max));
+
+    // Same hits as the binary tree
+    std::default_random_engine rng(3);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    auto ref_bvh = binary.ref();
+    auto wide_bvh = wide.ref();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1);
+        auto hr2 = closest_hit(r, &wide_bvh, &wide_bvh + 1);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit && hr2.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+
+        auto any1 = any_hit(r, &ref_bvh, &ref_bvh + 1);
+        auto any2 = any_hit(r, &wide_bvh, &wide_bvh + 1);
+
+        EXPECT_EQ(any1.hit, any2.hit);
+    }
+
+    // Ray packets
+    for (int i = 0; i < 250; ++i)
+    {
+        vec3 dirs[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            dirs[j] = normalize(vec3(dist(rng), dist(rng), dist(rng)));
+        }
+
+        basic_ray<simd::float4> r(
+                vector<3, simd::float4>(0.0f),
+                vector<3, simd::float4>(
+                    simd::float4(dirs[0].x, dirs[1].x, dirs[2].x, dirs[3].x),
+                    simd::float4(dirs[0].y, dirs[1].y, dirs[2].y, dirs[3].y),
+                    simd::float4(dirs[0].z, dirs[1].z, dirs[2].z, dirs[3].z)
+                    )
+                );
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1);
+        auto hr2 = closest_hit(r, &wide_bvh, &wide_bvh + 1);
+
+        EXPECT_TRUE(all(hr1.hit == hr2.hit));
+        EXPECT_TRUE(all(!hr1.hit || hr1.prim_id == hr2.prim_id));
+    }
+}
+
+TEST(BVH, Collapse)
+{
+    auto triangles = make_random_triangles(20000, 100.0f, 1.0f);
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+
+    auto index_tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+    auto tree = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+
+    test_collapse<bvh4<triangle_t>>(index_tree, triangles.size());
+    test_collapse<bvh8<triangle_t>>(index_tree, triangles.size());
+    test_collapse<bvh4<triangle_t>>(tree, triangles.size());
+    test_collapse<bvh8<triangle_t>>(tree, triangles.size());
+    test_collapse<compressed_bvh4<triangle_t>>(index_tree, triangles.size());
+    test_collapse<compressed_bvh8<triangle_t>>(tree, triangles.size());
+
+    // Root is a leaf
+    auto small_triangles = make_triangles();
+    auto small_tree = builder.build(index_bvh<triangle_t>{}, small_triangles.data(), small_triangles.size(), pool);
+
+    test_collapse<bvh4<triangle_t>>(small_tree, small_triangles.size());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test pack_leaves()
+//
+
+template <unsigned Size, typename BVH>
+void test_pack_leaves(BVH const& tree, size_t num_prims)
+{
+    auto packed = pack_leaves<packet_bvh<Size>>(tree);
+
+    EXPECT_EQ(packed.num_nodes(), tree.num_nodes());
+
+    // Every triangle is stored exactly once
+    std::vector<int> counts(num_prims, 0);
+
+    for (auto const& p : packed.primitives())
+    {
+        EXPECT_TRUE(p.count > 0 && p.count <= Size);
+
+        for (unsigned i = 0; i < p.count; ++i)
+        {
+            ++counts[p.prim_id[i]];
+        }
+    }
+
+    EXPECT_TRUE(std::all_of(counts.begin(), counts.end(), [](int c) { return c == 1; }));
+
+    aabb bounds = get_bounds(packed);
+    EXPECT_TRUE(all(bounds.min == tree.node(0).get_bounds().min));
+    EXPECT_TRUE(all(bounds.max == tree.node(0).get_bounds().max));
+
+    // Same hits as the triangle BVH
+    std::default_random_engine rng(5);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    auto ref1 = tree.ref();
+    auto ref2 = packed.ref();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = closest_hit(r, &ref1, &ref1 + 1);
+        auto hr2 = closest_hit(r, &ref2, &ref2 + 1);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+            EXPECT_FLOAT_EQ(hr1.u, hr2.u);
+            EXPECT_FLOAT_EQ(hr1.v, hr2.v);
+
+            auto n1 = get_normal(hr1, ref1);
+            auto n2 = get_normal(hr2, ref2);
+
+            EXPECT_FLOAT_EQ(n1.x, n2.x);
+            EXPECT_FLOAT_EQ(n1.y, n2.y);
+            EXPECT_FLOAT_EQ(n1.z, n2.z);
+        }
+
+        auto any1 = any_hit(r, &ref1, &ref1 + 1);
+        auto any2 = any_hit(r, &ref2, &ref2 + 1);
+
+        EXPECT_EQ(any1.hit, any2.hit);
+    }
+
+    // Ray packets
+    for (int i = 0; i < 250; ++i)
+    {
+        vec3 dirs[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            dirs[j] = normalize(vec3(dist(rng), dist(rng), dist(rng)));
+        }
+
+        basic_ray<simd::float4> r(
+                vector<3, simd::float4>(0.0f),
+                vector<3, simd::float4>(
+                    simd::float4(dirs[0].x, dirs[1].x, dirs[2].x, dirs[3].x),
+                    simd::float4(dirs[0].y, dirs[1].y, dirs[2].y, dirs[3].y),
+                    simd::float4(dirs[0].z, dirs[1].z, dirs[2].z, dirs[3].z)
+                    )
+                );
+
+        auto hr1 = closest_hit(r, &ref1, &ref1 + 1);
+        auto hr2 = closest_hit(r, &ref2, &ref2 + 1);
+
+        EXPECT_TRUE(all(hr1.hit == hr2.hit));
+        EXPECT_TRUE(all(!hr1.hit || hr1.prim_id == hr2.prim_id));
+    }
+}
+
+TEST(BVH, PackLeaves)
+{
+    auto triangles = make_random_triangles(20000, 100.0f, 1.0f);
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+    builder.set_packet_size(8);
+
+    auto index_tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool, 8);
+    auto tree = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), 8);
+
+    // Subtrees that are built in parallel use the packet size, too
+    auto serial_tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), 8);
+
+    EXPECT_EQ(serial_tree.num_nodes(), index_tree.num_nodes());
+    EXPECT_TRUE(subtrees_equal(serial_tree, 0, index_tree, 0));
+
+    test_pack_leaves<4>(index_tree, triangles.size());
+    test_pack_leaves<8>(index_tree, triangles.size());
+    test_pack_leaves<16>(index_tree, triangles.size());
+    test_pack_leaves<8>(tree, triangles.size());
+
+    // With packet-aware leaf costs, most leaves fill a whole packet
+    auto packed = pack_leaves<packet_bvh<8>>(index_tree);
+
+    size_t num_leaves = 0;
+
+    for (auto const& n : packed.nodes())
+    {
+        num_leaves += n.is_leaf() ? 1 : 0;
+    }
+
+    EXPECT_TRUE(packed.num_primitives() < num_leaves * 2);
+    EXPECT_TRUE(packed.num_primitives() * 4 < triangles.size());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that quantized child bounds contain the original bounds
+//
+
+template <typename Q>
+void test_compressed_node_bounds(aabb const* boxes, unsigned count)
+{
+    wide_bvh_node<8> n;
+
+    for (unsigned i = 0; i < 8; ++i)
+    {
+        if (i < count)
+        {
+            n.set_inner(i, boxes[i], i);
+        }
+        else
+        {
+            n.set_empty(i);
+        }
+    }
+
+    compressed_wide_bvh_node<8, Q> cn(n);
+
+    vector<3, simd::float8> bmin;
+    vector<3, simd::float8> bmax;
+    cn.get_bounds(bmin, bmax);
+
+    VSNRAY_ALIGN(32) float min_x[8];
+    store(min_x, bmin.x);
+
+    for (unsigned i = 0; i < count; ++i)
+    {
+        aabb b = cn.get_bounds(i);
+
+        EXPECT_TRUE(all(b.min <= boxes[i].min));
+        EXPECT_TRUE(all(b.max >= boxes[i].max));
+        EXPECT_TRUE(cn.is_inner(i));
+        EXPECT_EQ(cn.get_child(i), i);
+
+        // Scalar and SIMD decoding agree
+        EXPECT_EQ(min_x[i], b.min.x);
+    }
+
+    for (unsigned i = count; i < 8; ++i)
+    {
+        EXPECT_TRUE(cn.is_empty(i));
+    }
+
+}
+
+TEST(BVH, CompressedNode)
+{
+    std::default_random_engine rng(4);
+    std::uniform_real_distribution<float> pos(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> ext(0.0f, 10.0f);
+
+    for (int j = 0; j < 100; ++j)
+    {
+        aabb boxes[8];
+        vec3 base(pos(rng), pos(rng), pos(rng));
+
+        for (auto& b : boxes)
+        {
+            b.min = base + vec3(ext(rng), ext(rng), ext(rng));
+            b.max = b.min + vec3(ext(rng), ext(rng), ext(rng));
+        }
+
+        test_compressed_node_bounds<uint8_t>(boxes, 8);
+        test_compressed_node_bounds<uint16_t>(boxes, 5);
+    }
+
+    // Degenerate (flat) boxes far away from the origin
+    aabb flat[2];
+    flat[0] = aabb(vec3(1.0e6f, 3.0f, 0.0f), vec3(1.0e6f, 3.0f, 0.0f));
+    flat[1] = aabb(vec3(1.0e6f, 3.0f, 0.0f), vec3(1.0e6f + 1.0f, 3.0f, 0.0f));
+
+    test_compressed_node_bounds<uint8_t>(flat, 2);
+    test_compressed_node_bounds<uint16_t>(flat, 2);
+
+    // Huge bounds, the extent overflows float
+    aabb huge[2];
+    huge[0] = aabb(vec3(-1.0e38f), vec3(0.0f));
+    huge[1] = aabb(vec3(1.0f), vec3(3.0e38f));
+
+    test_compressed_node_bounds<uint8_t>(huge, 2);
+    test_compressed_node_bounds<uint16_t>(huge, 2);
+
+    // Bounds that cannot be quantized
+    float inf = std::numeric_limits<float>::infinity();
+    float max = std::numeric_limits<float>::max();
+
+    aabb bad[] = {
+        aabb(vec3(0.0f), vec3(inf, 0.0f, 0.0f)),
+        aabb(vec3(-max), vec3(max))
+        };
+
+    for (auto const& b : bad)
+    {
+        wide_bvh_node<4> n;
+        n.set_inner(0, b, 1);
+        n.set_empty(1);
+        n.set_empty(2);
+        n.set_empty(3);
+
+        EXPECT_THROW(compressed_wide_bvh_node<4> cn(n), std::range_error);
+    }
+
+    // Leaves with more primitives than fit into num_prims
+    wide_bvh_node<4> big_leaf;
+    big_leaf.set_leaf(0, aabb(vec3(0.0f), vec3(1.0f)), 0, 0x10000);
+    big_leaf.set_empty(1);
+    big_leaf.set_empty(2);
+    big_leaf.set_empty(3);
+
+    EXPECT_THROW(compressed_wide_bvh_node<4> cn(big_leaf), std::length_error);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test build_top_level() and instance transform updates
+//
+
+TEST(BVH, BuildTopLevel)
+{
+    using bottom_level_bvh = index_bvh<triangle_t>;
+    using instance_t = bottom_level_bvh::bvh_inst;
+
+    thread_pool pool(4);
+
+    binned_sah_builder sah;
+    lbvh_builder lbvh;
+
+    auto triangles = make_random_triangles(1000, 100.0f, 1.0f);
+
+    for (auto& t : triangles)
+    {
+        t.v1 *= 0.01f;
+    }
+
+    auto bottom = sah.build(bottom_level_bvh{}, triangles.data(), triangles.size(), pool);
+
+    std::default_random_engine rng(6);
+    std::uniform_real_distribution<float> pos(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.0f);
+
+    auto random_transform = [&]()
+    {
+        mat4 rot = mat4::rotation(normalize(vec3(pos(rng), pos(rng), pos(rng))), angle(rng));
+        return mat4::translation(vec3(pos(rng), pos(rng), pos(rng))) * rot;
+    };
+
+    aligned_vector<instance_t> instances(3000);
+
+    for (auto& inst : instances)
+    {
+        inst = bottom.inst(random_transform());
+    }
+
+    // Instance bounds contain the transformed corners of the bottom level bounds
+    for (auto const& inst : instances)
+    {
+        aabb bounds = get_bounds(inst);
+        mat4 trans = inverse(inst.transform_inv());
+
+        for (vec3 v : compute_vertices(bottom.node(0).get_bounds()))
+        {
+            vec3 w = (trans * vec4(v, 1.0f)).xyz();
+            EXPECT_TRUE(all(w >= bounds.min - vec3(1.0e-3f)));
+            EXPECT_TRUE(all(w <= bounds.max + vec3(1.0e-3f)));
+        }
+    }
+
+    index_bvh<instance_t> lbvh_top;
+    index_bvh<instance_t> sah_top;
+
+    auto check_hits = [&]()
+    {
+        auto lbvh_ref = lbvh_top.ref();
+        auto sah_ref = sah_top.ref();
+
+        std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+        for (int i = 0; i < 200; ++i)
+        {
+            basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+            auto hr1 = closest_hit(r, instances.begin(), instances.end());
+            auto hr2 = closest_hit(r, &lbvh_ref, &lbvh_ref + 1);
+            auto hr3 = closest_hit(r, &sah_ref, &sah_ref + 1);
+
+            EXPECT_EQ(hr1.hit, hr2.hit);
+            EXPECT_EQ(hr1.hit, hr3.hit);
+
+            if (hr1.hit && hr2.hit && hr3.hit)
+            {
+                EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+                EXPECT_FLOAT_EQ(hr1.t, hr3.t);
+            }
+        }
+    };
+
+    build_top_level(lbvh_top, lbvh, instances.data(), instances.size(), pool);
+    build_top_level(sah_top, sah, instances.data(), instances.size(), pool);
+
+    EXPECT_TRUE(lbvh_top.num_primitives() == instances.size());
+    EXPECT_TRUE(sah_top.num_primitives() == instances.size());
+
+    check_hits();
+
+    // Animate: update transforms and rebuild the top level in place
+    for (auto& inst : instances)
+    {
+        inst.set_transform(random_transform());
+    }
+
+    build_top_level(lbvh_top, lbvh, instances.data(), instances.size(), pool);
+    build_top_level(sah_top, sah, instances.data(), instances.size(), pool);
+
+    check_hits();
+
+    // The bottom level was not touched
+    EXPECT_TRUE(instances[0].get_ref() == bottom.ref());
+}
@@ -0,0 +1,251 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include <visionaray/detail/thread_pool.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/bvh_file.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+#include "../fixtures.h"
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+using triangle_t = basic_triangle<3, float>;
+
+// Compare the mapped BVH with the original one, and trace some rays
+template <typename Tree>
+static void test_mapped_bvh(Tree const& tree, mapped_bvh<Tree> const& mapped)
+{
+    ASSERT_TRUE(mapped.is_open());
+
+    ASSERT_EQ(mapped.num_nodes(), tree.num_nodes());
+    ASSERT_EQ(mapped.num_primitives(), tree.num_primitives());
+
+    using N = typename Tree::node_type;
+    using P = typename Tree::primitive_type;
+
+    EXPECT_EQ(std::memcmp(mapped.nodes().data(), tree.nodes().data(), sizeof(N) * tree.num_nodes()), 0);
+    EXPECT_EQ(std::memcmp(mapped.primitives().data(), tree.primitives().data(), sizeof(P) * tree.num_primitives()), 0);
+
+    // Sections are aligned
+    EXPECT_EQ(reinterpret_cast<size_t>(mapped.nodes().data()) % bvh_file_header::Alignment, 0U);
+    EXPECT_EQ(reinterpret_cast<size_t>(mapped.primitives().data()) % bvh_file_header::Alignment, 0U);
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    auto ref1 = tree.ref();
+    auto ref2 = mapped.ref();
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = closest_hit(r, &ref1, &ref1 + 1);
+        auto hr2 = closest_hit(r, &ref2, &ref2 + 1);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit && hr2.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test save_bvh() and mapped_bvh
+//
+
+TEST(BVH, File)
+{
+    auto triangles = make_random_triangles(10000, 1.0f, 0.1f);
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+
+    auto key = bvh_cache_key(triangles.data(), triangles.size(), 1);
+
+    std::string filename = "unittests_bvh_file.bin";
+
+    // index_bvh
+
+    auto index_tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+
+    ASSERT_TRUE(save_bvh(filename, index_tree, key));
+
+    {
+        mapped_bvh<index_bvh<triangle_t>> mapped;
+        ASSERT_TRUE(mapped.open(filename, key));
+
+        EXPECT_EQ(mapped.num_indices(), index_tree.num_indices());
+        EXPECT_EQ(std::memcmp(mapped.indices().data(), index_tree.indices().data(), sizeof(unsigned) * index_tree.num_indices()), 0);
+
+        test_mapped_bvh(index_tree, mapped);
+
+        // The ref points into the mapping
+        auto inst = mapped.inst(mat4::identity());
+        EXPECT_TRUE(inst.get_ref() == mapped.ref());
+        EXPECT_EQ(&inst.node(0), mapped.nodes().data());
+    }
+
+    // Wrong key, wrong BVH type, missing file
+
+    {
+        mapped_bvh<index_bvh<triangle_t>> mapped;
+        EXPECT_FALSE(mapped.open(filename, key + 1));
+        EXPECT_FALSE(mapped.is_open());
+
+        mapped_bvh<bvh<triangle_t>> plain;
+        EXPECT_FALSE(plain.open(filename, key));
+
+        mapped_bvh<index_bvh<basic_sphere<float>>> spheres;
+        EXPECT_FALSE(spheres.open(filename, key));
+
+        EXPECT_FALSE(mapped.open(filename + ".missing", key));
+    }
+
+    // Truncated file
+
+    {
+        std::ifstream in(filename, std::ios::binary);
+        std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+
+        std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+        out.write(data.data(), static_cast<std::streamsize>(data.size() - 1));
+        out.close();
+
+        mapped_bvh<index_bvh<triangle_t>> mapped;
+        EXPECT_FALSE(mapped.open(filename, key));
+    }
+
+    // bvh (overwrites the existing file)
+
+    auto tree = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+
+    ASSERT_TRUE(save_bvh(filename, tree, key));
+
+    {
+        mapped_bvh<bvh<triangle_t>> mapped;
+        ASSERT_TRUE(mapped.open(filename, key));
+
+        EXPECT_EQ(mapped.num_indices(), 0U);
+
+        test_mapped_bvh(tree, mapped);
+    }
+
+    std::remove(filename.c_str());
+
+    // The key depends on the primitives and the seed
+
+    EXPECT_NE(bvh_cache_key(triangles.data(), triangles.size(), 2), key);
+    EXPECT_NE(bvh_cache_key(triangles.data(), triangles.size() - 1, 1), key);
+
+    triangles[5000].v1.x += 1.0f;
+    EXPECT_NE(bvh_cache_key(triangles.data(), triangles.size(), 1), key);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test save_bvh() and mapped_bvh with motion_bvh_node
+//
+
+TEST(BVH, FileMotion)
+{
+    using motion_triangle_t = basic_motion_triangle<float>;
+
+    auto triangles = make_random_triangles(10000, 1.0f, 0.1f);
+
+    aligned_vector<motion_triangle_t> motion_triangles(triangles.size());
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangle_t key1 = triangles[i];
+        key1.v1 += vec3(0.05f, 0.0f, 0.0f);
+
+        motion_triangles[i] = motion_triangle_t(triangles[i], key1);
+    }
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+
+    auto key = bvh_cache_key(motion_triangles.data(), motion_triangles.size(), 1);
+
+    std::string filename = "unittests_bvh_file_motion.bin";
+
+    auto index_tree = builder.build(
+            index_motion_bvh<motion_triangle_t>{},
+            motion_triangles.data(),
+            motion_triangles.size(),
+            pool
+            );
+
+    ASSERT_TRUE(save_bvh(filename, index_tree, key));
+
+    {
+        mapped_bvh<index_motion_bvh<motion_triangle_t>> mapped;
+        ASSERT_TRUE(mapped.open(filename, key));
+
+        test_mapped_bvh(index_tree, mapped);
+
+        // Same primitives, but static nodes
+        mapped_bvh<index_bvh<motion_triangle_t>> static_nodes;
+        EXPECT_FALSE(static_nodes.open(filename, key));
+    }
+
+    auto tree = builder.build(
+            motion_bvh<motion_triangle_t>{},
+            motion_triangles.data(),
+            motion_triangles.size(),
+            pool
+            );
+
+    ASSERT_TRUE(save_bvh(filename, tree, key));
+
+    {
+        mapped_bvh<motion_bvh<motion_triangle_t>> mapped;
+        ASSERT_TRUE(mapped.open(filename, key));
+
+        test_mapped_bvh(tree, mapped);
+    }
+
+    std::remove(filename.c_str());
+}
+
+TEST(BVH, FileSerializablePrimitives)
+{
+    using indexed_triangle_t = basic_indexed_triangle<float>;
+
+    EXPECT_TRUE(is_serializable_primitive<triangle_t>::value);
+    EXPECT_TRUE(is_serializable_primitive<indexed_triangle_t>::value);
+    EXPECT_TRUE(is_serializable_primitive<basic_motion_triangle<float>>::value);
+    EXPECT_TRUE(is_serializable_primitive<basic_sphere<float>>::value);
+
+    // Point to the nodes of other BVHs
+    EXPECT_FALSE(is_serializable_primitive<bvh<triangle_t>::bvh_ref>::value);
+    EXPECT_FALSE(is_serializable_primitive<bvh<triangle_t>::bvh_inst>::value);
+    EXPECT_FALSE(is_serializable_primitive<index_bvh<triangle_t>::bvh_ref>::value);
+    EXPECT_FALSE(is_serializable_primitive<index_bvh<triangle_t>::bvh_inst>::value);
+    EXPECT_FALSE(is_serializable_primitive<index_bvh<triangle_t>::bvh_motion_inst>::value);
+    EXPECT_FALSE(is_serializable_primitive<index_bvh<indexed_triangle_t>::bvh_inst>::value);
+}
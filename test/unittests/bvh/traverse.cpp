@@ -1,12 +1,25 @@
 // This file is distributed under the MIT license.
 // See the LICENSE file for details.
 
+#include <cstddef>
+#include <random>
+
+#include <visionaray/detail/thread_pool.h>
+#include <visionaray/aligned_vector.h>
 #include <visionaray/bvh.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/get_primitive.h>
+#include <visionaray/traverse.h>
+#include <visionaray/wide_bvh.h>
 
 #include <gtest/gtest.h>
 
+#include "../fixtures.h"
+
 using namespace visionaray;
 
+using triangle_t = basic_triangle<3, float>;
+
 
 //-------------------------------------------------------------------------------------------------
 // Build some BVHs
@@ -346,3 +359,441 @@ TEST(BVH, TraverseParents)
         }
         );
 }
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that all BVH traversal strategies report the same hits
+//
+
+template <typename Strategy>
+struct strategy_intersector : basic_intersector<strategy_intersector<Strategy>, Strategy>
+{
+};
+
+template <typename Strategy, typename BVH>
+void test_traversal_strategy(BVH const& tree)
+{
+    std::default_random_engine rng(5);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    auto ref_bvh = tree.ref();
+
+    default_intersector ref_isect;
+    strategy_intersector<Strategy> isect;
+
+    for (int i = 0; i < 200; ++i)
+    {
+        basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1, ref_isect);
+        auto hr2 = closest_hit(r, &ref_bvh, &ref_bvh + 1, isect);
+
+        EXPECT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit && hr2.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+
+        auto any1 = any_hit(r, &ref_bvh, &ref_bvh + 1, ref_isect);
+        auto any2 = any_hit(r, &ref_bvh, &ref_bvh + 1, isect);
+
+        EXPECT_EQ(any1.hit, any2.hit);
+
+        auto multi1 = multi_hit<8>(r, &ref_bvh, &ref_bvh + 1, ref_isect);
+        auto multi2 = multi_hit<8>(r, &ref_bvh, &ref_bvh + 1, isect);
+
+        for (size_t j = 0; j < multi1.size(); ++j)
+        {
+            EXPECT_EQ(multi1[j].hit, multi2[j].hit);
+
+            if (multi1[j].hit && multi2[j].hit)
+            {
+                EXPECT_EQ(multi1[j].prim_id, multi2[j].prim_id);
+            }
+        }
+    }
+
+    // Ray packets
+    for (int i = 0; i < 250; ++i)
+    {
+        vec3 dirs[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            dirs[j] = normalize(vec3(dist(rng), dist(rng), dist(rng)));
+        }
+
+        basic_ray<simd::float4> r(
+                vector<3, simd::float4>(0.0f),
+                vector<3, simd::float4>(
+                    simd::float4(dirs[0].x, dirs[1].x, dirs[2].x, dirs[3].x),
+                    simd::float4(dirs[0].y, dirs[1].y, dirs[2].y, dirs[3].y),
+                    simd::float4(dirs[0].z, dirs[1].z, dirs[2].z, dirs[3].z)
+                    )
+                );
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1, ref_isect);
+        auto hr2 = closest_hit(r, &ref_bvh, &ref_bvh + 1, isect);
+
+        EXPECT_TRUE(all(hr1.hit == hr2.hit));
+        EXPECT_TRUE(all(!hr1.hit || hr1.prim_id == hr2.prim_id));
+    }
+}
+
+template <typename BVH>
+void test_traversal_strategies(BVH const& tree)
+{
+    test_traversal_strategy<bvh_traversal<bvh_child_order::split_axis>>(tree);
+    test_traversal_strategy<bvh_traversal<bvh_child_order::distance, bvh_stack_mode::restart>>(tree);
+    test_traversal_strategy<bvh_traversal<bvh_child_order::split_axis, bvh_stack_mode::restart>>(tree);
+    test_traversal_strategy<bvh_traversal<bvh_child_order::distance, bvh_stack_mode::restart, 0>>(tree);
+    test_traversal_strategy<bvh_traversal<bvh_child_order::split_axis, bvh_stack_mode::restart, 1>>(tree);
+}
+
+TEST(BVH, TraversalStrategies)
+{
+    auto triangles = make_random_triangles(5000, 100.0f, 1.0f);
+
+    // Scale down so that rays see lots of overlapping triangles
+    for (auto& t : triangles)
+    {
+        t.v1 *= 0.01f;
+    }
+
+    thread_pool pool(4);
+
+    binned_sah_builder sah;
+    lbvh_builder lbvh;
+
+    auto sah_tree = sah.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+    auto lbvh_tree = lbvh.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool, 1);
+
+    // The split axis is stored in the inner nodes
+    for (auto const& n : sah_tree.nodes())
+    {
+        if (n.is_inner())
+        {
+            auto const& low = sah_tree.nodes()[n.get_child(n.get_low_child())].get_bounds();
+            auto const& high = sah_tree.nodes()[n.get_child(!n.get_low_child())].get_bounds();
+            unsigned axis = n.get_split_axis();
+
+            EXPECT_LE(low.min[axis] + low.max[axis], high.min[axis] + high.max[axis]);
+        }
+    }
+
+    test_traversal_strategies(sah_tree);
+    test_traversal_strategies(lbvh_tree);
+}
+
+// Trees deeper than the restart trail (64 levels)
+TEST(BVH, TraversalDeepTree)
+{
+    auto triangles = make_random_triangles(150, 100.0f, 1.0f);
+
+    for (auto& t : triangles)
+    {
+        t.v1 *= 0.01f;
+    }
+
+    // Degenerate tree: inner node k has leaf k and inner node k+1 as children
+    index_bvh<triangle_t> tree(triangles.data(), triangles.size());
+
+    int n = static_cast<int>(triangles.size());
+
+    for (int k = 0; k < n; ++k)
+    {
+        tree.indices()[k] = static_cast<unsigned>(k);
+        tree.nodes()[k == n - 1 ? 2 * k : 2 * k + 1].set_leaf(get_bounds(triangles[k]), k, 1);
+    }
+
+    for (int k = n - 2; k >= 0; --k)
+    {
+        auto const& left = tree.nodes()[2 * k + 1].get_bounds();
+        auto const& right = tree.nodes()[2 * k + 2].get_bounds();
+        tree.nodes()[2 * k].set_inner(combine(left, right), 2 * k + 1, left, right);
+    }
+
+    auto ref_bvh = tree.ref();
+
+    std::default_random_engine rng(6);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    strategy_intersector<bvh_traversal<bvh_child_order::distance, bvh_stack_mode::restart>> isect1;
+    strategy_intersector<bvh_traversal<bvh_child_order::split_axis, bvh_stack_mode::restart, 0>> isect2;
+
+    int num_hits = 0;
+
+    for (int i = 0; i < 500; ++i)
+    {
+        basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        // Brute force
+        hit_record<basic_ray<float>, primitive<unsigned>> expected;
+
+        for (auto const& t : triangles)
+        {
+            auto hr = intersect(r, t);
+
+            if (hr.hit && hr.t > 0.0f && (!expected.hit || hr.t < expected.t))
+            {
+                expected = hr;
+            }
+        }
+
+        auto hr1 = closest_hit(r, &ref_bvh, &ref_bvh + 1, isect1);
+        auto hr2 = closest_hit(r, &ref_bvh, &ref_bvh + 1, isect2);
+
+        EXPECT_EQ(hr1.hit, expected.hit);
+        EXPECT_EQ(hr2.hit, expected.hit);
+
+        if (expected.hit)
+        {
+            EXPECT_EQ(hr1.prim_id, expected.prim_id);
+            EXPECT_EQ(hr2.prim_id, expected.prim_id);
+            ++num_hits;
+        }
+
+        EXPECT_EQ(any_hit(r, &ref_bvh, &ref_bvh + 1, isect2).hit, expected.hit);
+    }
+
+    EXPECT_GT(num_hits, 0);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that occlusion queries agree with any hit traversal
+//
+
+template <bvh_occlusion_order Order, typename Primitives>
+void test_occluded(Primitives begin, Primitives end)
+{
+    std::default_random_engine rng(7);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> dist_t(0.0f, 2.0f);
+
+    int num_occluded = 0;
+
+    for (int i = 0; i < 500; ++i)
+    {
+        basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+        float max_t = dist_t(rng);
+
+        auto hr = any_hit(r, begin, end, max_t);
+        bool occl = occluded<Order>(r, begin, end, max_t);
+
+        EXPECT_EQ(hr.hit, occl);
+
+        if (occl)
+        {
+            ++num_occluded;
+        }
+    }
+
+    EXPECT_TRUE(num_occluded > 0);
+    EXPECT_TRUE(num_occluded < 500);
+
+    // Ray packets
+    for (int i = 0; i < 250; ++i)
+    {
+        vec3 oris[4];
+        vec3 dirs[4];
+
+        for (int j = 0; j < 4; ++j)
+        {
+            oris[j] = vec3(dist(rng), dist(rng), dist(rng));
+            dirs[j] = normalize(vec3(dist(rng), dist(rng), dist(rng)));
+        }
+
+        basic_ray<simd::float4> r(
+                vector<3, simd::float4>(
+                    simd::float4(oris[0].x, oris[1].x, oris[2].x, oris[3].x),
+                    simd::float4(oris[0].y, oris[1].y, oris[2].y, oris[3].y),
+                    simd::float4(oris[0].z, oris[1].z, oris[2].z, oris[3].z)
+                    ),
+                vector<3, simd::float4>(
+                    simd::float4(dirs[0].x, dirs[1].x, dirs[2].x, dirs[3].x),
+                    simd::float4(dirs[0].y, dirs[1].y, dirs[2].y, dirs[3].y),
+                    simd::float4(dirs[0].z, dirs[1].z, dirs[2].z, dirs[3].z)
+                    )
+                );
+        simd::float4 max_t(dist_t(rng), dist_t(rng), dist_t(rng), dist_t(rng));
+
+        auto hr = any_hit(r, begin, end, max_t);
+        auto occl = occluded<Order>(r, begin, end, max_t);
+
+        EXPECT_TRUE(all(hr.hit == occl));
+    }
+}
+
+TEST(BVH, Occluded)
+{
+    auto triangles = make_random_triangles(5000, 100.0f, 1.0f);
+
+    // Scale down so that about half of the rays are occluded
+    for (auto& t : triangles)
+    {
+        t.v1 *= 0.01f;
+        t.e1 *= 0.05f;
+        t.e2 *= 0.05f;
+    }
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+
+    auto index_tree = builder.build(index_bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+    auto tree = builder.build(bvh<triangle_t>{}, triangles.data(), triangles.size(), pool);
+    auto wide_tree = collapse<bvh4<triangle_t>>(index_tree);
+
+    auto index_ref = index_tree.ref();
+    auto ref = tree.ref();
+    auto wide_ref = wide_tree.ref();
+
+    test_occluded<bvh_occlusion_order::none>(&index_ref, &index_ref + 1);
+    test_occluded<bvh_occlusion_order::surface_area>(&index_ref, &index_ref + 1);
+    test_occluded<bvh_occlusion_order::none>(&ref, &ref + 1);
+    test_occluded<bvh_occlusion_order::none>(&wide_ref, &wide_ref + 1);
+    test_occluded<bvh_occlusion_order::none>(triangles.begin(), triangles.begin() + 500);
+
+    // Two-level BVH
+    using instance_t = index_bvh<triangle_t>::bvh_inst;
+
+    aligned_vector<instance_t> instances;
+    instances.push_back(index_tree.inst(mat4::translation(vec3(0.5f, 0.0f, 0.0f))));
+    instances.push_back(index_tree.inst(mat4::scaling(vec3(0.5f))));
+
+    index_bvh<instance_t> top;
+    build_top_level(top, builder, instances.data(), instances.size(), pool);
+
+    auto top_ref = top.ref();
+
+    test_occluded<bvh_occlusion_order::surface_area>(&top_ref, &top_ref + 1);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test instances of BVHs over instances
+//
+
+TEST(BVH, NestedInstances)
+{
+    using bottom_level_bvh = index_bvh<triangle_t>;
+    using mesh_instance_t = bottom_level_bvh::bvh_inst;
+    using group_bvh = index_bvh<mesh_instance_t>;
+    using group_instance_t = group_bvh::bvh_inst;
+    using top_level_bvh = index_bvh<group_instance_t>;
+
+    binned_sah_builder builder;
+
+    aligned_vector<triangle_t> triangles;
+    triangles.emplace_back(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f));
+    triangles.emplace_back(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 1.0f, 0.0f), vec3(0.0f, 1.0f, 0.0f));
+    triangles.emplace_back(vec3(0.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 0.0f), vec3(1.0f, 0.0f, 1.0f));
+
+    for (size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i].prim_id = static_cast<unsigned>(i);
+        triangles[i].geom_id = 1;
+    }
+
+    auto bottom = builder.build(bottom_level_bvh{}, triangles.data(), triangles.size());
+
+    // A group of two meshes, the second one with its own material
+    aligned_vector<mesh_instance_t> meshes;
+    meshes.push_back(bottom.inst(mat4::identity()));
+    meshes.push_back(bottom.inst(mat4::translation(vec3(3.0f, 0.0f, 0.0f))));
+    meshes[0].set_inst_id(10);
+    meshes[1].set_inst_id(11);
+    meshes[1].set_geom_id(5);
+
+    auto group = builder.build(group_bvh{}, meshes.data(), meshes.size());
+
+    // Three instances of the group, the last one is turned around the y axis
+    aligned_vector<group_instance_t> groups;
+    groups.push_back(group.inst(mat4::identity()));
+    groups.push_back(group.inst(mat4::translation(vec3(0.0f, 5.0f, 0.0f))));
+    groups.push_back(group.inst(
+            mat4::translation(vec3(0.0f, -5.0f, 0.0f)) * mat4::rotation(vec3(0.0f, 1.0f, 0.0f), constants::pi<float>())
+            ));
+    groups[0].set_inst_id(20);
+    groups[1].set_inst_id(21);
+    groups[2].set_inst_id(22);
+
+    EXPECT_FALSE(groups[1] == group.inst(mat4::translation(vec3(0.0f, 5.0f, 0.0f))));
+
+    auto top = builder.build(top_level_bvh{}, groups.data(), groups.size());
+    auto top_ref = top.ref();
+
+    struct
+    {
+        basic_ray<float> ray;
+        int path[2];
+        int geom_id;
+        float nz;
+    } tests[] = {
+        { basic_ray<float>(vec3( 0.5f,  0.25f,  5.0f), vec3(0.0f, 0.0f, -1.0f)), { 20, 10 }, 1,  1.0f },
+        { basic_ray<float>(vec3( 3.5f,  5.25f,  5.0f), vec3(0.0f, 0.0f, -1.0f)), { 21, 11 }, 5,  1.0f },
+        { basic_ray<float>(vec3(-3.5f, -4.75f, -5.0f), vec3(0.0f, 0.0f,  1.0f)), { 22, 11 }, 5, -1.0f },
+        { basic_ray<float>(vec3(-0.5f, -4.75f, -5.0f), vec3(0.0f, 0.0f,  1.0f)), { 22, 10 }, 1, -1.0f }
+        };
+
+    array<basic_ray<float>, 4> rays;
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        auto const& test = tests[i];
+
+        auto hr = closest_hit(test.ray, &top_ref, &top_ref + 1);
+
+        ASSERT_TRUE(hr.hit);
+        EXPECT_FLOAT_EQ(hr.t, 5.0f);
+        EXPECT_EQ(hr.prim_id, 0);
+        EXPECT_EQ(hr.geom_id, test.geom_id);
+
+        auto path = get_inst_path(hr);
+        EXPECT_EQ(path.size(), 2U);
+        EXPECT_EQ(path[0], test.path[0]);
+        EXPECT_EQ(path[1], test.path[1]);
+
+        auto n = get_normal(hr, top_ref);
+        EXPECT_NEAR(n.z, test.nz, 1e-5f);
+
+        // Kernels look up the primitive through all instance levels
+        struct
+        {
+            using primitive_type = top_level_bvh::bvh_ref;
+
+            struct
+            {
+                primitive_type const* begin;
+            } prims;
+        } params;
+        params.prims.begin = &top_ref;
+
+        EXPECT_TRUE(&get_primitive(params, hr) == &bottom.primitive(0));
+
+        rays[i] = test.ray;
+    }
+
+    // Packet traversal
+    auto r4 = simd::pack(rays);
+    auto hrs = simd::unpack(closest_hit(r4, &top_ref, &top_ref + 1));
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        ASSERT_TRUE(hrs[i].hit);
+        EXPECT_FLOAT_EQ(hrs[i].t, 5.0f);
+        EXPECT_EQ(hrs[i].geom_id, tests[i].geom_id);
+
+        auto path = get_inst_path(hrs[i]);
+        EXPECT_EQ(path[0], tests[i].path[0]);
+        EXPECT_EQ(path[1], tests[i].path[1]);
+    }
+
+    // Misses between the instances
+    basic_ray<float> r(vec3(1.5f, 0.25f, 5.0f), vec3(0.0f, 0.0f, -1.0f));
+    EXPECT_FALSE(closest_hit(r, &top_ref, &top_ref + 1).hit);
+    EXPECT_FALSE(any_hit(r, &top_ref, &top_ref + 1).hit);
+}
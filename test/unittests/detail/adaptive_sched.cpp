@@ -0,0 +1,99 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include <visionaray/detail/range.h>
+#include <visionaray/scheduler.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that hilbert_index() visits each cell once, and neighbors consecutively
+//
+
+TEST(AdaptiveSched, HilbertIndex)
+{
+    unsigned n = 8;
+
+    std::vector<int> x(n * n, -1);
+    std::vector<int> y(n * n, -1);
+
+    for (unsigned j = 0; j < n; ++j)
+    {
+        for (unsigned i = 0; i < n; ++i)
+        {
+            unsigned d = detail::hilbert_index(n, i, j);
+            ASSERT_LT(d, n * n);
+            EXPECT_EQ(x[d], -1);
+
+            x[d] = i;
+            y[d] = j;
+        }
+    }
+
+    for (unsigned d = 1; d < n * n; ++d)
+    {
+        EXPECT_EQ(std::abs(x[d] - x[d - 1]) + std::abs(y[d] - y[d - 1]), 1);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that each packet is visited exactly once, also after tiles were split
+//
+
+TEST(AdaptiveSched, Coverage)
+{
+    adaptive_sched_backend backend(3);
+
+    int pw = 4;
+    int ph = 4;
+
+    for (int width : { 101, 37 })
+    {
+        int height = 53;
+
+        tiled_range2d<int> tr(0, width, 16, 0, height, 16);
+
+        std::vector<std::atomic<int>> counts(width * height);
+
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            for (auto& c : counts)
+            {
+                c = 0;
+            }
+
+            backend.for_each_packet(tr, pw, ph, [&](int x, int y)
+            {
+                EXPECT_EQ(x % pw, 0);
+                EXPECT_EQ(y % ph, 0);
+
+                ++counts[y * width + x];
+
+                // Expensive region, its tiles are split in later frames
+                if (x < 16 && y < 16)
+                {
+                    std::this_thread::sleep_for(std::chrono::microseconds(200));
+                }
+            });
+
+            for (int y = 0; y < height; ++y)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    bool packet = x % pw == 0 && y % ph == 0;
+                    EXPECT_EQ(counts[y * width + x].load(), packet ? 1 : 0);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,193 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include <visionaray/detail/numa.h>
+#include <visionaray/detail/thread_pool.h>
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test the topology, there is always at least one node with CPUs
+//
+
+TEST(NUMA, Topology)
+{
+    auto const& topology = get_numa_topology();
+
+    ASSERT_GE(topology.num_nodes(), 1U);
+
+    for (unsigned n = 0; n < topology.num_nodes(); ++n)
+    {
+        EXPECT_FALSE(topology.cpus[n].empty());
+
+        for (unsigned c : topology.cpus[n])
+        {
+            EXPECT_EQ(topology.node_of_cpu(c), n);
+        }
+    }
+
+    EXPECT_LT(current_numa_node(), topology.num_nodes());
+
+    auto ids = detail::parse_id_list("0-3,8,10-11");
+    EXPECT_EQ(ids, std::vector<unsigned>({ 0, 1, 2, 3, 8, 10, 11 }));
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test the thread pool in NUMA mode
+//
+
+TEST(NUMA, ThreadPool)
+{
+    thread_pool pool(4, true);
+
+    std::vector<std::atomic<int>> counts(10000);
+
+    for (int run = 0; run < 10; ++run)
+    {
+        for (auto& c : counts)
+        {
+            c = 0;
+        }
+
+        pool.run([&](long i) { ++counts[i]; }, static_cast<long>(counts.size()));
+
+        for (auto const& c : counts)
+        {
+            EXPECT_EQ(c.load(), 1);
+        }
+    }
+
+    std::atomic<long> count(0);
+
+    pool.run([&](long)
+    {
+        pool.run([&](long) { ++count; }, 10);
+    }, 10);
+
+    EXPECT_EQ(count.load(), 100);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that released pages read as zeros and can be written again
+//
+
+TEST(NUMA, ReleasePages)
+{
+    size_t n = 1 << 20;
+
+    aligned_vector<int> a(n, 1);
+
+    release_pages(a.data(), n * sizeof(int));
+
+    size_t zeros = 0;
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        EXPECT_TRUE(a[i] == 0 || a[i] == 1);
+        zeros += a[i] == 0;
+
+        a[i] = 2;
+    }
+
+    // Only partial pages at both ends are kept
+    EXPECT_GT(zeros, n / 2);
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        EXPECT_EQ(a[i], 2);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test per-node replication
+//
+
+TEST(NUMA, Replicated)
+{
+    std::vector<int> value{ 1, 2, 3 };
+
+    numa_replicated<std::vector<int>> replicas(value);
+
+    EXPECT_EQ(replicas.size(), get_numa_topology().num_nodes());
+
+    for (unsigned n = 0; n < replicas.size(); ++n)
+    {
+        EXPECT_EQ(replicas[n], value);
+        EXPECT_NE(replicas[n].data(), value.data());
+    }
+
+    EXPECT_EQ(replicas.local(), value);
+
+    auto generated = numa_replicated<unsigned>::generate([](unsigned node) { return node * 2; });
+
+    ASSERT_EQ(generated.size(), replicas.size());
+
+    for (unsigned n = 0; n < generated.size(); ++n)
+    {
+        EXPECT_EQ(generated[n], n * 2);
+    }
+
+    EXPECT_EQ(local_replica(generated), generated.local());
+    EXPECT_EQ(&local_replica(value), &value);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that the scheduler renders with the kernel of each thread's node
+//
+
+struct node_kernel
+{
+    float node;
+
+    template <typename R>
+    vector<4, typename R::scalar_type> operator()(R) const
+    {
+        using S = typename R::scalar_type;
+        return vector<4, S>(S(node));
+    }
+};
+
+TEST(NUMA, ReplicatedKernel)
+{
+    int width = 70;
+    int height = 37;
+
+    simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED> rt;
+    rt.resize(width, height);
+
+    auto sparams = make_sched_params(mat4::identity(), mat4::identity(), rt);
+
+    thread_pool pool(4, true);
+    tiled_sched<basic_ray<float>> sched(pool);
+
+    auto kernels = numa_replicated<node_kernel>::generate([](unsigned node)
+    {
+        return node_kernel{ static_cast<float>(node) };
+    });
+
+    sched.frame(kernels, sparams);
+
+    auto color = rt.color();
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        EXPECT_GE(color[i].x, 0.0f);
+        EXPECT_LT(color[i].x, static_cast<float>(kernels.size()));
+        EXPECT_EQ(color[i].x, static_cast<float>(static_cast<int>(color[i].x)));
+    }
+}
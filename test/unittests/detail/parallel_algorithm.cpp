@@ -6,9 +6,11 @@
 #include <algorithm>
 #include <array>
 #include <cstdlib>
+#include <iterator>
 #include <vector>
 
 #include <visionaray/detail/parallel_algorithm.h>
+#include <visionaray/detail/thread_pool.h>
 
 #include <gtest/gtest.h>
 
@@ -114,3 +116,109 @@ TEST(ParallelAlgorithm, CountingSort)
 }
 
 #endif // VSNRAY_HAVE_TBB
+
+
+//-------------------------------------------------------------------------------------------------
+// Test counting_sort() and radix_sort() on a thread pool
+//
+
+TEST(ParallelAlgorithm, CountingSortThreadPool)
+{
+    thread_pool pool(4);
+
+    // Larger array of key/value pairs, test stability
+    {
+        static const size_t N = 1000000;
+        static const size_t K = 256;
+
+        std::vector<std::pair<int, int>> a(N);
+        std::vector<std::pair<int, int>> b(N);
+        std::vector<int> counts(K);
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            a[i] = std::make_pair(rand() % static_cast<int>(K), static_cast<int>(i));
+        }
+
+        paralgo::counting_sort(
+                pool,
+                a.begin(),
+                a.end(),
+                b.begin(),
+                counts,
+                [](std::pair<int, int> const& val) { return val.first; }
+                );
+
+        // Keys sorted, values (input positions) ascending per key
+        EXPECT_TRUE(std::is_sorted(b.begin(), b.end()));
+        EXPECT_EQ(counts[K - 1], static_cast<int>(N));
+    }
+}
+
+TEST(ParallelAlgorithm, RadixSortThreadPool)
+{
+    thread_pool pool(4);
+
+    static const size_t N = 500000;
+
+    std::vector<unsigned> a(N);
+    std::vector<unsigned> temp(N);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        a[i] = static_cast<unsigned>(rand()) ^ (static_cast<unsigned>(rand()) << 16);
+    }
+
+    auto b = a;
+
+    paralgo::radix_sort(pool, a.begin(), a.end(), temp.begin());
+
+    std::sort(b.begin(), b.end());
+    EXPECT_TRUE(a == b);
+
+    // Odd number of passes, sort only the lower 30 bits
+    for (size_t i = 0; i < N; ++i)
+    {
+        a[i] &= 0x3FFFFFFF;
+    }
+
+    b = a;
+
+    paralgo::radix_sort<10>(pool, a.begin(), a.end(), temp.begin(), 30);
+
+    std::sort(b.begin(), b.end());
+    EXPECT_TRUE(a == b);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test copy_if() on a thread pool
+//
+
+TEST(ParallelAlgorithm, CopyIfThreadPool)
+{
+    thread_pool pool(4);
+
+    static const size_t N = 100003;
+
+    std::vector<int> a(N);
+
+    for (size_t i = 0; i < N; ++i)
+    {
+        a[i] = rand() % 100;
+    }
+
+    auto pred = [](int val) { return val < 30; };
+
+    std::vector<int> b(N);
+    std::vector<int> expected;
+    std::copy_if(a.begin(), a.end(), std::back_inserter(expected), pred);
+
+    auto last = paralgo::copy_if(pool, a.begin(), a.end(), b.begin(), pred);
+
+    ASSERT_EQ(static_cast<size_t>(last - b.begin()), expected.size());
+    EXPECT_TRUE(std::equal(expected.begin(), expected.end(), b.begin()));
+
+    // Empty input
+    EXPECT_TRUE(paralgo::copy_if(pool, a.begin(), a.begin(), b.begin(), pred) == b.begin());
+}
@@ -0,0 +1,163 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <visionaray/detail/parallel_for.h>
+#include <visionaray/detail/range.h>
+#include <visionaray/detail/thread_pool.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that each work item is executed exactly once
+//
+
+TEST(ThreadPool, Run)
+{
+    for (unsigned num_threads : { 0U, 1U, 4U })
+    {
+        thread_pool pool(num_threads);
+
+        std::vector<std::atomic<int>> counts(10000);
+
+        for (auto& c : counts)
+        {
+            c = 0;
+        }
+
+        pool.run([&](long i) { ++counts[i]; }, static_cast<long>(counts.size()));
+
+        for (auto const& c : counts)
+        {
+            EXPECT_EQ(c.load(), 1);
+        }
+
+        // Empty run
+        pool.run([&](long i) { ++counts[i]; }, 0);
+
+        EXPECT_EQ(counts[0].load(), 1);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test many small consecutive runs, e.g. one per frame
+//
+
+TEST(ThreadPool, ConsecutiveRuns)
+{
+    thread_pool pool(4);
+
+    std::atomic<long> sum(0);
+
+    for (int frame = 0; frame < 1000; ++frame)
+    {
+        pool.run([&](long i) { sum += i; }, 8);
+    }
+
+    EXPECT_EQ(sum.load(), 1000 * 28);
+
+    // After reset
+    pool.reset(2);
+    sum = 0;
+
+    pool.run([&](long i) { sum += i; }, 100);
+
+    EXPECT_EQ(sum.load(), 4950);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test run() from inside a work item
+//
+
+TEST(ThreadPool, Nested)
+{
+    thread_pool pool(4);
+
+    std::atomic<long> count(0);
+
+    pool.run([&](long)
+    {
+        pool.run([&](long)
+        {
+            pool.run([&](long) { ++count; }, 10);
+        }, 10);
+    }, 10);
+
+    EXPECT_EQ(count.load(), 1000);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test pool shared by several threads outside the pool
+//
+
+TEST(ThreadPool, SharedByThreads)
+{
+    thread_pool pool(2);
+
+    std::atomic<long> count1(0);
+    std::atomic<long> count2(0);
+
+    std::thread t1([&]()
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            pool.run([&](long) { ++count1; }, 100);
+        }
+    });
+
+    std::thread t2([&]()
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            pool.run([&](long) { ++count2; }, 100);
+        }
+    });
+
+    t1.join();
+    t2.join();
+
+    EXPECT_EQ(count1.load(), 10000);
+    EXPECT_EQ(count2.load(), 10000);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test parallel_for() on top of the pool
+//
+
+TEST(ThreadPool, ParallelFor)
+{
+    thread_pool pool(3);
+
+    std::vector<int> a(1001, 0);
+
+    parallel_for(pool, range1d<int>(0, 1001), [&](int i) { a[i] += i; });
+
+    for (int i = 0; i < 1001; ++i)
+    {
+        EXPECT_EQ(a[i], i);
+    }
+
+    std::atomic<int> count(0);
+
+    parallel_for(pool, tiled_range2d<int>(0, 100, 16, 0, 50, 16), [&](range2d<int> const& r)
+    {
+        count += (r.rows().end() - r.rows().begin()) * (r.cols().end() - r.cols().begin());
+    });
+
+    EXPECT_EQ(count.load(), 5000);
+
+    // Empty range
+    parallel_for(pool, range1d<int>(0, 0), [&](int i) { a[i] = -1; });
+
+    EXPECT_EQ(a[0], 0);
+}
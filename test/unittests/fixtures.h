@@ -0,0 +1,262 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#pragma once
+
+#ifndef VSNRAY_UNITTESTS_FIXTURES_H
+#define VSNRAY_UNITTESTS_FIXTURES_H 1
+
+#include <cstddef>
+#include <random>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/ray_stream.h>
+
+namespace visionaray
+{
+
+//-------------------------------------------------------------------------------------------------
+// Random triangles with their first vertex in [-pos_range..pos_range]^3 and
+// edges in [-edge_range..edge_range]^3, prim_ids are consecutive
+//
+
+template <typename Triangle = basic_triangle<3, float>>
+aligned_vector<Triangle, 32> make_random_triangles(
+        size_t      count,
+        float       pos_range,
+        float       edge_range,
+        unsigned    seed = 0,
+        unsigned    geom_id = 0
+        )
+{
+    std::default_random_engine rng(seed);
+    std::uniform_real_distribution<float> pos(-pos_range, pos_range);
+    std::uniform_real_distribution<float> edge(-edge_range, edge_range);
+
+    aligned_vector<Triangle, 32> triangles(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        triangles[i] = Triangle(
+                vec3(pos(rng), pos(rng), pos(rng)),
+                vec3(edge(rng), edge(rng), edge(rng)),
+                vec3(edge(rng), edge(rng), edge(rng))
+                );
+        triangles[i].prim_id = static_cast<unsigned>(i);
+        triangles[i].geom_id = geom_id;
+    }
+
+    return triangles;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Random triangles (cf. make_random_triangles()) that are translated by up to
+// motion_range and deformed by up to edge_range / 2 over the shutter interval
+//
+
+inline aligned_vector<basic_motion_triangle<float>> make_random_motion_triangles(
+        size_t      count,
+        float       pos_range,
+        float       edge_range,
+        float       motion_range,
+        unsigned    seed = 0
+        )
+{
+    auto key0 = make_random_triangles(count, pos_range, edge_range, seed);
+
+    std::default_random_engine rng(seed + 1);
+    std::uniform_real_distribution<float> edge(-edge_range, edge_range);
+    std::uniform_real_distribution<float> motion(-motion_range, motion_range);
+
+    aligned_vector<basic_motion_triangle<float>> triangles(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto key1 = key0[i];
+        key1.v1 += vec3(motion(rng), motion(rng), motion(rng));
+        key1.e1 += vec3(edge(rng), edge(rng), edge(rng)) * 0.5f;
+
+        triangles[i] = basic_motion_triangle<float>(key0[i], key1);
+    }
+
+    return triangles;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Random mesh where each vertex is shared by several triangles, triangles holds
+// the same triangles as indexed_triangles
+//
+
+struct random_mesh
+{
+    aligned_vector<vec3> vertices;
+    aligned_vector<basic_indexed_triangle<float>> indexed_triangles;
+    aligned_vector<basic_triangle<3, float>> triangles;
+};
+
+inline random_mesh make_random_mesh(size_t num_vertices, size_t num_triangles, unsigned seed = 0)
+{
+    std::default_random_engine rng(seed);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_int_distribution<unsigned> index(0, static_cast<unsigned>(num_vertices - 1));
+
+    random_mesh result;
+
+    result.vertices.resize(num_vertices);
+
+    for (auto& v : result.vertices)
+    {
+        v = vec3(pos(rng), pos(rng), pos(rng));
+    }
+
+    result.indexed_triangles.resize(num_triangles);
+    result.triangles.resize(num_triangles);
+
+    for (size_t i = 0; i < num_triangles; ++i)
+    {
+        unsigned i1 = index(rng);
+        unsigned i2 = index(rng);
+        unsigned i3 = index(rng);
+
+        // Keep the triangles small
+        vec3 v1 = result.vertices[i1];
+        result.vertices[i2] = v1 + (result.vertices[i2] - v1) * 0.1f;
+        result.vertices[i3] = v1 + (result.vertices[i3] - v1) * 0.1f;
+
+        result.indexed_triangles[i] = basic_indexed_triangle<float>(i1, i2, i3);
+        result.indexed_triangles[i].prim_id = static_cast<unsigned>(i);
+        result.indexed_triangles[i].geom_id = 1;
+    }
+
+    // Vertices were moved above, so convert afterwards
+    for (size_t i = 0; i < num_triangles; ++i)
+    {
+        result.triangles[i] = make_triangle(result.indexed_triangles[i], result.vertices.data());
+    }
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Bumpy N x N grid in the unit square, two indexed triangles per cell
+//
+
+struct grid_mesh
+{
+    int n;
+    aligned_vector<vec3> vertices;
+    aligned_vector<basic_indexed_triangle<float>> triangles;
+
+    unsigned index(int i, int j) const
+    {
+        return static_cast<unsigned>(j * n + i);
+    }
+};
+
+inline grid_mesh make_grid_mesh(int n, unsigned seed = 0)
+{
+    std::default_random_engine rng(seed);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+    grid_mesh result;
+    result.n = n;
+
+    float h = 1.0f / (n - 1);
+
+    for (int j = 0; j < n; ++j)
+    {
+        for (int i = 0; i < n; ++i)
+        {
+            result.vertices.emplace_back(
+                    (i + jitter(rng)) * h,
+                    (j + jitter(rng)) * h,
+                    jitter(rng) * h
+                    );
+        }
+    }
+
+    for (int j = 0; j < n - 1; ++j)
+    {
+        for (int i = 0; i < n - 1; ++i)
+        {
+            result.triangles.emplace_back(result.index(i, j), result.index(i + 1, j), result.index(i + 1, j + 1));
+            result.triangles.emplace_back(result.index(i, j), result.index(i + 1, j + 1), result.index(i, j + 1));
+        }
+    }
+
+    for (size_t i = 0; i < result.triangles.size(); ++i)
+    {
+        result.triangles[i].prim_id = static_cast<unsigned>(i);
+        result.triangles[i].geom_id = 0;
+    }
+
+    return result;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Random curves, each a random walk of control points with steps in
+// [-0.3..0.3]^3 starting in [-1..1]^3, prim_ids are consecutive
+//
+
+inline aligned_vector<basic_curve<float>> make_random_curves(size_t count, unsigned seed = 0)
+{
+    std::default_random_engine rng(seed);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> offset(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> radius(0.005f, 0.02f);
+
+    aligned_vector<basic_curve<float>> curves(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        vec3 p(pos(rng), pos(rng), pos(rng));
+
+        auto next = [&]()
+        {
+            p += vec3(offset(rng), offset(rng), offset(rng));
+            return vec4(p, radius(rng));
+        };
+
+        curves[i] = basic_curve<float>(next(), next(), next(), next());
+        curves[i].prim_id = static_cast<unsigned>(i);
+        curves[i].geom_id = 0;
+    }
+
+    return curves;
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Incoherent rays from random points in [-1..1]^3, every third ray has
+// max_t = 0.3, like a shadow ray
+//
+
+inline ray_stream make_random_rays(size_t count, unsigned seed = 0)
+{
+    std::default_random_engine rng(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    ray_stream rays;
+    rays.reserve(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        basic_ray<float> r(
+                vec3(dist(rng), dist(rng), dist(rng)),
+                normalize(vec3(dist(rng), dist(rng), dist(rng)))
+                );
+
+        rays.push_back(r, i % 3 == 0 ? 0.3f : numeric_limits<float>::max());
+    }
+
+    return rays;
+}
+
+} // visionaray
+
+#endif // VSNRAY_UNITTESTS_FIXTURES_H
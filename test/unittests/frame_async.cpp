@@ -0,0 +1,244 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <visionaray/math/math.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+using render_target_type = simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED>;
+
+// Records the threads that begin and end frames
+struct recording_rt : render_target_type
+{
+    void begin_frame()
+    {
+        begin_thread = std::this_thread::get_id();
+        ++num_begin;
+    }
+
+    void end_frame()
+    {
+        end_thread = std::this_thread::get_id();
+        ++num_end;
+    }
+
+    std::thread::id begin_thread;
+    std::thread::id end_thread;
+    int num_begin = 0;
+    int num_end = 0;
+};
+
+struct kernel
+{
+    template <typename R>
+    vector<4, typename R::scalar_type> operator()(R) const
+    {
+        using S = typename R::scalar_type;
+        return vector<4, S>(S(0.5f));
+    }
+};
+
+// Each pixel is covered by exactly one tile
+static void check_coverage(std::vector<recti> const& tiles, int width, int height)
+{
+    std::vector<int> counts(width * height, 0);
+
+    for (auto const& t : tiles)
+    {
+        for (int y = t.y; y < t.y + t.h; ++y)
+        {
+            for (int x = t.x; x < t.x + t.w; ++x)
+            {
+                ++counts[y * width + x];
+            }
+        }
+    }
+
+    for (int c : counts)
+    {
+        EXPECT_EQ(c, 1);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test frame_async() with tile callbacks and polling
+//
+
+TEST(FrameAsync, Tiles)
+{
+    int width = 70;
+    int height = 37;
+
+    render_target_type rt;
+    rt.resize(width, height);
+
+    mat4 mv = mat4::identity();
+    mat4 pr = mat4::identity();
+
+    auto sparams = make_sched_params(mv, pr, rt);
+
+    tiled_sched<basic_ray<float>> sched(3);
+
+    std::mutex mutex;
+    std::vector<recti> reported;
+
+    auto handle = sched.frame_async(kernel{}, sparams, [&](recti const& tile)
+    {
+        std::unique_lock<std::mutex> l(mutex);
+        reported.push_back(tile);
+    });
+
+    ASSERT_TRUE(handle.valid());
+
+    std::vector<recti> polled;
+
+    while (!handle.ready())
+    {
+        handle.poll(polled);
+    }
+
+    handle.wait();
+    handle.poll(polled);
+
+    EXPECT_FALSE(handle.canceled());
+    EXPECT_EQ(handle.num_tiles(), size_t(5 * 3));
+    EXPECT_EQ(handle.num_completed_tiles(), handle.num_tiles());
+    EXPECT_EQ(polled.size(), handle.num_tiles());
+    EXPECT_EQ(reported.size(), handle.num_tiles());
+
+    check_coverage(polled, width, height);
+    check_coverage(reported, width, height);
+
+    auto color = rt.color();
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        EXPECT_FLOAT_EQ(color[i].x, 0.5f);
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test canceling a frame
+//
+
+TEST(FrameAsync, Cancel)
+{
+    render_target_type rt;
+    rt.resize(512, 512);
+
+    mat4 mv = mat4::identity();
+    mat4 pr = mat4::identity();
+
+    auto sparams = make_sched_params(mv, pr, rt);
+
+    tiled_sched<basic_ray<float>> sched(2);
+
+    // Cancel before the first packet was rendered
+    std::atomic<bool> go(false);
+
+    auto handle = sched.frame_async(kernel{}, sparams, [&](recti const&)
+    {
+        while (!go)
+        {
+        }
+    });
+
+    handle.cancel();
+    go = true;
+    handle.wait();
+
+    EXPECT_TRUE(handle.ready());
+    EXPECT_TRUE(handle.canceled());
+    EXPECT_LT(handle.num_completed_tiles(), handle.num_tiles());
+
+    // The scheduler can render the next frame
+    auto next = sched.frame_async(kernel{}, sparams);
+    next.wait();
+
+    EXPECT_EQ(next.num_completed_tiles(), next.num_tiles());
+
+    // Cancel without waiting, the next frame waits for the running packets
+    go = false;
+
+    auto canceled = sched.frame_async(kernel{}, sparams, [&](recti const&)
+    {
+        while (!go)
+        {
+        }
+    });
+
+    canceled.cancel();
+    go = true;
+
+    auto last = sched.frame_async(kernel{}, sparams);
+
+    EXPECT_TRUE(canceled.ready());
+
+    last.wait();
+    EXPECT_EQ(last.num_completed_tiles(), last.num_tiles());
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that frames are begun and ended on the calling thread
+//
+
+TEST(FrameAsync, BeginEndFrame)
+{
+    recording_rt rt;
+    rt.resize(64, 64);
+
+    mat4 mv = mat4::identity();
+    mat4 pr = mat4::identity();
+
+    auto sparams = make_sched_params(mv, pr, rt);
+
+    tiled_sched<basic_ray<float>> sched(2);
+
+    auto handle = sched.frame_async(kernel{}, sparams);
+
+    EXPECT_EQ(rt.num_begin, 1);
+    EXPECT_EQ(rt.begin_thread, std::this_thread::get_id());
+
+    handle.finish();
+
+    EXPECT_TRUE(handle.ready());
+    EXPECT_EQ(rt.num_end, 1);
+    EXPECT_EQ(rt.end_thread, std::this_thread::get_id());
+
+    // Only the first call ends the frame
+    handle.finish();
+    EXPECT_EQ(rt.num_end, 1);
+
+    // The last handle ends the frame, or the next frame does
+    {
+        auto h = sched.frame_async(kernel{}, sparams);
+    }
+
+    EXPECT_EQ(rt.num_begin, 2);
+    EXPECT_EQ(rt.num_end, 2);
+
+    auto h = sched.frame_async(kernel{}, sparams);
+    sched.frame(kernel{}, sparams);
+
+    EXPECT_TRUE(h.ready());
+    EXPECT_EQ(rt.num_begin, 4);
+    EXPECT_EQ(rt.num_end, 4);
+    EXPECT_EQ(rt.end_thread, std::this_thread::get_id());
+}
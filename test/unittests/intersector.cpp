@@ -0,0 +1,186 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <random>
+
+#include <visionaray/detail/thread_pool.h>
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/intersector.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+#include "fixtures.h"
+
+using namespace visionaray;
+
+using triangle_type = basic_triangle<3, float>;
+using indexed_triangle_type = basic_indexed_triangle<float>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that the watertight test agrees with the default test
+//
+
+TEST(Intersector, WatertightTriangle)
+{
+    std::default_random_engine rng(5);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    int hits = 0;
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        triangle_type t(
+                vec3(dist(rng), dist(rng), dist(rng)),
+                vec3(dist(rng), dist(rng), dist(rng)),
+                vec3(dist(rng), dist(rng), dist(rng))
+                );
+        t.prim_id = static_cast<unsigned>(i);
+        t.geom_id = 2;
+
+        basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)) * 3.0f, vec3(0.0f));
+        r.dir = normalize(t.v1 + t.e1 * dist(rng) + t.e2 * dist(rng) - r.ori);
+
+        auto hr1 = intersect(r, t);
+        auto hr2 = intersect_watertight(r, t);
+
+        // Skip rays close to the edges
+        auto near_edge = [](float u, float v)
+        {
+            return (min(u, v) > -1e-3f && min(u, v) < 1e-3f)
+                || (u + v > 1.0f - 1e-3f && u + v < 1.0f + 1e-3f);
+        };
+
+        if (near_edge(hr1.u, hr1.v) || near_edge(hr2.u, hr2.v))
+        {
+            continue;
+        }
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            ++hits;
+
+            EXPECT_EQ(hr2.prim_id, t.prim_id);
+            EXPECT_EQ(hr2.geom_id, t.geom_id);
+            EXPECT_NEAR(hr1.t, hr2.t, 1e-3f * hr1.t);
+            EXPECT_NEAR(hr1.u, hr2.u, 1e-3f);
+            EXPECT_NEAR(hr1.v, hr2.v, 1e-3f);
+        }
+    }
+
+    EXPECT_TRUE(hits > 1000);
+
+    // SIMD rays agree with single rays
+    triangle_type t(vec3(-1.0f, -1.0f, 1.0f), vec3(2.0f, 0.0f, 0.0f), vec3(0.0f, 2.0f, 0.0f));
+    t.prim_id = 0;
+    t.geom_id = 0;
+
+    simd::ray4 r4;
+    r4.ori = vector<3, simd::float4>(
+            simd::float4(-0.5f, 0.5f, -0.5f, 2.0f),
+            simd::float4(-0.5f, -0.5f, 0.4f, 0.0f),
+            simd::float4(2.0f, 2.0f, 2.0f, -2.0f)
+            );
+    r4.dir = vector<3, simd::float4>(
+            simd::float4(0.0f, 0.0f, 0.1f, 0.0f),
+            simd::float4(0.0f, 0.0f, 0.0f, 0.0f),
+            simd::float4(-1.0f, -1.0f, -1.0f, 1.0f)
+            );
+
+    auto hrs = unpack(intersect_watertight(r4, t));
+    auto rays = unpack(r4);
+
+    for (int i = 0; i < 4; ++i)
+    {
+        auto hr = intersect_watertight(rays[i], t);
+
+        EXPECT_EQ(hrs[i].hit, hr.hit);
+
+        if (hr.hit)
+        {
+            EXPECT_FLOAT_EQ(hrs[i].t, hr.t);
+            EXPECT_FLOAT_EQ(hrs[i].u, hr.u);
+            EXPECT_FLOAT_EQ(hrs[i].v, hr.v);
+        }
+    }
+
+    EXPECT_TRUE(hrs[0].hit);
+    EXPECT_FLOAT_EQ(hrs[0].t, 1.0f);
+    EXPECT_FLOAT_EQ(hrs[1].u, 0.75f);
+    EXPECT_FLOAT_EQ(hrs[1].v, 0.25f);
+    EXPECT_FALSE(hrs[3].hit);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that rays through shared edges don't leak
+//
+
+TEST(Intersector, Watertight)
+{
+    auto g = make_grid_mesh(16, 4);
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+    index_bvh<indexed_triangle_type> tree;
+    build_indexed_triangles(tree, builder, g.triangles.data(), g.triangles.size(), g.vertices.data(), pool);
+    auto ref = tree.ref();
+
+    std::default_random_engine rng(6);
+    std::uniform_int_distribution<int> cell(1, g.n - 3);
+    std::uniform_int_distribution<int> edge(0, 2);
+    std::uniform_real_distribution<float> param(0.0f, 1.0f);
+    std::uniform_real_distribution<float> pos(-2.0f, 3.0f);
+
+    watertight_intersector isect(g.vertices.data());
+
+    for (int i = 0; i < 10000; ++i)
+    {
+        // Aim at a point on an interior edge
+        int x = cell(rng);
+        int y = cell(rng);
+        int e = edge(rng);
+
+        vec3 v1 = g.vertices[g.index(x, y)];
+        vec3 v2 = g.vertices[e == 0 ? g.index(x + 1, y) : e == 1 ? g.index(x, y + 1) : g.index(x + 1, y + 1)];
+
+        basic_ray<float> r(vec3(pos(rng), pos(rng), 2.0f), vec3(0.0f));
+        r.dir = normalize(lerp(v1, v2, param(rng)) - r.ori);
+
+        auto hr = closest_hit(r, &ref, &ref + 1, isect);
+
+        ASSERT_TRUE(hr.hit);
+        EXPECT_TRUE(hr.t > 0.0f);
+
+        // Axis-aligned rays, too
+        basic_ray<float> r2(vec3(lerp(v1, v2, param(rng)).xy(), 2.0f), vec3(0.0f, 0.0f, -1.0f));
+
+        hr = closest_hit(r2, &ref, &ref + 1, isect);
+
+        ASSERT_TRUE(hr.hit);
+    }
+
+    // Linear traversal and SIMD rays
+    std::uniform_real_distribution<float> target(0.2f, 0.8f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        simd::ray4 r4;
+        r4.ori = vector<3, simd::float4>(simd::float4(0.5f), simd::float4(0.5f), simd::float4(2.0f));
+        r4.dir = normalize(vector<3, simd::float4>(
+                simd::float4(target(rng), target(rng), target(rng), target(rng)),
+                simd::float4(target(rng), target(rng), target(rng), target(rng)),
+                simd::float4(0.0f)
+                ) - r4.ori);
+
+        auto hr = closest_hit(r4, g.triangles.begin(), g.triangles.end(), isect);
+
+        EXPECT_TRUE(all(hr.hit));
+    }
+}
@@ -0,0 +1,255 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <random>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/get_tex_coord.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+#include "../fixtures.h"
+
+using namespace visionaray;
+
+using curve_type = basic_curve<float>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test curve evaluation and bounds
+//
+
+TEST(Curve, Bounds)
+{
+    auto curves = make_random_curves(100, 3);
+
+    for (auto const& c : curves)
+    {
+        EXPECT_TRUE(curve_point(c, 0.0f) == c.p0);
+        EXPECT_TRUE(curve_point(c, 1.0f) == c.p3);
+
+        auto bounds = get_bounds(c);
+
+        for (int i = 0; i <= 32; ++i)
+        {
+            auto p = curve_point(c, i / 32.0f);
+
+            EXPECT_TRUE(bounds.contains(p.xyz() - vec3(p.w)));
+            EXPECT_TRUE(bounds.contains(p.xyz() + vec3(p.w)));
+        }
+    }
+
+    // Uniform B-spline with equidistant control points is a straight line
+    auto b = make_bspline_curve(
+            vec4(0.0f, 0.0f, 0.0f, 0.1f),
+            vec4(1.0f, 0.0f, 0.0f, 0.1f),
+            vec4(2.0f, 0.0f, 0.0f, 0.1f),
+            vec4(3.0f, 0.0f, 0.0f, 0.1f)
+            );
+
+    EXPECT_FLOAT_EQ(b.p0.x, 1.0f);
+    EXPECT_FLOAT_EQ(b.p3.x, 2.0f);
+    EXPECT_FLOAT_EQ(curve_point(b, 0.5f).x, 1.5f);
+    EXPECT_FLOAT_EQ(curve_point(b, 0.5f).w, 0.1f);
+    EXPECT_FLOAT_EQ(curve_tangent(b, 0.5f).x, 1.0f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test ray / curve intersection with a straight curve (a cylinder)
+//
+
+TEST(Curve, Intersect)
+{
+    curve_type c(
+            vec4(-2.0f, 0.0f, 0.0f, 0.5f),
+            vec4(-1.0f, 0.0f, 0.0f, 0.5f),
+            vec4( 1.0f, 0.0f, 0.0f, 0.5f),
+            vec4( 2.0f, 0.0f, 0.0f, 0.5f)
+            );
+    c.prim_id = 7;
+    c.geom_id = 3;
+
+    basic_ray<float> r(vec3(0.0f, 0.0f, 5.0f), vec3(0.0f, 0.0f, -1.0f));
+
+    auto hr = intersect(r, c);
+
+    EXPECT_TRUE(hr.hit);
+    EXPECT_EQ(hr.prim_id, 7U);
+    EXPECT_EQ(hr.geom_id, 3U);
+    EXPECT_NEAR(hr.t, 4.5f, 1e-4f);
+    EXPECT_NEAR(hr.u, 0.5f, 1e-4f);
+    EXPECT_NEAR(hr.v, 0.0f, 1e-4f);
+
+    auto n = get_normal(hr, c);
+    EXPECT_NEAR(n.z, 1.0f, 1e-4f);
+
+    auto tc = get_tex_coord(hr, c);
+    EXPECT_FLOAT_EQ(tc.x, hr.u);
+    EXPECT_FLOAT_EQ(tc.y, hr.v);
+
+    // Off-axis, the hit is on the surface
+    r.ori = vec3(0.5f, 0.3f, 5.0f);
+    hr = intersect(r, c);
+
+    EXPECT_TRUE(hr.hit);
+    EXPECT_NEAR(hr.t, 5.0f - 0.4f, 1e-4f);
+    EXPECT_NEAR(hr.v, 0.6f, 1e-4f);
+
+    n = get_normal(hr, c);
+    EXPECT_NEAR(n.x, 0.0f, 1e-4f);
+    EXPECT_NEAR(n.y, 0.6f, 1e-4f);
+    EXPECT_NEAR(n.z, 0.8f, 1e-4f);
+
+    // Misses: beside the tube, beyond the end, and behind the origin
+    r.ori = vec3(0.0f, 0.6f, 5.0f);
+    EXPECT_FALSE(intersect(r, c).hit);
+
+    r.ori = vec3(2.6f, 0.0f, 5.0f);
+    EXPECT_FALSE(intersect(r, c).hit);
+
+    r.ori = vec3(0.0f, 0.0f, 5.0f);
+    r.dir = vec3(0.0f, 0.0f, 1.0f);
+    EXPECT_FALSE(intersect(r, c).hit);
+
+    // SIMD ray
+    simd::ray4 r4;
+    r4.ori = vector<3, simd::float4>(
+            simd::float4(0.0f, 0.5f, 0.0f, 3.0f),
+            simd::float4(0.0f, 0.3f, 0.6f, 0.0f),
+            simd::float4(5.0f)
+            );
+    r4.dir = vector<3, simd::float4>(simd::float4(0.0f), simd::float4(0.0f), simd::float4(-1.0f));
+
+    auto hr4 = intersect(r4, c);
+    auto hrs = unpack(hr4);
+
+    EXPECT_TRUE(hrs[0].hit);
+    EXPECT_TRUE(hrs[1].hit);
+    EXPECT_FALSE(hrs[2].hit);
+    EXPECT_FALSE(hrs[3].hit);
+
+    EXPECT_NEAR(hrs[0].t, 4.5f, 1e-4f);
+    EXPECT_NEAR(hrs[1].t, 4.6f, 1e-4f);
+
+    r.ori = vec3(0.5f, 0.3f, 5.0f);
+    r.dir = vec3(0.0f, 0.0f, -1.0f);
+    hr = intersect(r, c);
+
+    EXPECT_FLOAT_EQ(hrs[1].u, hr.u);
+    EXPECT_FLOAT_EQ(hrs[1].v, hr.v);
+
+    // Oblique rays hit the surface of the cylinder, z = 0.5 at t = 1.5
+    r.ori = vec3(-1.0f, 0.0f, 2.0f);
+    r.dir = vec3(1.0f, 0.0f, -1.0f);
+    hr = intersect(r, c);
+
+    EXPECT_TRUE(hr.hit);
+    EXPECT_NEAR(hr.t, 1.5f, 1e-4f);
+    EXPECT_NEAR(hr.isect_pos.z, 0.5f, 1e-4f);
+    EXPECT_NEAR(hr.v, 0.0f, 1e-4f);
+
+    // Rays along the axis hit the sphere at the end
+    r.ori = vec3(5.0f, 0.0f, 0.0f);
+    r.dir = vec3(-1.0f, 0.0f, 0.0f);
+    hr = intersect(r, c);
+
+    EXPECT_TRUE(hr.hit);
+    EXPECT_NEAR(hr.t, 2.5f, 1e-4f);
+    EXPECT_NEAR(hr.u, 1.0f, 1e-4f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test ray / curve intersection with a straight curve with linearly varying radius (a cone)
+//
+
+TEST(Curve, IntersectCone)
+{
+    // Radius 0.2 + 0.1 * (x + 2)
+    curve_type c(
+            vec4(-2.0f,        0.0f, 0.0f, 0.2f),
+            vec4(-2.0f / 3.0f, 0.0f, 0.0f, 0.2f + 0.4f / 3.0f),
+            vec4( 2.0f / 3.0f, 0.0f, 0.0f, 0.2f + 0.8f / 3.0f),
+            vec4( 2.0f,        0.0f, 0.0f, 0.6f)
+            );
+
+    basic_ray<float> r(vec3(1.0f, 0.0f, 5.0f), vec3(0.0f, 0.0f, -1.0f));
+
+    auto hr = intersect(r, c);
+
+    EXPECT_TRUE(hr.hit);
+    EXPECT_NEAR(hr.t, 4.5f, 1e-4f);
+    EXPECT_NEAR(hr.u, 0.75f, 1e-4f);
+
+    // 2 - t = 0.2 + 0.1 * (1 + t)
+    r.ori = vec3(-1.0f, 0.0f, 2.0f);
+    r.dir = vec3(1.0f, 0.0f, -1.0f);
+    hr = intersect(r, c);
+
+    EXPECT_TRUE(hr.hit);
+    EXPECT_NEAR(hr.t, 1.7f / 1.1f, 1e-4f);
+    EXPECT_NEAR(hr.isect_pos.z, 0.2f + 0.1f * (hr.isect_pos.x + 2.0f), 1e-4f);
+
+    // Passes the thin end, hits the thick one
+    r.ori = vec3(-1.75f, 0.3f, 5.0f);
+    r.dir = vec3(0.0f, 0.0f, -1.0f);
+    EXPECT_FALSE(intersect(r, c).hit);
+
+    r.ori = vec3(1.75f, 0.3f, 5.0f);
+    EXPECT_TRUE(intersect(r, c).hit);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test BVHs over curves against brute force, with and without spatial splits
+//
+
+TEST(Curve, BVH)
+{
+    auto curves = make_random_curves(2000, 3);
+
+    std::default_random_engine rng(4);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int spatial_splits = 0; spatial_splits < 2; ++spatial_splits)
+    {
+        binned_sah_builder builder;
+        builder.enable_spatial_splits(spatial_splits != 0);
+
+        auto tree = builder.build(index_bvh<curve_type>{}, curves.data(), curves.size());
+        auto ref = tree.ref();
+
+        int hits = 0;
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)) * 0.2f, vec3(0.0f));
+            r.dir = normalize(vec3(dist(rng), dist(rng), dist(rng)));
+
+            auto hr1 = closest_hit(r, &ref, &ref + 1);
+            auto hr2 = closest_hit(r, curves.begin(), curves.end());
+
+            ASSERT_EQ(hr1.hit, hr2.hit);
+
+            if (hr1.hit)
+            {
+                ++hits;
+
+                EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+                EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+
+                auto n = get_normal(hr1, curves[hr1.prim_id]);
+                auto tangent = curve_tangent(curves[hr1.prim_id], hr1.u);
+
+                EXPECT_NEAR(dot(n, normalize(tangent)), 0.0f, 1e-3f);
+            }
+        }
+
+        EXPECT_TRUE(hits > 0);
+    }
+}
@@ -0,0 +1,275 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <random>
+
+#include <visionaray/detail/thread_pool.h>
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/get_area.h>
+#include <visionaray/get_color.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/get_shading_normal.h>
+#include <visionaray/get_tex_coord.h>
+#include <visionaray/intersector.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+#include "../fixtures.h"
+
+using namespace visionaray;
+
+using triangle_type = basic_triangle<3, float>;
+using indexed_triangle_type = basic_indexed_triangle<float>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test conversion to basic_triangle and geometric functions
+//
+
+TEST(IndexedTriangle, Conversion)
+{
+    aligned_vector<vec3> vertices{
+            vec3(1.0f, 2.0f, 3.0f),
+            vec3(3.0f, 2.0f, 3.0f),
+            vec3(1.0f, 2.0f, 7.0f)
+            };
+
+    // Indices only, no vertex pointer
+    static_assert(sizeof(indexed_triangle_type) == 20, "Size mismatch");
+
+    indexed_triangle_type t(0, 1, 2);
+    t.prim_id = 5;
+    t.geom_id = 6;
+
+    auto r = make_triangle(t, vertices.data());
+
+    EXPECT_EQ(r.prim_id, 5U);
+    EXPECT_EQ(r.geom_id, 6U);
+    EXPECT_TRUE(r.v1 == vertices[0]);
+    EXPECT_TRUE(r.e1 == vec3(2.0f, 0.0f, 0.0f));
+    EXPECT_TRUE(r.e2 == vec3(0.0f, 0.0f, 4.0f));
+
+    EXPECT_FLOAT_EQ(area(t, vertices.data()), 4.0f);
+
+    auto bounds = get_bounds(t, vertices.data());
+    EXPECT_TRUE(bounds.min == vec3(1.0f, 2.0f, 3.0f));
+    EXPECT_TRUE(bounds.max == vec3(3.0f, 2.0f, 7.0f));
+
+    auto n = get_normal(hit_record<basic_ray<float>, primitive<unsigned>>{}, t, vertices.data());
+    EXPECT_FLOAT_EQ(n.x, 0.0f);
+    EXPECT_FLOAT_EQ(n.y, -1.0f);
+    EXPECT_FLOAT_EQ(n.z, 0.0f);
+
+    // Triangles see changes to the shared vertex array
+    vertices[1] = vec3(5.0f, 2.0f, 3.0f);
+    EXPECT_FLOAT_EQ(area(t, vertices.data()), 8.0f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test ray / indexed triangle intersection against ray / triangle intersection
+//
+
+TEST(IndexedTriangle, Intersect)
+{
+    auto m = make_random_mesh(500, 1000);
+
+    std::default_random_engine rng(3);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    int hits = 0;
+
+    for (size_t i = 0; i < m.triangles.size(); ++i)
+    {
+        auto const& t = m.triangles[i];
+        auto const& it = m.indexed_triangles[i];
+
+        for (int j = 0; j < 10; ++j)
+        {
+            vec3 target = t.v1 + t.e1 * dist(rng) + t.e2 * dist(rng);
+
+            basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)) * 3.0f, vec3(0.0f));
+            r.dir = normalize(target - r.ori);
+
+            auto hr1 = intersect(r, t);
+            auto hr2 = intersect(r, it, m.vertices.data());
+
+            ASSERT_EQ(hr1.hit, hr2.hit);
+
+            if (hr1.hit)
+            {
+                ++hits;
+
+                EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+                EXPECT_EQ(hr1.geom_id, hr2.geom_id);
+                EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+                EXPECT_FLOAT_EQ(hr1.u, hr2.u);
+                EXPECT_FLOAT_EQ(hr1.v, hr2.v);
+            }
+        }
+    }
+
+    EXPECT_TRUE(hits > 0);
+
+    // SIMD ray
+    aligned_vector<vec3> vertices{
+            vec3(-1.0f, -1.0f, 1.0f),
+            vec3( 1.0f, -1.0f, 1.0f),
+            vec3(-1.0f,  1.0f, 1.0f)
+            };
+
+    indexed_triangle_type it(0, 1, 2);
+    it.prim_id = 0;
+    it.geom_id = 0;
+
+    simd::ray4 r4;
+    r4.ori = vector<3, simd::float4>(
+            simd::float4(-0.5f, 0.5f, -0.5f, 2.0f),
+            simd::float4(-0.5f, -0.5f, 0.4f, 0.0f),
+            simd::float4(2.0f)
+            );
+    r4.dir = vector<3, simd::float4>(simd::float4(0.0f), simd::float4(0.0f), simd::float4(-1.0f));
+
+    auto hrs = unpack(intersect(r4, it, vertices.data()));
+
+    EXPECT_TRUE(hrs[0].hit);
+    EXPECT_TRUE(hrs[1].hit);
+    EXPECT_TRUE(hrs[2].hit);
+    EXPECT_FALSE(hrs[3].hit);
+
+    EXPECT_FLOAT_EQ(hrs[0].t, 1.0f);
+    EXPECT_FLOAT_EQ(hrs[1].u, 0.75f);
+    EXPECT_FLOAT_EQ(hrs[1].v, 0.25f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test BVHs over indexed triangles and per-vertex data lookup
+//
+
+TEST(IndexedTriangle, BVH)
+{
+    auto m = make_random_mesh(5000, 10000);
+
+    thread_pool pool(4);
+
+    binned_sah_builder builder;
+    builder.enable_spatial_splits(true);
+
+    auto tree1 = builder.build(index_bvh<triangle_type>{}, m.triangles.data(), m.triangles.size(), pool);
+
+    index_bvh<indexed_triangle_type> tree2;
+    build_indexed_triangles(tree2, builder, m.indexed_triangles.data(), m.indexed_triangles.size(), m.vertices.data(), pool);
+
+    // Same nodes as the BVH over the fetched triangles, primitives in input order
+    ASSERT_EQ(tree1.num_nodes(), tree2.num_nodes());
+    ASSERT_EQ(tree2.num_primitives(), m.indexed_triangles.size());
+
+    for (size_t i = 0; i < tree2.num_primitives(); ++i)
+    {
+        EXPECT_EQ(tree2.primitives()[i].prim_id, m.indexed_triangles[i].prim_id);
+    }
+
+    auto ref1 = tree1.ref();
+    auto ref2 = tree2.ref();
+
+    indexed_triangle_intersector isect(m.vertices.data());
+
+    // Instances pass the intersector on to the referenced BVHs
+    index_bvh<index_bvh<indexed_triangle_type>::bvh_inst> top_level;
+    auto inst = tree2.inst(mat4::identity());
+    build_top_level(top_level, builder, &inst, 1, pool);
+    auto top_level_ref = top_level.ref();
+
+    std::default_random_engine rng(2);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    // Shared per-vertex data for the indexed triangles, three entries
+    // per triangle for the triangles
+    aligned_vector<vec3> shared_normals(m.vertices.size());
+    aligned_vector<vec2> shared_tex_coords(m.vertices.size());
+
+    for (size_t i = 0; i < m.vertices.size(); ++i)
+    {
+        shared_normals[i] = normalize(vec3(dist(rng), dist(rng), dist(rng)));
+        shared_tex_coords[i] = vec2(dist(rng), dist(rng));
+    }
+
+    aligned_vector<vec3> normals(m.triangles.size() * 3);
+    aligned_vector<vec2> tex_coords(m.triangles.size() * 3);
+
+    for (size_t i = 0; i < m.triangles.size(); ++i)
+    {
+        auto const& t = m.indexed_triangles[i];
+
+        normals[i * 3]         = shared_normals[t.i1];
+        normals[i * 3 + 1]     = shared_normals[t.i2];
+        normals[i * 3 + 2]     = shared_normals[t.i3];
+
+        tex_coords[i * 3]      = shared_tex_coords[t.i1];
+        tex_coords[i * 3 + 1]  = shared_tex_coords[t.i2];
+        tex_coords[i * 3 + 2]  = shared_tex_coords[t.i3];
+    }
+
+    int hits = 0;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = closest_hit(r, &ref1, &ref1 + 1);
+        auto hr2 = closest_hit(r, &ref2, &ref2 + 1, isect);
+        auto hr3 = closest_hit(r, &top_level_ref, &top_level_ref + 1, isect);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+        ASSERT_EQ(hr1.hit, hr3.hit);
+
+        EXPECT_EQ(occluded(r, &top_level_ref, &top_level_ref + 1, 10.0f, isect), hr1.hit);
+
+        if (hr1.hit)
+        {
+            ++hits;
+
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_EQ(hr1.prim_id, hr3.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+            EXPECT_FLOAT_EQ(hr1.t, hr3.t);
+
+            auto const& prim = ref2.primitive(hr2.primitive_list_index);
+
+            auto n1 = get_normal(hr1, ref1);
+            auto n2 = get_normal(hr2, prim, m.vertices.data());
+
+            EXPECT_FLOAT_EQ(dot(n1, n2), 1.0f);
+
+            EXPECT_FLOAT_EQ(get_area(&ref1, hr1), get_area(&ref2, hr2, isect));
+            EXPECT_FLOAT_EQ(get_area(&ref1, hr1), get_area(&top_level_ref, hr3, isect));
+
+            auto sn1 = get_shading_normal(normals.data(), hr1, triangle_type{}, normals_per_vertex_binding{});
+            auto sn2 = get_shading_normal(shared_normals.data(), hr2, prim, normals_per_vertex_binding{});
+
+            EXPECT_FLOAT_EQ(sn1.x, sn2.x);
+            EXPECT_FLOAT_EQ(sn1.y, sn2.y);
+            EXPECT_FLOAT_EQ(sn1.z, sn2.z);
+
+            auto tc1 = get_tex_coord(tex_coords.data(), hr1, triangle_type{});
+            auto tc2 = get_tex_coord(shared_tex_coords.data(), hr2, prim);
+
+            EXPECT_FLOAT_EQ(tc1.x, tc2.x);
+            EXPECT_FLOAT_EQ(tc1.y, tc2.y);
+
+            auto c1 = get_color(normals.data(), hr1, triangle_type{}, colors_per_vertex_binding{});
+            auto c2 = get_color(shared_normals.data(), hr2, prim, colors_per_vertex_binding{});
+
+            EXPECT_FLOAT_EQ(c1.x, c2.x);
+            EXPECT_FLOAT_EQ(c1.y, c2.y);
+            EXPECT_FLOAT_EQ(c1.z, c2.z);
+        }
+    }
+
+    EXPECT_TRUE(hits > 0);
+}
@@ -0,0 +1,408 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <random>
+
+#include <visionaray/detail/sched_common.h>
+#include <visionaray/detail/thread_pool.h>
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/matrix_camera.h>
+#include <visionaray/pinhole_camera.h>
+#include <visionaray/random_generator.h>
+#include <visionaray/thin_lens_camera.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+#include "../fixtures.h"
+
+using namespace visionaray;
+
+using triangle_type = basic_triangle<3, float>;
+using motion_triangle_type = basic_motion_triangle<float>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+// Sample primary rays and check that their times lie in the shutter interval
+template <typename Camera>
+static void test_shutter(Camera cam)
+{
+    random_generator<float> gen(7);
+
+    basic_ray<float> r;
+
+    // Empty shutter interval: no motion blur
+    for (int i = 0; i < 16; ++i)
+    {
+        r = detail::invoke_cam_primary_ray(basic_ray<float>{}, cam, gen, float(i), 8.0f, 16.0f, 16.0f);
+        EXPECT_EQ(r.time, 0.0f);
+    }
+
+    cam.set_shutter(0.25f, 0.75f);
+
+    float min_time = 1.0f;
+    float max_time = 0.0f;
+
+    for (int i = 0; i < 256; ++i)
+    {
+        r = detail::invoke_cam_primary_ray(basic_ray<float>{}, cam, gen, float(i % 16), float(i / 16), 16.0f, 16.0f);
+        EXPECT_GE(r.time, 0.25f);
+        EXPECT_LT(r.time, 0.75f);
+
+        min_time = min(min_time, r.time);
+        max_time = max(max_time, r.time);
+    }
+
+    EXPECT_LT(min_time, 0.35f);
+    EXPECT_GT(max_time, 0.65f);
+}
+
+// Brute force closest hit with the triangles at TIME
+static hit_record<basic_ray<float>, primitive<unsigned>> closest_hit_at(
+        basic_ray<float> const&                     r,
+        aligned_vector<motion_triangle_type> const& triangles
+        )
+{
+    aligned_vector<triangle_type> static_triangles;
+
+    for (auto const& t : triangles)
+    {
+        static_triangles.push_back(interpolate(t, r.time));
+    }
+
+    return closest_hit(r, static_triangles.begin(), static_triangles.end());
+}
+
+template <typename BVH>
+static void test_motion_bvh(BVH const& tree, aligned_vector<motion_triangle_type> const& triangles)
+{
+    std::default_random_engine rng(6);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> time(0.0f, 1.0f);
+
+    // Key bounds of inner nodes contain the key bounds of their children
+    for (auto const& n : tree.nodes())
+    {
+        if (n.is_leaf())
+        {
+            continue;
+        }
+
+        for (int key = 0; key < 2; ++key)
+        {
+            aabb bounds = n.get_key_bounds(key);
+
+            for (unsigned i = 0; i < 2; ++i)
+            {
+                aabb child_bounds = tree.node(n.get_child(i)).get_key_bounds(key);
+                EXPECT_TRUE(all(child_bounds.min >= bounds.min));
+                EXPECT_TRUE(all(child_bounds.max <= bounds.max));
+            }
+        }
+    }
+
+    auto ref = tree.ref();
+
+    int hits = 0;
+
+    for (int i = 0; i < 500; ++i)
+    {
+        basic_ray<float> r(
+                vec3(dist(rng), dist(rng), dist(rng)),
+                normalize(vec3(dist(rng), dist(rng), dist(rng))),
+                time(rng)
+                );
+
+        auto hr1 = closest_hit(r, &ref, &ref + 1);
+        auto hr2 = closest_hit_at(r, triangles);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            ++hits;
+
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+
+            EXPECT_TRUE(any_hit(r, &ref, &ref + 1, hr1.t + 1e-3f).hit);
+            EXPECT_FALSE(any_hit(r, &ref, &ref + 1, hr1.t * 0.99f).hit);
+        }
+    }
+
+    EXPECT_TRUE(hits > 50);
+
+    // Packets with different times per ray
+    for (int i = 0; i < 100; ++i)
+    {
+        array<basic_ray<float>, 4> rays;
+
+        for (auto& r : rays)
+        {
+            r = basic_ray<float>(
+                    vec3(dist(rng), dist(rng), dist(rng)),
+                    normalize(vec3(dist(rng), dist(rng), dist(rng))),
+                    time(rng)
+                    );
+        }
+
+        auto r4 = simd::pack(rays);
+        auto hrs = simd::unpack(closest_hit(r4, &ref, &ref + 1));
+
+        for (int j = 0; j < 4; ++j)
+        {
+            auto hr = closest_hit_at(rays[j], triangles);
+
+            ASSERT_EQ(hrs[j].hit, hr.hit);
+
+            if (hr.hit)
+            {
+                EXPECT_EQ(hrs[j].prim_id, hr.prim_id);
+                EXPECT_FLOAT_EQ(hrs[j].t, hr.t);
+            }
+        }
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test interpolation, intersection, and normals of motion triangles
+//
+
+TEST(MotionTriangle, Intersect)
+{
+    triangle_type key0(
+            vec3(-1.0f, -1.0f, 0.0f),
+            vec3( 2.0f,  0.0f, 0.0f),
+            vec3( 0.0f,  2.0f, 0.0f)
+            );
+    key0.prim_id = 7;
+    key0.geom_id = 3;
+
+    // Moves by 4 along x, tilts towards +z
+    triangle_type key1(
+            vec3( 3.0f, -1.0f, 0.0f),
+            vec3( 2.0f,  0.0f, 2.0f),
+            vec3( 0.0f,  2.0f, 0.0f)
+            );
+
+    motion_triangle_type mt(key0, key1);
+
+    EXPECT_EQ(mt.prim_id, 7U);
+    EXPECT_EQ(mt.geom_id, 3U);
+
+    auto t = interpolate(mt, 0.5f);
+    EXPECT_FLOAT_EQ(t.v1.x, 1.0f);
+    EXPECT_FLOAT_EQ(t.e1.z, 1.0f);
+    EXPECT_EQ(t.prim_id, 7U);
+
+    // Time is clamped
+    EXPECT_FLOAT_EQ(interpolate(mt, 2.0f).v1.x, 3.0f);
+
+    auto bounds = get_bounds(mt);
+    EXPECT_FLOAT_EQ(bounds.min.x, -1.0f);
+    EXPECT_FLOAT_EQ(bounds.max.x, 5.0f);
+    EXPECT_FLOAT_EQ(bounds.max.z, 2.0f);
+
+    // Hits at time 0 only
+    basic_ray<float> r(vec3(-0.5f, -0.5f, 5.0f), vec3(0.0f, 0.0f, -1.0f));
+
+    auto hr = intersect(r, mt);
+    EXPECT_TRUE(hr.hit);
+    EXPECT_EQ(hr.prim_id, 7U);
+    EXPECT_FLOAT_EQ(hr.t, 5.0f);
+
+    auto n = get_normal(hr, mt);
+    EXPECT_FLOAT_EQ(n.z, 1.0f);
+
+    r.time = 1.0f;
+    EXPECT_FALSE(intersect(r, mt).hit);
+
+    // The tilted triangle at time 1
+    r.ori = vec3(3.5f, -0.5f, 5.0f);
+    hr = intersect(r, mt);
+    EXPECT_TRUE(hr.hit);
+    EXPECT_FLOAT_EQ(hr.t, 4.5f);
+
+    EXPECT_NEAR(get_time(mt, hr.isect_pos, hr.u, hr.v), 1.0f, 1e-5f);
+
+    n = get_normal(hr, mt);
+    EXPECT_NEAR(n.x, -0.70710678f, 1e-5f);
+    EXPECT_NEAR(n.z,  0.70710678f, 1e-5f);
+
+    // SIMD ray with a different time per lane
+    simd::ray4 r4;
+    r4.ori = vector<3, simd::float4>(
+            simd::float4(-0.5f, 1.5f, 3.5f, -0.5f),
+            simd::float4(-0.5f),
+            simd::float4(5.0f)
+            );
+    r4.dir = vector<3, simd::float4>(simd::float4(0.0f), simd::float4(0.0f), simd::float4(-1.0f));
+    r4.time = simd::float4(0.0f, 0.5f, 1.0f, 1.0f);
+
+    auto hrs = simd::unpack(intersect(r4, mt));
+
+    EXPECT_TRUE(hrs[0].hit);
+    EXPECT_TRUE(hrs[1].hit);
+    EXPECT_TRUE(hrs[2].hit);
+    EXPECT_FALSE(hrs[3].hit);
+
+    EXPECT_FLOAT_EQ(hrs[0].t, 5.0f);
+    EXPECT_FLOAT_EQ(hrs[2].t, 4.5f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test motion BVHs over motion triangles against brute force at random times
+//
+
+TEST(MotionTriangle, BVH)
+{
+    auto triangles = make_random_motion_triangles(2000, 1.0f, 0.1f, 0.2f, 5);
+
+    thread_pool pool(4);
+
+    for (int spatial_splits = 0; spatial_splits < 2; ++spatial_splits)
+    {
+        binned_sah_builder builder;
+        builder.enable_spatial_splits(spatial_splits != 0);
+
+        auto tree1 = builder.build(index_motion_bvh<motion_triangle_type>{}, triangles.data(), triangles.size());
+        test_motion_bvh(tree1, triangles);
+
+        auto tree2 = builder.build(motion_bvh<motion_triangle_type>{}, triangles.data(), triangles.size());
+        test_motion_bvh(tree2, triangles);
+    }
+
+    lbvh_builder lbvh;
+
+    auto tree = lbvh.build(index_motion_bvh<motion_triangle_type>{}, triangles.data(), triangles.size(), pool);
+    test_motion_bvh(tree, triangles);
+
+    // Restructuring keeps the key bounds valid
+    optimize(tree, pool);
+    test_motion_bvh(tree, triangles);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test BVH instances with transform motion
+//
+
+TEST(MotionTriangle, InstanceMotion)
+{
+    using bottom_level_bvh = index_bvh<triangle_type>;
+    using instance_t = bottom_level_bvh::bvh_motion_inst;
+
+    // Static instances do not store the motion keys
+    static_assert(
+            sizeof(bottom_level_bvh::bvh_inst) + 2 * sizeof(mat4) <= sizeof(instance_t),
+            "Size mismatch"
+            );
+
+    auto triangles = make_random_triangles(500, 1.0f, 0.2f, 7);
+
+    std::default_random_engine rng(7);
+    std::uniform_real_distribution<float> pos(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> time(0.0f, 1.0f);
+
+    binned_sah_builder builder;
+
+    auto bottom = builder.build(bottom_level_bvh{}, triangles.data(), triangles.size());
+
+    aligned_vector<instance_t> instances;
+    instances.push_back(instance_t(bottom.ref(), mat4::translation(vec3(-3.0f, 0.0f, 0.0f))));
+    instances.push_back(bottom.motion_inst(
+            mat4::translation(vec3(3.0f, 0.0f, 0.0f)),
+            mat4::translation(vec3(3.0f, 2.0f, 0.0f))
+            ));
+
+    EXPECT_FALSE(instances[0].has_motion());
+    EXPECT_TRUE(instances[1].has_motion());
+
+    // Bounds cover both keys
+    aabb bounds = get_bounds(instances[1]);
+    aabb bottom_bounds = bottom.node(0).get_bounds();
+    EXPECT_NEAR(bounds.min.y, bottom_bounds.min.y, 1e-5f);
+    EXPECT_NEAR(bounds.max.y, bottom_bounds.max.y + 2.0f, 1e-5f);
+
+    index_motion_bvh<instance_t> top = builder.build(
+            index_motion_bvh<instance_t>{},
+            instances.data(),
+            instances.size()
+            );
+    auto top_ref = top.ref();
+
+    int hits = 0;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(
+                vec3(pos(rng) * 4.0f, pos(rng) * 2.0f + 1.0f, 5.0f),
+                vec3(0.0f, 0.0f, -1.0f),
+                time(rng)
+                );
+
+        // The moving instance is at x > 2, translate the ray instead
+        basic_ray<float> local = r;
+        local.ori -= r.ori.x > 0.0f ? vec3(3.0f, 2.0f * r.time, 0.0f) : vec3(-3.0f, 0.0f, 0.0f);
+
+        auto hr1 = closest_hit(r, &top_ref, &top_ref + 1);
+        auto hr2 = closest_hit(local, triangles.begin(), triangles.end());
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            ++hits;
+
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_NEAR(hr1.t, hr2.t, 1e-4f);
+
+            EXPECT_TRUE(any_hit(r, &top_ref, &top_ref + 1, hr1.t + 1e-3f).hit);
+        }
+    }
+
+    EXPECT_TRUE(hits > 50);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that the schedulers' primary rays sample the camera shutter interval
+//
+
+TEST(MotionTriangle, CameraShutter)
+{
+    static_assert(detail::has_shutter<pinhole_camera>::value, "Shutter missing");
+    static_assert(detail::has_shutter<thin_lens_camera>::value, "Shutter missing");
+    static_assert(detail::has_shutter<matrix_camera>::value, "Shutter missing");
+
+    pinhole_camera pinhole;
+    pinhole.perspective(45.0f * constants::degrees_to_radians<float>(), 1.0f, 0.001f, 1000.0f);
+    pinhole.set_viewport(0, 0, 16, 16);
+    pinhole.look_at(vec3(0.0f, 0.0f, 4.0f), vec3(0.0f));
+    pinhole.begin_frame();
+
+    test_shutter(pinhole);
+
+    thin_lens_camera thin_lens;
+    thin_lens.perspective(45.0f * constants::degrees_to_radians<float>(), 1.0f, 0.001f, 1000.0f);
+    thin_lens.set_viewport(0, 0, 16, 16);
+    thin_lens.look_at(vec3(0.0f, 0.0f, 4.0f), vec3(0.0f));
+    thin_lens.set_lens_radius(0.1f);
+    thin_lens.set_focal_distance(4.0f);
+    thin_lens.begin_frame();
+
+    test_shutter(thin_lens);
+
+    matrix_camera matrix(pinhole.get_view_matrix(), pinhole.get_proj_matrix());
+    matrix.begin_frame();
+
+    test_shutter(matrix);
+}
@@ -0,0 +1,285 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <random>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/get_normal.h>
+#include <visionaray/get_tex_coord.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+#include "../fixtures.h"
+
+using namespace visionaray;
+
+using triangle_type = basic_triangle<3, float>;
+using woop_triangle_type = basic_woop_triangle<float>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test conversion to and from basic_triangle
+//
+
+TEST(WoopTriangle, Conversion)
+{
+    auto triangles = make_random_triangles(100, 1.0f, 0.2f, 0, 1);
+
+    for (auto const& t : triangles)
+    {
+        woop_triangle_type w(t);
+
+        EXPECT_EQ(w.prim_id, t.prim_id);
+        EXPECT_EQ(w.geom_id, t.geom_id);
+
+        auto r = make_triangle(w);
+
+        EXPECT_EQ(r.prim_id, t.prim_id);
+        EXPECT_EQ(r.geom_id, t.geom_id);
+
+        for (int i = 0; i < 3; ++i)
+        {
+            EXPECT_NEAR(r.v1[i], t.v1[i], 1e-5f);
+            EXPECT_NEAR(r.e1[i], t.e1[i], 1e-5f);
+            EXPECT_NEAR(r.e2[i], t.e2[i], 1e-5f);
+        }
+
+        EXPECT_NEAR(area(w), area(t), 1e-5f);
+
+        auto n1 = get_normal(hit_record<basic_ray<float>, primitive<unsigned>>{}, w);
+        auto n2 = get_normal(hit_record<basic_ray<float>, primitive<unsigned>>{}, t);
+
+        EXPECT_NEAR(n1.x, n2.x, 1e-5f);
+        EXPECT_NEAR(n1.y, n2.y, 1e-5f);
+        EXPECT_NEAR(n1.z, n2.z, 1e-5f);
+    }
+
+    // The transform maps the vertices to the unit triangle
+    woop_triangle_type w(vec3(1.0f, 2.0f, 3.0f), vec3(2.0f, 0.0f, 0.0f), vec3(0.0f, 0.0f, 4.0f));
+
+    auto apply = [](vec4 const& plane, vec3 const& p)
+    {
+        return dot(plane.xyz(), p) + plane.w;
+    };
+
+    EXPECT_FLOAT_EQ(apply(w.plane_u, vec3(3.0f, 2.0f, 3.0f)), 1.0f);
+    EXPECT_FLOAT_EQ(apply(w.plane_v, vec3(3.0f, 2.0f, 3.0f)), 0.0f);
+    EXPECT_FLOAT_EQ(apply(w.plane_u, vec3(1.0f, 2.0f, 7.0f)), 0.0f);
+    EXPECT_FLOAT_EQ(apply(w.plane_v, vec3(1.0f, 2.0f, 7.0f)), 1.0f);
+    EXPECT_FLOAT_EQ(apply(w.plane_n, vec3(1.0f, 2.0f, 3.0f)), 0.0f);
+
+    // Degenerate triangles keep their position and are never hit
+    woop_triangle_type d(vec3(1.0f, 2.0f, 3.0f), vec3(1.0f, 1.0f, 1.0f), vec3(2.0f, 2.0f, 2.0f));
+
+    auto bounds = get_bounds(d);
+    EXPECT_TRUE(bounds.min == vec3(1.0f, 2.0f, 3.0f));
+    EXPECT_TRUE(bounds.max == vec3(1.0f, 2.0f, 3.0f));
+
+    basic_ray<float> r(vec3(1.0f, 2.0f, 0.0f), vec3(0.0f, 0.0f, 1.0f));
+    EXPECT_FALSE(intersect(r, d).hit);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test that the bounds contain the source vertices, also for thin triangles far from the origin
+//
+
+TEST(WoopTriangle, Bounds)
+{
+    auto triangles = make_random_triangles(1000, 1.0f, 0.2f, 0, 1);
+
+    std::default_random_engine rng(2);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        vec3 v1 = vec3(dist(rng), dist(rng), dist(rng)) * 1000.0f;
+        vec3 e1 = vec3(dist(rng), dist(rng), dist(rng));
+        vec3 e2 = e1 * (1.0f + dist(rng) * 0.01f) + vec3(dist(rng), dist(rng), dist(rng)) * 1e-3f;
+
+        triangles.push_back(triangle_type(v1, e1, e2));
+    }
+
+    for (auto const& t : triangles)
+    {
+        woop_triangle_type w(t);
+
+        auto bounds = get_bounds(w);
+
+        EXPECT_TRUE(bounds.contains(t.v1));
+        EXPECT_TRUE(bounds.contains(t.v1 + t.e1));
+        EXPECT_TRUE(bounds.contains(t.v1 + t.e2));
+
+        // The padding stays small for well-conditioned triangles
+        if (length(t.v1) < 2.0f)
+        {
+            auto ref = get_bounds(t);
+            EXPECT_LT(max_element(bounds.size() - ref.size()), 1e-3f);
+        }
+
+        aabb L;
+        aabb R;
+        float plane = t.v1.x + t.e1.x * 0.5f;
+        split_primitive(L, R, plane, 0, w);
+
+        aabb L_ref;
+        aabb R_ref;
+        split_primitive(L_ref, R_ref, plane, 0, t);
+
+        EXPECT_TRUE(!L_ref.valid() || L.contains(L_ref));
+        EXPECT_TRUE(!R_ref.valid() || R.contains(R_ref));
+    }
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test ray / woop triangle intersection against ray / triangle intersection
+//
+
+TEST(WoopTriangle, Intersect)
+{
+    auto triangles = make_random_triangles(1000, 1.0f, 0.2f, 0, 1);
+
+    std::default_random_engine rng(1);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    int hits = 0;
+
+    for (auto const& t : triangles)
+    {
+        woop_triangle_type w(t);
+
+        for (int i = 0; i < 10; ++i)
+        {
+            // Aim at a random point around the triangle
+            vec3 target = t.v1 + t.e1 * dist(rng) + t.e2 * dist(rng);
+
+            basic_ray<float> r(vec3(dist(rng), dist(rng), dist(rng)) * 3.0f, vec3(0.0f));
+            r.dir = normalize(target - r.ori);
+
+            auto hr1 = intersect(r, t);
+            auto hr2 = intersect(r, w);
+
+            // Skip rays that graze the edges
+            if (hr1.hit && (min(hr1.u, hr1.v) < 1e-3f || hr1.u + hr1.v > 1.0f - 1e-3f))
+            {
+                continue;
+            }
+
+            if (!hr1.hit && hr2.hit && (min(hr2.u, hr2.v) < 1e-3f || hr2.u + hr2.v > 1.0f - 1e-3f))
+            {
+                continue;
+            }
+
+            ASSERT_EQ(hr1.hit, hr2.hit);
+
+            if (hr1.hit)
+            {
+                ++hits;
+
+                EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+                EXPECT_EQ(hr1.geom_id, hr2.geom_id);
+                EXPECT_NEAR(hr1.t, hr2.t, 1e-3f);
+                EXPECT_NEAR(hr1.u, hr2.u, 1e-3f);
+                EXPECT_NEAR(hr1.v, hr2.v, 1e-3f);
+            }
+        }
+    }
+
+    EXPECT_TRUE(hits > 0);
+
+    // SIMD ray
+    woop_triangle_type w(vec3(-1.0f, -1.0f, 1.0f), vec3(2.0f, 0.0f, 0.0f), vec3(0.0f, 2.0f, 0.0f));
+    w.prim_id = 0;
+    w.geom_id = 0;
+
+    simd::ray4 r4;
+    r4.ori = vector<3, simd::float4>(
+            simd::float4(-0.5f, 0.5f, -0.5f, 2.0f),
+            simd::float4(-0.5f, -0.5f, 0.4f, 0.0f),
+            simd::float4(2.0f)
+            );
+    r4.dir = vector<3, simd::float4>(simd::float4(0.0f), simd::float4(0.0f), simd::float4(-1.0f));
+
+    auto hr4 = intersect(r4, w);
+    auto hrs = unpack(hr4);
+
+    EXPECT_TRUE(hrs[0].hit);
+    EXPECT_TRUE(hrs[1].hit);
+    EXPECT_TRUE(hrs[2].hit);
+    EXPECT_FALSE(hrs[3].hit);
+
+    EXPECT_FLOAT_EQ(hrs[0].t, 1.0f);
+    EXPECT_FLOAT_EQ(hrs[1].u, 0.75f);
+    EXPECT_FLOAT_EQ(hrs[1].v, 0.25f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Test BVHs over woop triangles
+//
+
+TEST(WoopTriangle, BVH)
+{
+    auto triangles = make_random_triangles(10000, 1.0f, 0.2f, 0, 1);
+    auto woop_triangles = aligned_vector<woop_triangle_type>(triangles.begin(), triangles.end());
+
+    binned_sah_builder builder;
+    builder.enable_spatial_splits(true);
+
+    auto tree1 = builder.build(index_bvh<triangle_type>{}, triangles.data(), triangles.size());
+    auto tree2 = builder.build(index_bvh<woop_triangle_type>{}, woop_triangles.data(), woop_triangles.size());
+
+    auto ref1 = tree1.ref();
+    auto ref2 = tree2.ref();
+
+    std::default_random_engine rng(2);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+
+    aligned_vector<vec2> tex_coords(triangles.size() * 3);
+
+    for (auto& tc : tex_coords)
+    {
+        tc = vec2(dist(rng), dist(rng));
+    }
+
+    int mismatches = 0;
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        basic_ray<float> r(vec3(0.0f), normalize(vec3(dist(rng), dist(rng), dist(rng))));
+
+        auto hr1 = closest_hit(r, &ref1, &ref1 + 1);
+        auto hr2 = closest_hit(r, &ref2, &ref2 + 1);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (hr1.hit)
+        {
+            // Rays may hit a different triangle where triangles overlap
+            if (hr1.prim_id != hr2.prim_id)
+            {
+                ++mismatches;
+                continue;
+            }
+
+            EXPECT_NEAR(hr1.t, hr2.t, 1e-3f);
+
+            auto n1 = get_normal(hr1, ref1);
+            auto n2 = get_normal(hr2, ref2);
+
+            EXPECT_NEAR(dot(n1, n2), 1.0f, 1e-4f);
+
+            auto tc1 = get_tex_coord(tex_coords.data(), hr1, triangle_type{});
+            auto tc2 = get_tex_coord(tex_coords.data(), hr2, woop_triangle_type{});
+
+            EXPECT_NEAR(tc1.x, tc2.x, 1e-3f);
+            EXPECT_NEAR(tc1.y, tc2.y, 1e-3f);
+        }
+    }
+
+    EXPECT_TRUE(mismatches < 10);
+}
@@ -0,0 +1,350 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cstddef>
+#include <random>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/ray_stream.h>
+#include <visionaray/traverse.h>
+
+#include <gtest/gtest.h>
+
+#include "fixtures.h"
+
+using namespace visionaray;
+
+using triangle_type = basic_triangle<3, float>;
+
+
+//-------------------------------------------------------------------------------------------------
+// Test ray stream traversal against single ray traversal
+//
+
+TEST(RayStream, ClosestHit)
+{
+    auto triangles1 = make_random_triangles(5000, 1.0f, 0.1f, 2, 0);
+    auto triangles2 = make_random_triangles(5000, 1.0f, 0.1f, 3, 1);
+
+    binned_sah_builder builder;
+    builder.enable_spatial_splits(true);
+
+    auto tree1 = builder.build(index_bvh<triangle_type>{}, triangles1.data(), triangles1.size());
+    auto tree2 = builder.build(bvh<triangle_type>{}, triangles2.data(), triangles2.size());
+
+    auto rays = make_random_rays(5000, 7);
+
+    // index_bvh
+
+    auto ref1 = tree1.ref();
+
+    hit_stream hits;
+    closest_hit_stream(rays, hits, &ref1, &ref1 + 1);
+
+    ASSERT_EQ(hits.size(), rays.size());
+
+    int num_hits = 0;
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto hr1 = closest_hit(rays.get_ray(i), &ref1, &ref1 + 1);
+        auto hr2 = hits.get_hit_record(rays, i);
+
+        bool expected = hr1.hit && hr1.t < rays.max_t[i];
+
+        ASSERT_EQ(hr2.hit, expected);
+
+        if (expected)
+        {
+            ++num_hits;
+
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_EQ(hr1.geom_id, hr2.geom_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+            EXPECT_FLOAT_EQ(hr1.u, hr2.u);
+            EXPECT_FLOAT_EQ(hr1.v, hr2.v);
+
+            auto pos = rays.get_ray(i).ori + rays.get_ray(i).dir * hr1.t;
+            EXPECT_FLOAT_EQ(pos.x, hr2.isect_pos.x);
+        }
+    }
+
+    EXPECT_TRUE(num_hits > 1000);
+
+    // Multiple BVHs
+
+    auto tree3 = builder.build(bvh<triangle_type>{}, triangles1.data(), triangles1.size());
+
+    aligned_vector<bvh<triangle_type>::bvh_ref> refs;
+    refs.push_back(tree3.ref());
+    refs.push_back(tree2.ref());
+
+    closest_hit_stream(rays, hits, refs.begin(), refs.end());
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto hr1 = closest_hit(rays.get_ray(i), refs.begin(), refs.end());
+        auto hr2 = hits.get_hit_record(rays, i);
+
+        bool expected = hr1.hit && hr1.t < rays.max_t[i];
+
+        ASSERT_EQ(hr2.hit, expected);
+
+        if (expected)
+        {
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_EQ(hr1.geom_id, hr2.geom_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+    }
+}
+
+TEST(RayStream, AnyHit)
+{
+    auto triangles = make_random_triangles(10000, 1.0f, 0.1f, 2, 0);
+
+    binned_sah_builder builder;
+
+    auto tree = builder.build(index_bvh<triangle_type>{}, triangles.data(), triangles.size());
+    auto ref = tree.ref();
+
+    auto rays = make_random_rays(5000, 7);
+
+    hit_stream hits;
+    any_hit_stream(rays, hits, &ref, &ref + 1);
+
+    ASSERT_EQ(hits.size(), rays.size());
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto r = rays.get_ray(i);
+        auto hr1 = any_hit(r, &ref, &ref + 1, rays.max_t[i]);
+        auto hr2 = hits.get_hit_record(rays, i);
+
+        ASSERT_EQ(hr1.hit, hr2.hit);
+
+        if (hr2.hit)
+        {
+            // Any hit may report another primitive, but it must be a hit closer than max_t
+            EXPECT_TRUE(hr2.t < rays.max_t[i]);
+
+            auto hr3 = intersect(r, triangles[hr2.prim_id]);
+
+            EXPECT_TRUE(hr3.hit);
+            EXPECT_FLOAT_EQ(hr3.t, hr2.t);
+        }
+    }
+
+    // Empty stream
+    ray_stream empty;
+    any_hit_stream(empty, hits, &ref, &ref + 1);
+    EXPECT_EQ(hits.size(), 0U);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Streams carry the ray time, test against motion primitives
+//
+
+TEST(RayStream, MotionBlur)
+{
+    auto triangles = make_random_triangles(5000, 1.0f, 0.1f, 2, 0);
+
+    aligned_vector<basic_motion_triangle<float>> motion_triangles;
+
+    for (auto const& t : triangles)
+    {
+        auto t1 = t;
+        t1.v1 += vec3(0.0f, 0.5f, 0.0f);
+        motion_triangles.push_back(basic_motion_triangle<float>(t, t1));
+    }
+
+    binned_sah_builder builder;
+
+    auto tree = builder.build(
+            motion_bvh<basic_motion_triangle<float>>{},
+            motion_triangles.data(),
+            motion_triangles.size()
+            );
+    auto ref = tree.ref();
+
+    auto rays = make_random_rays(5000, 7);
+
+    std::default_random_engine rng(8);
+    std::uniform_real_distribution<float> time(0.0f, 1.0f);
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        rays.time[i] = time(rng);
+    }
+
+    hit_stream hits;
+    closest_hit_stream(rays, hits, &ref, &ref + 1);
+
+    int num_hits = 0;
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto r = rays.get_ray(i);
+        ASSERT_EQ(r.time, rays.time[i]);
+
+        auto hr1 = closest_hit(r, &ref, &ref + 1);
+        auto hr2 = hits.get_hit_record(rays, i);
+
+        bool expected = hr1.hit && hr1.t < rays.max_t[i];
+
+        ASSERT_EQ(hr2.hit, expected);
+
+        if (expected)
+        {
+            ++num_hits;
+
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_FLOAT_EQ(hr1.t, hr2.t);
+        }
+    }
+
+    EXPECT_TRUE(num_hits > 1000);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Two-level scenes: BVHs over (moving) instances
+//
+
+TEST(RayStream, Instances)
+{
+    using bottom_level_bvh = index_bvh<triangle_type>;
+    using instance_t = bottom_level_bvh::bvh_motion_inst;
+
+    auto triangles = make_random_triangles(2000, 0.5f, 0.1f, 2, 0);
+
+    binned_sah_builder builder;
+
+    auto bottom = builder.build(bottom_level_bvh{}, triangles.data(), triangles.size());
+
+    aligned_vector<instance_t> instances;
+
+    for (int i = 0; i < 4; ++i)
+    {
+        mat4 m = mat4::translation(vec3(i % 2 ? 0.5f : -0.5f, i / 2 ? 0.5f : -0.5f, 0.0f));
+        m = m * mat4::rotation(vec3(0.0f, 1.0f, 0.0f), static_cast<float>(i));
+
+        if (i == 3)
+        {
+            instances.push_back(bottom.motion_inst(m, mat4::translation(vec3(0.0f, 0.3f, 0.0f)) * m));
+        }
+        else
+        {
+            instances.push_back(instance_t(bottom.ref(), m));
+        }
+
+        instances.back().set_inst_id(i + 1);
+
+        if (i == 2)
+        {
+            instances.back().set_geom_id(7);
+        }
+    }
+
+    auto top = builder.build(index_bvh<instance_t>{}, instances.data(), instances.size());
+    auto ref = top.ref();
+
+    auto rays = make_random_rays(5000, 7);
+
+    std::default_random_engine rng(9);
+    std::uniform_real_distribution<float> time(0.0f, 1.0f);
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        rays.time[i] = time(rng);
+    }
+
+    hit_stream hits;
+    closest_hit_stream(rays, hits, &ref, &ref + 1);
+
+    int num_hits = 0;
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto hr1 = closest_hit(rays.get_ray(i), &ref, &ref + 1);
+        auto hr2 = hits.get_hit_record(rays, i);
+
+        bool expected = hr1.hit && hr1.t < rays.max_t[i];
+
+        ASSERT_EQ(hr2.hit, expected);
+
+        if (expected)
+        {
+            ++num_hits;
+
+            EXPECT_EQ(hr1.prim_id, hr2.prim_id);
+            EXPECT_EQ(hr1.geom_id, hr2.geom_id);
+            EXPECT_EQ(hr1.inst_id, static_cast<int>(hits.inst_id[i]));
+            EXPECT_NEAR(hr1.t, hr2.t, 1e-5f);
+        }
+    }
+
+    EXPECT_TRUE(num_hits > 1000);
+
+    // Any hit
+
+    any_hit_stream(rays, hits, &ref, &ref + 1);
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto hr1 = any_hit(rays.get_ray(i), &ref, &ref + 1, rays.max_t[i]);
+
+        ASSERT_EQ(hr1.hit, hits.hit[i] != 0);
+
+        if (hits.hit[i])
+        {
+            EXPECT_TRUE(hits.t[i] < rays.max_t[i]);
+        }
+    }
+
+    // Single instance as the traversed BVH
+
+    closest_hit_stream(rays, hits, &instances[3], &instances[3] + 1);
+
+    for (size_t i = 0; i < rays.size(); ++i)
+    {
+        auto hr1 = closest_hit(rays.get_ray(i), &instances[3], &instances[3] + 1);
+
+        ASSERT_EQ(hr1.hit && hr1.t < rays.max_t[i], hits.hit[i] != 0);
+
+        if (hits.hit[i])
+        {
+            EXPECT_EQ(hr1.prim_id, static_cast<int>(hits.prim_id[i]));
+            EXPECT_EQ(hits.inst_id[i], 4U);
+        }
+    }
+
+    // Scratch reused for consecutive traversals, one level per instance level
+
+    default_intersector isect;
+    ray_stream_scratch scratch;
+    hit_stream hits2;
+
+    closest_hit_stream(rays, hits, &ref, &ref + 1);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        closest_hit_stream(rays, hits2, &ref, &ref + 1, isect, scratch);
+
+        for (size_t i = 0; i < rays.size(); ++i)
+        {
+            ASSERT_EQ(hits2.hit[i], hits.hit[i]);
+
+            if (hits.hit[i])
+            {
+                EXPECT_EQ(hits2.prim_id[i], hits.prim_id[i]);
+                EXPECT_EQ(hits2.t[i], hits.t[i]);
+            }
+        }
+    }
+
+    EXPECT_EQ(scratch.levels.size(), size_t(2));
+}
@@ -0,0 +1,300 @@
+// This file is distributed under the MIT license.
+// See the LICENSE file for details.
+
+#include <cmath>
+
+#include <visionaray/math/math.h>
+#include <visionaray/aligned_vector.h>
+#include <visionaray/bvh.h>
+#include <visionaray/kernels.h>
+#include <visionaray/material.h>
+#include <visionaray/pinhole_camera.h>
+#include <visionaray/point_light.h>
+#include <visionaray/random_generator.h>
+#include <visionaray/scheduler.h>
+#include <visionaray/simple_buffer_rt.h>
+
+#include <gtest/gtest.h>
+
+using namespace visionaray;
+
+
+//-------------------------------------------------------------------------------------------------
+// Helpers
+//
+
+using render_target_type = simple_buffer_rt<PF_RGBA32F, PF_UNSPECIFIED>;
+
+struct scene
+{
+    scene()
+    {
+        spheres.resize(3);
+
+        spheres[0] = basic_sphere<float>(vec3(-1.0f, 0.0f, 0.0f), 1.0f);
+        spheres[1] = basic_sphere<float>(vec3( 1.0f, 0.0f, 0.0f), 1.0f);
+        spheres[2] = basic_sphere<float>(vec3( 0.0f, 1.5f, 0.0f), 0.5f);
+
+        for (size_t i = 0; i < spheres.size(); ++i)
+        {
+            spheres[i].prim_id = static_cast<int>(i);
+            spheres[i].geom_id = static_cast<int>(i);
+        }
+
+        binned_sah_builder builder;
+        bvh = builder.build(index_bvh<basic_sphere<float>>{}, spheres.data(), spheres.size());
+        bvh_refs.push_back(bvh.ref());
+
+        materials.resize(3);
+        materials[0].ca() = from_rgb(0.0f, 0.0f, 0.0f);
+        materials[0].cd() = from_rgb(0.8f, 0.2f, 0.2f);
+        materials[0].ka() = 0.0f;
+        materials[0].kd() = 1.0f;
+        materials[1].ca() = from_rgb(0.0f, 0.0f, 0.0f);
+        materials[1].cd() = from_rgb(0.2f, 0.8f, 0.2f);
+        materials[1].ka() = 0.0f;
+        materials[1].kd() = 1.0f;
+        materials[2].ca() = from_rgb(0.0f, 0.0f, 0.0f);
+        materials[2].cd() = from_rgb(0.2f, 0.2f, 0.8f);
+        materials[2].ka() = 0.0f;
+        materials[2].kd() = 1.0f;
+
+        lights.resize(1);
+        lights[0].set_position(vec3(0.0f, 5.0f, 5.0f));
+        lights[0].set_cl(vec3(1.0f));
+        lights[0].set_kl(20.0f);
+        lights[0].set_constant_attenuation(1.0f);
+        lights[0].set_linear_attenuation(0.0f);
+        lights[0].set_quadratic_attenuation(0.0f);
+
+        cam.perspective(45.0f * constants::degrees_to_radians<float>(), 1.0f, 0.001f, 1000.0f);
+        cam.look_at(vec3(0.0f, 0.0f, 8.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    aligned_vector<basic_sphere<float>> spheres;
+    index_bvh<basic_sphere<float>> bvh;
+    aligned_vector<index_bvh<basic_sphere<float>>::bvh_ref> bvh_refs;
+    aligned_vector<matte<float>> materials;
+    aligned_vector<point_light<float>> lights;
+    pinhole_camera cam;
+};
+
+
+//-------------------------------------------------------------------------------------------------
+// Direct lighting from a point light (one bounce) is deterministic, compare with the
+// pathtracing kernel
+//
+
+TEST(WavefrontSched, DirectLighting)
+{
+    int width = 67;
+    int height = 41;
+
+    scene s;
+    s.cam.set_viewport(0, 0, width, height);
+
+    auto kparams = make_kernel_params(
+            s.bvh_refs.data(),
+            s.bvh_refs.data() + s.bvh_refs.size(),
+            s.materials.data(),
+            s.lights.data(),
+            s.lights.data() + s.lights.size(),
+            1,
+            1e-4f,
+            vec4(0.1f, 0.2f, 0.3f, 1.0f),
+            vec4(0.0f)
+            );
+
+    pathtracing::kernel<decltype(kparams)> kernel;
+    kernel.params = kparams;
+
+    render_target_type rt;
+    rt.resize(width, height);
+
+    wavefront_sched<simd::ray4> sched(3);
+    auto sparams = make_sched_params(s.cam, rt);
+    sched.frame(kernel, sparams);
+
+    random_generator<float> gen(0);
+
+    s.cam.begin_frame();
+
+    int num_lit = 0;
+    int num_mismatches = 0;
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        auto r = detail::make_primary_rays(
+                basic_ray<float>{},
+                pixel_sampler::uniform_type{},
+                gen,
+                i % width,
+                i / width,
+                width,
+                height,
+                s.cam
+                );
+
+        auto c = rt.color()[i];
+        auto e = kernel(r, gen).color;
+
+        // SIMD and scalar math may round differently, pixels
+        // at shadow boundaries may therefore flip
+        if (length(c - e) > 1e-3f * max(1.0f, length(e)))
+        {
+            ++num_mismatches;
+        }
+
+        if (c.x > 0.2f || c.y > 0.3f)
+        {
+            ++num_lit;
+        }
+    }
+
+    EXPECT_LE(num_mismatches, width * height / 100);
+
+    s.cam.end_frame();
+
+    // Make sure the spheres were actually lit
+    EXPECT_GT(num_lit, 0);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Multiple bounces: paths terminate at different bounces, the image must stay finite
+// and converge to the same mean as the pathtracing kernel
+//
+
+TEST(WavefrontSched, MultipleBounces)
+{
+    int width = 32;
+    int height = 32;
+
+    scene s;
+    s.cam.set_viewport(0, 0, width, height);
+
+    auto kparams = make_kernel_params(
+            s.bvh_refs.data(),
+            s.bvh_refs.data() + s.bvh_refs.size(),
+            s.materials.data(),
+            s.lights.data(),
+            s.lights.data() + s.lights.size(),
+            5,
+            1e-4f,
+            vec4(0.0f),
+            vec4(0.5f, 0.5f, 0.5f, 1.0f)
+            );
+
+    pathtracing::kernel<decltype(kparams)> kernel;
+    kernel.params = kparams;
+
+    int const num_frames = 64;
+
+    vec4 sum(0.0f);
+    vec4 expected_sum(0.0f);
+
+    render_target_type rt;
+    rt.resize(width, height);
+
+    wavefront_sched<simd::ray4> sched(2);
+    tiled_sched<basic_ray<float>> ref_sched(2);
+
+    for (int f = 0; f < num_frames; ++f)
+    {
+        auto sparams = make_sched_params(pixel_sampler::jittered_type{}, s.cam, rt);
+        sched.frame(kernel, sparams);
+
+        for (int i = 0; i < width * height; ++i)
+        {
+            auto c = rt.color()[i];
+
+            ASSERT_TRUE(std::isfinite(c.x) && std::isfinite(c.y) && std::isfinite(c.z));
+
+            sum += c;
+        }
+
+        ref_sched.frame(kernel, sparams);
+
+        for (int i = 0; i < width * height; ++i)
+        {
+            expected_sum += rt.color()[i];
+        }
+    }
+
+    sum /= static_cast<float>(num_frames * width * height);
+    expected_sum /= static_cast<float>(num_frames * width * height);
+
+    EXPECT_NEAR(sum.x, expected_sum.x, 0.02f);
+    EXPECT_NEAR(sum.y, expected_sum.y, 0.02f);
+    EXPECT_NEAR(sum.z, expected_sum.z, 0.02f);
+}
+
+
+//-------------------------------------------------------------------------------------------------
+// Sparse material ids are sorted with radix sort instead of counting sort, the
+// order of the materials and thus the image stays the same
+//
+
+TEST(WavefrontSched, SparseMaterialIds)
+{
+    int width = 32;
+    int height = 32;
+
+    scene s;
+    s.cam.set_viewport(0, 0, width, height);
+
+    render_target_type rt;
+    rt.resize(width, height);
+
+    // The schedulers seed with the frame number, use a fresh one per image
+    auto render = [&](wavefront_sched<simd::ray4>& sched)
+    {
+        auto kparams = make_kernel_params(
+                s.bvh_refs.data(),
+                s.bvh_refs.data() + s.bvh_refs.size(),
+                s.materials.data(),
+                s.lights.data(),
+                s.lights.data() + s.lights.size(),
+                3,
+                1e-4f,
+                vec4(0.0f),
+                vec4(0.5f, 0.5f, 0.5f, 1.0f)
+                );
+
+        pathtracing::kernel<decltype(kparams)> kernel;
+        kernel.params = kparams;
+
+        auto sparams = make_sched_params(s.cam, rt);
+        sched.frame(kernel, sparams);
+
+        return aligned_vector<vec4>(rt.color(), rt.color() + width * height);
+    };
+
+    wavefront_sched<simd::ray4> sched1(2);
+    auto dense = render(sched1);
+
+    int const stride = 100000;
+
+    auto materials = s.materials;
+    s.materials.resize(2 * stride + 1);
+
+    for (size_t i = 0; i < s.spheres.size(); ++i)
+    {
+        s.spheres[i].geom_id = static_cast<int>(i) * stride;
+        s.materials[i * stride] = materials[i];
+    }
+
+    binned_sah_builder builder;
+    s.bvh = builder.build(index_bvh<basic_sphere<float>>{}, s.spheres.data(), s.spheres.size());
+    s.bvh_refs[0] = s.bvh.ref();
+
+    wavefront_sched<simd::ray4> sched2(2);
+    auto sparse = render(sched2);
+
+    for (int i = 0; i < width * height; ++i)
+    {
+        EXPECT_FLOAT_EQ(dense[i].x, sparse[i].x);
+        EXPECT_FLOAT_EQ(dense[i].y, sparse[i].y);
+        EXPECT_FLOAT_EQ(dense[i].z, sparse[i].z);
+    }
+}